@@ -17,6 +17,7 @@ extern int num_processors;
 extern int disabled_cpus;
 extern cpumask_t cpu_sibling_map[];
 extern cpumask_t cpu_core_map[];
+extern cpumask_t cpu_cluster_map[];
 extern cpumask_t cpu_foreign_map[];
 
 void loongson_smp_setup(void);
@@ -67,7 +68,8 @@ struct secondary_data {
 	unsigned long stack;
 	unsigned long thread_info;
 };
-extern struct secondary_data cpuboot_data;
+/* Indexed by physical CPU id, so that several CPUs can be started at once */
+extern struct secondary_data cpuboot_data[NR_CPUS];
 
 extern asmlinkage void smpboot_entry(void);
 
@@ -33,6 +33,12 @@ void numa_set_distance(int from, int to, int distance);
 #define topology_core_id(cpu)			(cpu_data[cpu].core)
 #define topology_core_cpumask(cpu)		(&cpu_core_map[cpu])
 #define topology_sibling_cpumask(cpu)		(&cpu_sibling_map[cpu])
+#define topology_cluster_id(cpu)		(cpu_data[cpu].cluster)
+#define topology_cluster_cpumask(cpu)		(&cpu_cluster_map[cpu])
+
+#ifdef CONFIG_SCHED_CLUSTER
+const struct cpumask *cpu_clustergroup_mask(int cpu);
+#endif
 #endif
 
 #include <asm-generic/topology.h>
@@ -165,6 +165,15 @@ int __init parse_acpi_topology(void)
 
 			cpu_data[cpu].core = topology_id;
 		}
+
+		/*
+		 * Without a cluster level in the PPTT, the package ID is
+		 * returned instead. Keep the default cluster in that case.
+		 */
+		topology_id = find_acpi_cpu_topology_cluster(cpu);
+		if (topology_id >= 0 &&
+		    topology_id != find_acpi_cpu_topology_package(cpu))
+			cpu_data[cpu].cluster = topology_id;
 	}
 
 	pptt_enabled = 1;
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/sched/clock.h>
 #include <asm/alternative.h>
 #include <asm/cacheflush.h>
 #include <asm/inst.h>
@@ -240,7 +241,13 @@ void __init_or_module apply_alternatives(struct alt_instr *start, struct alt_ins
 
 void __init alternative_instructions(void)
 {
+	u64 start = local_clock();
+
 	apply_alternatives(__alt_instructions, __alt_instructions_end);
 
 	alternatives_patched = 1;
+
+	pr_debug("%s: applied %td entries in %llu us\n", __func__,
+		 __alt_instructions_end - __alt_instructions,
+		 div_u64(local_clock() - start, NSEC_PER_USEC));
 }
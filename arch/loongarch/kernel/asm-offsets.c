@@ -257,6 +257,7 @@ void output_smpboot_defines(void)
 	COMMENT("Linux smp cpu boot offsets.");
 	OFFSET(CPU_BOOT_STACK, secondary_data, stack);
 	OFFSET(CPU_BOOT_TINFO, secondary_data, thread_info);
+	DEFINE(CPU_BOOT_SIZE, sizeof(struct secondary_data));
 	BLANK();
 }
 #endif
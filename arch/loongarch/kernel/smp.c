@@ -13,6 +13,7 @@
 #include <linux/cpumask.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
+#include <linux/ktime.h>
 #include <linux/seq_file.h>
 #include <linux/smp.h>
 #include <linux/threads.h>
@@ -46,8 +47,17 @@ EXPORT_SYMBOL(cpu_sibling_map);
 cpumask_t cpu_core_map[NR_CPUS] __read_mostly;
 EXPORT_SYMBOL(cpu_core_map);
 
+/* Representing the cores sharing a cluster (L3 slice) of each logical CPU */
+cpumask_t cpu_cluster_map[NR_CPUS] __read_mostly;
+EXPORT_SYMBOL(cpu_cluster_map);
+
+#ifndef CONFIG_HOTPLUG_PARALLEL
 static DECLARE_COMPLETION(cpu_starting);
 static DECLARE_COMPLETION(cpu_running);
+#endif
+
+/* When smp_prepare_cpus() started, to report how long bring-up took */
+static ktime_t smp_bringup_start __initdata;
 
 /*
  * A logcal cpu mask containing only one VPE per core to
@@ -62,7 +72,22 @@ static cpumask_t cpu_sibling_setup_map;
 /* representing cpus for which core maps can be computed */
 static cpumask_t cpu_core_setup_map;
 
-struct secondary_data cpuboot_data;
+/* representing cpus for which cluster maps can be computed */
+static cpumask_t cpu_cluster_setup_map;
+
+/*
+ * Loongson-3 processors group 4 cores around a shared L3; this is used
+ * when the firmware doesn't describe clusters in the PPTT.
+ */
+#define LOONGSON_CORES_PER_CLUSTER	4
+
+static inline int cpu_default_cluster(int cpu)
+{
+	return (cpu_logical_map(cpu) % loongson_sysconf.cores_per_package) /
+		LOONGSON_CORES_PER_CLUSTER;
+}
+
+struct secondary_data cpuboot_data[NR_CPUS];
 static DEFINE_PER_CPU(int, cpu_state);
 
 enum ipi_msg_type {
@@ -226,6 +251,9 @@ void __init loongson_prepare_cpus(unsigned int max_cpus)
 {
 	int i = 0;
 
+	for_each_possible_cpu(i)
+		cpu_data[i].cluster = cpu_default_cluster(i);
+
 	parse_acpi_topology();
 
 	for (i = 0; i < loongson_sysconf.nr_cpus; i++) {
@@ -242,13 +270,14 @@ void __init loongson_prepare_cpus(unsigned int max_cpus)
  */
 void loongson_boot_secondary(int cpu, struct task_struct *idle)
 {
+	struct secondary_data *data = &cpuboot_data[cpu_logical_map(cpu)];
 	unsigned long entry;
 
 	pr_info("Booting CPU#%d...\n", cpu);
 
 	entry = __pa_symbol((unsigned long)&smpboot_entry);
-	cpuboot_data.stack = (unsigned long)__KSTK_TOS(idle);
-	cpuboot_data.thread_info = (unsigned long)task_thread_info(idle);
+	data->stack = (unsigned long)__KSTK_TOS(idle);
+	data->thread_info = (unsigned long)task_thread_info(idle);
 
 	csr_mail_send(entry, cpu_logical_map(cpu), 0);
 
@@ -276,6 +305,8 @@ void loongson_init_secondary(void)
 		     cpu_logical_map(cpu) / loongson_sysconf.cores_per_package;
 	cpu_data[cpu].core = pptt_enabled ? cpu_data[cpu].core :
 		     cpu_logical_map(cpu) % loongson_sysconf.cores_per_package;
+	cpu_data[cpu].cluster = pptt_enabled ? cpu_data[cpu].cluster :
+		     cpu_default_cluster(cpu);
 }
 
 void loongson_smp_finish(void)
@@ -326,6 +357,7 @@ void play_dead(void)
 	local_irq_enable();
 	set_csr_ecfg(ECFGF_IPI);
 	__this_cpu_write(cpu_state, CPU_DEAD);
+	cpuhp_ap_report_dead();
 
 	__smp_mb();
 	do {
@@ -403,6 +435,29 @@ static inline void set_cpu_core_map(int cpu)
 	}
 }
 
+static inline void set_cpu_cluster_map(int cpu)
+{
+	int i;
+
+	cpumask_set_cpu(cpu, &cpu_cluster_setup_map);
+
+	for_each_cpu(i, &cpu_cluster_setup_map) {
+		if (cpu_data[cpu].package == cpu_data[i].package &&
+		    cpu_data[cpu].cluster == cpu_data[i].cluster) {
+			cpumask_set_cpu(i, &cpu_cluster_map[cpu]);
+			cpumask_set_cpu(cpu, &cpu_cluster_map[i]);
+		}
+	}
+}
+
+#ifdef CONFIG_SCHED_CLUSTER
+/* maps the cpu to the sched domain representing a cluster */
+const struct cpumask *cpu_clustergroup_mask(int cpu)
+{
+	return &cpu_cluster_map[cpu];
+}
+#endif
+
 /*
  * Calculate a new cpu_foreign_map mask whenever a
  * new cpu appears or disappears.
@@ -466,17 +521,36 @@ void smp_prepare_boot_cpu(void)
 /* called from main before smp_init() */
 void __init smp_prepare_cpus(unsigned int max_cpus)
 {
+	smp_bringup_start = ktime_get();
 	init_new_context(current, &init_mm);
 	current_thread_info()->cpu = 0;
 	loongson_prepare_cpus(max_cpus);
 	set_cpu_sibling_map(0);
 	set_cpu_core_map(0);
+	set_cpu_cluster_map(0);
 	calculate_cpu_foreign_map();
 #ifndef CONFIG_HOTPLUG_CPU
 	init_cpu_present(cpu_possible_mask);
 #endif
 }
 
+#ifdef CONFIG_HOTPLUG_PARALLEL
+/*
+ * Each CPU gets its own boot stack slot, so all of them can be kicked
+ * through the mailbox before waiting for any. The hotplug core then waits
+ * for each in cpuhp_ap_sync_alive() and releases them one by one.
+ */
+int arch_cpuhp_kick_ap_alive(unsigned int cpu, struct task_struct *tidle)
+{
+	loongson_boot_secondary(cpu, tidle);
+	return 0;
+}
+
+bool __init arch_cpuhp_init_parallel_bringup(void)
+{
+	return true;
+}
+#else
 int __cpu_up(unsigned int cpu, struct task_struct *tidle)
 {
 	loongson_boot_secondary(cpu, tidle);
@@ -493,6 +567,7 @@ int __cpu_up(unsigned int cpu, struct task_struct *tidle)
 
 	return 0;
 }
+#endif
 
 /*
  * First C code run on the secondary CPUs after being started up by
@@ -506,28 +581,42 @@ asmlinkage void start_secondary(void)
 	cpu = smp_processor_id();
 	set_my_cpu_offset(per_cpu_offset(cpu));
 
+	/*
+	 * Synchronization point with the hotplug core when CPUs are brought
+	 * up in parallel: wait for the control CPU to release this one. All
+	 * below updates global state (hwcaps, topology maps) and must not run
+	 * concurrently with other CPUs.
+	 */
+	if (IS_ENABLED(CONFIG_HOTPLUG_PARALLEL))
+		cpuhp_ap_sync_alive();
+
 	cpu_probe();
 	constant_clockevent_init();
 	loongson_init_secondary();
 
 	set_cpu_sibling_map(cpu);
 	set_cpu_core_map(cpu);
+	set_cpu_cluster_map(cpu);
 
 	notify_cpu_starting(cpu);
 
+#ifndef CONFIG_HOTPLUG_PARALLEL
 	/* Notify boot CPU that we're starting */
 	complete(&cpu_starting);
+#endif
 
 	/* The CPU is running, now mark it online */
 	set_cpu_online(cpu, true);
 
 	calculate_cpu_foreign_map();
 
+#ifndef CONFIG_HOTPLUG_PARALLEL
 	/*
 	 * Notify boot CPU that we're up & online and it can safely return
 	 * from __cpu_up()
 	 */
 	complete(&cpu_running);
+#endif
 
 	/*
 	 * irq will be enabled in loongson_smp_finish(), enabling it too
@@ -541,6 +630,8 @@ asmlinkage void start_secondary(void)
 
 void __init smp_cpus_done(unsigned int max_cpus)
 {
+	pr_info("SMP: %u CPUs brought up in %lld us\n", num_online_cpus(),
+		ktime_us_delta(ktime_get(), smp_bringup_start));
 }
 
 static void stop_this_cpu(void *dummy)
@@ -10,6 +10,7 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/objtool.h>
+#include <linux/sched/clock.h>
 #include <linux/sched/task_stack.h>
 #include <linux/sort.h>
 
@@ -41,9 +42,6 @@ extern struct orc_entry __stop_orc_unwind[];
 static bool orc_init __ro_after_init;
 static unsigned int lookup_num_blocks __ro_after_init;
 
-static int *cur_orc_ip_table = __start_orc_unwind_ip;
-static struct orc_entry *cur_orc_table = __start_orc_unwind;
-
 static inline unsigned long orc_ip(const int *ip)
 {
 	return (unsigned long)ip + *ip;
@@ -155,10 +153,19 @@ static struct orc_entry *orc_find(unsigned long ip)
 }
 
 #ifdef CONFIG_MODULES
-static DEFINE_MUTEX(sort_mutex);
+/*
+ * Lets the sort callbacks associate an .orc_unwind_ip table entry with its
+ * corresponding .orc_unwind entry, without serializing the sorts of modules
+ * loaded in parallel on global state.
+ */
+struct orc_sort_tables {
+	int			*orc_ip;
+	struct orc_entry	*orc;
+};
 
-static void orc_sort_swap(void *_a, void *_b, int size)
+static void orc_sort_swap(void *_a, void *_b, int size, const void *priv)
 {
+	const struct orc_sort_tables *tables = priv;
 	struct orc_entry *orc_a, *orc_b;
 	struct orc_entry orc_tmp;
 	int *a = _a, *b = _b, tmp;
@@ -170,15 +177,16 @@ static void orc_sort_swap(void *_a, void *_b, int size)
 	*b = tmp - delta;
 
 	/* Swap the corresponding .orc_unwind entries: */
-	orc_a = cur_orc_table + (a - cur_orc_ip_table);
-	orc_b = cur_orc_table + (b - cur_orc_ip_table);
+	orc_a = tables->orc + (a - tables->orc_ip);
+	orc_b = tables->orc + (b - tables->orc_ip);
 	orc_tmp = *orc_a;
 	*orc_a = *orc_b;
 	*orc_b = orc_tmp;
 }
 
-static int orc_sort_cmp(const void *_a, const void *_b)
+static int orc_sort_cmp(const void *_a, const void *_b, const void *priv)
 {
+	const struct orc_sort_tables *tables = priv;
 	struct orc_entry *orc_a;
 	const int *a = _a, *b = _b;
 	unsigned long a_val = orc_ip(a);
@@ -195,31 +203,50 @@ static int orc_sort_cmp(const void *_a, const void *_b)
 	 * These terminator entries exist to handle any gaps created by
 	 * whitelisted .o files which didn't get objtool generation.
 	 */
-	orc_a = cur_orc_table + (a - cur_orc_ip_table);
+	orc_a = tables->orc + (a - tables->orc_ip);
 	return orc_a->type == ORC_TYPE_UNDEFINED ? -1 : 1;;
 }
 
+/*
+ * objtool emits the entries of each object in address order, so the tables
+ * of a module are often sorted already.  Ties are left to orc_sort_cmp().
+ */
+static bool orc_sorted(int *ip_table, unsigned int num_entries)
+{
+	unsigned int i;
+
+	for (i = 1; i < num_entries; i++)
+		if (orc_ip(&ip_table[i - 1]) >= orc_ip(&ip_table[i]))
+			return false;
+
+	return true;
+}
+
 void unwind_module_init(struct module *mod, void *_orc_ip, size_t orc_ip_size,
 			void *_orc, size_t orc_size)
 {
 	int *orc_ip = _orc_ip;
 	struct orc_entry *orc = _orc;
 	unsigned int num_entries = orc_ip_size / sizeof(int);
+	struct orc_sort_tables tables = {
+		.orc_ip	= orc_ip,
+		.orc	= orc,
+	};
+	u64 start = local_clock();
+	bool sorted;
 
 	WARN_ON_ONCE(orc_ip_size % sizeof(int) != 0 ||
 		     orc_size % sizeof(*orc) != 0 ||
 		     num_entries != orc_size / sizeof(*orc));
 
-	/*
-	 * The 'cur_orc_*' globals allow the orc_sort_swap() callback to
-	 * associate an .orc_unwind_ip table entry with its corresponding
-	 * .orc_unwind entry so they can both be swapped.
-	 */
-	mutex_lock(&sort_mutex);
-	cur_orc_ip_table = orc_ip;
-	cur_orc_table = orc;
-	sort(orc_ip, num_entries, sizeof(int), orc_sort_cmp, orc_sort_swap);
-	mutex_unlock(&sort_mutex);
+	sorted = orc_sorted(orc_ip, num_entries);
+	if (!sorted)
+		sort_r(orc_ip, num_entries, sizeof(int), orc_sort_cmp,
+		       orc_sort_swap, &tables);
+
+	pr_debug("%s: %u ORC entries %s in %llu ns\n", mod->name, num_entries,
+		 sorted ? "checked" : "sorted",
+		 local_clock() - start);
 
 	mod->arch.orc_unwind_ip = orc_ip;
 	mod->arch.orc_unwind = orc;
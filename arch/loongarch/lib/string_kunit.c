@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Benchmarks for the LoongArch copy_user, clear_user and memmove routines.
+ *
+ * Each variant is timed over a range of sizes and source/destination
+ * misalignments, and its result is checked once per configuration. The
+ * user copy routines are called on kernel buffers: LoongArch has no
+ * separate user address space to switch to, so this measures exactly the
+ * code uaccess runs.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <kunit/test.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/random.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/types.h>
+
+#include <asm/cpu-features.h>
+#include <asm/uaccess.h>
+
+unsigned long __copy_user_generic(void *to, const void *from, size_t n);
+unsigned long __copy_user_fast(void *to, const void *from, size_t n);
+unsigned long __clear_user_generic(void __user *addr, size_t size);
+unsigned long __clear_user_fast(void __user *addr, size_t size);
+
+#define BENCH_MAX_SIZE		SZ_64K
+#define BENCH_MAX_OFFSET	8
+#define BENCH_BUF_SIZE		(BENCH_MAX_SIZE + 2 * BENCH_MAX_OFFSET)
+/* Bytes to move per configuration, so small sizes run enough iterations */
+#define BENCH_BYTES		SZ_16M
+
+static const size_t bench_sizes[] = { 8, 15, 64, 255, 1024, 4096, SZ_64K };
+static const unsigned int bench_offsets[][2] = {
+	{ 0, 0 }, { 1, 0 }, { 0, 1 }, { 3, 5 }, { 7, 7 },
+};
+
+struct bench_buf {
+	u8 *src;
+	u8 *dst;
+	u8 *ref;
+};
+
+static void bench_buf_init(struct kunit *test, struct bench_buf *buf)
+{
+	buf->src = kunit_kmalloc(test, BENCH_BUF_SIZE, GFP_KERNEL);
+	buf->dst = kunit_kmalloc(test, BENCH_BUF_SIZE, GFP_KERNEL);
+	buf->ref = kunit_kmalloc(test, BENCH_BUF_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, buf->src);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, buf->dst);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, buf->ref);
+
+	get_random_bytes(buf->src, BENCH_BUF_SIZE);
+}
+
+static unsigned int bench_loops(size_t size)
+{
+	return max_t(unsigned int, BENCH_BYTES / size, 1);
+}
+
+/* Report MB/s, which is bytes per microsecond */
+static void bench_report(struct kunit *test, const char *name, size_t size,
+			 const unsigned int *off, unsigned int loops, u64 ns)
+{
+	u64 bytes = (u64)size * loops;
+
+	kunit_info(test, "%-24s size %6zu dst+%u src+%u: %6llu MB/s\n",
+		   name, size, off[0], off[1],
+		   div64_u64(bytes * NSEC_PER_USEC, max_t(u64, ns, 1)));
+}
+
+typedef unsigned long (*copy_user_fn)(void *, const void *, size_t);
+
+static void bench_copy_user(struct kunit *test, const char *name,
+			    copy_user_fn fn)
+{
+	struct bench_buf buf;
+	int i, j;
+
+	bench_buf_init(test, &buf);
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(bench_offsets); j++) {
+			const unsigned int *off = bench_offsets[j];
+			size_t size = bench_sizes[i];
+			unsigned int loops = bench_loops(size), n;
+			u8 *dst = buf.dst + off[0];
+			u8 *src = buf.src + off[1];
+			u64 start, ns;
+
+			memset(buf.dst, 0, BENCH_BUF_SIZE);
+			KUNIT_ASSERT_EQ(test, fn(dst, src, size), 0);
+			KUNIT_ASSERT_EQ(test, memcmp(dst, src, size), 0);
+
+			start = ktime_get_ns();
+			for (n = 0; n < loops; n++)
+				fn(dst, src, size);
+			ns = ktime_get_ns() - start;
+
+			bench_report(test, name, size, off, loops, ns);
+			cond_resched();
+		}
+	}
+}
+
+static void copy_user_bench(struct kunit *test)
+{
+	bench_copy_user(test, "__copy_user_generic", __copy_user_generic);
+	if (cpu_has_ual)
+		bench_copy_user(test, "__copy_user_fast", __copy_user_fast);
+}
+
+typedef unsigned long (*clear_user_fn)(void __user *, size_t);
+
+static void bench_clear_user(struct kunit *test, const char *name,
+			     clear_user_fn fn)
+{
+	struct bench_buf buf;
+	int i, j;
+
+	bench_buf_init(test, &buf);
+	memset(buf.ref, 0, BENCH_BUF_SIZE);
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(bench_offsets); j++) {
+			const unsigned int *off = bench_offsets[j];
+			size_t size = bench_sizes[i];
+			unsigned int loops = bench_loops(size), n;
+			u8 *dst = buf.dst + off[0];
+			u64 start, ns;
+
+			memset(buf.dst, 0xa5, BENCH_BUF_SIZE);
+			KUNIT_ASSERT_EQ(test, fn((__force void __user *)dst, size), 0);
+			KUNIT_ASSERT_EQ(test, memcmp(dst, buf.ref, size), 0);
+			KUNIT_ASSERT_EQ(test, dst[size], 0xa5);
+
+			start = ktime_get_ns();
+			for (n = 0; n < loops; n++)
+				fn((__force void __user *)dst, size);
+			ns = ktime_get_ns() - start;
+
+			bench_report(test, name, size, off, loops, ns);
+			cond_resched();
+		}
+	}
+}
+
+static void clear_user_bench(struct kunit *test)
+{
+	bench_clear_user(test, "__clear_user_generic", __clear_user_generic);
+	if (cpu_has_ual)
+		bench_clear_user(test, "__clear_user_fast", __clear_user_fast);
+}
+
+/*
+ * memmove() picks the copy direction itself, so run it on overlapping
+ * buffers both ways: dst below src copies forward, dst above src backward.
+ */
+static void bench_memmove(struct kunit *test, const char *name, bool backward)
+{
+	struct bench_buf buf;
+	int i, j;
+
+	bench_buf_init(test, &buf);
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(bench_offsets); j++) {
+			const unsigned int *off = bench_offsets[j];
+			size_t size = bench_sizes[i];
+			unsigned int loops = bench_loops(size), n;
+			/* Keep the two ranges overlapping for every size */
+			size_t gap = min_t(size_t, size / 2, BENCH_MAX_OFFSET) + 1;
+			u8 *lo = buf.dst + off[0];
+			u8 *hi = buf.dst + off[1] + gap;
+			u8 *dst = backward ? hi : lo;
+			u8 *src = backward ? lo : hi;
+			u64 start, ns;
+
+			memcpy(buf.dst, buf.src, BENCH_BUF_SIZE);
+			memcpy(buf.ref, src, size);
+			memmove(dst, src, size);
+			KUNIT_ASSERT_EQ(test, memcmp(dst, buf.ref, size), 0);
+
+			start = ktime_get_ns();
+			for (n = 0; n < loops; n++)
+				memmove(dst, src, size);
+			ns = ktime_get_ns() - start;
+
+			bench_report(test, name, size, off, loops, ns);
+			cond_resched();
+		}
+	}
+}
+
+static void memmove_bench(struct kunit *test)
+{
+	bench_memmove(test, "memmove forward", false);
+	bench_memmove(test, "memmove backward", true);
+}
+
+static struct kunit_case string_bench_cases[] = {
+	KUNIT_CASE(copy_user_bench),
+	KUNIT_CASE(clear_user_bench),
+	KUNIT_CASE(memmove_bench),
+	{}
+};
+
+static struct kunit_suite string_bench_suite = {
+	.name = "loongarch_string_bench",
+	.test_cases = string_bench_cases,
+};
+
+kunit_test_suite(string_bench_suite);
@@ -47,6 +47,8 @@ struct veth_stats {
 	u64	xdp_drops;
 	u64	xdp_tx;
 	u64	xdp_tx_err;
+	u64	xdp_frames_gro;
+	u64	skb_alloc_err;
 	u64	peer_tq_xdp_xmit;
 	u64	peer_tq_xdp_xmit_err;
 };
@@ -101,6 +103,8 @@ static const struct veth_q_stat_desc veth_rq_stats_desc[] = {
 	{ "xdp_drops",		VETH_RQ_STAT(xdp_drops) },
 	{ "xdp_tx",		VETH_RQ_STAT(xdp_tx) },
 	{ "xdp_tx_errors",	VETH_RQ_STAT(xdp_tx_err) },
+	{ "xdp_frames_gro",	VETH_RQ_STAT(xdp_frames_gro) },
+	{ "skb_alloc_errors",	VETH_RQ_STAT(skb_alloc_err) },
 };
 
 #define VETH_RQ_STATS_LEN	ARRAY_SIZE(veth_rq_stats_desc)
@@ -672,7 +676,11 @@ static struct xdp_frame *veth_xdp_rcv_one(struct veth_rq *rq,
 	return NULL;
 }
 
-/* frames array contains VETH_XDP_BATCH at most */
+/* frames array contains VETH_XDP_BATCH at most.
+ * Frames coming from a page_pool backed device build skbs marked for
+ * recycling, so their pages go back to the originating pool once the
+ * (possibly GRO merged) skb is freed.
+ */
 static void veth_xdp_rcv_bulk_skb(struct veth_rq *rq, void **frames,
 				  int n_xdpf, struct veth_xdp_tx_bq *bq,
 				  struct veth_stats *stats)
@@ -685,6 +693,7 @@ static void veth_xdp_rcv_bulk_skb(struct veth_rq *rq, void **frames,
 		for (i = 0; i < n_xdpf; i++)
 			xdp_return_frame(frames[i]);
 		stats->rx_drops += n_xdpf;
+		stats->skb_alloc_err += n_xdpf;
 
 		return;
 	}
@@ -697,9 +706,11 @@ static void veth_xdp_rcv_bulk_skb(struct veth_rq *rq, void **frames,
 		if (!skb) {
 			xdp_return_frame(frames[i]);
 			stats->rx_drops++;
+			stats->skb_alloc_err++;
 			continue;
 		}
 		napi_gro_receive(&rq->xdp_napi, skb);
+		stats->xdp_frames_gro++;
 	}
 }
 
@@ -980,6 +991,8 @@ static int veth_xdp_rcv(struct veth_rq *rq, int budget,
 	rq->stats.vs.xdp_bytes += stats->xdp_bytes;
 	rq->stats.vs.xdp_drops += stats->xdp_drops;
 	rq->stats.vs.rx_drops += stats->rx_drops;
+	rq->stats.vs.xdp_frames_gro += stats->xdp_frames_gro;
+	rq->stats.vs.skb_alloc_err += stats->skb_alloc_err;
 	rq->stats.vs.xdp_packets += done;
 	u64_stats_update_end(&rq->stats.syncp);
 
@@ -34,6 +34,7 @@
 #include <linux/security.h>
 #include <linux/gfp.h>
 #include <linux/socket.h>
+#include <linux/net.h>
 #include <linux/sched/signal.h>
 
 #include "internal.h"
@@ -800,6 +801,111 @@ iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
 
 EXPORT_SYMBOL(iter_file_splice_write);
 
+/*
+ * Send as many pipe buffers as fit in one bio_vec array through a single
+ * sendmsg(MSG_SPLICE_PAGES) call, instead of one ->sendpage() per buffer.
+ * Only used for sockets that set SOCK_SPLICE_PAGES.
+ */
+static ssize_t splice_to_socket(struct pipe_inode_info *pipe,
+				struct socket *sock, size_t len,
+				unsigned int flags)
+{
+	struct splice_desc sd = {
+		.total_len = len,
+		.flags = flags,
+	};
+	struct bio_vec bvec[16];
+	ssize_t ret;
+
+	pipe_lock(pipe);
+
+	splice_from_pipe_begin(&sd);
+	while (sd.total_len) {
+		struct msghdr msg = {};
+		unsigned int head, tail, mask;
+		size_t left;
+		int n;
+
+		ret = splice_from_pipe_next(pipe, &sd);
+		if (ret <= 0)
+			break;
+
+		head = pipe->head;
+		tail = pipe->tail;
+		mask = pipe->ring_size - 1;
+
+		/* build the vector */
+		left = sd.total_len;
+		for (n = 0; !pipe_empty(head, tail) && left &&
+			    n < ARRAY_SIZE(bvec); tail++) {
+			struct pipe_buffer *buf = &pipe->bufs[tail & mask];
+			size_t this_len = buf->len;
+
+			/* zero-length bvecs are not supported, skip them */
+			if (!this_len)
+				continue;
+			this_len = min(this_len, left);
+
+			ret = pipe_buf_confirm(pipe, buf);
+			if (unlikely(ret)) {
+				if (ret == -ENODATA)
+					ret = 0;
+				goto done;
+			}
+
+			bvec_set_page(&bvec[n], buf->page, this_len,
+				      buf->offset);
+			left -= this_len;
+			n++;
+		}
+
+		msg.msg_flags = MSG_SPLICE_PAGES;
+		if (flags & SPLICE_F_MORE)
+			msg.msg_flags |= MSG_MORE;
+		if (left && !pipe_empty(head, tail))
+			msg.msg_flags |= MSG_MORE;
+		if (sock->file->f_flags & O_NONBLOCK)
+			msg.msg_flags |= MSG_DONTWAIT;
+
+		iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, bvec, n,
+			      sd.total_len - left);
+		ret = sock_sendmsg(sock, &msg);
+		if (ret <= 0)
+			break;
+
+		sd.num_spliced += ret;
+		sd.total_len -= ret;
+
+		/* dismiss the fully eaten buffers, adjust the partial one */
+		tail = pipe->tail;
+		while (ret) {
+			struct pipe_buffer *buf = &pipe->bufs[tail & mask];
+			if (ret >= buf->len) {
+				ret -= buf->len;
+				buf->len = 0;
+				pipe_buf_release(pipe, buf);
+				tail++;
+				pipe->tail = tail;
+				if (pipe->files)
+					sd.need_wakeup = true;
+			} else {
+				buf->offset += ret;
+				buf->len -= ret;
+				ret = 0;
+			}
+		}
+	}
+done:
+	splice_from_pipe_end(pipe, &sd);
+
+	pipe_unlock(pipe);
+
+	if (sd.num_spliced)
+		ret = sd.num_spliced;
+
+	return ret;
+}
+
 /**
  * generic_splice_sendpage - splice data from a pipe to a socket
  * @pipe:	pipe to splice from
@@ -816,6 +922,11 @@ EXPORT_SYMBOL(iter_file_splice_write);
 ssize_t generic_splice_sendpage(struct pipe_inode_info *pipe, struct file *out,
 				loff_t *ppos, size_t len, unsigned int flags)
 {
+	struct socket *sock = sock_from_file(out);
+
+	if (sock && test_bit(SOCK_SPLICE_PAGES, &sock->flags))
+		return splice_to_socket(pipe, sock, len, flags);
+
 	return splice_from_pipe(pipe, out, ppos, len, flags, pipe_to_sendpage);
 }
 
@@ -786,6 +786,10 @@ struct mm_struct {
 		 */
 		unsigned long ksm_rmap_items;
 #endif
+#ifdef CONFIG_FUTEX
+		/* private futex hash, see kernel/futex/core.c */
+		struct futex_private_hash *futex_phash;
+#endif
 #ifdef CONFIG_LRU_GEN
 		struct {
 			/* this mm_struct is on lru_gen_mm_list */
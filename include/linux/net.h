@@ -43,6 +43,7 @@ struct net;
 #define SOCK_PASSSEC		4
 #define SOCK_SUPPORT_ZC		5
 #define SOCK_CUSTOM_SOCKOPT	6
+#define SOCK_SPLICE_PAGES	7
 
 #ifndef ARCH_HAS_SOCKET_TYPES
 /**
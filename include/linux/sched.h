@@ -37,6 +37,7 @@
 #include <linux/kcsan.h>
 #include <linux/rv.h>
 #include <linux/livepatch_sched.h>
+#include <linux/sched/ext.h>
 #include <asm/kmap_size.h>
 
 /* task_struct member predeclarations (sorted alphabetically): */
@@ -557,6 +558,9 @@ struct sched_entity {
 	u64				sum_exec_runtime;
 	u64				vruntime;
 	u64				prev_sum_exec_runtime;
+	/* virtual deadline and the min_deadline of the rbtree subtree: */
+	u64				deadline;
+	u64				min_deadline;
 
 	u64				nr_migrations;
 
@@ -785,11 +789,15 @@ struct task_struct {
 	int				prio;
 	int				static_prio;
 	int				normal_prio;
+	int				latency_prio;
 	unsigned int			rt_priority;
 
 	struct sched_entity		se;
 	struct sched_rt_entity		rt;
 	struct sched_dl_entity		dl;
+#ifdef CONFIG_SCHED_CLASS_EXT
+	struct sched_ext_entity		scx;
+#endif
 	const struct sched_class	*sched_class;
 
 #ifdef CONFIG_SCHED_CORE
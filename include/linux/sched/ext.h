@@ -0,0 +1,255 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * BPF extensible scheduler class, see kernel/sched/ext.c
+ */
+#ifndef _LINUX_SCHED_EXT_H
+#define _LINUX_SCHED_EXT_H
+
+#ifdef CONFIG_SCHED_CLASS_EXT
+
+#include <linux/list.h>
+#include <linux/rhashtable-types.h>
+#include <linux/spinlock_types.h>
+
+struct task_struct;
+
+enum scx_consts {
+	SCX_OPS_NAME_LEN	= 128,
+	SCX_EXIT_REASON_LEN	= 128,
+	SCX_EXIT_MSG_LEN	= 1024,
+
+	SCX_SLICE_DFL		= 20 * 1000000,	/* 20ms */
+};
+
+/*
+ * Dispatch queue (dsq) IDs. Builtin DSQs have bit 63 set, the rest of the
+ * ID space is free for the BPF scheduler to use with scx_bpf_create_dsq().
+ */
+enum scx_dsq_id_flags {
+	SCX_DSQ_FLAG_BUILTIN	= 1LLU << 63,
+
+	SCX_DSQ_INVALID		= SCX_DSQ_FLAG_BUILTIN | 0,
+	SCX_DSQ_GLOBAL		= SCX_DSQ_FLAG_BUILTIN | 1,
+	SCX_DSQ_LOCAL		= SCX_DSQ_FLAG_BUILTIN | 2,
+};
+
+/*
+ * A dispatch queue is a FIFO of runnable tasks. Each CPU has a local DSQ
+ * from which it picks the next task; the global DSQ and the DSQs created
+ * by the BPF scheduler are shared and get consumed into local DSQs.
+ */
+struct scx_dispatch_q {
+	raw_spinlock_t		lock;
+	struct list_head	fifo;
+	u32			nr;
+	u64			id;
+	struct rhash_head	hash_node;
+	struct rcu_head		rcu;
+};
+
+/* scx_entity.flags, protected by the rq lock */
+enum scx_ent_flags {
+	SCX_TASK_QUEUED		= 1 << 0, /* on ext runqueue */
+	SCX_TASK_ENQ_LOCAL	= 1 << 1, /* next enqueue goes to the local DSQ */
+};
+
+/* scx_entity.kf_mask, the kfuncs the current sched_ext_ops call may use */
+enum scx_kf_mask {
+	SCX_KF_INIT		= 1 << 0, /* ops.init() */
+	SCX_KF_SELECT_CPU	= 1 << 1, /* ops.select_cpu() */
+	SCX_KF_ENQUEUE		= 1 << 2, /* ops.enqueue() */
+	SCX_KF_DISPATCH		= 1 << 3, /* ops.dispatch() */
+	SCX_KF_REST		= 1 << 4, /* other rq-locked operations */
+	SCX_KF_EXIT		= 1 << 5, /* ops.exit() */
+
+	SCX_KF_ANY		= SCX_KF_INIT | SCX_KF_SELECT_CPU |
+				  SCX_KF_ENQUEUE | SCX_KF_DISPATCH |
+				  SCX_KF_REST | SCX_KF_EXIT,
+};
+
+struct sched_ext_entity {
+	struct scx_dispatch_q	*dsq;
+	struct list_head	dsq_node;
+	struct list_head	runnable_node;	/* rq->scx.runnable_list */
+	unsigned long		runnable_at;
+	u32			flags;
+	u32			kf_mask;
+	s32			holding_cpu;
+	bool			initialized;	/* ops.init_task() done, pi_lock */
+	u64			slice;
+
+	/* direct dispatch from ops.select_cpu() or ops.enqueue() */
+	u64			ddsp_dsq_id;
+	u64			ddsp_enq_flags;
+};
+
+enum scx_exit_kind {
+	SCX_EXIT_NONE,
+	SCX_EXIT_DONE,
+
+	SCX_EXIT_UNREG = 64,	/* BPF unregistration */
+
+	SCX_EXIT_ERROR = 1024,	/* runtime error, error msg contains details */
+	SCX_EXIT_ERROR_BPF,	/* ERROR but triggered through scx_bpf_error() */
+	SCX_EXIT_ERROR_STALL,	/* watchdog detected stalled runnable tasks */
+};
+
+/* passed to ops.exit() to describe why the BPF scheduler is being disabled */
+struct scx_exit_info {
+	enum scx_exit_kind	kind;
+	char			reason[SCX_EXIT_REASON_LEN];
+	char			msg[SCX_EXIT_MSG_LEN];
+};
+
+enum scx_ops_flags {
+	/*
+	 * Only tasks with the SCHED_EXT policy are handed to the BPF
+	 * scheduler. Without this flag, all SCHED_NORMAL, SCHED_BATCH and
+	 * SCHED_IDLE tasks are switched over as well.
+	 */
+	SCX_OPS_SWITCH_PARTIAL	= 1LLU << 0,
+
+	SCX_OPS_ALL_FLAGS	= SCX_OPS_SWITCH_PARTIAL,
+};
+
+/* ops.select_cpu() wake_flags, see WF_* in kernel/sched/sched.h */
+enum scx_wake_flags {
+	SCX_WAKE_EXEC		= 0x02,	/* wakeup after exec */
+	SCX_WAKE_FORK		= 0x04,	/* wakeup after fork */
+	SCX_WAKE_TTWU		= 0x08,	/* wakeup */
+	SCX_WAKE_SYNC		= 0x10,	/* waker goes to sleep after wakeup */
+};
+
+/* ops.enqueue() and scx_bpf_dispatch() flags */
+enum scx_enq_flags {
+	/* expose select ENQUEUE_* flags, see kernel/sched/sched.h */
+	SCX_ENQ_WAKEUP		= 1LLU << 0,	/* ENQUEUE_WAKEUP */
+	SCX_ENQ_HEAD		= 1LLU << 4,	/* ENQUEUE_HEAD */
+
+	/* preempt the current task if dispatched to the local DSQ */
+	SCX_ENQ_PREEMPT		= 1LLU << 32,
+};
+
+/* ops.dequeue() flags */
+enum scx_deq_flags {
+	SCX_DEQ_SLEEP		= 1LLU << 0,	/* DEQUEUE_SLEEP */
+};
+
+/**
+ * struct sched_ext_ops - Operation table for BPF scheduler implementation
+ *
+ * A BPF scheduler implements these operations and attaches itself through
+ * a BPF_MAP_TYPE_STRUCT_OPS map. Only one BPF scheduler can be loaded at a
+ * time. All operations are optional except @name.
+ */
+struct sched_ext_ops {
+	/**
+	 * select_cpu - Pick the target CPU for a task which is being woken up
+	 * @p: task being woken up
+	 * @prev_cpu: the CPU @p was on before sleeping
+	 * @wake_flags: %SCX_WAKE_*
+	 *
+	 * Decision made here isn't final, @p may end up on a different CPU
+	 * if the returned one isn't allowed anymore. @p can be dispatched
+	 * from here with scx_bpf_dispatch(), in which case ops.enqueue()
+	 * is skipped. If unset, an idle CPU sharing the cache with
+	 * @prev_cpu is picked.
+	 */
+	s32 (*select_cpu)(struct task_struct *p, s32 prev_cpu, u64 wake_flags);
+
+	/**
+	 * enqueue - Enqueue a task on the BPF scheduler
+	 * @p: task being enqueued
+	 * @enq_flags: %SCX_ENQ_*
+	 *
+	 * @p is ready to run. Dispatch it with scx_bpf_dispatch() to a DSQ;
+	 * failing to do so is an error. If unset, tasks are dispatched to
+	 * the global DSQ.
+	 */
+	void (*enqueue)(struct task_struct *p, u64 enq_flags);
+
+	/**
+	 * dequeue - Remove a task from the BPF scheduler
+	 * @p: task being dequeued
+	 * @deq_flags: %SCX_DEQ_*
+	 *
+	 * @p is going to sleep or changing properties. The kernel takes it
+	 * off its DSQ, this is only a notification.
+	 */
+	void (*dequeue)(struct task_struct *p, u64 deq_flags);
+
+	/**
+	 * dispatch - Fill the local DSQ of a CPU
+	 * @cpu: CPU to dispatch tasks for
+	 * @prev: the task being switched out, not necessarily a SCHED_EXT one
+	 *
+	 * Called when @cpu's local DSQ and the global DSQ are both empty.
+	 * Move tasks into the local DSQ with scx_bpf_consume().
+	 */
+	void (*dispatch)(s32 cpu, struct task_struct *prev);
+
+	/**
+	 * running - A task is starting to run on its CPU
+	 * @p: task starting to run
+	 */
+	void (*running)(struct task_struct *p);
+
+	/**
+	 * stopping - A task is stopping execution
+	 * @p: task stopping to run
+	 * @runnable: is @p still runnable?
+	 */
+	void (*stopping)(struct task_struct *p, bool runnable);
+
+	/**
+	 * init_task - Initialize a task for the BPF scheduler
+	 * @p: task to initialize
+	 *
+	 * Called for every existing task when the BPF scheduler is loaded
+	 * and for every new task afterwards. A non-zero return disables the
+	 * BPF scheduler.
+	 */
+	s32 (*init_task)(struct task_struct *p);
+
+	/**
+	 * exit_task - Counterpart of ops.init_task()
+	 * @p: task exiting, or the BPF scheduler is being unloaded
+	 */
+	void (*exit_task)(struct task_struct *p);
+
+	/**
+	 * init - Initialize the BPF scheduler
+	 *
+	 * DSQs are created from here with scx_bpf_create_dsq().
+	 */
+	s32 (*init)(void);
+
+	/**
+	 * exit - Clean up after the BPF scheduler
+	 * @info: exit info
+	 */
+	void (*exit)(struct scx_exit_info *info);
+
+	/**
+	 * flags - %SCX_OPS_* flags
+	 */
+	u64 flags;
+
+	/**
+	 * timeout_ms - The maximum amount of time, in milliseconds, that a
+	 * runnable task may wait before running. If exceeded, the BPF
+	 * scheduler is disabled. 0 selects the maximum, 30 seconds.
+	 */
+	u32 timeout_ms;
+
+	/**
+	 * name - BPF scheduler's name
+	 *
+	 * Must be a non-zero valid BPF object name including only isalnum(),
+	 * '_' and '.' chars.
+	 */
+	char name[SCX_OPS_NAME_LEN];
+};
+
+#endif	/* CONFIG_SCHED_CLASS_EXT */
+#endif	/* _LINUX_SCHED_EXT_H */
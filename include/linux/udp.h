@@ -23,6 +23,15 @@ static inline struct udphdr *udp_hdr(const struct sk_buff *skb)
 	return (struct udphdr *)skb_transport_header(skb);
 }
 
+/* Per-CPU receive queue of a UDP_PERCPU_RXQ socket.  @fwd_alloc is the
+ * forward allocated memory this CPU borrowed from the socket, so that
+ * producers only touch sk_receive_queue.lock once every few packets.
+ */
+struct udp_percpu_rxq {
+	struct sk_buff_head	queue;
+	int			fwd_alloc;
+};
+
 #define UDP_HTABLE_SIZE_MIN_PERNET	128
 #define UDP_HTABLE_SIZE_MIN		(CONFIG_BASE_SMALL ? 128 : 256)
 #define UDP_HTABLE_SIZE_MAX		65536
@@ -93,6 +102,14 @@ struct udp_sock {
 
 	/* This fields follows rcvbuf value, and is touched by udp_recvmsg */
 	int		forward_threshold;
+
+	/* UDP_PERCPU_RXQ: producers queue to the local CPU, readers drain the
+	 * CPUs set in percpu_rxq_pending round-robin, starting from
+	 * percpu_rxq_next.  percpu_rxq is never cleared once set.
+	 */
+	struct udp_percpu_rxq __percpu *percpu_rxq;
+	unsigned long	*percpu_rxq_pending;
+	unsigned int	percpu_rxq_next;
 };
 
 #define UDP_MAX_SEGMENTS	(1 << 6UL)
@@ -45,6 +45,15 @@ struct uprobe_consumer {
 	struct uprobe_consumer *next;
 };
 
+/*
+ * Used by uprobe_register_batch() and uprobe_unregister_batch() to get the
+ * consumer of the idx-th probe in a batch, along with the file offsets of
+ * the probe and of its reference counter.
+ */
+typedef struct uprobe_consumer *(*uprobe_consumer_fn)(u32 idx, void *ctx,
+						       loff_t *offset,
+						       loff_t *ref_ctr_offset);
+
 #ifdef CONFIG_UPROBES
 #include <asm/uprobes.h>
 
@@ -77,6 +86,7 @@ struct uprobe_task {
 	unsigned long			xol_vaddr;
 
 	struct return_instance		*return_instances;
+	struct return_instance		*ri_pool;	/* free, for reuse */
 	unsigned int			depth;
 };
 
@@ -113,7 +123,10 @@ extern int uprobe_write_opcode(struct arch_uprobe *auprobe, struct mm_struct *mm
 extern int uprobe_register(struct inode *inode, loff_t offset, struct uprobe_consumer *uc);
 extern int uprobe_register_refctr(struct inode *inode, loff_t offset, loff_t ref_ctr_offset, struct uprobe_consumer *uc);
 extern int uprobe_apply(struct inode *inode, loff_t offset, struct uprobe_consumer *uc, bool);
-extern void uprobe_unregister(struct inode *inode, loff_t offset, struct uprobe_consumer *uc);
+extern void uprobe_unregister_nosync(struct inode *inode, loff_t offset, struct uprobe_consumer *uc);
+extern void uprobe_unregister_sync(void);
+extern int uprobe_register_batch(struct inode *inode, u32 cnt, uprobe_consumer_fn get_uprobe_consumer, void *ctx);
+extern void uprobe_unregister_batch(struct inode *inode, u32 cnt, uprobe_consumer_fn get_uprobe_consumer, void *ctx);
 extern int uprobe_mmap(struct vm_area_struct *vma);
 extern void uprobe_munmap(struct vm_area_struct *vma, unsigned long start, unsigned long end);
 extern void uprobe_start_dup_mmap(void);
@@ -163,7 +176,21 @@ uprobe_apply(struct inode *inode, loff_t offset, struct uprobe_consumer *uc, boo
 	return -ENOSYS;
 }
 static inline void
-uprobe_unregister(struct inode *inode, loff_t offset, struct uprobe_consumer *uc)
+uprobe_unregister_nosync(struct inode *inode, loff_t offset, struct uprobe_consumer *uc)
+{
+}
+static inline void uprobe_unregister_sync(void)
+{
+}
+static inline int
+uprobe_register_batch(struct inode *inode, u32 cnt,
+		      uprobe_consumer_fn get_uprobe_consumer, void *ctx)
+{
+	return -ENOSYS;
+}
+static inline void
+uprobe_unregister_batch(struct inode *inode, u32 cnt,
+			uprobe_consumer_fn get_uprobe_consumer, void *ctx)
 {
 }
 static inline int uprobe_mmap(struct vm_area_struct *vma)
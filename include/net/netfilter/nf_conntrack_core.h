@@ -81,6 +81,15 @@ void print_tuple(struct seq_file *s, const struct nf_conntrack_tuple *tuple,
 extern spinlock_t nf_conntrack_locks[CONNTRACK_LOCKS];
 void nf_conntrack_lock(spinlock_t *lock);
 
+/* The table size is a multiple of CONNTRACK_LOCKS and each lock covers a
+ * contiguous range of buckets.
+ */
+static inline spinlock_t *nf_conntrack_bucket_lock(unsigned int bucket,
+						   unsigned int hsize)
+{
+	return &nf_conntrack_locks[bucket / (hsize / CONNTRACK_LOCKS)];
+}
+
 extern spinlock_t nf_conntrack_expect_lock;
 
 /* ctnetlink code shared by both ctnetlink and nf_conntrack_bpf */
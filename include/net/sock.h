@@ -1879,8 +1879,10 @@ void sk_send_sigurg(struct sock *sk);
 
 static inline void sock_replace_proto(struct sock *sk, struct proto *proto)
 {
-	if (sk->sk_socket)
+	if (sk->sk_socket) {
 		clear_bit(SOCK_SUPPORT_ZC, &sk->sk_socket->flags);
+		clear_bit(SOCK_SPLICE_PAGES, &sk->sk_socket->flags);
+	}
 	WRITE_ONCE(sk->sk_prot, proto);
 }
 
@@ -256,6 +256,13 @@ struct tls_context {
 	struct cipher_context tx;
 	struct cipher_context rx;
 
+	/* records decrypted straight into the user buffer / into skbs,
+	 * here rather than in priv_ctx_rx for tls_get_info() to read
+	 * them under RCU
+	 */
+	u64 rx_zc_records;
+	u64 rx_copy_records;
+
 	struct scatterlist *partially_sent_record;
 	u16 partially_sent_offset;
 
@@ -183,6 +183,28 @@ static inline void udp_lib_init_sock(struct sock *sk)
 	set_bit(SOCK_CUSTOM_SOCKOPT, &sk->sk_socket->flags);
 }
 
+/* Paired with smp_store_release() in udp_percpu_rxq_enable() */
+static inline struct udp_percpu_rxq __percpu *
+udp_percpu_rxq(const struct sock *sk)
+{
+	return smp_load_acquire(&udp_sk(sk)->percpu_rxq);
+}
+
+/* True if no packet is waiting to be spliced into the reader queue */
+static inline bool udp_rxq_empty_lockless(const struct sock *sk)
+{
+	if (!skb_queue_empty_lockless(&sk->sk_receive_queue))
+		return false;
+
+	/* sk_receive_queue may still hold packets from before the per-CPU
+	 * queues were enabled
+	 */
+	if (udp_percpu_rxq(sk))
+		return bitmap_empty(udp_sk(sk)->percpu_rxq_pending, nr_cpu_ids);
+
+	return true;
+}
+
 /* hash routines shared between UDPv4/6 and UDP-Litev4/6 */
 static inline int udp_lib_hash(struct sock *sk)
 {
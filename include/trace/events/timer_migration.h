@@ -0,0 +1,165 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM timer_migration
+
+#if !defined(_TRACE_TIMER_MIGRATION_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_TIMER_MIGRATION_H
+
+#include <linux/tracepoint.h>
+
+/* Group events */
+TRACE_EVENT(tmigr_group_set,
+
+	TP_PROTO(struct tmigr_group *group),
+
+	TP_ARGS(group),
+
+	TP_STRUCT__entry(
+		__field( void *,	group		)
+		__field( void *,	parent		)
+		__field( unsigned int,	lvl		)
+		__field( int,		numa_node	)
+		__field( unsigned int,	num_children	)
+		__field( u8,		childmask	)
+	),
+
+	TP_fast_assign(
+		__entry->group		= group;
+		__entry->parent		= group->parent;
+		__entry->lvl		= group->level;
+		__entry->numa_node	= group->numa_node;
+		__entry->num_children	= group->num_children;
+		__entry->childmask	= group->childmask;
+	),
+
+	TP_printk("group=%p parent=%p lvl=%d numa=%d num_children=%d childmask=0x%02x",
+		  __entry->group, __entry->parent, __entry->lvl,
+		  __entry->numa_node, __entry->num_children,
+		  __entry->childmask)
+);
+
+/* CPU events */
+DECLARE_EVENT_CLASS(tmigr_cpugroup,
+
+	TP_PROTO(struct tmigr_cpu *tmc),
+
+	TP_ARGS(tmc),
+
+	TP_STRUCT__entry(
+		__field( void *,	parent		)
+		__field( unsigned int,	cpu		)
+		__field( u64,		wakeup		)
+		__field( u8,		childmask	)
+	),
+
+	TP_fast_assign(
+		__entry->parent		= tmc->tmgroup;
+		__entry->cpu		= tmc->cpuevt.cpu;
+		__entry->wakeup		= tmc->wakeup;
+		__entry->childmask	= tmc->childmask;
+	),
+
+	TP_printk("cpu=%d parent=%p wakeup=%llu childmask=0x%02x",
+		  __entry->cpu, __entry->parent, __entry->wakeup,
+		  __entry->childmask)
+);
+
+/**
+ * tmigr_cpu_active - called when a CPU takes its global timers back
+ * @tmc:	the per CPU timer migration state
+ */
+DEFINE_EVENT(tmigr_cpugroup, tmigr_cpu_active,
+
+	TP_PROTO(struct tmigr_cpu *tmc),
+
+	TP_ARGS(tmc)
+);
+
+/**
+ * tmigr_cpu_online - called when a CPU joins the hierarchy
+ * @tmc:	the per CPU timer migration state
+ */
+DEFINE_EVENT(tmigr_cpugroup, tmigr_cpu_online,
+
+	TP_PROTO(struct tmigr_cpu *tmc),
+
+	TP_ARGS(tmc)
+);
+
+/**
+ * tmigr_cpu_offline - called when a CPU leaves the hierarchy
+ * @tmc:	the per CPU timer migration state
+ */
+DEFINE_EVENT(tmigr_cpugroup, tmigr_cpu_offline,
+
+	TP_PROTO(struct tmigr_cpu *tmc),
+
+	TP_ARGS(tmc)
+);
+
+/**
+ * tmigr_cpu_idle - called when a CPU hands its global timers over
+ * @tmc:	the per CPU timer migration state
+ * @nextevt:	the first global timer of the CPU
+ *
+ * @tmc->wakeup is the time the CPU has to wake up on behalf of the
+ * hierarchy, KTIME_MAX unless it was the last active CPU.
+ */
+TRACE_EVENT(tmigr_cpu_idle,
+
+	TP_PROTO(struct tmigr_cpu *tmc, u64 nextevt),
+
+	TP_ARGS(tmc, nextevt),
+
+	TP_STRUCT__entry(
+		__field( void *,	parent		)
+		__field( unsigned int,	cpu		)
+		__field( u64,		nextevt		)
+		__field( u64,		wakeup		)
+		__field( u8,		childmask	)
+	),
+
+	TP_fast_assign(
+		__entry->parent		= tmc->tmgroup;
+		__entry->cpu		= tmc->cpuevt.cpu;
+		__entry->nextevt	= nextevt;
+		__entry->wakeup		= tmc->wakeup;
+		__entry->childmask	= tmc->childmask;
+	),
+
+	TP_printk("cpu=%d parent=%p nextevt=%llu wakeup=%llu childmask=0x%02x",
+		  __entry->cpu, __entry->parent, __entry->nextevt,
+		  __entry->wakeup, __entry->childmask)
+);
+
+/**
+ * tmigr_handle_remote_cpu - called before expiring the timers of an idle CPU
+ * @cpu:	the idle CPU whose global timers are expired
+ * @now:	the clock monotonic time the expiry is based on
+ *
+ * The event is emitted on the CPU which expires the timers, so together
+ * with timer_expire_entry it shows who ran each global timer.
+ */
+TRACE_EVENT(tmigr_handle_remote_cpu,
+
+	TP_PROTO(unsigned int cpu, u64 now),
+
+	TP_ARGS(cpu, now),
+
+	TP_STRUCT__entry(
+		__field( unsigned int,	cpu	)
+		__field( u64,		now	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu	= cpu;
+		__entry->now	= now;
+	),
+
+	TP_printk("cpu=%d now=%llu", __entry->cpu, __entry->now)
+);
+
+#endif /*  _TRACE_TIMER_MIGRATION_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
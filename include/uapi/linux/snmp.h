@@ -350,6 +350,8 @@ enum
 	LINUX_MIB_TLSRXDEVICERESYNC,		/* TlsRxDeviceResync */
 	LINUX_MIB_TLSDECRYPTRETRY,		/* TlsDecryptRetry */
 	LINUX_MIB_TLSRXNOPADVIOL,		/* TlsRxNoPadViolation */
+	LINUX_MIB_TLSRXZEROCOPY,		/* TlsRxZeroCopy */
+	LINUX_MIB_TLSRXCOPY,			/* TlsRxCopy */
 	__LINUX_MIB_TLSMAX
 };
 
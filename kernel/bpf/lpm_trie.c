@@ -9,6 +9,8 @@
 #include <linux/bpf.h>
 #include <linux/btf.h>
 #include <linux/err.h>
+#include <linux/irq_work.h>
+#include <linux/log2.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/vmalloc.h>
@@ -29,9 +31,22 @@ struct lpm_trie_node {
 	u8				data[];
 };
 
+/* Entry of the stride table, see lpm_stride_update() */
+struct lpm_trie_stride {
+	struct lpm_trie_node __rcu	*node;
+	struct lpm_trie_node __rcu	*found;
+};
+
 struct lpm_trie {
 	struct bpf_map			map;
 	struct lpm_trie_node __rcu	*root;
+	struct lpm_trie_stride		*stride_tbl;
+	struct lpm_trie_stride		*stride_fill;
+	u32				stride_filled;
+	u32				stride;
+	bool				stride_queued;
+	struct irq_work			stride_irq_work;
+	struct work_struct		stride_work;
 	size_t				n_entries;
 	size_t				max_prefixlen;
 	size_t				data_size;
@@ -147,8 +162,41 @@ struct lpm_trie {
  * is a child that can be used to become more specific, the trie is traversed
  * downwards. The last node in the traversal that is a non-intermediate one is
  * returned.
+ *
+ * With many entries, the top of the trie is close to a complete binary tree
+ * and a lookup spends most of its time chasing pointers through it. To skip
+ * those levels, a trie sized for enough entries also keeps a stride table,
+ * indexed by the first @stride bits of a key. Each entry records where the
+ * walk for keys starting with those bits continues, the first node with a
+ * prefix of at least @stride bits, and the best match among the shorter
+ * prefixes above it. The table is kept up to date by the update and delete
+ * paths under the trie lock, and read locklessly like the nodes are.
+ *
+ * The table is only allocated once the trie actually holds enough entries,
+ * from a work item kicked through irq_work as updates may come from any
+ * context. The work item fills it LPM_STRIDE_BATCH entries at a time with
+ * the trie lock held, and only publishes it once it is complete.
+ *
+ * Recomputing an entry walks at most @stride levels, and an update or delete
+ * recomputes every entry below the shortest prefix it touched, up to
+ * 2^@stride of them for a /0. Doing that with the trie lock held and
+ * interrupts off is bounded by LPM_STRIDE_BATCH entries: an update covering
+ * more withdraws the table from lookups and hands it back to the work item,
+ * which resumes filling it from the first entry affected.
  */
 
+/* A stride table is only worth it from a few levels on, and is capped at
+ * 2^16 entries.
+ */
+#define LPM_STRIDE_MIN		4
+#define LPM_STRIDE_MAX		16
+
+/* Number of entries from which the stride table is allocated */
+#define LPM_STRIDE_THRESHOLD(trie)	(1U << ((trie)->stride - LPM_STRIDE_MIN))
+
+/* Most stride table entries recomputed in one go with the trie lock held */
+#define LPM_STRIDE_BATCH	256
+
 static inline int extract_bit(const u8 *data, size_t index)
 {
 	return !!(data[index / 8] & (1 << (7 - (index % 8))));
@@ -224,17 +272,219 @@ static size_t longest_prefix_match(const struct lpm_trie *trie,
 	return prefixlen;
 }
 
+/* The first @stride bits of @data, which is at least that long */
+static u32 lpm_stride_index(const struct lpm_trie *trie, const u8 *data)
+{
+	u32 idx = data[0] << 8;
+
+	if (trie->data_size > 1)
+		idx |= data[1];
+
+	return idx >> (LPM_STRIDE_MAX - trie->stride);
+}
+
+/**
+ * lpm_stride_update() - recompute a stride table entry
+ * @trie:	The trie to operate on
+ * @tbl:	The stride table
+ * @idx:	The index of the entry
+ *
+ * Walk the nodes with a prefix shorter than @trie->stride which match @idx,
+ * and record the last non-intermediate one along with the node the walk
+ * ends at, if that node starts with @idx too. A lookup for a key starting
+ * with @idx resumes from that node exactly as if it had walked down from the
+ * root. A node starting with other bits could never match such a key, and
+ * recording it would leave it reachable from entries that aren't updated
+ * when it goes away.
+ *
+ * Readers may see the two pointers of an entry updated at different times,
+ * which at worst yields the result from before or after the update that is
+ * in progress.
+ */
+static void lpm_stride_update(struct lpm_trie *trie,
+			      struct lpm_trie_stride *tbl, u32 idx)
+{
+	struct lpm_trie_stride *entry = &tbl[idx];
+	struct lpm_trie_node *node, *found = NULL;
+	u32 bits;
+
+	node = rcu_dereference_protected(trie->root,
+					 lockdep_is_held(&trie->lock));
+	while (node && node->prefixlen < trie->stride) {
+		bits = trie->stride - node->prefixlen;
+		if (lpm_stride_index(trie, node->data) >> bits != idx >> bits) {
+			node = NULL;
+			break;
+		}
+
+		if (!(node->flags & LPM_TREE_NODE_FLAG_IM))
+			found = node;
+
+		node = rcu_dereference_protected(
+			node->child[(idx >> (bits - 1)) & 1],
+			lockdep_is_held(&trie->lock));
+	}
+
+	if (node && lpm_stride_index(trie, node->data) != idx)
+		node = NULL;
+
+	rcu_assign_pointer(entry->found, found);
+	rcu_assign_pointer(entry->node, node);
+}
+
+/* Called with the trie lock held, from any context */
+static void lpm_stride_queue(struct lpm_trie *trie)
+{
+	if (trie->stride_queued)
+		return;
+
+	trie->stride_queued = true;
+	irq_work_queue(&trie->stride_irq_work);
+}
+
+/* Recompute the stride table entries covered by the prefix @data/@prefixlen
+ * after the nodes on its path changed. Nodes with a prefix of at least
+ * @trie->stride bits are only recorded in the entry of their own first
+ * @trie->stride bits, and shorter nodes only affect the entries within their
+ * prefix, so covering the shortest node added or removed covers every change
+ * an update or a delete makes.
+ *
+ * While the table is being filled, entries the work item hasn't reached yet
+ * are computed from the trie as it is by then and are left alone.
+ */
+static void lpm_stride_update_range(struct lpm_trie *trie, const u8 *data,
+				    u32 prefixlen)
+{
+	struct lpm_trie_stride *tbl = trie->stride_tbl;
+	u32 idx, nr = 1;
+
+	if (!tbl && !trie->stride_fill)
+		return;
+
+	idx = lpm_stride_index(trie, data);
+	if (prefixlen < trie->stride) {
+		nr <<= trie->stride - prefixlen;
+		idx &= ~(nr - 1);
+	}
+
+	if (nr > LPM_STRIDE_BATCH) {
+		/* Too many to redo here, lookups walk from the root until
+		 * the work item is done. Those which already found the table
+		 * only see entries pointing to nodes still in their RCU
+		 * grace period, like with any update racing with them.
+		 */
+		if (tbl) {
+			WRITE_ONCE(trie->stride_tbl, NULL);
+			trie->stride_fill = tbl;
+			trie->stride_filled = 1U << trie->stride;
+		}
+		trie->stride_filled = min(trie->stride_filled, idx);
+		lpm_stride_queue(trie);
+		return;
+	}
+
+	if (!tbl) {
+		tbl = trie->stride_fill;
+		if (idx >= trie->stride_filled)
+			return;
+		nr = min(nr, trie->stride_filled - idx);
+	}
+
+	while (nr--)
+		lpm_stride_update(trie, tbl, idx++);
+}
+
+static void lpm_stride_fill_work(struct work_struct *work)
+{
+	struct lpm_trie *trie = container_of(work, struct lpm_trie, stride_work);
+	u32 end, nr = 1U << trie->stride;
+	struct lpm_trie_stride *tbl;
+	unsigned long irq_flags;
+
+	/* Only this work item installs a table to fill, updates merely
+	 * hand a published one back to it.
+	 */
+	tbl = READ_ONCE(trie->stride_fill);
+	if (!tbl) {
+		tbl = bpf_map_kvcalloc(&trie->map, nr, sizeof(*tbl),
+				       GFP_KERNEL | __GFP_NOWARN);
+
+		spin_lock_irqsave(&trie->lock, irq_flags);
+		if (!tbl) {
+			/* let a later update try again */
+			trie->stride_queued = false;
+			spin_unlock_irqrestore(&trie->lock, irq_flags);
+			return;
+		}
+		trie->stride_fill = tbl;
+		trie->stride_filled = 0;
+		spin_unlock_irqrestore(&trie->lock, irq_flags);
+	}
+
+	for (;;) {
+		spin_lock_irqsave(&trie->lock, irq_flags);
+		end = min(trie->stride_filled + LPM_STRIDE_BATCH, nr);
+		while (trie->stride_filled < end)
+			lpm_stride_update(trie, tbl, trie->stride_filled++);
+
+		if (end == nr) {
+			/* Lookups only ever see a complete table */
+			trie->stride_fill = NULL;
+			smp_store_release(&trie->stride_tbl, tbl);
+			trie->stride_queued = false;
+			spin_unlock_irqrestore(&trie->lock, irq_flags);
+			return;
+		}
+		spin_unlock_irqrestore(&trie->lock, irq_flags);
+
+		cond_resched();
+	}
+}
+
+static void lpm_stride_fill_irq_work(struct irq_work *work)
+{
+	struct lpm_trie *trie = container_of(work, struct lpm_trie,
+					     stride_irq_work);
+
+	schedule_work(&trie->stride_work);
+}
+
+/* Called with the trie lock held, from any context */
+static void lpm_stride_maybe_alloc(struct lpm_trie *trie)
+{
+	if (!trie->stride || trie->stride_tbl ||
+	    trie->n_entries < LPM_STRIDE_THRESHOLD(trie))
+		return;
+
+	lpm_stride_queue(trie);
+}
+
 /* Called from syscall or from eBPF program */
 static void *trie_lookup_elem(struct bpf_map *map, void *_key)
 {
 	struct lpm_trie *trie = container_of(map, struct lpm_trie, map);
 	struct lpm_trie_node *node, *found = NULL;
 	struct bpf_lpm_trie_key *key = _key;
+	struct lpm_trie_stride *tbl;
 
-	/* Start walking the trie from the root node ... */
+	/* Start walking the trie from the root node, or skip the top of the
+	 * trie through the stride table ...
+	 */
+	tbl = smp_load_acquire(&trie->stride_tbl);
+	if (tbl && key->prefixlen >= trie->stride) {
+		struct lpm_trie_stride *entry;
+
+		entry = &tbl[lpm_stride_index(trie, key->data)];
+		node = rcu_dereference_check(entry->node,
+					     rcu_read_lock_bh_held());
+		found = rcu_dereference_check(entry->found,
+					      rcu_read_lock_bh_held());
+	} else {
+		node = rcu_dereference_check(trie->root,
+					     rcu_read_lock_bh_held());
+	}
 
-	for (node = rcu_dereference_check(trie->root, rcu_read_lock_bh_held());
-	     node;) {
+	while (node) {
 		unsigned int next_bit;
 		size_t matchlen;
 
@@ -423,6 +673,9 @@ static long trie_update_elem(struct bpf_map *map,
 
 		kfree(new_node);
 		kfree(im_node);
+	} else {
+		lpm_stride_update_range(trie, key->data, key->prefixlen);
+		lpm_stride_maybe_alloc(trie);
 	}
 
 	spin_unlock_irqrestore(&trie->lock, irq_flags);
@@ -437,6 +690,8 @@ static long trie_delete_elem(struct bpf_map *map, void *_key)
 	struct bpf_lpm_trie_key *key = _key;
 	struct lpm_trie_node __rcu **trim, **trim2;
 	struct lpm_trie_node *node, *parent;
+	const u8 *freed_data = key->data;
+	u32 freed_prefixlen = key->prefixlen;
 	unsigned long irq_flags;
 	unsigned int next_bit;
 	size_t matchlen = 0;
@@ -503,6 +758,9 @@ static long trie_delete_elem(struct bpf_map *map, void *_key)
 		else
 			rcu_assign_pointer(
 				*trim2, rcu_access_pointer(parent->child[0]));
+		/* The parent covers more of the stride table than @key */
+		freed_data = parent->data;
+		freed_prefixlen = parent->prefixlen;
 		kfree_rcu(parent, rcu);
 		kfree_rcu(node, rcu);
 		goto out;
@@ -521,6 +779,9 @@ static long trie_delete_elem(struct bpf_map *map, void *_key)
 	kfree_rcu(node, rcu);
 
 out:
+	if (!ret)
+		lpm_stride_update_range(trie, freed_data, freed_prefixlen);
+
 	spin_unlock_irqrestore(&trie->lock, irq_flags);
 
 	return ret;
@@ -568,6 +829,13 @@ static struct bpf_map *trie_alloc(union bpf_attr *attr)
 			  offsetof(struct bpf_lpm_trie_key, data);
 	trie->max_prefixlen = trie->data_size * 8;
 
+	trie->stride = min3(ilog2(attr->max_entries), LPM_STRIDE_MAX,
+			    (int)trie->max_prefixlen);
+	if (trie->stride < LPM_STRIDE_MIN)
+		trie->stride = 0;
+	init_irq_work(&trie->stride_irq_work, lpm_stride_fill_irq_work);
+	INIT_WORK(&trie->stride_work, lpm_stride_fill_work);
+
 	spin_lock_init(&trie->lock);
 
 	return &trie->map;
@@ -579,6 +847,9 @@ static void trie_free(struct bpf_map *map)
 	struct lpm_trie_node __rcu **slot;
 	struct lpm_trie_node *node;
 
+	irq_work_sync(&trie->stride_irq_work);
+	cancel_work_sync(&trie->stride_work);
+
 	/* Always start at the root and walk down to a node that has no
 	 * children. Then free that node, nullify its reference in the parent
 	 * and start over.
@@ -609,6 +880,8 @@ static void trie_free(struct bpf_map *map)
 	}
 
 out:
+	kvfree(trie->stride_tbl);
+	kvfree(trie->stride_fill);
 	bpf_map_area_free(trie);
 }
 
@@ -727,7 +1000,9 @@ static u64 trie_mem_usage(const struct bpf_map *map)
 
 	elem_size = sizeof(struct lpm_trie_node) + trie->data_size +
 			    trie->map.value_size;
-	return elem_size * READ_ONCE(trie->n_entries);
+	return elem_size * READ_ONCE(trie->n_entries) +
+	       (READ_ONCE(trie->stride_tbl) || READ_ONCE(trie->stride_fill) ?
+		sizeof(*trie->stride_tbl) << trie->stride : 0);
 }
 
 BTF_ID_LIST_SINGLE(trie_map_btf_ids, struct, lpm_trie)
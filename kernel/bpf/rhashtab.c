@@ -0,0 +1,413 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Resizable hash table map
+ *
+ * BPF_MAP_TYPE_HASH sizes its bucket array from max_entries at creation
+ * time, so a map has to be provisioned for the worst case even if it
+ * mostly holds a handful of elements. BPF_MAP_TYPE_RHASH is backed by an
+ * rhashtable instead: the bucket array starts small, is grown and shrunk
+ * incrementally by a deferred worker as elements come and go, and lookups
+ * stay lockless under RCU while a resize is in progress. Elements are
+ * always allocated on demand, max_entries only caps the element count.
+ */
+#include <linux/bpf.h>
+#include <linux/btf.h>
+#include <linux/btf_ids.h>
+#include <linux/err.h>
+#include <linux/rhashtable.h>
+#include <linux/bpf_mem_alloc.h>
+
+#define RHTAB_CREATE_FLAG_MASK						\
+	(BPF_F_NO_PREALLOC | BPF_F_NUMA_NODE | BPF_F_ACCESS_MASK)
+
+/* Smallest bucket array the table shrinks back to */
+#define RHTAB_MIN_SIZE		16
+
+struct bpf_rhtab {
+	struct bpf_map map;
+	struct bpf_mem_alloc ma;
+	struct rhashtable ht;
+	struct rhashtable_params params;
+	/* number of elements, may transiently exceed max_entries by the
+	 * number of concurrent updaters
+	 */
+	atomic_t count;
+	u32 elem_size;	/* size of each element in bytes */
+	int __percpu *map_locked;
+};
+
+/* each rhtab element is struct rhtab_elem + key + value */
+struct rhtab_elem {
+	struct rhash_head node;
+	char key[] __aligned(8);
+};
+
+static inline void *rhtab_elem_value(struct rhtab_elem *l, u32 key_size)
+{
+	return l->key + round_up(key_size, 8);
+}
+
+/* BPF programs can run in any context, including from inside the
+ * rhashtable code of this very map on the same CPU. Updates and deletes
+ * take the bucket locks of the table, so refuse to nest them instead of
+ * deadlocking, the same way hashtab does for its bucket locks.
+ */
+static inline int rhtab_lock(struct bpf_rhtab *rhtab)
+{
+	preempt_disable();
+	if (unlikely(__this_cpu_inc_return(*rhtab->map_locked) != 1)) {
+		__this_cpu_dec(*rhtab->map_locked);
+		preempt_enable();
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+static inline void rhtab_unlock(struct bpf_rhtab *rhtab)
+{
+	__this_cpu_dec(*rhtab->map_locked);
+	preempt_enable();
+}
+
+/* Called from syscall */
+static int rhtab_map_alloc_check(union bpf_attr *attr)
+{
+	if (!bpf_capable())
+		return -EPERM;
+
+	if (attr->map_flags & ~RHTAB_CREATE_FLAG_MASK ||
+	    !(attr->map_flags & BPF_F_NO_PREALLOC) ||
+	    !bpf_map_flags_access_ok(attr->map_flags))
+		return -EINVAL;
+
+	if (attr->max_entries == 0 || attr->key_size == 0 ||
+	    attr->value_size == 0)
+		return -EINVAL;
+
+	/* rhashtable keeps the key length in a u16 */
+	if (attr->key_size > U16_MAX)
+		return -E2BIG;
+
+	if ((u64)attr->key_size + attr->value_size >= KMALLOC_MAX_SIZE -
+	    sizeof(struct rhtab_elem))
+		/* same limit as hashtab, elements have to be reachable
+		 * through the bpf syscall and kmalloc-able
+		 */
+		return -E2BIG;
+
+	return 0;
+}
+
+static struct bpf_map *rhtab_map_alloc(union bpf_attr *attr)
+{
+	struct bpf_rhtab *rhtab;
+	int err;
+
+	rhtab = bpf_map_area_alloc(sizeof(*rhtab), NUMA_NO_NODE);
+	if (!rhtab)
+		return ERR_PTR(-ENOMEM);
+
+	bpf_map_init_from_attr(&rhtab->map, attr);
+
+	rhtab->elem_size = sizeof(struct rhtab_elem) +
+			   round_up(rhtab->map.key_size, 8) +
+			   round_up(rhtab->map.value_size, 8);
+
+	rhtab->params = (struct rhashtable_params) {
+		.key_len = rhtab->map.key_size,
+		.key_offset = offsetof(struct rhtab_elem, key),
+		.head_offset = offsetof(struct rhtab_elem, node),
+		.min_size = RHTAB_MIN_SIZE,
+		.automatic_shrinking = true,
+	};
+
+	err = -ENOMEM;
+	rhtab->map_locked = bpf_map_alloc_percpu(&rhtab->map, sizeof(int),
+						 sizeof(int), GFP_USER);
+	if (!rhtab->map_locked)
+		goto free_rhtab;
+
+	err = bpf_mem_alloc_init(&rhtab->ma, rhtab->elem_size, false);
+	if (err)
+		goto free_map_locked;
+
+	err = rhashtable_init(&rhtab->ht, &rhtab->params);
+	if (err)
+		goto free_ma;
+
+	return &rhtab->map;
+
+free_ma:
+	bpf_mem_alloc_destroy(&rhtab->ma);
+free_map_locked:
+	free_percpu(rhtab->map_locked);
+free_rhtab:
+	bpf_map_area_free(rhtab);
+	return ERR_PTR(err);
+}
+
+static void rhtab_free_elem(void *ptr, void *arg)
+{
+	struct bpf_rhtab *rhtab = arg;
+
+	bpf_mem_cache_free(&rhtab->ma, ptr);
+}
+
+/* Called when map->refcnt goes to zero, either from workqueue or from syscall */
+static void rhtab_map_free(struct bpf_map *map)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+
+	/* No programs or syscalls can reach the map anymore, but the
+	 * elements still have to go back to the per-CPU caches they came
+	 * from before those are destroyed.
+	 */
+	migrate_disable();
+	rhashtable_free_and_destroy(&rhtab->ht, rhtab_free_elem, rhtab);
+	migrate_enable();
+
+	bpf_mem_alloc_destroy(&rhtab->ma);
+	free_percpu(rhtab->map_locked);
+	bpf_map_area_free(rhtab);
+}
+
+static struct rhtab_elem *__rhtab_map_lookup_elem(struct bpf_rhtab *rhtab,
+						  void *key)
+{
+	WARN_ON_ONCE(!rcu_read_lock_held() && !rcu_read_lock_bh_held());
+
+	return rhashtable_lookup(&rhtab->ht, key, rhtab->params);
+}
+
+/* Called from syscall or from eBPF program */
+static void *rhtab_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l;
+
+	l = __rhtab_map_lookup_elem(rhtab, key);
+	if (l)
+		return rhtab_elem_value(l, map->key_size);
+
+	return NULL;
+}
+
+static struct rhtab_elem *rhtab_elem_alloc(struct bpf_rhtab *rhtab,
+					   void *key, void *value)
+{
+	u32 key_size = rhtab->map.key_size;
+	struct rhtab_elem *l;
+
+	l = bpf_mem_cache_alloc(&rhtab->ma);
+	if (!l)
+		return NULL;
+
+	memcpy(l->key, key, key_size);
+	copy_map_value(&rhtab->map, rhtab_elem_value(l, key_size), value);
+
+	return l;
+}
+
+/* Called from syscall or from eBPF program */
+static long rhtab_map_update_elem(struct bpf_map *map, void *key, void *value,
+				  u64 map_flags)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l_new, *l_old;
+	int ret;
+
+	if (unlikely(map_flags > BPF_EXIST))
+		/* unknown flags */
+		return -EINVAL;
+
+	/* Inserting may kick the deferred resize worker, which is not
+	 * safe to do from NMI. The verifier keeps tracing programs, which
+	 * may run under the scheduler or allocator locks, to lookups.
+	 */
+	if (unlikely(in_nmi()))
+		return -EOPNOTSUPP;
+
+	l_new = rhtab_elem_alloc(rhtab, key, value);
+	if (!l_new)
+		return -ENOMEM;
+
+	ret = rhtab_lock(rhtab);
+	if (ret)
+		goto err_free;
+
+again:
+	l_old = __rhtab_map_lookup_elem(rhtab, key);
+	if (l_old) {
+		if (map_flags == BPF_NOEXIST) {
+			ret = -EEXIST;
+			goto err_unlock;
+		}
+
+		/* Swap the element in place, readers see either the old or
+		 * the new value but never miss the key.
+		 */
+		ret = rhashtable_replace_fast(&rhtab->ht, &l_old->node,
+					      &l_new->node, rhtab->params);
+		if (!ret) {
+			rhtab_unlock(rhtab);
+			bpf_mem_cache_free(&rhtab->ma, l_old);
+			return 0;
+		}
+		/* l_old was deleted under us, fall back to an insert */
+	}
+
+	if (map_flags == BPF_EXIST) {
+		ret = -ENOENT;
+		goto err_unlock;
+	}
+
+	if (atomic_inc_return(&rhtab->count) > map->max_entries) {
+		ret = -E2BIG;
+		goto err_uncount;
+	}
+
+	l_old = rhashtable_lookup_get_insert_fast(&rhtab->ht, &l_new->node,
+						  rhtab->params);
+	if (unlikely(l_old)) {
+		atomic_dec(&rhtab->count);
+		if (IS_ERR(l_old)) {
+			ret = PTR_ERR(l_old);
+			goto err_unlock;
+		}
+		/* lost a race with an insert of the same key */
+		goto again;
+	}
+
+	rhtab_unlock(rhtab);
+	return 0;
+
+err_uncount:
+	atomic_dec(&rhtab->count);
+err_unlock:
+	rhtab_unlock(rhtab);
+err_free:
+	bpf_mem_cache_free(&rhtab->ma, l_new);
+	return ret;
+}
+
+/* Called from syscall or from eBPF program */
+static long rhtab_map_delete_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l;
+	int ret;
+
+	if (unlikely(in_nmi()))
+		return -EOPNOTSUPP;
+
+	ret = rhtab_lock(rhtab);
+	if (ret)
+		return ret;
+
+	l = __rhtab_map_lookup_elem(rhtab, key);
+	if (l)
+		ret = rhashtable_remove_fast(&rhtab->ht, &l->node,
+					     rhtab->params);
+	else
+		ret = -ENOENT;
+
+	rhtab_unlock(rhtab);
+
+	if (!ret) {
+		atomic_dec(&rhtab->count);
+		bpf_mem_cache_free(&rhtab->ma, l);
+	}
+
+	return ret;
+}
+
+/* Called from syscall
+ *
+ * Walks the buckets of the current table. Elements are visited in bucket
+ * order, so an iteration that runs concurrently with a resize may see some
+ * keys twice or miss keys that moved behind it, like it may for hashtab
+ * when elements are deleted and re-added.
+ */
+static int rhtab_map_get_next_key(struct bpf_map *map, void *key,
+				  void *next_key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct bucket_table *tbl;
+	struct rhash_head *pos;
+	struct rhtab_elem *l, *next_l;
+	unsigned int hash = 0;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	tbl = rht_dereference_rcu(rhtab->ht.tbl, &rhtab->ht);
+
+	if (!key)
+		goto find_first_elem;
+
+	l = __rhtab_map_lookup_elem(rhtab, key);
+	if (!l)
+		goto find_first_elem;
+
+	hash = rht_head_hashfn(&rhtab->ht, tbl, &l->node, rhtab->params);
+
+	/* the key is somewhere in this chain unless it is being moved to
+	 * a new table, in which case carry on with the next bucket
+	 */
+	rht_for_each_entry_rcu(next_l, pos, tbl, hash, node) {
+		if (next_l != l)
+			continue;
+
+		pos = rht_dereference_bucket_rcu(pos->next, tbl, hash);
+		if (!rht_is_a_nulls(pos)) {
+			next_l = rht_obj(&rhtab->ht, pos);
+			memcpy(next_key, next_l->key, map->key_size);
+			return 0;
+		}
+		break;
+	}
+
+	hash++;
+
+find_first_elem:
+	for (; hash < tbl->size; hash++) {
+		rht_for_each_entry_rcu(next_l, pos, tbl, hash, node) {
+			memcpy(next_key, next_l->key, map->key_size);
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+static u64 rhtab_map_mem_usage(const struct bpf_map *map)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct bucket_table *tbl;
+	u64 usage = sizeof(struct bpf_rhtab);
+
+	usage += sizeof(int) * num_possible_cpus();
+	usage += (u64)(rhtab->elem_size + sizeof(struct llist_node)) *
+		 atomic_read(&rhtab->count);
+
+	rcu_read_lock();
+	tbl = rht_dereference_rcu(rhtab->ht.tbl, &rhtab->ht);
+	usage += sizeof(*tbl) + sizeof(tbl->buckets[0]) * tbl->size;
+	rcu_read_unlock();
+
+	return usage;
+}
+
+BTF_ID_LIST_SINGLE(rhtab_map_btf_ids, struct, bpf_rhtab)
+const struct bpf_map_ops rhtab_map_ops = {
+	.map_meta_equal = bpf_map_meta_equal,
+	.map_alloc_check = rhtab_map_alloc_check,
+	.map_alloc = rhtab_map_alloc,
+	.map_free = rhtab_map_free,
+	.map_get_next_key = rhtab_map_get_next_key,
+	.map_lookup_elem = rhtab_map_lookup_elem,
+	.map_update_elem = rhtab_map_update_elem,
+	.map_delete_elem = rhtab_map_delete_elem,
+	.map_mem_usage = rhtab_map_mem_usage,
+	.map_btf_id = &rhtab_map_btf_ids[0],
+};
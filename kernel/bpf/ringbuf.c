@@ -12,7 +12,7 @@
 #include <uapi/linux/btf.h>
 #include <linux/btf_ids.h>
 
-#define RINGBUF_CREATE_FLAG_MASK (BPF_F_NUMA_NODE)
+#define RINGBUF_CREATE_FLAG_MASK (BPF_F_NUMA_NODE | BPF_F_RB_OVERWRITE)
 
 /* non-mmap()'able part of bpf_ringbuf (everything up to consumer page) */
 #define RINGBUF_PGOFF \
@@ -38,6 +38,7 @@ struct bpf_ringbuf {
 	u64 mask;
 	struct page **pages;
 	int nr_pages;
+	bool overwrite_mode;
 	spinlock_t spinlock ____cacheline_aligned_in_smp;
 	/* For user-space producer ring buffers, an atomic_t busy bit is used
 	 * to synchronize access to the ring buffers in the kernel, rather than
@@ -76,9 +77,19 @@ struct bpf_ringbuf {
 	 * communicate to the kernel, but the kernel must carefully check and
 	 * validate each sample to ensure that they're correctly formatted, and
 	 * fully contained within the ring buffer.
+	 *
+	 * Overwrite mode
+	 * --------------
+	 * Kernel-producer ring buffers created with BPF_F_RB_OVERWRITE never
+	 * run out of space: producers drop the oldest committed records
+	 * instead. overwrite_pos, which lives next to the producer position,
+	 * is the position of the oldest record that hasn't been overwritten
+	 * yet. A consumer that falls behind it has lost the records in
+	 * between and should resume from overwrite_pos.
 	 */
 	unsigned long consumer_pos __aligned(PAGE_SIZE);
 	unsigned long producer_pos __aligned(PAGE_SIZE);
+	unsigned long overwrite_pos;
 	char data[] __aligned(PAGE_SIZE);
 };
 
@@ -161,7 +172,8 @@ static void bpf_ringbuf_notify(struct irq_work *work)
 	wake_up_all(&rb->waitq);
 }
 
-static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
+static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node,
+					     bool overwrite_mode)
 {
 	struct bpf_ringbuf *rb;
 
@@ -177,6 +189,8 @@ static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
 	rb->mask = data_sz - 1;
 	rb->consumer_pos = 0;
 	rb->producer_pos = 0;
+	rb->overwrite_pos = 0;
+	rb->overwrite_mode = overwrite_mode;
 
 	return rb;
 }
@@ -188,6 +202,11 @@ static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 	if (attr->map_flags & ~RINGBUF_CREATE_FLAG_MASK)
 		return ERR_PTR(-EINVAL);
 
+	/* user-space producers can't be overwritten behind their back */
+	if ((attr->map_flags & BPF_F_RB_OVERWRITE) &&
+	    attr->map_type == BPF_MAP_TYPE_USER_RINGBUF)
+		return ERR_PTR(-EINVAL);
+
 	if (attr->key_size || attr->value_size ||
 	    !is_power_of_2(attr->max_entries) ||
 	    !PAGE_ALIGNED(attr->max_entries))
@@ -205,7 +224,8 @@ static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 
 	bpf_map_init_from_attr(&rb_map->map, attr);
 
-	rb_map->rb = bpf_ringbuf_alloc(attr->max_entries, rb_map->map.numa_node);
+	rb_map->rb = bpf_ringbuf_alloc(attr->max_entries, rb_map->map.numa_node,
+				       attr->map_flags & BPF_F_RB_OVERWRITE);
 	if (!rb_map->rb) {
 		bpf_map_area_free(rb_map);
 		return ERR_PTR(-ENOMEM);
@@ -297,11 +317,27 @@ static int ringbuf_map_mmap_user(struct bpf_map *map, struct vm_area_struct *vma
 	return remap_vmalloc_range(vma, rb_map->rb, vma->vm_pgoff + RINGBUF_PGOFF);
 }
 
+/* Position of the oldest record the consumer can still read. In overwrite
+ * mode this is past consumer_pos when producers overwrote records the
+ * consumer hasn't got to yet.
+ */
+static unsigned long ringbuf_consumer_pos(struct bpf_ringbuf *rb)
+{
+	unsigned long cons_pos, over_pos;
+
+	cons_pos = smp_load_acquire(&rb->consumer_pos);
+	if (!rb->overwrite_mode)
+		return cons_pos;
+
+	over_pos = smp_load_acquire(&rb->overwrite_pos);
+	return (long)(over_pos - cons_pos) > 0 ? over_pos : cons_pos;
+}
+
 static unsigned long ringbuf_avail_data_sz(struct bpf_ringbuf *rb)
 {
 	unsigned long cons_pos, prod_pos;
 
-	cons_pos = smp_load_acquire(&rb->consumer_pos);
+	cons_pos = ringbuf_consumer_pos(rb);
 	prod_pos = smp_load_acquire(&rb->producer_pos);
 	return prod_pos - cons_pos;
 }
@@ -406,6 +442,58 @@ bpf_ringbuf_restore_from_rec(struct bpf_ringbuf_hdr *hdr)
 	return (void*)((addr & PAGE_MASK) - off);
 }
 
+/* Maximum number of records dropped by a single reservation */
+#define RINGBUF_OVERWRITE_MAX_RECS 256
+
+/* Drop the oldest records until a record of len bytes fits in front of
+ * new_prod_pos. Only committed or discarded records can go, a record that is
+ * still being written stops us and the reservation fails. Must be called
+ * with rb->spinlock held.
+ *
+ * The walk starts from overwrite_pos rather than consumer_pos: the former is
+ * only ever written here and always sits on a record boundary, while the
+ * latter is under user-space control.
+ *
+ * As this runs with IRQs off, at most RINGBUF_OVERWRITE_MAX_RECS records are
+ * dropped at a time. A large record that needs more fails to reserve, the
+ * records dropped so far stay dropped so that a retry gets further.
+ */
+static bool bpf_ringbuf_overwrite(struct bpf_ringbuf *rb,
+				  unsigned long new_prod_pos)
+{
+	unsigned long over_pos = rb->overwrite_pos;
+	unsigned long prod_pos = rb->producer_pos;
+	struct bpf_ringbuf_hdr *hdr;
+	int nr_recs = 0;
+	bool fits;
+	u32 len;
+
+	while (!(fits = new_prod_pos - over_pos <= rb->mask)) {
+		if (over_pos == prod_pos ||
+		    nr_recs++ == RINGBUF_OVERWRITE_MAX_RECS)
+			break;
+
+		hdr = (void *)rb->data + (over_pos & rb->mask);
+		len = READ_ONCE(hdr->len);
+		if (len & BPF_RINGBUF_BUSY_BIT)
+			break;
+
+		len &= ~BPF_RINGBUF_DISCARD_BIT;
+		over_pos += round_up(len + BPF_RINGBUF_HDR_SZ, 8);
+	}
+
+	if (over_pos != rb->overwrite_pos) {
+		/* pairs with consumer's smp_load_acquire() */
+		smp_store_release(&rb->overwrite_pos, over_pos);
+		/* The dropped records are about to be overwritten. Like a
+		 * seqcount writer, make the new overwrite_pos visible first,
+		 * pairs with smp_rmb() in consumers before they recheck it.
+		 */
+		smp_wmb();
+	}
+	return fits;
+}
+
 static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 {
 	unsigned long cons_pos, prod_pos, new_prod_pos, flags;
@@ -432,9 +520,15 @@ static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 	new_prod_pos = prod_pos + len;
 
 	/* check for out of ringbuf space by ensuring producer position
-	 * doesn't advance more than (ringbuf_size - 1) ahead
+	 * doesn't advance more than (ringbuf_size - 1) ahead, or make room
+	 * for the record by dropping old ones in overwrite mode
 	 */
-	if (new_prod_pos - cons_pos > rb->mask) {
+	if (rb->overwrite_mode) {
+		if (!bpf_ringbuf_overwrite(rb, new_prod_pos)) {
+			spin_unlock_irqrestore(&rb->spinlock, flags);
+			return NULL;
+		}
+	} else if (new_prod_pos - cons_pos > rb->mask) {
 		spin_unlock_irqrestore(&rb->spinlock, flags);
 		return NULL;
 	}
@@ -491,7 +585,7 @@ static void bpf_ringbuf_commit(void *sample, u64 flags, bool discard)
 	 * new data availability
 	 */
 	rec_pos = (void *)hdr - (void *)rb->data;
-	cons_pos = smp_load_acquire(&rb->consumer_pos) & rb->mask;
+	cons_pos = ringbuf_consumer_pos(rb) & rb->mask;
 
 	if (flags & BPF_RB_FORCE_WAKEUP)
 		irq_work_queue(&rb->work);
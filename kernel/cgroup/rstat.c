@@ -7,9 +7,22 @@
 #include <linux/btf.h>
 #include <linux/btf_ids.h>
 
+#include <trace/events/cgroup.h>
+
 static DEFINE_SPINLOCK(cgroup_rstat_lock);
 static DEFINE_PER_CPU(raw_spinlock_t, cgroup_rstat_cpu_lock);
 
+/*
+ * The subtree a sleepable flush is currently working on, if any. Flushers
+ * of a cgroup inside that subtree wait for it to finish instead of lining
+ * up on cgroup_rstat_lock to redo the same work. Only ever compared or
+ * dereferenced under RCU, cgroups are RCU freed.
+ */
+static struct cgroup *cgroup_rstat_ongoing;
+/* Bumped when the flush published in cgroup_rstat_ongoing finishes */
+static unsigned long cgroup_rstat_flush_seq;
+static DECLARE_WAIT_QUEUE_HEAD(cgroup_rstat_flush_waitq);
+
 static void cgroup_base_stat_flush(struct cgroup *cgrp, int cpu);
 
 static struct cgroup_rstat_cpu *cgroup_rstat_cpu(struct cgroup *cgrp, int cpu)
@@ -170,20 +183,92 @@ __weak noinline void bpf_rstat_flush(struct cgroup *cgrp,
 
 __diag_pop();
 
+static inline void __cgroup_rstat_lock(struct cgroup *cgrp, int cpu_in_loop)
+	__acquires(&cgroup_rstat_lock)
+{
+	bool contended;
+
+	contended = !spin_trylock_irq(&cgroup_rstat_lock);
+	if (contended) {
+		trace_cgroup_rstat_lock_contended(cgrp, cpu_in_loop, contended);
+		spin_lock_irq(&cgroup_rstat_lock);
+	}
+	trace_cgroup_rstat_locked(cgrp, cpu_in_loop, contended);
+}
+
+static inline void __cgroup_rstat_unlock(struct cgroup *cgrp, int cpu_in_loop)
+	__releases(&cgroup_rstat_lock)
+{
+	trace_cgroup_rstat_unlock(cgrp, cpu_in_loop, false);
+	spin_unlock_irq(&cgroup_rstat_lock);
+}
+
+/*
+ * Wait for an ongoing flush of an ancestor of @cgrp, or of @cgrp itself, to
+ * finish. Returns false if there is none and @cgrp needs to be flushed.
+ *
+ * The ongoing flush may have passed some CPUs already when we get here, so
+ * updates made on those after it started are not necessarily included. That
+ * is no different from an update racing with a flush of our own.
+ */
+static bool cgroup_rstat_wait_ongoing(struct cgroup *cgrp)
+{
+	struct cgroup *ongoing;
+	unsigned long seq;
+
+	/*
+	 * Sample the sequence before looking at the ongoing flush, pairs with
+	 * the release in cgroup_rstat_flush_locked(). If we see a flush in
+	 * progress, its completion is guaranteed to change the sequence, even
+	 * if the same cgroup is flushed again right after.
+	 */
+	seq = smp_load_acquire(&cgroup_rstat_flush_seq);
+	rcu_read_lock();
+	ongoing = READ_ONCE(cgroup_rstat_ongoing);
+	if (!ongoing || !cgroup_is_descendant(cgrp, ongoing)) {
+		rcu_read_unlock();
+		return false;
+	}
+	trace_cgroup_rstat_flush_wait(cgrp, ongoing);
+	rcu_read_unlock();
+
+	wait_event(cgroup_rstat_flush_waitq,
+		   READ_ONCE(cgroup_rstat_flush_seq) != seq);
+	return true;
+}
+
 /* see cgroup_rstat_flush() */
 static void cgroup_rstat_flush_locked(struct cgroup *cgrp, bool may_sleep)
 	__releases(&cgroup_rstat_lock) __acquires(&cgroup_rstat_lock)
 {
+	bool ongoing = false;
 	int cpu;
 
 	lockdep_assert_held(&cgroup_rstat_lock);
 
+	/*
+	 * Only sleepable flushes are waited for, an atomic flush must not
+	 * make sleepers wait behind a context which can't yield.
+	 */
+	if (may_sleep && !cgroup_rstat_ongoing) {
+		WRITE_ONCE(cgroup_rstat_ongoing, cgrp);
+		ongoing = true;
+	}
+
 	for_each_possible_cpu(cpu) {
 		raw_spinlock_t *cpu_lock = per_cpu_ptr(&cgroup_rstat_cpu_lock,
 						       cpu);
 		struct cgroup *pos = NULL;
 		unsigned long flags;
 
+		/*
+		 * Skip CPUs without updates in this subtree without taking
+		 * their lock. This is racy, but an update which is missed
+		 * here is no different from one made right after the flush.
+		 */
+		if (!READ_ONCE(cgroup_rstat_cpu(cgrp, cpu)->updated_next))
+			continue;
+
 		/*
 		 * The _irqsave() is needed because cgroup_rstat_lock is
 		 * spinlock_t which is a sleeping lock on PREEMPT_RT. Acquiring
@@ -210,12 +295,19 @@ static void cgroup_rstat_flush_locked(struct cgroup *cgrp, bool may_sleep)
 		/* if @may_sleep, play nice and yield if necessary */
 		if (may_sleep && (need_resched() ||
 				  spin_needbreak(&cgroup_rstat_lock))) {
-			spin_unlock_irq(&cgroup_rstat_lock);
+			__cgroup_rstat_unlock(cgrp, cpu);
 			if (!cond_resched())
 				cpu_relax();
-			spin_lock_irq(&cgroup_rstat_lock);
+			__cgroup_rstat_lock(cgrp, cpu);
 		}
 	}
+
+	if (ongoing) {
+		WRITE_ONCE(cgroup_rstat_ongoing, NULL);
+		smp_store_release(&cgroup_rstat_flush_seq,
+				  cgroup_rstat_flush_seq + 1);
+		wake_up_all(&cgroup_rstat_flush_waitq);
+	}
 }
 
 /**
@@ -229,15 +321,21 @@ static void cgroup_rstat_flush_locked(struct cgroup *cgrp, bool may_sleep)
  * This also gets all cgroups in the subtree including @cgrp off the
  * ->updated_children lists.
  *
+ * If a flush of a subtree containing @cgrp is already in progress, wait
+ * for it to finish instead of flushing again.
+ *
  * This function may block.
  */
 __bpf_kfunc void cgroup_rstat_flush(struct cgroup *cgrp)
 {
 	might_sleep();
 
-	spin_lock_irq(&cgroup_rstat_lock);
+	if (cgroup_rstat_wait_ongoing(cgrp))
+		return;
+
+	__cgroup_rstat_lock(cgrp, -1);
 	cgroup_rstat_flush_locked(cgrp, true);
-	spin_unlock_irq(&cgroup_rstat_lock);
+	__cgroup_rstat_unlock(cgrp, -1);
 }
 
 /**
@@ -268,7 +366,7 @@ void cgroup_rstat_flush_hold(struct cgroup *cgrp)
 	__acquires(&cgroup_rstat_lock)
 {
 	might_sleep();
-	spin_lock_irq(&cgroup_rstat_lock);
+	__cgroup_rstat_lock(cgrp, -1);
 	cgroup_rstat_flush_locked(cgrp, true);
 }
 
@@ -23,6 +23,7 @@
 #include <linux/ptrace.h>	/* user_enable_single_step */
 #include <linux/kdebug.h>	/* notifier mechanism */
 #include <linux/percpu-rwsem.h>
+#include <linux/srcu.h>
 #include <linux/task_work.h>
 #include <linux/shmem_fs.h>
 #include <linux/khugepaged.h>
@@ -40,6 +41,17 @@ static struct rb_root uprobes_tree = RB_ROOT;
 #define no_uprobe_events()	RB_EMPTY_ROOT(&uprobes_tree)
 
 static DEFINE_SPINLOCK(uprobes_treelock);	/* serialize rbtree access */
+static seqcount_spinlock_t uprobes_seqcount =
+	SEQCNT_SPINLOCK_ZERO(uprobes_seqcount, &uprobes_treelock);
+
+/*
+ * The breakpoint hit path looks uprobes up without uprobes_treelock and
+ * runs their consumers without uprobe->register_rwsem, see handle_swbp().
+ * uprobes_srcu keeps both the uprobe and the consumers it finds around:
+ * uprobes are freed after a grace period, and unregistration waits for one
+ * before the caller can free its consumer.
+ */
+DEFINE_STATIC_SRCU(uprobes_srcu);
 
 #define UPROBES_HASH_SZ	13
 /* serialize uprobe->pending_list */
@@ -48,6 +60,9 @@ static struct mutex uprobes_mmap_mutex[UPROBES_HASH_SZ];
 
 DEFINE_STATIC_PERCPU_RWSEM(dup_mmap_sem);
 
+/* Max number of probes of a batch handled under one hold of dup_mmap_sem */
+#define UPROBE_BATCH_CHUNK	64
+
 /* Have a copy of original instruction */
 #define UPROBE_COPY_INSN	0
 
@@ -57,11 +72,12 @@ struct uprobe {
 	struct rw_semaphore	register_rwsem;
 	struct rw_semaphore	consumer_rwsem;
 	struct list_head	pending_list;
-	struct uprobe_consumer	*consumers;
+	struct uprobe_consumer	*consumers;	/* SRCU protected on hits */
 	struct inode		*inode;		/* Also hold a ref to inode */
 	loff_t			offset;
 	loff_t			ref_ctr_offset;
 	unsigned long		flags;
+	struct rcu_head		rcu;
 
 	/*
 	 * The generic code assumes that it has two members of unknown type
@@ -595,6 +611,22 @@ static struct uprobe *get_uprobe(struct uprobe *uprobe)
 	return uprobe;
 }
 
+/*
+ * For uprobes found under uprobes_srcu only: the last reference may have
+ * been dropped already, in which case the uprobe is on its way out.
+ */
+static struct uprobe *try_get_uprobe(struct uprobe *uprobe)
+{
+	if (refcount_inc_not_zero(&uprobe->ref))
+		return uprobe;
+	return NULL;
+}
+
+static void uprobe_free_rcu(struct rcu_head *rcu)
+{
+	kfree(container_of(rcu, struct uprobe, rcu));
+}
+
 static void put_uprobe(struct uprobe *uprobe)
 {
 	if (refcount_dec_and_test(&uprobe->ref)) {
@@ -606,7 +638,7 @@ static void put_uprobe(struct uprobe *uprobe)
 		mutex_lock(&delayed_uprobe_lock);
 		delayed_uprobe_remove(uprobe, NULL);
 		mutex_unlock(&delayed_uprobe_lock);
-		kfree(uprobe);
+		call_srcu(&uprobes_srcu, &uprobe->rcu, uprobe_free_rcu);
 	}
 }
 
@@ -678,13 +710,64 @@ static struct uprobe *find_uprobe(struct inode *inode, loff_t offset)
 	return uprobe;
 }
 
-static struct uprobe *__insert_uprobe(struct uprobe *uprobe)
+/*
+ * Lockless lookup for the breakpoint hit path, called under uprobes_srcu.
+ *
+ * Insertion links nodes with rb_link_node_rcu() and the rbtree code only
+ * ever publishes consistent child pointers, so a walk racing with a
+ * rebalance terminates but can miss the node it is looking for. A node it
+ * does find is a real uprobe that can't be freed before the end of the
+ * SRCU read side. uprobes_seqcount tells the miss apart from a true one.
+ */
+static struct uprobe *find_uprobe_rcu(struct inode *inode, loff_t offset)
 {
+	struct __uprobe_key key = {
+		.inode = inode,
+		.offset = offset,
+	};
 	struct rb_node *node;
+	unsigned int seq;
+	int cmp;
 
-	node = rb_find_add(&uprobe->rb_node, &uprobes_tree, __uprobe_cmp);
-	if (node)
-		return get_uprobe(__node_2_uprobe(node));
+	lockdep_assert(srcu_read_lock_held(&uprobes_srcu));
+
+	do {
+		seq = read_seqcount_begin(&uprobes_seqcount);
+		node = rcu_dereference_raw(uprobes_tree.rb_node);
+		while (node) {
+			cmp = __uprobe_cmp_key(&key, node);
+			if (!cmp)
+				return __node_2_uprobe(node);
+			if (cmp < 0)
+				node = rcu_dereference_raw(node->rb_left);
+			else
+				node = rcu_dereference_raw(node->rb_right);
+		}
+	} while (read_seqcount_retry(&uprobes_seqcount, seq));
+
+	return NULL;
+}
+
+/* Called with uprobes_treelock held and uprobes_seqcount write-locked */
+static struct uprobe *__insert_uprobe(struct uprobe *uprobe)
+{
+	struct rb_node **link = &uprobes_tree.rb_node;
+	struct rb_node *parent = NULL;
+	int cmp;
+
+	while (*link) {
+		parent = *link;
+		cmp = __uprobe_cmp(&uprobe->rb_node, parent);
+		if (!cmp)
+			return get_uprobe(__node_2_uprobe(parent));
+		if (cmp < 0)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+
+	rb_link_node_rcu(&uprobe->rb_node, parent, link);
+	rb_insert_color(&uprobe->rb_node, &uprobes_tree);
 
 	/* get access + creation ref */
 	refcount_set(&uprobe->ref, 2);
@@ -704,7 +787,9 @@ static struct uprobe *insert_uprobe(struct uprobe *uprobe)
 	struct uprobe *u;
 
 	spin_lock(&uprobes_treelock);
+	write_seqcount_begin(&uprobes_seqcount);
 	u = __insert_uprobe(uprobe);
+	write_seqcount_end(&uprobes_seqcount);
 	spin_unlock(&uprobes_treelock);
 
 	return u;
@@ -756,7 +841,8 @@ static void consumer_add(struct uprobe *uprobe, struct uprobe_consumer *uc)
 {
 	down_write(&uprobe->consumer_rwsem);
 	uc->next = uprobe->consumers;
-	uprobe->consumers = uc;
+	/* pairs with srcu_dereference() in handler_chain() */
+	rcu_assign_pointer(uprobe->consumers, uc);
 	up_write(&uprobe->consumer_rwsem);
 }
 
@@ -764,6 +850,9 @@ static void consumer_add(struct uprobe *uprobe, struct uprobe_consumer *uc)
  * For uprobe @uprobe, delete the consumer @uc.
  * Return true if the @uc is deleted successfully
  * or return false.
+ *
+ * @uc->next is left alone for the breakpoint handlers still walking the
+ * list, @uc itself must not be freed before an uprobes_srcu grace period.
  */
 static bool consumer_del(struct uprobe *uprobe, struct uprobe_consumer *uc)
 {
@@ -773,7 +862,7 @@ static bool consumer_del(struct uprobe *uprobe, struct uprobe_consumer *uc)
 	down_write(&uprobe->consumer_rwsem);
 	for (con = &uprobe->consumers; *con; con = &(*con)->next) {
 		if (*con == uc) {
-			*con = uc->next;
+			WRITE_ONCE(*con, uc->next);
 			ret = true;
 			break;
 		}
@@ -930,7 +1019,7 @@ static inline bool uprobe_is_active(struct uprobe *uprobe)
 /*
  * There could be threads that have already hit the breakpoint. They
  * will recheck the current insn and restart if find_uprobe() fails.
- * See find_active_uprobe().
+ * See find_active_uprobe_rcu().
  */
 static void delete_uprobe(struct uprobe *uprobe)
 {
@@ -938,7 +1027,9 @@ static void delete_uprobe(struct uprobe *uprobe)
 		return;
 
 	spin_lock(&uprobes_treelock);
+	write_seqcount_begin(&uprobes_seqcount);
 	rb_erase(&uprobe->rb_node, &uprobes_tree);
+	write_seqcount_end(&uprobes_seqcount);
 	spin_unlock(&uprobes_treelock);
 	RB_CLEAR_NODE(&uprobe->rb_node); /* for uprobe_is_active() */
 	put_uprobe(uprobe);
@@ -947,7 +1038,9 @@ static void delete_uprobe(struct uprobe *uprobe)
 struct map_info {
 	struct map_info *next;
 	struct mm_struct *mm;
-	unsigned long vaddr;
+	unsigned long vm_start;
+	unsigned long vm_end;
+	unsigned long vm_pgoff;
 };
 
 static inline struct map_info *free_map_info(struct map_info *info)
@@ -957,10 +1050,41 @@ static inline struct map_info *free_map_info(struct map_info *info)
 	return next;
 }
 
+static void free_map_info_list(struct map_info *info)
+{
+	while (info) {
+		mmput(info->mm);
+		info = free_map_info(info);
+	}
+}
+
+/*
+ * Where @offset was mapped in the vma recorded in @info, if it was mapped
+ * there at all. Like the rest of map_info this is only a hint, the caller
+ * has to recheck it against the real vma under mmap_lock.
+ */
+static bool map_info_vaddr(struct map_info *info, loff_t offset,
+			   unsigned long *vaddr)
+{
+	loff_t start = (loff_t)info->vm_pgoff << PAGE_SHIFT;
+
+	if (offset < start || offset - start >= info->vm_end - info->vm_start)
+		return false;
+
+	*vaddr = info->vm_start + (offset - start);
+	return true;
+}
+
+/*
+ * Collect the vmas mapping any part of [@start, @end] of @mapping, so one
+ * walk of the i_mmap tree can serve a whole batch of probes.
+ */
 static struct map_info *
-build_map_info(struct address_space *mapping, loff_t offset, bool is_register)
+build_map_info(struct address_space *mapping, loff_t start, loff_t end,
+	       bool is_register)
 {
-	unsigned long pgoff = offset >> PAGE_SHIFT;
+	unsigned long pgoff = start >> PAGE_SHIFT;
+	unsigned long last_pgoff = end >> PAGE_SHIFT;
 	struct vm_area_struct *vma;
 	struct map_info *curr = NULL;
 	struct map_info *prev = NULL;
@@ -969,7 +1093,7 @@ build_map_info(struct address_space *mapping, loff_t offset, bool is_register)
 
  again:
 	i_mmap_lock_read(mapping);
-	vma_interval_tree_foreach(vma, &mapping->i_mmap, pgoff, pgoff) {
+	vma_interval_tree_foreach(vma, &mapping->i_mmap, pgoff, last_pgoff) {
 		if (!valid_vma(vma, is_register))
 			continue;
 
@@ -997,7 +1121,9 @@ build_map_info(struct address_space *mapping, loff_t offset, bool is_register)
 		curr = info;
 
 		info->mm = vma->vm_mm;
-		info->vaddr = offset_to_vaddr(vma, offset);
+		info->vm_start = vma->vm_start;
+		info->vm_end = vma->vm_end;
+		info->vm_pgoff = vma->vm_pgoff;
 	}
 	i_mmap_unlock_read(mapping);
 
@@ -1027,57 +1153,73 @@ build_map_info(struct address_space *mapping, loff_t offset, bool is_register)
 	return curr;
 }
 
+/*
+ * Install or remove the breakpoints of @uprobe in the vmas listed in @info.
+ * The caller holds dup_mmap_sem for writing and uprobe->register_rwsem.
+ */
 static int
-register_for_each_vma(struct uprobe *uprobe, struct uprobe_consumer *new)
+__register_for_each_vma(struct uprobe *uprobe, struct uprobe_consumer *new,
+			struct map_info *info)
 {
 	bool is_register = !!new;
-	struct map_info *info;
 	int err = 0;
 
-	percpu_down_write(&dup_mmap_sem);
-	info = build_map_info(uprobe->inode->i_mapping,
-					uprobe->offset, is_register);
-	if (IS_ERR(info)) {
-		err = PTR_ERR(info);
-		goto out;
-	}
-
-	while (info) {
+	for (; info; info = info->next) {
 		struct mm_struct *mm = info->mm;
 		struct vm_area_struct *vma;
+		unsigned long vaddr;
 
 		if (err && is_register)
-			goto free;
+			break;
+
+		if (!map_info_vaddr(info, uprobe->offset, &vaddr))
+			continue;
 
 		mmap_write_lock(mm);
-		vma = find_vma(mm, info->vaddr);
+		vma = find_vma(mm, vaddr);
 		if (!vma || !valid_vma(vma, is_register) ||
 		    file_inode(vma->vm_file) != uprobe->inode)
 			goto unlock;
 
-		if (vma->vm_start > info->vaddr ||
-		    vaddr_to_offset(vma, info->vaddr) != uprobe->offset)
+		if (vma->vm_start > vaddr ||
+		    vaddr_to_offset(vma, vaddr) != uprobe->offset)
 			goto unlock;
 
 		if (is_register) {
 			/* consult only the "caller", new consumer. */
 			if (consumer_filter(new,
 					UPROBE_FILTER_REGISTER, mm))
-				err = install_breakpoint(uprobe, mm, vma, info->vaddr);
+				err = install_breakpoint(uprobe, mm, vma, vaddr);
 		} else if (test_bit(MMF_HAS_UPROBES, &mm->flags)) {
 			if (!filter_chain(uprobe,
 					UPROBE_FILTER_UNREGISTER, mm))
-				err |= remove_breakpoint(uprobe, mm, info->vaddr);
+				err |= remove_breakpoint(uprobe, mm, vaddr);
 		}
 
  unlock:
 		mmap_write_unlock(mm);
- free:
-		mmput(mm);
-		info = free_map_info(info);
 	}
- out:
-	percpu_up_write(&dup_mmap_sem);
+
+	return err;
+}
+
+/*
+ * Must be called with dup_mmap_sem held for writing, which nests outside
+ * uprobe->register_rwsem.
+ */
+static int
+register_for_each_vma(struct uprobe *uprobe, struct uprobe_consumer *new)
+{
+	struct map_info *info;
+	int err;
+
+	info = build_map_info(uprobe->inode->i_mapping, uprobe->offset,
+			      uprobe->offset, !!new);
+	if (IS_ERR(info))
+		return PTR_ERR(info);
+
+	err = __register_for_each_vma(uprobe, new, info);
+	free_map_info_list(info);
 	return err;
 }
 
@@ -1096,12 +1238,17 @@ __uprobe_unregister(struct uprobe *uprobe, struct uprobe_consumer *uc)
 }
 
 /*
- * uprobe_unregister - unregister an already registered probe.
+ * uprobe_unregister_nosync - unregister an already registered probe.
  * @inode: the file in which the probe has to be removed.
  * @offset: offset from the start of the file.
  * @uc: identify which probe if multiple probes are colocated.
+ *
+ * Breakpoint handlers may still be running @uc when this returns, the
+ * caller has to call uprobe_unregister_sync() before releasing it. One
+ * uprobe_unregister_sync() covers any number of unregistered probes.
  */
-void uprobe_unregister(struct inode *inode, loff_t offset, struct uprobe_consumer *uc)
+void uprobe_unregister_nosync(struct inode *inode, loff_t offset,
+			      struct uprobe_consumer *uc)
 {
 	struct uprobe *uprobe;
 
@@ -1109,12 +1256,53 @@ void uprobe_unregister(struct inode *inode, loff_t offset, struct uprobe_consume
 	if (WARN_ON(!uprobe))
 		return;
 
+	percpu_down_write(&dup_mmap_sem);
 	down_write(&uprobe->register_rwsem);
 	__uprobe_unregister(uprobe, uc);
 	up_write(&uprobe->register_rwsem);
+	percpu_up_write(&dup_mmap_sem);
 	put_uprobe(uprobe);
 }
-EXPORT_SYMBOL_GPL(uprobe_unregister);
+EXPORT_SYMBOL_GPL(uprobe_unregister_nosync);
+
+/*
+ * uprobe_unregister_sync - wait for handler_chain() to let go of the
+ * consumers unregistered so far with uprobe_unregister_nosync().
+ */
+void uprobe_unregister_sync(void)
+{
+	synchronize_srcu(&uprobes_srcu);
+}
+EXPORT_SYMBOL_GPL(uprobe_unregister_sync);
+
+static int uprobe_check_args(struct inode *inode, loff_t offset,
+			     loff_t ref_ctr_offset, struct uprobe_consumer *uc)
+{
+	/* Uprobe must have at least one set consumer */
+	if (!uc->handler && !uc->ret_handler)
+		return -EINVAL;
+
+	/* copy_insn() uses read_mapping_page() or shmem_read_mapping_page() */
+	if (!inode->i_mapping->a_ops->read_folio &&
+	    !shmem_mapping(inode->i_mapping))
+		return -EIO;
+	/* Racy, just to catch the obvious mistakes */
+	if (offset < 0 || offset > i_size_read(inode))
+		return -EINVAL;
+	if (ref_ctr_offset < 0)
+		return -EINVAL;
+
+	/*
+	 * This ensures that copy_from_page(), copy_to_page() and
+	 * __update_ref_ctr() can't cross page boundary.
+	 */
+	if (!IS_ALIGNED(offset, UPROBE_SWBP_INSN_SIZE))
+		return -EINVAL;
+	if (!IS_ALIGNED(ref_ctr_offset, sizeof(short)))
+		return -EINVAL;
+
+	return 0;
+}
 
 /*
  * __uprobe_register - register a probe
@@ -1140,26 +1328,9 @@ static int __uprobe_register(struct inode *inode, loff_t offset,
 	struct uprobe *uprobe;
 	int ret;
 
-	/* Uprobe must have at least one set consumer */
-	if (!uc->handler && !uc->ret_handler)
-		return -EINVAL;
-
-	/* copy_insn() uses read_mapping_page() or shmem_read_mapping_page() */
-	if (!inode->i_mapping->a_ops->read_folio &&
-	    !shmem_mapping(inode->i_mapping))
-		return -EIO;
-	/* Racy, just to catch the obvious mistakes */
-	if (offset > i_size_read(inode))
-		return -EINVAL;
-
-	/*
-	 * This ensures that copy_from_page(), copy_to_page() and
-	 * __update_ref_ctr() can't cross page boundary.
-	 */
-	if (!IS_ALIGNED(offset, UPROBE_SWBP_INSN_SIZE))
-		return -EINVAL;
-	if (!IS_ALIGNED(ref_ctr_offset, sizeof(short)))
-		return -EINVAL;
+	ret = uprobe_check_args(inode, offset, ref_ctr_offset, uc);
+	if (ret)
+		return ret;
 
  retry:
 	uprobe = alloc_uprobe(inode, offset, ref_ctr_offset);
@@ -1172,6 +1343,7 @@ static int __uprobe_register(struct inode *inode, loff_t offset,
 	 * We can race with uprobe_unregister()->delete_uprobe().
 	 * Check uprobe_is_active() and retry if it is false.
 	 */
+	percpu_down_write(&dup_mmap_sem);
 	down_write(&uprobe->register_rwsem);
 	ret = -EAGAIN;
 	if (likely(uprobe_is_active(uprobe))) {
@@ -1181,10 +1353,14 @@ static int __uprobe_register(struct inode *inode, loff_t offset,
 			__uprobe_unregister(uprobe, uc);
 	}
 	up_write(&uprobe->register_rwsem);
+	percpu_up_write(&dup_mmap_sem);
 	put_uprobe(uprobe);
 
 	if (unlikely(ret == -EAGAIN))
 		goto retry;
+	/* handler_chain() may have run @uc in the meantime */
+	if (ret)
+		synchronize_srcu(&uprobes_srcu);
 	return ret;
 }
 
@@ -1202,6 +1378,340 @@ int uprobe_register_refctr(struct inode *inode, loff_t offset,
 }
 EXPORT_SYMBOL_GPL(uprobe_register_refctr);
 
+/*
+ * Insert probes @first to @first + @cnt - 1 of a batch into uprobes_tree in
+ * one uprobes_treelock section. Each slot of @uprobes ends up with an access
+ * reference to either a new uprobe or the one already registered at that
+ * inode:offset. On -EINVAL (ref_ctr_offset mismatch) the slots are still
+ * filled in and the caller has to drop them with uprobe_release_batch().
+ */
+static int insert_uprobe_batch(struct inode *inode, u32 first, u32 cnt,
+			       uprobe_consumer_fn get_uprobe_consumer,
+			       void *ctx, struct uprobe **uprobes)
+{
+	struct uprobe *uprobe, *cur_uprobe;
+	loff_t offset, ref_ctr_offset;
+	int err = 0;
+	u32 i;
+
+	for (i = 0; i < cnt; i++) {
+		uprobe = kzalloc(sizeof(struct uprobe), GFP_KERNEL);
+		if (!uprobe)
+			goto free;
+
+		get_uprobe_consumer(first + i, ctx, &offset, &ref_ctr_offset);
+		uprobe->inode = inode;
+		uprobe->offset = offset;
+		uprobe->ref_ctr_offset = ref_ctr_offset;
+		init_rwsem(&uprobe->register_rwsem);
+		init_rwsem(&uprobe->consumer_rwsem);
+		uprobes[i] = uprobe;
+	}
+
+	spin_lock(&uprobes_treelock);
+	write_seqcount_begin(&uprobes_seqcount);
+	for (i = 0; i < cnt; i++) {
+		uprobe = uprobes[i];
+		cur_uprobe = __insert_uprobe(uprobe);
+		if (!cur_uprobe)
+			continue;
+
+		if (cur_uprobe->ref_ctr_offset != uprobe->ref_ctr_offset) {
+			ref_ctr_mismatch_warn(cur_uprobe, uprobe);
+			err = -EINVAL;
+		}
+		kfree(uprobe);
+		uprobes[i] = cur_uprobe;
+	}
+	write_seqcount_end(&uprobes_seqcount);
+	spin_unlock(&uprobes_treelock);
+
+	return err;
+
+ free:
+	while (i--) {
+		kfree(uprobes[i]);
+		uprobes[i] = NULL;
+	}
+	return -ENOMEM;
+}
+
+/*
+ * Drop the references insert_uprobe_batch() took. Uprobes that are left
+ * without consumers are removed from uprobes_tree, just like the last
+ * uprobe_unregister_nosync() would do. Called with dup_mmap_sem held for
+ * writing.
+ */
+static void uprobe_release_batch(struct uprobe **uprobes, u32 cnt)
+{
+	struct uprobe *uprobe;
+	u32 i;
+
+	for (i = 0; i < cnt; i++) {
+		uprobe = uprobes[i];
+		if (!uprobe)
+			continue;
+
+		down_write(&uprobe->register_rwsem);
+		/* the same uprobe can show up more than once in a batch */
+		if (uprobe_is_active(uprobe) && !uprobe->consumers)
+			delete_uprobe(uprobe);
+		up_write(&uprobe->register_rwsem);
+		put_uprobe(uprobe);
+	}
+}
+
+/*
+ * Register probes @first to @first + @cnt - 1 of a batch, under a single
+ * hold of dup_mmap_sem. On failure the probes of this chunk are rolled
+ * back, but the caller still has to wait for an SRCU grace period before
+ * the consumers can go.
+ */
+static int uprobe_register_chunk(struct inode *inode, u32 first, u32 cnt,
+				 uprobe_consumer_fn get_uprobe_consumer,
+				 void *ctx, struct uprobe **uprobes)
+{
+	loff_t offset, ref_ctr_offset, start = LLONG_MAX, end = 0;
+	struct uprobe_consumer *uc;
+	struct map_info *info;
+	struct uprobe *uprobe;
+	int err;
+	u32 i;
+
+	for (i = 0; i < cnt; i++) {
+		get_uprobe_consumer(first + i, ctx, &offset, &ref_ctr_offset);
+		start = min(start, offset);
+		end = max(end, offset);
+	}
+
+	/*
+	 * Holding dup_mmap_sem from the start also keeps delete_uprobe() away,
+	 * so unlike __uprobe_register() we don't have to recheck
+	 * uprobe_is_active() after the insertion.
+	 */
+	/* @uprobes is reused across chunks, don't leave stale slots behind */
+	memset(uprobes, 0, cnt * sizeof(*uprobes));
+
+	percpu_down_write(&dup_mmap_sem);
+	err = insert_uprobe_batch(inode, first, cnt, get_uprobe_consumer, ctx,
+				  uprobes);
+	if (err) {
+		uprobe_release_batch(uprobes, cnt);
+		goto out;
+	}
+
+	/*
+	 * Add all the consumers before looking for the vmas, so that a vma
+	 * mmap()ed in the meantime gets its breakpoints from uprobe_mmap().
+	 */
+	for (i = 0; i < cnt; i++) {
+		uc = get_uprobe_consumer(first + i, ctx, &offset, &ref_ctr_offset);
+		uprobe = uprobes[i];
+		down_write(&uprobe->register_rwsem);
+		consumer_add(uprobe, uc);
+		up_write(&uprobe->register_rwsem);
+	}
+
+	info = build_map_info(inode->i_mapping, start, end, true);
+	if (IS_ERR(info)) {
+		err = PTR_ERR(info);
+	} else {
+		for (i = 0; i < cnt && !err; i++) {
+			uc = get_uprobe_consumer(first + i, ctx, &offset,
+						 &ref_ctr_offset);
+			uprobe = uprobes[i];
+			down_write(&uprobe->register_rwsem);
+			err = __register_for_each_vma(uprobe, uc, info);
+			up_write(&uprobe->register_rwsem);
+		}
+		free_map_info_list(info);
+	}
+
+	for (i = 0; i < cnt; i++) {
+		uprobe = uprobes[i];
+		if (err) {
+			uc = get_uprobe_consumer(first + i, ctx, &offset,
+						 &ref_ctr_offset);
+			down_write(&uprobe->register_rwsem);
+			__uprobe_unregister(uprobe, uc);
+			up_write(&uprobe->register_rwsem);
+		}
+		put_uprobe(uprobe);
+	}
+ out:
+	percpu_up_write(&dup_mmap_sem);
+	return err;
+}
+
+/**
+ * uprobe_register_batch - register a batch of probes in the same file
+ * @inode: the file in which the probes have to be placed.
+ * @cnt: number of probes in the batch.
+ * @get_uprobe_consumer: returns the consumer of the idx-th probe and fills
+ *	in its offset and ref_ctr_offset.
+ * @ctx: passed through to @get_uprobe_consumer.
+ *
+ * Does the same as calling uprobe_register_refctr() for every probe, but
+ * inserts the probes into uprobes_tree under a single uprobes_treelock
+ * section, takes dup_mmap_sem once, and finds the vmas mapping @inode in a
+ * single walk of the i_mmap tree instead of one per probe. To not hold off
+ * fork() for too long, this is done for UPROBE_BATCH_CHUNK probes at a time.
+ * Either all probes get registered, or none.
+ *
+ * Return errno if it cannot successully install probes
+ * else return 0 (success)
+ */
+int uprobe_register_batch(struct inode *inode, u32 cnt,
+			  uprobe_consumer_fn get_uprobe_consumer, void *ctx)
+{
+	loff_t offset, ref_ctr_offset;
+	struct uprobe_consumer *uc;
+	struct uprobe **uprobes;
+	u32 i, nr;
+	int err;
+
+	if (!cnt)
+		return -EINVAL;
+
+	for (i = 0; i < cnt; i++) {
+		uc = get_uprobe_consumer(i, ctx, &offset, &ref_ctr_offset);
+		err = uprobe_check_args(inode, offset, ref_ctr_offset, uc);
+		if (err)
+			return err;
+	}
+
+	uprobes = kvcalloc(min_t(u32, cnt, UPROBE_BATCH_CHUNK),
+			   sizeof(*uprobes), GFP_KERNEL);
+	if (!uprobes)
+		return -ENOMEM;
+
+	for (i = 0; i < cnt; i += nr) {
+		nr = min_t(u32, cnt - i, UPROBE_BATCH_CHUNK);
+		err = uprobe_register_chunk(inode, i, nr, get_uprobe_consumer,
+					    ctx, uprobes);
+		if (err)
+			break;
+	}
+	kvfree(uprobes);
+
+	if (!err)
+		return 0;
+
+	/*
+	 * Undo the chunks that made it. Either way, don't let the caller free
+	 * consumers handler_chain() may still see.
+	 */
+	if (i)
+		uprobe_unregister_batch(inode, i, get_uprobe_consumer, ctx);
+	else
+		synchronize_srcu(&uprobes_srcu);
+	return err;
+}
+EXPORT_SYMBOL_GPL(uprobe_register_batch);
+
+/*
+ * Unregister probes @first to @first + @cnt - 1 of a batch, under a single
+ * hold of dup_mmap_sem. The caller waits for the SRCU grace period.
+ */
+static void uprobe_unregister_chunk(struct inode *inode, u32 first, u32 cnt,
+				    uprobe_consumer_fn get_uprobe_consumer,
+				    void *ctx, struct uprobe **uprobes)
+{
+	loff_t offset, ref_ctr_offset, start = LLONG_MAX, end = 0;
+	struct uprobe_consumer *uc;
+	struct map_info *info;
+	struct uprobe *uprobe;
+	int err;
+	u32 i;
+
+	spin_lock(&uprobes_treelock);
+	for (i = 0; i < cnt; i++) {
+		get_uprobe_consumer(first + i, ctx, &offset, &ref_ctr_offset);
+		uprobes[i] = __find_uprobe(inode, offset);
+		start = min(start, offset);
+		end = max(end, offset);
+	}
+	spin_unlock(&uprobes_treelock);
+
+	percpu_down_write(&dup_mmap_sem);
+	for (i = 0; i < cnt; i++) {
+		uc = get_uprobe_consumer(first + i, ctx, &offset, &ref_ctr_offset);
+		uprobe = uprobes[i];
+		if (WARN_ON(!uprobe))
+			continue;
+
+		down_write(&uprobe->register_rwsem);
+		if (WARN_ON(!consumer_del(uprobe, uc)))
+			uprobes[i] = NULL;
+		up_write(&uprobe->register_rwsem);
+		if (!uprobes[i])
+			put_uprobe(uprobe);
+	}
+
+	info = build_map_info(inode->i_mapping, start, end, false);
+	for (i = 0; i < cnt; i++) {
+		uprobe = uprobes[i];
+		if (!uprobe)
+			continue;
+
+		down_write(&uprobe->register_rwsem);
+		if (IS_ERR(info))
+			err = register_for_each_vma(uprobe, NULL);
+		else
+			err = __register_for_each_vma(uprobe, NULL, info);
+		/* the same uprobe can show up more than once in a batch */
+		if (!uprobe->consumers && !err && uprobe_is_active(uprobe))
+			delete_uprobe(uprobe);
+		up_write(&uprobe->register_rwsem);
+		put_uprobe(uprobe);
+	}
+	if (!IS_ERR(info))
+		free_map_info_list(info);
+	percpu_up_write(&dup_mmap_sem);
+}
+
+/**
+ * uprobe_unregister_batch - unregister a batch of probes in the same file
+ * @inode: the file in which the probes have to be removed.
+ * @cnt: number of probes in the batch.
+ * @get_uprobe_consumer: same as for uprobe_register_batch().
+ * @ctx: passed through to @get_uprobe_consumer.
+ *
+ * Counterpart of uprobe_register_batch(), with the same batching of
+ * uprobes_treelock, dup_mmap_sem and the i_mmap walk.
+ */
+void uprobe_unregister_batch(struct inode *inode, u32 cnt,
+			     uprobe_consumer_fn get_uprobe_consumer, void *ctx)
+{
+	loff_t offset, ref_ctr_offset;
+	struct uprobe_consumer *uc;
+	struct uprobe **uprobes;
+	u32 i, nr;
+
+	uprobes = kvcalloc(min_t(u32, cnt, UPROBE_BATCH_CHUNK),
+			   sizeof(*uprobes), GFP_KERNEL);
+	if (!uprobes) {
+		/* unregistration can't fail, do it the slow way */
+		for (i = 0; i < cnt; i++) {
+			uc = get_uprobe_consumer(i, ctx, &offset, &ref_ctr_offset);
+			uprobe_unregister_nosync(inode, offset, uc);
+		}
+		uprobe_unregister_sync();
+		return;
+	}
+
+	for (i = 0; i < cnt; i += nr) {
+		nr = min_t(u32, cnt - i, UPROBE_BATCH_CHUNK);
+		uprobe_unregister_chunk(inode, i, nr, get_uprobe_consumer, ctx,
+					uprobes);
+	}
+
+	kvfree(uprobes);
+	/* one grace period covers all the consumers of the batch */
+	synchronize_srcu(&uprobes_srcu);
+}
+EXPORT_SYMBOL_GPL(uprobe_unregister_batch);
+
 /*
  * uprobe_apply - unregister an already registered probe.
  * @inode: the file in which the probe has to be removed.
@@ -1220,12 +1730,14 @@ int uprobe_apply(struct inode *inode, loff_t offset,
 	if (WARN_ON(!uprobe))
 		return ret;
 
+	percpu_down_write(&dup_mmap_sem);
 	down_write(&uprobe->register_rwsem);
 	for (con = uprobe->consumers; con && con != uc ; con = con->next)
 		;
 	if (con)
 		ret = register_for_each_vma(uprobe, add ? uc : NULL);
 	up_write(&uprobe->register_rwsem);
+	percpu_up_write(&dup_mmap_sem);
 	put_uprobe(uprobe);
 
 	return ret;
@@ -1699,11 +2211,32 @@ unsigned long uprobe_get_trap_addr(struct pt_regs *regs)
 	return instruction_pointer(regs);
 }
 
-static struct return_instance *free_ret_instance(struct return_instance *ri)
+/*
+ * Return instances go back to a per-task pool instead of the allocator, so
+ * that a task bouncing in and out of a uretprobed function doesn't kmalloc
+ * and kfree on every call. The pool never holds more than the deepest
+ * nesting the task has reached, so it is bounded by MAX_URETPROBE_DEPTH.
+ */
+static struct return_instance *alloc_ret_instance(struct uprobe_task *utask)
+{
+	struct return_instance *ri = utask->ri_pool;
+
+	if (likely(ri)) {
+		utask->ri_pool = ri->next;
+		return ri;
+	}
+
+	return kmalloc(sizeof(struct return_instance), GFP_KERNEL);
+}
+
+static struct return_instance *free_ret_instance(struct uprobe_task *utask,
+						 struct return_instance *ri)
 {
 	struct return_instance *next = ri->next;
+
 	put_uprobe(ri->uprobe);
-	kfree(ri);
+	ri->next = utask->ri_pool;
+	utask->ri_pool = ri;
 	return next;
 }
 
@@ -1714,7 +2247,7 @@ static struct return_instance *free_ret_instance(struct return_instance *ri)
 void uprobe_free_utask(struct task_struct *t)
 {
 	struct uprobe_task *utask = t->utask;
-	struct return_instance *ri;
+	struct return_instance *ri, *next;
 
 	if (!utask)
 		return;
@@ -1724,7 +2257,12 @@ void uprobe_free_utask(struct task_struct *t)
 
 	ri = utask->return_instances;
 	while (ri)
-		ri = free_ret_instance(ri);
+		ri = free_ret_instance(utask, ri);
+
+	for (ri = utask->ri_pool; ri; ri = next) {
+		next = ri->next;
+		kfree(ri);
+	}
 
 	xol_free_insn_slot(t);
 	kfree(utask);
@@ -1849,7 +2387,7 @@ static void cleanup_return_instances(struct uprobe_task *utask, bool chained,
 	enum rp_check ctx = chained ? RP_CHECK_CHAIN_CALL : RP_CHECK_CALL;
 
 	while (ri && !arch_uretprobe_is_alive(ri, ctx, regs)) {
-		ri = free_ret_instance(ri);
+		ri = free_ret_instance(utask, ri);
 		utask->depth--;
 	}
 	utask->return_instances = ri;
@@ -1876,9 +2414,16 @@ static void prepare_uretprobe(struct uprobe *uprobe, struct pt_regs *regs)
 		return;
 	}
 
-	ri = kmalloc(sizeof(struct return_instance), GFP_KERNEL);
-	if (!ri)
+	/* found under uprobes_srcu, but the instance outlives the read side */
+	if (!try_get_uprobe(uprobe))
+		return;
+
+	ri = alloc_ret_instance(utask);
+	if (!ri) {
+		put_uprobe(uprobe);
 		return;
+	}
+	ri->uprobe = uprobe;
 
 	trampoline_vaddr = get_trampoline_vaddr();
 	orig_ret_vaddr = arch_uretprobe_hijack_return_addr(trampoline_vaddr, regs);
@@ -1906,7 +2451,6 @@ static void prepare_uretprobe(struct uprobe *uprobe, struct pt_regs *regs)
 		orig_ret_vaddr = utask->return_instances->orig_ret_vaddr;
 	}
 
-	ri->uprobe = get_uprobe(uprobe);
 	ri->func = instruction_pointer(regs);
 	ri->stack = user_stack_pointer(regs);
 	ri->orig_ret_vaddr = orig_ret_vaddr;
@@ -1918,7 +2462,7 @@ static void prepare_uretprobe(struct uprobe *uprobe, struct pt_regs *regs)
 
 	return;
  fail:
-	kfree(ri);
+	free_ret_instance(utask, ri);
 }
 
 /* Prepare to single-step probed instruction out of line. */
@@ -1933,9 +2477,15 @@ pre_ssout(struct uprobe *uprobe, struct pt_regs *regs, unsigned long bp_vaddr)
 	if (!utask)
 		return -ENOMEM;
 
+	/* the single-step spans a return to user space, so pin the uprobe */
+	if (!try_get_uprobe(uprobe))
+		return -EINVAL;
+
 	xol_vaddr = xol_get_insn_slot(uprobe);
-	if (!xol_vaddr)
-		return -ENOMEM;
+	if (!xol_vaddr) {
+		err = -ENOMEM;
+		goto put;
+	}
 
 	utask->xol_vaddr = xol_vaddr;
 	utask->vaddr = bp_vaddr;
@@ -1943,12 +2493,16 @@ pre_ssout(struct uprobe *uprobe, struct pt_regs *regs, unsigned long bp_vaddr)
 	err = arch_uprobe_pre_xol(&uprobe->arch, regs);
 	if (unlikely(err)) {
 		xol_free_insn_slot(current);
-		return err;
+		goto put;
 	}
 
 	utask->active_uprobe = uprobe;
 	utask->state = UTASK_SSTEP;
 	return 0;
+
+ put:
+	put_uprobe(uprobe);
+	return err;
 }
 
 /*
@@ -2039,12 +2593,55 @@ static int is_trap_at_addr(struct mm_struct *mm, unsigned long vaddr)
 	return is_trap_insn(&opcode);
 }
 
-static struct uprobe *find_active_uprobe(unsigned long bp_vaddr, int *is_swbp)
+#ifdef CONFIG_PER_VMA_LOCK
+/*
+ * Look the vma up without mmap_lock, which every thread of a process
+ * hitting breakpoints would otherwise bounce around. This is what
+ * lock_vma_under_rcu() does, minus its restriction to anonymous vmas.
+ */
+static struct uprobe *find_active_uprobe_speculative(unsigned long bp_vaddr)
+{
+	MA_STATE(mas, &current->mm->mm_mt, bp_vaddr, bp_vaddr);
+	struct uprobe *uprobe = NULL;
+	struct vm_area_struct *vma;
+
+	rcu_read_lock();
+	vma = mas_walk(&mas);
+	if (!vma || !vma_start_read(vma))
+		goto out;
+
+	/* the vma can change or go away until it is locked */
+	if (!vma->detached &&
+	    bp_vaddr >= vma->vm_start && bp_vaddr < vma->vm_end &&
+	    valid_vma(vma, false)) {
+		struct inode *inode = file_inode(vma->vm_file);
+		loff_t offset = vaddr_to_offset(vma, bp_vaddr);
+
+		uprobe = find_uprobe_rcu(inode, offset);
+	}
+	vma_end_read(vma);
+ out:
+	rcu_read_unlock();
+	return uprobe;
+}
+#else
+static struct uprobe *find_active_uprobe_speculative(unsigned long bp_vaddr)
+{
+	return NULL;
+}
+#endif
+
+/* Called under uprobes_srcu, the uprobe returned holds no reference */
+static struct uprobe *find_active_uprobe_rcu(unsigned long bp_vaddr, int *is_swbp)
 {
 	struct mm_struct *mm = current->mm;
 	struct uprobe *uprobe = NULL;
 	struct vm_area_struct *vma;
 
+	uprobe = find_active_uprobe_speculative(bp_vaddr);
+	if (likely(uprobe))
+		return uprobe;
+
 	mmap_read_lock(mm);
 	vma = vma_lookup(mm, bp_vaddr);
 	if (vma) {
@@ -2052,7 +2649,7 @@ static struct uprobe *find_active_uprobe(unsigned long bp_vaddr, int *is_swbp)
 			struct inode *inode = file_inode(vma->vm_file);
 			loff_t offset = vaddr_to_offset(vma, bp_vaddr);
 
-			uprobe = find_uprobe(inode, offset);
+			uprobe = find_uprobe_rcu(inode, offset);
 		}
 
 		if (!uprobe)
@@ -2070,12 +2667,12 @@ static struct uprobe *find_active_uprobe(unsigned long bp_vaddr, int *is_swbp)
 
 static void handler_chain(struct uprobe *uprobe, struct pt_regs *regs)
 {
-	struct uprobe_consumer *uc;
+	struct uprobe_consumer *uc, *first;
 	int remove = UPROBE_HANDLER_REMOVE;
 	bool need_prep = false; /* prepare return uprobe, when needed */
 
-	down_read(&uprobe->register_rwsem);
-	for (uc = uprobe->consumers; uc; uc = uc->next) {
+	first = srcu_dereference(uprobe->consumers, &uprobes_srcu);
+	for (uc = first; uc; uc = srcu_dereference(uc->next, &uprobes_srcu)) {
 		int rc = 0;
 
 		if (uc->handler) {
@@ -2093,11 +2690,18 @@ static void handler_chain(struct uprobe *uprobe, struct pt_regs *regs)
 	if (need_prep && !remove)
 		prepare_uretprobe(uprobe, regs); /* put bp at return */
 
-	if (remove && uprobe->consumers) {
-		WARN_ON(!uprobe_is_active(uprobe));
-		unapply_uprobe(uprobe, current->mm);
+	if (remove && first) {
+		down_read(&uprobe->register_rwsem);
+		/*
+		 * Consumers are added at the head of the list, so it is still
+		 * the one walked above unless a consumer that didn't get a
+		 * say was registered since. The uprobe may also have been
+		 * unregistered meanwhile, both are legit races.
+		 */
+		if (uprobe->consumers == first && uprobe_is_active(uprobe))
+			unapply_uprobe(uprobe, current->mm);
+		up_read(&uprobe->register_rwsem);
 	}
-	up_read(&uprobe->register_rwsem);
 }
 
 static void
@@ -2105,13 +2709,15 @@ handle_uretprobe_chain(struct return_instance *ri, struct pt_regs *regs)
 {
 	struct uprobe *uprobe = ri->uprobe;
 	struct uprobe_consumer *uc;
+	int srcu_idx;
 
-	down_read(&uprobe->register_rwsem);
-	for (uc = uprobe->consumers; uc; uc = uc->next) {
+	srcu_idx = srcu_read_lock(&uprobes_srcu);
+	for (uc = srcu_dereference(uprobe->consumers, &uprobes_srcu); uc;
+	     uc = srcu_dereference(uc->next, &uprobes_srcu)) {
 		if (uc->ret_handler)
 			uc->ret_handler(uc, ri->func, regs);
 	}
-	up_read(&uprobe->register_rwsem);
+	srcu_read_unlock(&uprobes_srcu, srcu_idx);
 }
 
 static struct return_instance *find_next_ret_chain(struct return_instance *ri)
@@ -2154,7 +2760,7 @@ static void handle_trampoline(struct pt_regs *regs)
 		do {
 			if (valid)
 				handle_uretprobe_chain(ri, regs);
-			ri = free_ret_instance(ri);
+			ri = free_ret_instance(utask, ri);
 			utask->depth--;
 		} while (ri != next);
 	} while (!valid);
@@ -2187,13 +2793,20 @@ static void handle_swbp(struct pt_regs *regs)
 {
 	struct uprobe *uprobe;
 	unsigned long bp_vaddr;
-	int is_swbp;
+	int is_swbp, srcu_idx;
 
 	bp_vaddr = uprobe_get_swbp_addr(regs);
 	if (bp_vaddr == get_trampoline_vaddr())
 		return handle_trampoline(regs);
 
-	uprobe = find_active_uprobe(bp_vaddr, &is_swbp);
+	/*
+	 * No uprobes_treelock and no references on the way in: everything
+	 * below only relies on uprobes_srcu, and pre_ssout() pins the uprobe
+	 * for the rare probes that have to be single-stepped.
+	 */
+	srcu_idx = srcu_read_lock(&uprobes_srcu);
+
+	uprobe = find_active_uprobe_rcu(bp_vaddr, &is_swbp);
 	if (!uprobe) {
 		if (is_swbp > 0) {
 			/* No matching uprobe; signal SIGTRAP. */
@@ -2209,7 +2822,7 @@ static void handle_swbp(struct pt_regs *regs)
 			 */
 			instruction_pointer_set(regs, bp_vaddr);
 		}
-		return;
+		goto out;
 	}
 
 	/* change it in advance for ->handler() and restart */
@@ -2244,12 +2857,10 @@ static void handle_swbp(struct pt_regs *regs)
 	if (arch_uprobe_skip_sstep(&uprobe->arch, regs))
 		goto out;
 
-	if (!pre_ssout(uprobe, regs, bp_vaddr))
-		return;
-
-	/* arch_uprobe_skip_sstep() succeeded, or restart if can't singlestep */
+	/* restart if can't singlestep */
+	pre_ssout(uprobe, regs, bp_vaddr);
 out:
-	put_uprobe(uprobe);
+	srcu_read_unlock(&uprobes_srcu, srcu_idx);
 }
 
 /*
@@ -37,6 +37,8 @@
 #include <linux/memblock.h>
 #include <linux/fault-inject.h>
 #include <linux/slab.h>
+#include <linux/prctl.h>
+#include <linux/vmalloc.h>
 
 #include "futex.h"
 #include "../locking/rtmutex_common.h"
@@ -53,6 +55,34 @@ static struct {
 #define futex_queues   (__futex_data.queues)
 #define futex_hashsize (__futex_data.hashsize)
 
+/*
+ * Per-process hash for private futexes. Private futex keys are only ever
+ * looked up by tasks sharing the mm, so they can be hashed into a table
+ * owned by that mm instead of the global one: unrelated processes stop
+ * contending on the same bucket locks and the buckets live on the node the
+ * process was set up on.
+ *
+ * The table is installed once, while the mm has a single user, and stays
+ * until the mm goes away. That way no waiter can ever be queued on a
+ * different table than the one its waker looks at, and futex_hash() does
+ * not need any reference counting.
+ */
+struct futex_private_hash {
+	unsigned int			hash_mask;
+	struct futex_hash_bucket	queues[];
+};
+
+#define FUTEX_HASH_MIN_SLOTS	16
+#define FUTEX_HASH_MAX_SLOTS	(1U << 16)
+
+static bool futex_auto_hash __ro_after_init;
+
+static int __init setup_futex_auto_hash(char *str)
+{
+	return !kstrtobool(str, &futex_auto_hash);
+}
+__setup("futex_private_hash=", setup_futex_auto_hash);
+
 
 /*
  * Fault injections for futexes.
@@ -106,20 +136,132 @@ late_initcall(fail_futex_debugfs);
 #endif /* CONFIG_FAIL_FUTEX */
 
 /**
- * futex_hash - Return the hash bucket in the global hash
+ * futex_hash - Return the hash bucket for a futex key
  * @key:	Pointer to the futex key for which the hash is calculated
  *
  * We hash on the keys returned from get_futex_key (see below) and return the
- * corresponding hash bucket in the global hash.
+ * corresponding hash bucket in the private hash of the key's mm, if it has
+ * one and the key is a private one, or in the global hash otherwise.
  */
 struct futex_hash_bucket *futex_hash(union futex_key *key)
 {
 	u32 hash = jhash2((u32 *)key, offsetof(typeof(*key), both.offset) / 4,
 			  key->both.offset);
 
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))) {
+		struct futex_private_hash *fph;
+
+		fph = READ_ONCE(key->private.mm->futex_phash);
+		if (fph)
+			return &fph->queues[hash & fph->hash_mask];
+	}
+
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
+static void futex_hash_bucket_init(struct futex_hash_bucket *hb)
+{
+	atomic_set(&hb->waiters, 0);
+	plist_head_init(&hb->chain);
+	spin_lock_init(&hb->lock);
+}
+
+/*
+ * Without a hint, size the table for as many threads as can contend at the
+ * same time, i.e. a few buckets per online CPU.
+ */
+static unsigned int futex_hash_default_slots(void)
+{
+	unsigned int slots = roundup_pow_of_two(4 * num_online_cpus());
+
+	return clamp_t(unsigned int, slots, FUTEX_HASH_MIN_SLOTS,
+		       min_t(unsigned long, futex_hashsize, FUTEX_HASH_MAX_SLOTS));
+}
+
+static int futex_hash_allocate(struct mm_struct *mm, unsigned int slots)
+{
+	struct futex_private_hash *fph;
+	unsigned int i;
+
+	if (mm->futex_phash)
+		return -EBUSY;
+
+	/*
+	 * Only the current task can add users to its own mm, so with a single
+	 * user there is nobody else who could have queued on, or be about to
+	 * look up, the global hash for this mm's private futexes. A transient
+	 * reference from e.g. /proc makes us back off; that is fine.
+	 */
+	if (atomic_read(&mm->mm_users) != 1)
+		return -EBUSY;
+
+	fph = kvzalloc_node(struct_size(fph, queues, slots), GFP_KERNEL_ACCOUNT,
+			    numa_node_id());
+	if (!fph)
+		return -ENOMEM;
+
+	fph->hash_mask = slots - 1;
+	for (i = 0; i < slots; i++)
+		futex_hash_bucket_init(&fph->queues[i]);
+
+	/* Pairs with the READ_ONCE() in futex_hash(). */
+	smp_store_release(&mm->futex_phash, fph);
+	return 0;
+}
+
+/**
+ * futex_hash_allocate_default - Give a process its private futex hash
+ * @mm:		The mm of the task which is about to create its first thread
+ *
+ * Called from copy_mm() before the new thread takes its reference on @mm.
+ * Only does anything if the futex_private_hash= boot option is set. A
+ * failure just leaves the process on the global hash.
+ */
+void futex_hash_allocate_default(struct mm_struct *mm)
+{
+	if (futex_auto_hash)
+		futex_hash_allocate(mm, futex_hash_default_slots());
+}
+
+void futex_hash_free(struct mm_struct *mm)
+{
+	kvfree(mm->futex_phash);
+	mm->futex_phash = NULL;
+}
+
+static int futex_hash_set_slots(unsigned long slots)
+{
+	if (!slots)
+		slots = futex_hash_default_slots();
+	else if (slots > FUTEX_HASH_MAX_SLOTS || slots > futex_hashsize)
+		return -EINVAL;
+	else
+		slots = roundup_pow_of_two(slots);
+
+	return futex_hash_allocate(current->mm, slots);
+}
+
+static int futex_hash_get_slots(void)
+{
+	struct futex_private_hash *fph = READ_ONCE(current->mm->futex_phash);
+
+	return fph ? fph->hash_mask + 1 : 0;
+}
+
+int futex_hash_prctl(unsigned long arg2, unsigned long arg3)
+{
+	switch (arg2) {
+	case PR_FUTEX_HASH_SET_SLOTS:
+		return futex_hash_set_slots(arg3);
+	case PR_FUTEX_HASH_GET_SLOTS:
+		if (arg3)
+			return -EINVAL;
+		return futex_hash_get_slots();
+	default:
+		return -EINVAL;
+	}
+}
+
 
 /**
  * futex_setup_timer - set up the sleeping hrtimer.
@@ -1138,11 +1280,8 @@ static int __init futex_init(void)
 					       futex_hashsize, futex_hashsize);
 	futex_hashsize = 1UL << futex_shift;
 
-	for (i = 0; i < futex_hashsize; i++) {
-		atomic_set(&futex_queues[i].waiters, 0);
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	for (i = 0; i < futex_hashsize; i++)
+		futex_hash_bucket_init(&futex_queues[i]);
 
 	return 0;
 }
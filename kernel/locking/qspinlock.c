@@ -11,13 +11,14 @@
  *          Peter Zijlstra <peterz@infradead.org>
  */
 
-#ifndef _GEN_PV_LOCK_SLOWPATH
+#if !defined(_GEN_PV_LOCK_SLOWPATH) && !defined(_GEN_CNA_LOCK_SLOWPATH)
 
 #include <linux/smp.h>
 #include <linux/bug.h>
 #include <linux/cpumask.h>
 #include <linux/percpu.h>
 #include <linux/hardirq.h>
+#include <linux/jump_label.h>
 #include <linux/mutex.h>
 #include <linux/prefetch.h>
 #include <asm/byteorder.h>
@@ -77,11 +78,12 @@
  * two of them can fit in a cacheline in this case. That is OK as it is rare
  * to have more than 2 levels of slowpath nesting in actual use. We don't
  * want to penalize pvqspinlocks to optimize for a rare case in native
- * qspinlocks.
+ * qspinlocks. The NUMA-aware variant (CNA) uses the same extra space for
+ * its per-node state.
  */
 struct qnode {
 	struct mcs_spinlock mcs;
-#ifdef CONFIG_PARAVIRT_SPINLOCKS
+#if defined(CONFIG_PARAVIRT_SPINLOCKS) || defined(CONFIG_NUMA_AWARE_SPINLOCKS)
 	long reserved[2];
 #endif
 };
@@ -286,11 +288,42 @@ static __always_inline u32  __pv_wait_head_or_lock(struct qspinlock *lock,
 #define pv_kick_node		__pv_kick_node
 #define pv_wait_head_or_lock	__pv_wait_head_or_lock
 
+/*
+ * MCS lock hand-off callbacks, the NUMA-aware variant replaces these to
+ * maintain its secondary queue.
+ */
+static __always_inline bool __try_clear_tail(struct qspinlock *lock,
+					     u32 val,
+					     struct mcs_spinlock *node)
+{
+	return atomic_try_cmpxchg_relaxed(&lock->val, &val, _Q_LOCKED_VAL);
+}
+
+static __always_inline void __mcs_pass_lock(struct mcs_spinlock *node,
+					    struct mcs_spinlock *next)
+{
+	arch_mcs_spin_unlock_contended(&next->locked);
+}
+
+#define try_clear_tail		__try_clear_tail
+#define mcs_pass_lock		__mcs_pass_lock
+
+#ifdef CONFIG_NUMA_AWARE_SPINLOCKS
+/* Enabled at boot with numa_spinlock=on, see qspinlock_cna.h */
+static DEFINE_STATIC_KEY_FALSE(numa_spinlock_enabled);
+#define cna_enabled()		static_branch_unlikely(&numa_spinlock_enabled)
+
+void __cna_queued_spin_lock_slowpath(struct qspinlock *lock, u32 val);
+#else
+#define cna_enabled()		false
+#define __cna_queued_spin_lock_slowpath(lock, val)	do { } while (0)
+#endif
+
 #ifdef CONFIG_PARAVIRT_SPINLOCKS
 #define queued_spin_lock_slowpath	native_queued_spin_lock_slowpath
 #endif
 
-#endif /* _GEN_PV_LOCK_SLOWPATH */
+#endif /* !_GEN_PV_LOCK_SLOWPATH && !_GEN_CNA_LOCK_SLOWPATH */
 
 /**
  * queued_spin_lock_slowpath - acquire the queued spinlock
@@ -324,6 +357,11 @@ void __lockfunc queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 	if (pv_enabled())
 		goto pv_queue;
 
+	if (cna_enabled()) {
+		__cna_queued_spin_lock_slowpath(lock, val);
+		return;
+	}
+
 	if (virt_spin_lock(lock))
 		return;
 
@@ -536,7 +574,7 @@ void __lockfunc queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 	 *       PENDING will make the uncontended transition fail.
 	 */
 	if ((val & _Q_TAIL_MASK) == tail) {
-		if (atomic_try_cmpxchg_relaxed(&lock->val, &val, _Q_LOCKED_VAL))
+		if (try_clear_tail(lock, val, node))
 			goto release; /* No contention */
 	}
 
@@ -553,7 +591,7 @@ void __lockfunc queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 	if (!next)
 		next = smp_cond_load_relaxed(&node->next, (VAL));
 
-	arch_mcs_spin_unlock_contended(&next->locked);
+	mcs_pass_lock(node, next);
 	pv_kick_node(lock, next);
 
 release:
@@ -566,20 +604,61 @@ void __lockfunc queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 }
 EXPORT_SYMBOL(queued_spin_lock_slowpath);
 
+/*
+ * Generate the code for NUMA-aware spinlocks.
+ */
+#if !defined(_GEN_CNA_LOCK_SLOWPATH) && !defined(_GEN_PV_LOCK_SLOWPATH) && \
+    defined(CONFIG_NUMA_AWARE_SPINLOCKS)
+#define _GEN_CNA_LOCK_SLOWPATH
+
+#undef  cna_enabled
+#define cna_enabled()			false
+
+#undef  pv_init_node
+#define pv_init_node			cna_init_node
+
+#undef  pv_wait_head_or_lock
+#define pv_wait_head_or_lock		cna_wait_head_or_lock
+
+#undef  try_clear_tail
+#define try_clear_tail			cna_try_clear_tail
+
+#undef  mcs_pass_lock
+#define mcs_pass_lock			cna_pass_lock
+
+#undef  queued_spin_lock_slowpath
+#define queued_spin_lock_slowpath	__cna_queued_spin_lock_slowpath
+
+#include "qspinlock_cna.h"
+#include "qspinlock.c"
+
+#undef _GEN_CNA_LOCK_SLOWPATH
+#endif
+
 /*
  * Generate the paravirt code for queued_spin_unlock_slowpath().
  */
-#if !defined(_GEN_PV_LOCK_SLOWPATH) && defined(CONFIG_PARAVIRT_SPINLOCKS)
+#if !defined(_GEN_PV_LOCK_SLOWPATH) && !defined(_GEN_CNA_LOCK_SLOWPATH) && \
+    defined(CONFIG_PARAVIRT_SPINLOCKS)
 #define _GEN_PV_LOCK_SLOWPATH
 
 #undef  pv_enabled
 #define pv_enabled()	true
 
+#undef  cna_enabled
+#define cna_enabled()	false
+
 #undef pv_init_node
 #undef pv_wait_node
 #undef pv_kick_node
 #undef pv_wait_head_or_lock
 
+#undef  try_clear_tail
+#define try_clear_tail		__try_clear_tail
+
+#undef  mcs_pass_lock
+#define mcs_pass_lock		__mcs_pass_lock
+
 #undef  queued_spin_lock_slowpath
 #define queued_spin_lock_slowpath	__pv_queued_spin_lock_slowpath
 
@@ -0,0 +1,351 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _GEN_CNA_LOCK_SLOWPATH
+#error "do not include this file"
+#endif
+
+#include <linux/kstrtox.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/rt.h>
+#include <linux/topology.h>
+
+/*
+ * Implement a NUMA-aware version of MCS (aka CNA, or compact NUMA-aware lock).
+ *
+ * In CNA, spinning threads are organized in two queues, a primary queue for
+ * threads running on the same NUMA node as the current lock holder, and a
+ * secondary queue for threads running on other nodes. Schematically, it
+ * looks like this:
+ *
+ *    cna_node
+ *   +----------+     +--------+         +--------+
+ *   |mcs:next  | --> |mcs:next| --> ... |mcs:next| --> NULL  [Primary queue]
+ *   |mcs:locked| -.  +--------+         +--------+
+ *   +----------+  |
+ *                 `----------------------.
+ *                                        v
+ *                 +--------+         +--------+
+ *                 |mcs:next| --> ... |mcs:next|            [Secondary queue]
+ *                 +--------+         +--------+
+ *                     ^                    |
+ *                     `--------------------'
+ *
+ * N.B. locked := 1 if the secondary queue is absent. Otherwise, it contains
+ * the encoded tail of the secondary queue, which is organized as a circular
+ * list.
+ *
+ * After acquiring the MCS lock and while waiting for the spinlock owner to go
+ * away, the queue head checks whether the next waiter in the primary queue is
+ * running on the same NUMA node. If it is not, that waiter is moved to the
+ * tail of the secondary queue. This way the primary queue is gradually
+ * filtered, leaving only waiters on the preferred node, and the lock (and the
+ * data it protects) stays on one node across hand-offs.
+ *
+ * The secondary queue is spliced back in front of the primary queue when the
+ * primary queue runs empty, or when remote waiters have been passed over for
+ * longer than numa_spinlock_threshold_ns, which bounds their starvation.
+ *
+ * For more details, see https://arxiv.org/abs/1810.05600.
+ */
+
+#define FLUSH_SECONDARY_QUEUE	1
+
+#define CNA_PRIORITY_NODE	0xffff
+
+struct cna_node {
+	struct mcs_spinlock	mcs;
+	u16			numa_node;	/* preferred node */
+	u16			real_numa_node;
+	u32			encoded_tail;	/* self */
+	u64			start_time;	/* remote waiters passed over since */
+};
+
+static bool numa_spinlock_on __initdata;
+
+/* 1ms by default */
+static u64 numa_spinlock_threshold_ns __ro_after_init = NSEC_PER_MSEC;
+
+static int __init numa_spinlock_setup(char *str)
+{
+	return !kstrtobool(str, &numa_spinlock_on);
+}
+__setup("numa_spinlock=", numa_spinlock_setup);
+
+static int __init numa_spinlock_threshold_setup(char *str)
+{
+	u64 threshold;
+
+	if (kstrtou64(str, 0, &threshold) || !threshold)
+		return 0;
+
+	numa_spinlock_threshold_ns = threshold;
+	return 1;
+}
+__setup("numa_spinlock_threshold_ns=", numa_spinlock_threshold_setup);
+
+static inline bool cna_has_secondary(struct mcs_spinlock *node)
+{
+	return (u32)node->locked > 1;
+}
+
+static inline bool intra_node_threshold_reached(struct cna_node *cn)
+{
+	return local_clock() - cn->start_time > numa_spinlock_threshold_ns;
+}
+
+static void __init cna_init_nodes_per_cpu(unsigned int cpu)
+{
+	struct mcs_spinlock *base = per_cpu_ptr(&qnodes[0].mcs, cpu);
+	int numa_node = cpu_to_node(cpu);
+	int i;
+
+	for (i = 0; i < MAX_NODES; i++) {
+		struct cna_node *cn = (struct cna_node *)grab_mcs_node(base, i);
+
+		cn->real_numa_node = numa_node;
+		cn->encoded_tail = encode_tail(cpu, i);
+		/*
+		 * make sure @encoded_tail is not confused with other valid
+		 * values for @locked (0 or 1)
+		 */
+		WARN_ON(cn->encoded_tail <= 1);
+	}
+}
+
+/*
+ * Switching lock variants while waiters are queued would mix nodes that
+ * do not understand the secondary queue, so this must run before the
+ * secondary CPUs are brought up.
+ */
+static int __init cna_init_nodes(void)
+{
+	unsigned int cpu;
+
+	BUILD_BUG_ON(sizeof(struct cna_node) > sizeof(struct qnode));
+
+	if (!numa_spinlock_on || nr_node_ids < 2)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		cna_init_nodes_per_cpu(cpu);
+
+	static_branch_enable(&numa_spinlock_enabled);
+	pr_info("qspinlock: NUMA-aware slow path enabled, threshold %lluns\n",
+		numa_spinlock_threshold_ns);
+
+	return 0;
+}
+early_initcall(cna_init_nodes);
+
+/*
+ * Waiters in interrupt context and RT tasks are never moved to the secondary
+ * queue. Plain irqs-disabled callers are not exempt: most of the contended
+ * locks CNA is aimed at are taken with spin_lock_irqsave(), and the fairness
+ * threshold bounds how long they can be passed over.
+ */
+static __always_inline void cna_init_node(struct mcs_spinlock *node)
+{
+	bool priority = !in_task() || rt_task(current);
+	struct cna_node *cn = (struct cna_node *)node;
+
+	cn->numa_node = priority ? CNA_PRIORITY_NODE : cn->real_numa_node;
+	cn->start_time = 0;
+}
+
+/*
+ * cna_splice_head -- splice the entire secondary queue onto the head of the
+ * primary queue.
+ *
+ * Returns the new primary head node or NULL on failure.
+ */
+static struct mcs_spinlock *
+cna_splice_head(struct qspinlock *lock, u32 val,
+		struct mcs_spinlock *node, struct mcs_spinlock *next)
+{
+	struct mcs_spinlock *head_2nd, *tail_2nd;
+	u32 new;
+
+	tail_2nd = decode_tail(node->locked);
+	head_2nd = tail_2nd->next;
+
+	if (next) {
+		/*
+		 * If the primary queue is not empty, the primary tail doesn't
+		 * need to change and we can simply link the secondary tail to
+		 * the old primary head.
+		 */
+		tail_2nd->next = next;
+	} else {
+		/*
+		 * When the primary queue is empty, the secondary tail becomes
+		 * the primary tail.
+		 *
+		 * Speculatively break the secondary queue's circular link such
+		 * that when the secondary tail becomes the primary tail it all
+		 * works out:
+		 *
+		 * tail_2nd->next = NULL;	old = xchg_tail(lock, tail);
+		 *				prev = decode_tail(old);
+		 * try_cmpxchg_release(...);	WRITE_ONCE(prev->next, node);
+		 *
+		 * If the following cmpxchg() succeeds, our stores will not
+		 * collide.
+		 */
+		tail_2nd->next = NULL;
+
+		new = ((struct cna_node *)tail_2nd)->encoded_tail | _Q_LOCKED_VAL;
+		if (!atomic_try_cmpxchg_release(&lock->val, &val, new)) {
+			/* Restore the secondary queue's circular link. */
+			tail_2nd->next = head_2nd;
+			return NULL;
+		}
+	}
+
+	/* The primary queue head now is what was the secondary queue head. */
+	return head_2nd;
+}
+
+static __always_inline bool cna_try_clear_tail(struct qspinlock *lock, u32 val,
+					       struct mcs_spinlock *node)
+{
+	struct mcs_spinlock *next;
+
+	/* Both queues are empty, do what MCS does. */
+	if (!cna_has_secondary(node))
+		return __try_clear_tail(lock, val, node);
+
+	/*
+	 * The primary queue is empty but there are remote waiters: move them
+	 * back onto the primary queue, with the lock held, and let them rip.
+	 */
+	next = cna_splice_head(lock, val, node, NULL);
+	if (!next)
+		return false;
+
+	smp_store_release(&next->locked, 1);
+	return true;
+}
+
+/*
+ * cna_splice_next -- move the next waiter from the primary queue to the
+ * tail of the secondary queue.
+ */
+static void cna_splice_next(struct mcs_spinlock *node,
+			    struct mcs_spinlock *next,
+			    struct mcs_spinlock *nnext)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+
+	/* remove @next from the primary queue */
+	node->next = nnext;
+
+	if (!cna_has_secondary(node)) {
+		/* create the secondary queue */
+		next->next = next;
+		if (!cn->start_time)
+			cn->start_time = local_clock();
+	} else {
+		/* add to the tail of the secondary queue */
+		struct mcs_spinlock *tail_2nd = decode_tail(node->locked);
+		struct mcs_spinlock *head_2nd = tail_2nd->next;
+
+		tail_2nd->next = next;
+		next->next = head_2nd;
+	}
+
+	node->locked = ((struct cna_node *)next)->encoded_tail;
+	lockevent_inc(cna_splice_next);
+}
+
+/*
+ * cna_order_queue - check whether the next waiter in the primary queue is on
+ * the preferred NUMA node; if not, and it has a waiter behind it, move it to
+ * the secondary queue. Only the queue head changes @node->next and the
+ * waiter behind @next has already linked itself, so this doesn't race with
+ * enqueuers.
+ *
+ * Returns true if the next waiter runs on the preferred node.
+ */
+static bool cna_order_queue(struct mcs_spinlock *node)
+{
+	struct mcs_spinlock *next = READ_ONCE(node->next);
+	struct cna_node *cn = (struct cna_node *)node;
+	int next_numa_node;
+
+	if (!next)
+		return false;
+
+	next_numa_node = ((struct cna_node *)next)->numa_node;
+
+	if (next_numa_node != cn->numa_node &&
+	    next_numa_node != CNA_PRIORITY_NODE) {
+		struct mcs_spinlock *nnext = READ_ONCE(next->next);
+
+		if (nnext)
+			cna_splice_next(node, next, nnext);
+
+		return false;
+	}
+
+	return true;
+}
+
+#define LOCK_IS_BUSY(lock) (atomic_read(&(lock)->val) & _Q_LOCKED_PENDING_MASK)
+
+/*
+ * Use the pv_wait_head_or_lock() hook to sort the primary queue while the
+ * lock owner goes away, or to decide that it is time to flush the secondary
+ * queue. We never take the lock here.
+ */
+static __always_inline u32 cna_wait_head_or_lock(struct qspinlock *lock,
+						 struct mcs_spinlock *node)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+
+	/* At the queue head, no need to hide our NUMA node anymore */
+	if (cn->numa_node == CNA_PRIORITY_NODE)
+		cn->numa_node = cn->real_numa_node;
+
+	if (!cn->start_time || !intra_node_threshold_reached(cn)) {
+		while (LOCK_IS_BUSY(lock) && !cna_order_queue(node))
+			cpu_relax();
+	} else {
+		cn->start_time = FLUSH_SECONDARY_QUEUE;
+	}
+
+	return 0; /* we lied; we didn't wait, go do so now */
+}
+
+static __always_inline void cna_pass_lock(struct mcs_spinlock *node,
+					  struct mcs_spinlock *next)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+	u32 val = 1;
+
+	if (cna_has_secondary(node)) {
+		if (cn->start_time == FLUSH_SECONDARY_QUEUE) {
+			/*
+			 * Remote waiters waited long enough: splice the
+			 * secondary queue in front and pass the lock to the
+			 * longest waiting of them.
+			 */
+			next = cna_splice_head(NULL, 0, node, next);
+			lockevent_inc(cna_flush);
+		} else {
+			/* preserve the secondary queue */
+			val = node->locked;
+
+			/* cna_order_queue() may have changed @node->next */
+			next = node->next;
+
+			/*
+			 * Pass on the preferred node and the time remote
+			 * waiters have been waiting, even if @next is a
+			 * priority waiter from another node.
+			 */
+			((struct cna_node *)next)->numa_node = cn->numa_node;
+			((struct cna_node *)next)->start_time = cn->start_time;
+		}
+	}
+
+	smp_store_release(&next->locked, val);
+}
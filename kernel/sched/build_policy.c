@@ -19,10 +19,15 @@
 #include <linux/sched/posix-timers.h>
 #include <linux/sched/rt.h>
 
+#include <linux/bpf_verifier.h>
+#include <linux/btf.h>
+#include <linux/btf_ids.h>
 #include <linux/cpuidle.h>
 #include <linux/jiffies.h>
+#include <linux/kthread.h>
 #include <linux/livepatch.h>
 #include <linux/psi.h>
+#include <linux/rhashtable.h>
 #include <linux/seqlock_api.h>
 #include <linux/slab.h>
 #include <linux/suspend.h>
@@ -52,3 +57,7 @@
 #include "cputime.c"
 #include "deadline.c"
 
+#ifdef CONFIG_SCHED_CLASS_EXT
+# include "ext.c"
+#endif
+
@@ -0,0 +1,1480 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * BPF extensible scheduler class: sched_ext
+ *
+ * The policy of this class is implemented by a BPF program attached
+ * through struct sched_ext_ops. Runnable tasks are kept on dispatch queues
+ * (DSQs):
+ *
+ *  - every CPU has a local DSQ from which it picks the next task,
+ *  - the global DSQ is shared by all CPUs,
+ *  - the BPF scheduler can create more shared DSQs.
+ *
+ * ops.select_cpu() and ops.enqueue() decide where a waking task goes by
+ * dispatching it to one of them. When a CPU runs out of local tasks, it
+ * first consumes from the global DSQ, then lets ops.dispatch() pull from
+ * the BPF scheduler's DSQs.
+ *
+ * The kernel stays in charge: runnable tasks are watched, and an error
+ * raised by or detected in the BPF scheduler disables it, moving all its
+ * tasks back to the fair class.
+ */
+
+enum scx_internal_consts {
+	SCX_WATCHDOG_MAX_TIMEOUT	= 30 * HZ,
+};
+
+enum scx_ops_enable_state {
+	SCX_OPS_DISABLED,
+	SCX_OPS_ENABLING,
+	SCX_OPS_ENABLED,
+	SCX_OPS_DISABLING,
+};
+
+static_assert(SCX_ENQ_WAKEUP == ENQUEUE_WAKEUP);
+static_assert(SCX_ENQ_HEAD == ENQUEUE_HEAD);
+static_assert(SCX_DEQ_SLEEP == DEQUEUE_SLEEP);
+static_assert(SCX_WAKE_EXEC == WF_EXEC);
+static_assert(SCX_WAKE_FORK == WF_FORK);
+static_assert(SCX_WAKE_TTWU == WF_TTWU);
+static_assert(SCX_WAKE_SYNC == WF_SYNC);
+
+/*
+ * scx_ops_enable_mutex serializes loading and unloading. While loaded, the
+ * BPF scheduler's operations are copied into scx_ops; scx_ops_kdata is the
+ * struct_ops map value they came from.
+ */
+static DEFINE_MUTEX(scx_ops_enable_mutex);
+DEFINE_STATIC_KEY_FALSE(__scx_ops_enabled);
+static atomic_t scx_ops_enable_state_var = ATOMIC_INIT(SCX_OPS_DISABLED);
+static bool scx_switching_all;
+static struct sched_ext_ops scx_ops;
+static void *scx_ops_kdata;
+
+static atomic_t scx_exit_kind = ATOMIC_INIT(SCX_EXIT_DONE);
+static struct scx_exit_info *scx_exit_info;
+
+static unsigned long scx_watchdog_timeout;
+static struct delayed_work scx_watchdog_work;
+
+/* disabling is done from an RT kthread so that it can't be starved */
+static struct kthread_worker *scx_ops_helper;
+static void scx_ops_disable_workfn(struct kthread_work *work);
+static DEFINE_KTHREAD_WORK(scx_ops_disable_work, scx_ops_disable_workfn);
+
+static void scx_ops_error_irq_workfn(struct irq_work *irq_work);
+static DEFINE_IRQ_WORK(scx_ops_error_irq_work, scx_ops_error_irq_workfn);
+
+static struct scx_dispatch_q scx_dsq_global;
+static struct rhashtable dsq_hash;
+
+static const struct rhashtable_params dsq_hash_params = {
+	.key_len		= 8,
+	.key_offset		= offsetof(struct scx_dispatch_q, id),
+	.head_offset		= offsetof(struct scx_dispatch_q, hash_node),
+};
+
+/* the task in ops.select_cpu() or ops.enqueue(), may be dispatched */
+static DEFINE_PER_CPU(struct task_struct *, scx_ddsp_task);
+
+/* rq being dispatched for in ops.dispatch(), used by scx_bpf_consume() */
+struct scx_dsp_ctx {
+	struct rq		*rq;
+	struct rq_flags		*rf;
+};
+static DEFINE_PER_CPU(struct scx_dsp_ctx, scx_dsp_ctx);
+
+static __printf(2, 3) void scx_ops_error_kind(enum scx_exit_kind kind,
+					      const char *fmt, ...);
+
+#define scx_ops_error(fmt, args...)					\
+	scx_ops_error_kind(SCX_EXIT_ERROR, fmt, ##args)
+
+#define SCX_HAS_OP(op)	(scx_ops.op != NULL)
+
+/*
+ * Operations are called with the kfuncs they may use recorded in
+ * current->scx.kf_mask, see scx_kf_allowed().
+ */
+#define SCX_CALL_OP(mask, op, args...)					\
+do {									\
+	current->scx.kf_mask |= (mask);					\
+	scx_ops.op(args);						\
+	current->scx.kf_mask &= ~(mask);				\
+} while (0)
+
+#define SCX_CALL_OP_RET(mask, op, args...)				\
+({									\
+	__typeof__(scx_ops.op(args)) __ret;				\
+	current->scx.kf_mask |= (mask);					\
+	__ret = scx_ops.op(args);					\
+	current->scx.kf_mask &= ~(mask);				\
+	__ret;								\
+})
+
+static enum scx_ops_enable_state scx_ops_enable_state(void)
+{
+	return atomic_read(&scx_ops_enable_state_var);
+}
+
+static enum scx_ops_enable_state
+scx_ops_set_enable_state(enum scx_ops_enable_state to)
+{
+	return atomic_xchg(&scx_ops_enable_state_var, to);
+}
+
+static bool scx_kf_allowed(u32 mask)
+{
+	/*
+	 * The DSQ hash and the rest only exist between scx_ops_enable() and
+	 * the end of scx_ops_disable_workfn().
+	 */
+	if (unlikely(scx_ops_enable_state() == SCX_OPS_DISABLED))
+		return false;
+
+	if (unlikely(!(current->scx.kf_mask & mask))) {
+		scx_ops_error("kfunc with mask 0x%x called from an operation only allowing 0x%x",
+			      mask, current->scx.kf_mask);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * While being disabled, the class keeps scheduling its remaining tasks
+ * FIFO through the global DSQ without calling into the BPF scheduler.
+ */
+static bool scx_ops_bypassing(void)
+{
+	return unlikely(scx_ops_enable_state() == SCX_OPS_DISABLING);
+}
+
+static bool ops_cpu_valid(s32 cpu)
+{
+	return likely(cpu >= 0 && cpu < nr_cpu_ids && cpu_possible(cpu));
+}
+
+static bool task_can_run_on_rq(struct task_struct *p, struct rq *rq)
+{
+	int cpu = cpu_of(rq);
+
+	return likely(cpumask_test_cpu(cpu, p->cpus_ptr) &&
+		      !is_migration_disabled(p)) && cpu_active(cpu);
+}
+
+/*
+ * Dispatch queues
+ */
+
+static void init_dsq(struct scx_dispatch_q *dsq, u64 dsq_id)
+{
+	memset(dsq, 0, sizeof(*dsq));
+	raw_spin_lock_init(&dsq->lock);
+	INIT_LIST_HEAD(&dsq->fifo);
+	dsq->id = dsq_id;
+}
+
+static struct scx_dispatch_q *find_user_dsq(u64 dsq_id)
+{
+	return rhashtable_lookup_fast(&dsq_hash, &dsq_id, dsq_hash_params);
+}
+
+static struct scx_dispatch_q *find_dsq_for_dispatch(struct rq *rq, u64 dsq_id,
+						    struct task_struct *p)
+{
+	struct scx_dispatch_q *dsq;
+
+	if (dsq_id == SCX_DSQ_LOCAL)
+		return &rq->scx.local_dsq;
+
+	if (dsq_id == SCX_DSQ_GLOBAL)
+		return &scx_dsq_global;
+
+	dsq = find_user_dsq(dsq_id);
+	if (unlikely(!dsq)) {
+		scx_ops_error("non-existent DSQ 0x%llx for %s[%d]",
+			      dsq_id, p->comm, p->pid);
+		return &scx_dsq_global;
+	}
+
+	return dsq;
+}
+
+static void dispatch_enqueue(struct scx_dispatch_q *dsq, struct task_struct *p,
+			     u64 enq_flags)
+{
+	raw_spin_lock(&dsq->lock);
+
+	/* raced against scx_bpf_destroy_dsq() */
+	if (unlikely(dsq->id == SCX_DSQ_INVALID)) {
+		raw_spin_unlock(&dsq->lock);
+		scx_ops_error("attempting to dispatch %s[%d] to a destroyed DSQ",
+			      p->comm, p->pid);
+		dsq = &scx_dsq_global;
+		raw_spin_lock(&dsq->lock);
+	}
+
+	if (enq_flags & SCX_ENQ_HEAD)
+		list_add(&p->scx.dsq_node, &dsq->fifo);
+	else
+		list_add_tail(&p->scx.dsq_node, &dsq->fifo);
+	WRITE_ONCE(dsq->nr, dsq->nr + 1);
+	WRITE_ONCE(p->scx.dsq, dsq);
+
+	raw_spin_unlock(&dsq->lock);
+}
+
+static void task_unlink_from_dsq(struct task_struct *p,
+				 struct scx_dispatch_q *dsq)
+{
+	list_del_init(&p->scx.dsq_node);
+	WRITE_ONCE(dsq->nr, dsq->nr - 1);
+	/* pairs with smp_load_acquire() in dispatch_dequeue() */
+	smp_store_release(&p->scx.dsq, NULL);
+}
+
+static void dispatch_dequeue(struct task_struct *p)
+{
+	struct scx_dispatch_q *dsq = smp_load_acquire(&p->scx.dsq);
+
+	if (dsq) {
+		raw_spin_lock(&dsq->lock);
+		/* a remote CPU may have taken @p off @dsq in the meantime */
+		if (p->scx.dsq == dsq)
+			task_unlink_from_dsq(p, dsq);
+		raw_spin_unlock(&dsq->lock);
+	}
+
+	/*
+	 * If a remote CPU took @p off its DSQ to migrate it, make it back
+	 * off, see consume_remote_task().
+	 */
+	WRITE_ONCE(p->scx.holding_cpu, -1);
+}
+
+/*
+ * Enqueue and dequeue
+ */
+
+static void set_task_runnable(struct rq *rq, struct task_struct *p)
+{
+	p->scx.runnable_at = jiffies;
+	list_add_tail(&p->scx.runnable_node, &rq->scx.runnable_list);
+}
+
+static void clr_task_runnable(struct task_struct *p)
+{
+	list_del_init(&p->scx.runnable_node);
+}
+
+static void do_enqueue_task(struct rq *rq, struct task_struct *p, u64 enq_flags)
+{
+	struct scx_dispatch_q *dsq;
+
+	/* migrated by consume_remote_task() */
+	if (p->scx.flags & SCX_TASK_ENQ_LOCAL) {
+		p->scx.flags &= ~SCX_TASK_ENQ_LOCAL;
+		dsq = &rq->scx.local_dsq;
+		goto dispatch;
+	}
+
+	/* dispatched from ops.select_cpu() */
+	if (p->scx.ddsp_dsq_id != SCX_DSQ_INVALID)
+		goto direct;
+
+	if (unlikely(scx_ops_bypassing()) || !SCX_HAS_OP(enqueue)) {
+		p->scx.slice = SCX_SLICE_DFL;
+		dsq = &scx_dsq_global;
+		goto dispatch;
+	}
+
+	__this_cpu_write(scx_ddsp_task, p);
+	SCX_CALL_OP(SCX_KF_ENQUEUE, enqueue, p, enq_flags);
+	__this_cpu_write(scx_ddsp_task, NULL);
+
+	if (likely(p->scx.ddsp_dsq_id != SCX_DSQ_INVALID))
+		goto direct;
+
+	scx_ops_error("ops.enqueue() didn't dispatch %s[%d]", p->comm, p->pid);
+	p->scx.slice = SCX_SLICE_DFL;
+	dsq = &scx_dsq_global;
+	goto dispatch;
+
+direct:
+	dsq = find_dsq_for_dispatch(rq, p->scx.ddsp_dsq_id, p);
+	enq_flags |= p->scx.ddsp_enq_flags;
+	p->scx.ddsp_dsq_id = SCX_DSQ_INVALID;
+	p->scx.ddsp_enq_flags = 0;
+dispatch:
+	dispatch_enqueue(dsq, p, enq_flags);
+
+	if (dsq == &rq->scx.local_dsq && (enq_flags & SCX_ENQ_PREEMPT) &&
+	    rq->curr != p) {
+		if (rq->curr->sched_class == &ext_sched_class)
+			rq->curr->scx.slice = 0;
+		resched_curr(rq);
+	}
+}
+
+static void enqueue_task_scx(struct rq *rq, struct task_struct *p, int enq_flags)
+{
+	if (WARN_ON_ONCE(p->scx.flags & SCX_TASK_QUEUED))
+		return;
+
+	p->scx.flags |= SCX_TASK_QUEUED;
+	rq->scx.nr_running++;
+	add_nr_running(rq, 1);
+
+	set_task_runnable(rq, p);
+	do_enqueue_task(rq, p, enq_flags);
+}
+
+static void dequeue_task_scx(struct rq *rq, struct task_struct *p, int deq_flags)
+{
+	if (!(p->scx.flags & SCX_TASK_QUEUED))
+		return;
+
+	/* migrations by consume_remote_task() aren't visible to the BPF side */
+	if (SCX_HAS_OP(dequeue) && !scx_ops_bypassing() &&
+	    !(p->scx.flags & SCX_TASK_ENQ_LOCAL))
+		SCX_CALL_OP(SCX_KF_REST, dequeue, p, deq_flags);
+
+	dispatch_dequeue(p);
+	clr_task_runnable(p);
+
+	p->scx.flags &= ~SCX_TASK_QUEUED;
+	rq->scx.nr_running--;
+	sub_nr_running(rq, 1);
+}
+
+static void yield_task_scx(struct rq *rq)
+{
+	rq->curr->scx.slice = 0;
+}
+
+/* tasks in this class only preempt each other through SCX_ENQ_PREEMPT */
+static void check_preempt_curr_scx(struct rq *rq, struct task_struct *p,
+				   int wake_flags)
+{
+}
+
+static void update_curr_scx(struct rq *rq)
+{
+	struct task_struct *curr = rq->curr;
+	u64 now = rq_clock_task(rq);
+	u64 delta_exec;
+
+	if (curr->sched_class != &ext_sched_class)
+		return;
+
+	delta_exec = now - curr->se.exec_start;
+	if (unlikely((s64)delta_exec <= 0))
+		return;
+
+	schedstat_set(curr->stats.exec_max,
+		      max(curr->stats.exec_max, delta_exec));
+	update_current_exec_runtime(curr, now, delta_exec);
+
+	curr->scx.slice -= min(curr->scx.slice, delta_exec);
+}
+
+/*
+ * Consuming shared DSQs into the local one
+ */
+
+/*
+ * @p was taken off its DSQ with ->holding_cpu set to this CPU while only
+ * the DSQ lock was held. Migrate it to @rq's local DSQ unless it was
+ * dequeued from @src_rq meanwhile, which resets ->holding_cpu.
+ */
+static bool consume_remote_task(struct rq *rq, struct rq_flags *rf,
+				struct task_struct *p, struct rq *src_rq)
+{
+	bool moved = false;
+
+	rq_unpin_lock(rq, rf);
+	double_lock_balance(rq, src_rq);
+
+	if (likely(READ_ONCE(p->scx.holding_cpu) == cpu_of(rq) &&
+		   task_rq(p) == src_rq && task_on_rq_queued(p))) {
+		p->scx.holding_cpu = -1;
+		p->scx.flags |= SCX_TASK_ENQ_LOCAL;
+		deactivate_task(src_rq, p, 0);
+		set_task_cpu(p, cpu_of(rq));
+		activate_task(rq, p, 0);
+		moved = true;
+	}
+
+	double_unlock_balance(rq, src_rq);
+	rq_repin_lock(rq, rf);
+
+	return moved;
+}
+
+static bool consume_dispatch_q(struct rq *rq, struct rq_flags *rf,
+			       struct scx_dispatch_q *dsq)
+{
+	struct task_struct *p;
+	struct rq *task_rq;
+
+retry:
+	if (!READ_ONCE(dsq->nr))
+		return false;
+
+	raw_spin_lock(&dsq->lock);
+
+	list_for_each_entry(p, &dsq->fifo, scx.dsq_node) {
+		task_rq = task_rq(p);
+
+		if (task_rq == rq) {
+			task_unlink_from_dsq(p, dsq);
+			raw_spin_unlock(&dsq->lock);
+			dispatch_enqueue(&rq->scx.local_dsq, p, 0);
+			return true;
+		}
+
+		if (task_can_run_on_rq(p, rq)) {
+			WRITE_ONCE(p->scx.holding_cpu, cpu_of(rq));
+			task_unlink_from_dsq(p, dsq);
+			raw_spin_unlock(&dsq->lock);
+			if (likely(consume_remote_task(rq, rf, p, task_rq)))
+				return true;
+			/*
+			 * @p was dequeued while we weren't holding any lock
+			 * and is gone from @dsq, there may be other tasks
+			 * we can take.
+			 */
+			goto retry;
+		}
+	}
+
+	raw_spin_unlock(&dsq->lock);
+	return false;
+}
+
+static int balance_scx(struct rq *rq, struct task_struct *prev,
+		       struct rq_flags *rf)
+{
+	bool prev_on_scx = prev->sched_class == &ext_sched_class;
+	struct scx_dsp_ctx *dspc;
+
+	if (!scx_enabled())
+		return 0;
+
+	if (prev_on_scx) {
+		update_curr_scx(rq);
+
+		/* put_prev_task_scx() will keep @prev at the head */
+		if ((prev->scx.flags & SCX_TASK_QUEUED) && prev->scx.slice)
+			return 1;
+	}
+
+	if (READ_ONCE(rq->scx.local_dsq.nr))
+		return 1;
+
+	if (consume_dispatch_q(rq, rf, &scx_dsq_global))
+		return 1;
+
+	if (SCX_HAS_OP(dispatch) && !scx_ops_bypassing()) {
+		dspc = this_cpu_ptr(&scx_dsp_ctx);
+		dspc->rq = rq;
+		dspc->rf = rf;
+		SCX_CALL_OP(SCX_KF_DISPATCH, dispatch, cpu_of(rq), prev);
+		dspc->rq = NULL;
+		dspc->rf = NULL;
+
+		if (READ_ONCE(rq->scx.local_dsq.nr))
+			return 1;
+	}
+
+	/* nothing else to run, let @prev go on with a fresh slice */
+	if (prev_on_scx && (prev->scx.flags & SCX_TASK_QUEUED)) {
+		prev->scx.slice = SCX_SLICE_DFL;
+		return 1;
+	}
+
+	return 0;
+}
+
+static void set_next_task_scx(struct rq *rq, struct task_struct *p, bool first)
+{
+	if (p->scx.flags & SCX_TASK_QUEUED) {
+		dispatch_dequeue(p);
+		clr_task_runnable(p);
+	}
+
+	p->se.exec_start = rq_clock_task(rq);
+
+	if (SCX_HAS_OP(running) && !scx_ops_bypassing())
+		SCX_CALL_OP(SCX_KF_REST, running, p);
+}
+
+static void put_prev_task_scx(struct rq *rq, struct task_struct *p)
+{
+	update_curr_scx(rq);
+
+	if (SCX_HAS_OP(stopping) && !scx_ops_bypassing())
+		SCX_CALL_OP(SCX_KF_REST, stopping, p,
+			    p->scx.flags & SCX_TASK_QUEUED);
+
+	if (!(p->scx.flags & SCX_TASK_QUEUED))
+		return;
+
+	set_task_runnable(rq, p);
+
+	/* preempted by a higher class with slice left, go again first */
+	if (p->scx.slice && !scx_ops_bypassing()) {
+		dispatch_enqueue(&rq->scx.local_dsq, p, SCX_ENQ_HEAD);
+		return;
+	}
+
+	do_enqueue_task(rq, p, 0);
+}
+
+static struct task_struct *first_local_task(struct rq *rq)
+{
+	return list_first_entry_or_null(&rq->scx.local_dsq.fifo,
+					struct task_struct, scx.dsq_node);
+}
+
+static struct task_struct *pick_task_scx(struct rq *rq)
+{
+	return first_local_task(rq);
+}
+
+static struct task_struct *pick_next_task_scx(struct rq *rq)
+{
+	struct task_struct *p = first_local_task(rq);
+
+	if (!p)
+		return NULL;
+
+	set_next_task_scx(rq, p, true);
+	return p;
+}
+
+/*
+ * Default ops.select_cpu(): @prev_cpu if idle, else an idle CPU sharing the
+ * LLC with it, else any idle CPU.
+ */
+static s32 scx_select_cpu_dfl(struct task_struct *p, s32 prev_cpu,
+			      u64 wake_flags)
+{
+	struct sched_domain *sd;
+	s32 cpu;
+
+	if (cpumask_test_cpu(prev_cpu, p->cpus_ptr) &&
+	    available_idle_cpu(prev_cpu))
+		return prev_cpu;
+
+	rcu_read_lock();
+	sd = rcu_dereference(per_cpu(sd_llc, prev_cpu));
+	if (sd) {
+		for_each_cpu_and(cpu, sched_domain_span(sd), p->cpus_ptr) {
+			if (available_idle_cpu(cpu))
+				goto out_unlock;
+		}
+	}
+	rcu_read_unlock();
+
+	for_each_cpu_and(cpu, p->cpus_ptr, cpu_active_mask) {
+		if (available_idle_cpu(cpu))
+			return cpu;
+	}
+
+	return prev_cpu;
+
+out_unlock:
+	rcu_read_unlock();
+	return cpu;
+}
+
+static int select_task_rq_scx(struct task_struct *p, int prev_cpu,
+			      int wake_flags)
+{
+	s32 cpu;
+
+	if (!SCX_HAS_OP(select_cpu) || scx_ops_bypassing())
+		return scx_select_cpu_dfl(p, prev_cpu, wake_flags);
+
+	/* sched_exec() balancing of a running task, no enqueue follows */
+	if (wake_flags & WF_EXEC)
+		return SCX_CALL_OP_RET(SCX_KF_REST, select_cpu, p, prev_cpu,
+				       wake_flags);
+
+	__this_cpu_write(scx_ddsp_task, p);
+	cpu = SCX_CALL_OP_RET(SCX_KF_SELECT_CPU, select_cpu, p, prev_cpu,
+			      wake_flags);
+	__this_cpu_write(scx_ddsp_task, NULL);
+
+	if (likely(ops_cpu_valid(cpu)))
+		return cpu;
+
+	scx_ops_error("select_cpu returned invalid cpu %d", cpu);
+	return prev_cpu;
+}
+
+static void task_tick_scx(struct rq *rq, struct task_struct *curr, int queued)
+{
+	update_curr_scx(rq);
+
+	/* out of slice, or preempted through SCX_ENQ_PREEMPT */
+	if (!curr->scx.slice)
+		resched_curr(rq);
+}
+
+static void switched_to_scx(struct rq *rq, struct task_struct *p)
+{
+}
+
+static void prio_changed_scx(struct rq *rq, struct task_struct *p, int oldprio)
+{
+}
+
+DEFINE_SCHED_CLASS(ext) = {
+	.enqueue_task		= enqueue_task_scx,
+	.dequeue_task		= dequeue_task_scx,
+	.yield_task		= yield_task_scx,
+
+	.check_preempt_curr	= check_preempt_curr_scx,
+
+	.pick_next_task		= pick_next_task_scx,
+	.put_prev_task		= put_prev_task_scx,
+	.set_next_task		= set_next_task_scx,
+
+	.balance		= balance_scx,
+	.pick_task		= pick_task_scx,
+	.select_task_rq		= select_task_rq_scx,
+	.set_cpus_allowed	= set_cpus_allowed_common,
+
+	.task_tick		= task_tick_scx,
+
+	.switched_to		= switched_to_scx,
+	.prio_changed		= prio_changed_scx,
+
+	.update_curr		= update_curr_scx,
+};
+
+/*
+ * Task lifecycle and the watchdog
+ */
+
+void init_scx_entity(struct sched_ext_entity *scx)
+{
+	memset(scx, 0, sizeof(*scx));
+	INIT_LIST_HEAD(&scx->dsq_node);
+	INIT_LIST_HEAD(&scx->runnable_node);
+	scx->holding_cpu = -1;
+	scx->ddsp_dsq_id = SCX_DSQ_INVALID;
+}
+
+bool task_should_scx(struct task_struct *p)
+{
+	if (!scx_enabled() || !p->scx.initialized)
+		return false;
+
+	switch (scx_ops_enable_state()) {
+	case SCX_OPS_ENABLING:
+	case SCX_OPS_ENABLED:
+		break;
+	default:
+		return false;
+	}
+
+	if (READ_ONCE(scx_switching_all))
+		return true;
+	return p->policy == SCHED_EXT;
+}
+
+static int scx_ops_init_task(struct task_struct *p)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	raw_spin_lock_irqsave(&p->pi_lock, flags);
+
+	switch (scx_ops_enable_state()) {
+	case SCX_OPS_ENABLING:
+	case SCX_OPS_ENABLED:
+		if (p->scx.initialized)
+			break;
+		if (SCX_HAS_OP(init_task))
+			ret = SCX_CALL_OP_RET(SCX_KF_REST, init_task, p);
+		if (!ret)
+			p->scx.initialized = true;
+		break;
+	default:
+		break;
+	}
+
+	raw_spin_unlock_irqrestore(&p->pi_lock, flags);
+	return ret;
+}
+
+static void scx_ops_exit_task(struct task_struct *p)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&p->pi_lock, flags);
+	if (p->scx.initialized) {
+		p->scx.initialized = false;
+		if (SCX_HAS_OP(exit_task))
+			SCX_CALL_OP(SCX_KF_REST, exit_task, p);
+	}
+	raw_spin_unlock_irqrestore(&p->pi_lock, flags);
+}
+
+void scx_post_fork(struct task_struct *p)
+{
+	int ret;
+
+	if (!scx_enabled())
+		return;
+
+	ret = scx_ops_init_task(p);
+	if (unlikely(ret)) {
+		scx_ops_error("ops.init_task() failed (%d) for %s[%d] while forking",
+			      ret, p->comm, p->pid);
+		return;
+	}
+
+	raw_spin_lock_irq(&p->pi_lock);
+	if (p->sched_class == &fair_sched_class && task_should_scx(p))
+		p->sched_class = &ext_sched_class;
+	raw_spin_unlock_irq(&p->pi_lock);
+}
+
+void scx_task_dead(struct task_struct *p)
+{
+	if (!scx_enabled())
+		return;
+
+	/* once disabling started, scx_ops_disable_workfn() takes care of @p */
+	switch (scx_ops_enable_state()) {
+	case SCX_OPS_ENABLING:
+	case SCX_OPS_ENABLED:
+		scx_ops_exit_task(p);
+		break;
+	default:
+		break;
+	}
+}
+
+static void check_rq_for_timeouts(struct rq *rq)
+{
+	struct task_struct *p;
+	u32 dur_ms;
+
+	lockdep_assert_rq_held(rq);
+
+	p = list_first_entry_or_null(&rq->scx.runnable_list,
+				     struct task_struct, scx.runnable_node);
+	if (!p || likely(!time_after(jiffies,
+				     p->scx.runnable_at + scx_watchdog_timeout)))
+		return;
+
+	dur_ms = jiffies_to_msecs(jiffies - p->scx.runnable_at);
+	scx_ops_error_kind(SCX_EXIT_ERROR_STALL,
+			   "%s[%d] failed to run for %u.%03us",
+			   p->comm, p->pid, dur_ms / 1000, dur_ms % 1000);
+}
+
+/* scheduler_tick() can't detect a CPU which stopped ticking */
+static void scx_watchdog_workfn(struct work_struct *work)
+{
+	struct rq_flags rf;
+	struct rq *rq;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		rq = cpu_rq(cpu);
+		rq_lock_irqsave(rq, &rf);
+		check_rq_for_timeouts(rq);
+		rq_unlock_irqrestore(rq, &rf);
+		cond_resched();
+	}
+
+	queue_delayed_work(system_unbound_wq, to_delayed_work(work),
+			   scx_watchdog_timeout / 2);
+}
+
+void scx_tick(struct rq *rq)
+{
+	if (!scx_enabled())
+		return;
+
+	check_rq_for_timeouts(rq);
+}
+
+static void scx_kick_cpu_workfn(struct irq_work *irq_work)
+{
+	struct rq *rq = container_of(irq_work, struct rq, scx.kick_work);
+
+	resched_cpu(cpu_of(rq));
+}
+
+/*
+ * Enabling and disabling
+ */
+
+static const char *scx_exit_reason(enum scx_exit_kind kind)
+{
+	switch (kind) {
+	case SCX_EXIT_UNREG:
+		return "BPF scheduler unregistered";
+	case SCX_EXIT_ERROR:
+		return "runtime error";
+	case SCX_EXIT_ERROR_BPF:
+		return "scx_bpf_error";
+	case SCX_EXIT_ERROR_STALL:
+		return "runnable task stall";
+	default:
+		return "<UNKNOWN>";
+	}
+}
+
+static void free_dsq_cb(void *ptr, void *arg)
+{
+	kfree(ptr);
+}
+
+static void scx_ops_disable_workfn(struct kthread_work *work)
+{
+	struct scx_exit_info *ei = scx_exit_info;
+	struct task_struct *g, *p;
+	int kind;
+
+	kind = atomic_read(&scx_exit_kind);
+	while (true) {
+		/*
+		 * NONE means a new BPF scheduler was loaded since this work
+		 * was queued, leave it alone. DONE means it's already
+		 * disabled.
+		 */
+		if (kind == SCX_EXIT_NONE || kind == SCX_EXIT_DONE)
+			return;
+		if (atomic_try_cmpxchg(&scx_exit_kind, &kind, SCX_EXIT_DONE))
+			break;
+	}
+
+	cancel_delayed_work_sync(&scx_watchdog_work);
+
+	mutex_lock(&scx_ops_enable_mutex);
+
+	switch (scx_ops_set_enable_state(SCX_OPS_DISABLING)) {
+	case SCX_OPS_DISABLED:
+	case SCX_OPS_DISABLING:
+		WARN_ONCE(true, "sched_ext: disabling while not enabled\n");
+		scx_ops_set_enable_state(SCX_OPS_DISABLED);
+		mutex_unlock(&scx_ops_enable_mutex);
+		return;
+	default:
+		break;
+	}
+
+	ei->kind = kind;
+	strscpy(ei->reason, scx_exit_reason(kind), sizeof(ei->reason));
+
+	/*
+	 * All operations are called from RCU read-side sections after
+	 * checking for bypass, wait for those that missed DISABLING.
+	 */
+	synchronize_rcu();
+
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, p)
+		sched_ext_reset_class(p);
+	read_unlock(&tasklist_lock);
+
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, p)
+		scx_ops_exit_task(p);
+	read_unlock(&tasklist_lock);
+
+	if (SCX_HAS_OP(exit))
+		SCX_CALL_OP(SCX_KF_EXIT, exit, ei);
+
+	WRITE_ONCE(scx_switching_all, false);
+	static_branch_disable(&__scx_ops_enabled);
+	rhashtable_free_and_destroy(&dsq_hash, free_dsq_cb, NULL);
+
+	if (kind >= SCX_EXIT_ERROR) {
+		pr_err("sched_ext: BPF scheduler \"%s\" errored, disabling (%s)\n",
+		       scx_ops.name, ei->reason);
+		if (ei->msg[0])
+			pr_err("sched_ext: %s\n", ei->msg);
+	} else {
+		pr_info("sched_ext: BPF scheduler \"%s\" disabled (%s)\n",
+			scx_ops.name, ei->reason);
+	}
+
+	memset(&scx_ops, 0, sizeof(scx_ops));
+	scx_ops_kdata = NULL;
+	scx_exit_info = NULL;
+	kfree(ei);
+
+	WARN_ON_ONCE(scx_ops_set_enable_state(SCX_OPS_DISABLED) !=
+		     SCX_OPS_DISABLING);
+	mutex_unlock(&scx_ops_enable_mutex);
+}
+
+static void scx_ops_disable(enum scx_exit_kind kind)
+{
+	int none = SCX_EXIT_NONE;
+
+	if (WARN_ON_ONCE(kind == SCX_EXIT_NONE || kind == SCX_EXIT_DONE))
+		kind = SCX_EXIT_ERROR;
+
+	atomic_try_cmpxchg(&scx_exit_kind, &none, kind);
+	kthread_queue_work(scx_ops_helper, &scx_ops_disable_work);
+}
+
+static void scx_ops_error_irq_workfn(struct irq_work *irq_work)
+{
+	kthread_queue_work(scx_ops_helper, &scx_ops_disable_work);
+}
+
+/* only the first error is recorded, and triggers disabling */
+static __printf(2, 3) void scx_ops_error_kind(enum scx_exit_kind kind,
+					      const char *fmt, ...)
+{
+	struct scx_exit_info *ei = scx_exit_info;
+	int none = SCX_EXIT_NONE;
+	va_list args;
+
+	if (!atomic_try_cmpxchg(&scx_exit_kind, &none, kind))
+		return;
+
+	va_start(args, fmt);
+	vscnprintf(ei->msg, SCX_EXIT_MSG_LEN, fmt, args);
+	va_end(args);
+
+	irq_work_queue(&scx_ops_error_irq_work);
+}
+
+static int scx_ops_enable(struct sched_ext_ops *ops)
+{
+	struct kthread_worker *helper;
+	struct task_struct *g, *p;
+	int ret;
+
+	mutex_lock(&scx_ops_enable_mutex);
+
+	if (!scx_ops_helper) {
+		helper = kthread_create_worker(0, "sched_ext_ops_helper");
+		if (IS_ERR(helper)) {
+			ret = PTR_ERR(helper);
+			goto err_unlock;
+		}
+		sched_set_fifo(helper->task);
+		scx_ops_helper = helper;
+	}
+
+	if (scx_ops_enable_state() != SCX_OPS_DISABLED) {
+		ret = -EBUSY;
+		goto err_unlock;
+	}
+
+	ret = rhashtable_init(&dsq_hash, &dsq_hash_params);
+	if (ret)
+		goto err_unlock;
+
+	scx_exit_info = kzalloc(sizeof(*scx_exit_info), GFP_KERNEL);
+	if (!scx_exit_info) {
+		ret = -ENOMEM;
+		goto err_free_hash;
+	}
+
+	/* from here on, errors are reported through scx_ops_error() */
+	scx_ops = *ops;
+	scx_ops_kdata = ops;
+	atomic_set(&scx_exit_kind, SCX_EXIT_NONE);
+	WARN_ON_ONCE(scx_ops_set_enable_state(SCX_OPS_ENABLING) !=
+		     SCX_OPS_DISABLED);
+
+	scx_watchdog_timeout = SCX_WATCHDOG_MAX_TIMEOUT;
+	if (ops->timeout_ms)
+		scx_watchdog_timeout = msecs_to_jiffies(ops->timeout_ms);
+	queue_delayed_work(system_unbound_wq, &scx_watchdog_work,
+			   scx_watchdog_timeout / 2);
+
+	if (SCX_HAS_OP(init)) {
+		ret = SCX_CALL_OP_RET(SCX_KF_INIT, init);
+		if (ret) {
+			scx_ops_error("ops.init() failed (%d)", ret);
+			goto err_disable;
+		}
+	}
+
+	/* new tasks are initialized by scx_post_fork() from now on */
+	static_branch_enable(&__scx_ops_enabled);
+
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, p) {
+		ret = scx_ops_init_task(p);
+		if (ret) {
+			scx_ops_error("ops.init_task() failed (%d) for %s[%d] while loading",
+				      ret, p->comm, p->pid);
+			break;
+		}
+	}
+	read_unlock(&tasklist_lock);
+	if (ret)
+		goto err_disable;
+
+	WRITE_ONCE(scx_switching_all, !(ops->flags & SCX_OPS_SWITCH_PARTIAL));
+	WARN_ON_ONCE(scx_ops_set_enable_state(SCX_OPS_ENABLED) !=
+		     SCX_OPS_ENABLING);
+
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, p)
+		sched_ext_reset_class(p);
+	read_unlock(&tasklist_lock);
+
+	pr_info("sched_ext: BPF scheduler \"%s\" enabled\n", scx_ops.name);
+	mutex_unlock(&scx_ops_enable_mutex);
+	return 0;
+
+err_free_hash:
+	rhashtable_free_and_destroy(&dsq_hash, NULL, NULL);
+err_unlock:
+	mutex_unlock(&scx_ops_enable_mutex);
+	return ret;
+
+err_disable:
+	mutex_unlock(&scx_ops_enable_mutex);
+	/* scx_ops_error() queued the disable work, wait for it */
+	irq_work_sync(&scx_ops_error_irq_work);
+	kthread_flush_work(&scx_ops_disable_work);
+	return ret;
+}
+
+void __init init_sched_ext_class(void)
+{
+	struct rq *rq;
+	int cpu;
+
+	init_dsq(&scx_dsq_global, SCX_DSQ_GLOBAL);
+
+	for_each_possible_cpu(cpu) {
+		rq = cpu_rq(cpu);
+		init_dsq(&rq->scx.local_dsq, SCX_DSQ_LOCAL);
+		INIT_LIST_HEAD(&rq->scx.runnable_list);
+		init_irq_work(&rq->scx.kick_work, scx_kick_cpu_workfn);
+	}
+
+	INIT_DELAYED_WORK(&scx_watchdog_work, scx_watchdog_workfn);
+}
+
+/*
+ * struct_ops
+ */
+
+/* "extern" is to avoid sparse warning.  It is only used in bpf_struct_ops.c. */
+extern struct bpf_struct_ops bpf_sched_ext_ops;
+
+static const struct bpf_func_proto *
+bpf_scx_get_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
+{
+	switch (func_id) {
+	case BPF_FUNC_task_storage_get:
+		return &bpf_task_storage_get_proto;
+	case BPF_FUNC_task_storage_delete:
+		return &bpf_task_storage_delete_proto;
+	default:
+		return bpf_base_func_proto(func_id);
+	}
+}
+
+static int bpf_scx_btf_struct_access(struct bpf_verifier_log *log,
+				     const struct bpf_reg_state *reg,
+				     int off, int size)
+{
+	bpf_log(log, "only read is supported\n");
+	return -EACCES;
+}
+
+static const struct bpf_verifier_ops bpf_scx_verifier_ops = {
+	.get_func_proto		= bpf_scx_get_func_proto,
+	.is_valid_access	= bpf_tracing_btf_ctx_access,
+	.btf_struct_access	= bpf_scx_btf_struct_access,
+};
+
+static int bpf_scx_reg(void *kdata)
+{
+	return scx_ops_enable(kdata);
+}
+
+static void bpf_scx_unreg(void *kdata)
+{
+	mutex_lock(&scx_ops_enable_mutex);
+	if (scx_ops_kdata != kdata) {
+		/* already disabled on error */
+		mutex_unlock(&scx_ops_enable_mutex);
+		return;
+	}
+	scx_ops_disable(SCX_EXIT_UNREG);
+	mutex_unlock(&scx_ops_enable_mutex);
+
+	kthread_flush_work(&scx_ops_disable_work);
+}
+
+static int bpf_scx_check_member(const struct btf_type *t,
+				const struct btf_member *member,
+				const struct bpf_prog *prog)
+{
+	return 0;
+}
+
+static int bpf_scx_init_member(const struct btf_type *t,
+			       const struct btf_member *member,
+			       void *kdata, const void *udata)
+{
+	const struct sched_ext_ops *uops = udata;
+	struct sched_ext_ops *ops = kdata;
+	u32 moff = __btf_member_bit_offset(t, member) / 8;
+
+	switch (moff) {
+	case offsetof(struct sched_ext_ops, flags):
+		if (uops->flags & ~SCX_OPS_ALL_FLAGS)
+			return -EINVAL;
+		ops->flags = uops->flags;
+		return 1;
+	case offsetof(struct sched_ext_ops, timeout_ms):
+		if (msecs_to_jiffies(uops->timeout_ms) >
+		    SCX_WATCHDOG_MAX_TIMEOUT)
+			return -E2BIG;
+		ops->timeout_ms = uops->timeout_ms;
+		return 1;
+	case offsetof(struct sched_ext_ops, name):
+		if (bpf_obj_name_cpy(ops->name, uops->name,
+				     sizeof(ops->name)) <= 0)
+			return -EINVAL;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int bpf_scx_init(struct btf *btf)
+{
+	return 0;
+}
+
+struct bpf_struct_ops bpf_sched_ext_ops = {
+	.verifier_ops	= &bpf_scx_verifier_ops,
+	.reg		= bpf_scx_reg,
+	.unreg		= bpf_scx_unreg,
+	.check_member	= bpf_scx_check_member,
+	.init_member	= bpf_scx_init_member,
+	.init		= bpf_scx_init,
+	.name		= "sched_ext_ops",
+};
+
+/*
+ * kfuncs
+ */
+
+__diag_push();
+__diag_ignore_all("-Wmissing-prototypes",
+		  "Global functions as their definitions will be in vmlinux BTF");
+
+/**
+ * scx_bpf_create_dsq - Create a DSQ
+ * @dsq_id: DSQ to create, must not have %SCX_DSQ_FLAG_BUILTIN set
+ * @node: NUMA node to allocate from, or %NUMA_NO_NODE
+ *
+ * Only allowed from ops.init().
+ */
+__bpf_kfunc s32 scx_bpf_create_dsq(u64 dsq_id, s32 node)
+{
+	struct scx_dispatch_q *dsq;
+	int ret;
+
+	if (!scx_kf_allowed(SCX_KF_INIT))
+		return -EINVAL;
+
+	if (unlikely(node >= (int)nr_node_ids ||
+		     (node < 0 && node != NUMA_NO_NODE)))
+		return -EINVAL;
+
+	if (dsq_id & SCX_DSQ_FLAG_BUILTIN)
+		return -EINVAL;
+
+	dsq = kmalloc_node(sizeof(*dsq), GFP_ATOMIC, node);
+	if (!dsq)
+		return -ENOMEM;
+
+	init_dsq(dsq, dsq_id);
+
+	ret = rhashtable_lookup_insert_fast(&dsq_hash, &dsq->hash_node,
+					    dsq_hash_params);
+	if (ret)
+		kfree(dsq);
+	return ret;
+}
+
+/**
+ * scx_bpf_destroy_dsq - Destroy an empty DSQ
+ * @dsq_id: DSQ to destroy
+ *
+ * Destroying a DSQ with tasks on it is an error.
+ */
+__bpf_kfunc void scx_bpf_destroy_dsq(u64 dsq_id)
+{
+	struct scx_dispatch_q *dsq;
+	unsigned long flags;
+
+	if (!scx_kf_allowed(SCX_KF_ANY))
+		return;
+
+	dsq = find_user_dsq(dsq_id);
+	if (!dsq)
+		return;
+
+	raw_spin_lock_irqsave(&dsq->lock, flags);
+
+	if (dsq->nr) {
+		scx_ops_error("attempting to destroy in-use DSQ 0x%016llx (nr=%u)",
+			      dsq->id, dsq->nr);
+		goto out_unlock;
+	}
+
+	if (rhashtable_remove_fast(&dsq_hash, &dsq->hash_node, dsq_hash_params))
+		goto out_unlock;
+
+	/* make racing dispatch_enqueue() calls fail */
+	dsq->id = SCX_DSQ_INVALID;
+	kfree_rcu(dsq, rcu);
+
+out_unlock:
+	raw_spin_unlock_irqrestore(&dsq->lock, flags);
+}
+
+/**
+ * scx_bpf_dispatch - Dispatch a task to a DSQ
+ * @p: task_struct to dispatch
+ * @dsq_id: DSQ to dispatch to
+ * @slice: duration @p can run for in nsecs, 0 for %SCX_SLICE_DFL
+ * @enq_flags: %SCX_ENQ_*
+ *
+ * Only allowed on the task being handled by ops.select_cpu() or
+ * ops.enqueue(), once. %SCX_DSQ_LOCAL is the local DSQ of the CPU @p ends
+ * up on.
+ */
+__bpf_kfunc void scx_bpf_dispatch(struct task_struct *p, u64 dsq_id, u64 slice,
+				  u64 enq_flags)
+{
+	if (!scx_kf_allowed(SCX_KF_SELECT_CPU | SCX_KF_ENQUEUE))
+		return;
+
+	if (unlikely(__this_cpu_read(scx_ddsp_task) != p)) {
+		scx_ops_error("%s[%d] can only be dispatched from its own ops.select_cpu() or ops.enqueue()",
+			      p->comm, p->pid);
+		return;
+	}
+
+	if (unlikely(p->scx.ddsp_dsq_id != SCX_DSQ_INVALID)) {
+		scx_ops_error("%s[%d] dispatched twice", p->comm, p->pid);
+		return;
+	}
+
+	p->scx.slice = slice ?: SCX_SLICE_DFL;
+	p->scx.ddsp_dsq_id = dsq_id;
+	p->scx.ddsp_enq_flags = enq_flags;
+}
+
+/**
+ * scx_bpf_consume - Move a task from a DSQ to the current CPU's local DSQ
+ * @dsq_id: DSQ to consume
+ *
+ * The first task on @dsq_id which can run on the current CPU is moved.
+ * Only allowed from ops.dispatch(). Returns whether a task was moved.
+ */
+__bpf_kfunc bool scx_bpf_consume(u64 dsq_id)
+{
+	struct scx_dsp_ctx *dspc = this_cpu_ptr(&scx_dsp_ctx);
+	struct scx_dispatch_q *dsq;
+
+	if (!scx_kf_allowed(SCX_KF_DISPATCH))
+		return false;
+
+	if (dsq_id == SCX_DSQ_GLOBAL)
+		dsq = &scx_dsq_global;
+	else
+		dsq = find_user_dsq(dsq_id);
+	if (unlikely(!dsq)) {
+		scx_ops_error("invalid DSQ ID 0x%016llx", dsq_id);
+		return false;
+	}
+
+	return consume_dispatch_q(dspc->rq, dspc->rf, dsq);
+}
+
+/**
+ * scx_bpf_dsq_nr_queued - Return the number of queued tasks
+ * @dsq_id: DSQ to examine, %SCX_DSQ_LOCAL for the current CPU's
+ */
+__bpf_kfunc s32 scx_bpf_dsq_nr_queued(u64 dsq_id)
+{
+	struct scx_dispatch_q *dsq;
+
+	if (!scx_kf_allowed(SCX_KF_ANY))
+		return -EPERM;
+
+	if (dsq_id == SCX_DSQ_LOCAL)
+		return READ_ONCE(this_rq()->scx.local_dsq.nr);
+
+	if (dsq_id == SCX_DSQ_GLOBAL)
+		dsq = &scx_dsq_global;
+	else
+		dsq = find_user_dsq(dsq_id);
+	if (unlikely(!dsq)) {
+		scx_ops_error("invalid DSQ ID 0x%016llx", dsq_id);
+		return -ENOENT;
+	}
+
+	return READ_ONCE(dsq->nr);
+}
+
+/**
+ * scx_bpf_kick_cpu - Trigger rescheduling on a CPU
+ * @cpu: CPU to kick
+ * @flags: reserved, must be 0
+ *
+ * Makes an idle @cpu go through balance_scx() and thus ops.dispatch().
+ */
+__bpf_kfunc void scx_bpf_kick_cpu(s32 cpu, u64 flags)
+{
+	if (!scx_kf_allowed(SCX_KF_ANY))
+		return;
+
+	if (!ops_cpu_valid(cpu)) {
+		scx_ops_error("invalid cpu %d", cpu);
+		return;
+	}
+
+	if (cpu_online(cpu))
+		irq_work_queue_on(&cpu_rq(cpu)->scx.kick_work, cpu);
+}
+
+/**
+ * scx_bpf_select_cpu_dfl - The default ops.select_cpu() implementation
+ * @p: task_struct to select a CPU for
+ * @prev_cpu: CPU @p was on previously
+ * @wake_flags: %SCX_WAKE_*
+ *
+ * Only allowed from ops.select_cpu().
+ */
+__bpf_kfunc s32 scx_bpf_select_cpu_dfl(struct task_struct *p, s32 prev_cpu,
+				       u64 wake_flags)
+{
+	if (!scx_kf_allowed(SCX_KF_SELECT_CPU))
+		return prev_cpu;
+
+	return scx_select_cpu_dfl(p, prev_cpu, wake_flags);
+}
+
+/**
+ * scx_bpf_error_bstr - Disable the BPF scheduler with an error message
+ * @fmt: error message format string
+ * @data: format string parameters packaged using ___bpf_fill() macro
+ * @data__sz: @data len, must end in '__sz' for the verifier
+ *
+ * Use the scx_bpf_error() wrapper from the BPF side.
+ */
+__bpf_kfunc void scx_bpf_error_bstr(char *fmt, unsigned long long *data,
+				    u32 data__sz)
+{
+	static char buf[SCX_EXIT_MSG_LEN];
+	static DEFINE_RAW_SPINLOCK(buf_lock);
+	struct bpf_bprintf_data bprintf_data = { .get_bin_args = true };
+	unsigned long flags;
+	int ret;
+
+	if (data__sz % 8 || data__sz > MAX_BPRINTF_VARARGS * 8 ||
+	    (data__sz && !data)) {
+		scx_ops_error("invalid data=%p and data__sz=%u",
+			      (void *)data, data__sz);
+		return;
+	}
+
+	ret = bpf_bprintf_prepare(fmt, UINT_MAX, data, data__sz / 8,
+				  &bprintf_data);
+	if (ret < 0) {
+		scx_ops_error("failed to format error message (%d)", ret);
+		return;
+	}
+
+	raw_spin_lock_irqsave(&buf_lock, flags);
+	bstr_printf(buf, sizeof(buf), fmt, bprintf_data.bin_args);
+	scx_ops_error_kind(SCX_EXIT_ERROR_BPF, "%s", buf);
+	raw_spin_unlock_irqrestore(&buf_lock, flags);
+
+	bpf_bprintf_cleanup(&bprintf_data);
+}
+
+/**
+ * scx_bpf_task_cpu - CPU a task is currently associated with
+ * @p: task of interest
+ */
+__bpf_kfunc s32 scx_bpf_task_cpu(const struct task_struct *p)
+{
+	return task_cpu(p);
+}
+
+/**
+ * scx_bpf_nr_cpu_ids - Number of possible CPU IDs
+ */
+__bpf_kfunc u32 scx_bpf_nr_cpu_ids(void)
+{
+	return nr_cpu_ids;
+}
+
+__diag_pop();
+
+BTF_SET8_START(scx_kfunc_ids)
+BTF_ID_FLAGS(func, scx_bpf_create_dsq)
+BTF_ID_FLAGS(func, scx_bpf_destroy_dsq)
+BTF_ID_FLAGS(func, scx_bpf_dispatch, KF_RCU)
+BTF_ID_FLAGS(func, scx_bpf_consume)
+BTF_ID_FLAGS(func, scx_bpf_dsq_nr_queued)
+BTF_ID_FLAGS(func, scx_bpf_kick_cpu)
+BTF_ID_FLAGS(func, scx_bpf_select_cpu_dfl, KF_RCU)
+BTF_ID_FLAGS(func, scx_bpf_error_bstr)
+BTF_ID_FLAGS(func, scx_bpf_task_cpu, KF_RCU)
+BTF_ID_FLAGS(func, scx_bpf_nr_cpu_ids)
+BTF_SET8_END(scx_kfunc_ids)
+
+/* keep the other struct_ops, e.g. tcp_congestion_ops, off the scx kfuncs */
+static int scx_kfunc_filter(const struct bpf_prog *prog, u32 kfunc_id)
+{
+	if (!btf_id_set8_contains(&scx_kfunc_ids, kfunc_id))
+		return 0;
+
+	if (prog->aux->attach_btf_id != bpf_sched_ext_ops.type_id)
+		return -EACCES;
+
+	return 0;
+}
+
+static const struct btf_kfunc_id_set scx_kfunc_set = {
+	.owner	= THIS_MODULE,
+	.set	= &scx_kfunc_ids,
+	.filter	= scx_kfunc_filter,
+};
+
+static int __init scx_init(void)
+{
+	int ret;
+
+	ret = register_btf_kfunc_id_set(BPF_PROG_TYPE_STRUCT_OPS,
+					&scx_kfunc_set);
+	if (ret) {
+		pr_err("sched_ext: failed to register kfunc set (%d)\n", ret);
+		return ret;
+	}
+
+	return 0;
+}
+late_initcall(scx_init);
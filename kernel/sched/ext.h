@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * BPF extensible scheduler class: core scheduler interface, see ext.c.
+ */
+#ifndef _KERNEL_SCHED_EXT_H
+#define _KERNEL_SCHED_EXT_H
+
+#ifdef CONFIG_SCHED_CLASS_EXT
+
+DECLARE_STATIC_KEY_FALSE(__scx_ops_enabled);
+
+#define scx_enabled()		static_branch_unlikely(&__scx_ops_enabled)
+
+bool task_should_scx(struct task_struct *p);
+void init_scx_entity(struct sched_ext_entity *scx);
+void scx_post_fork(struct task_struct *p);
+void scx_task_dead(struct task_struct *p);
+void scx_tick(struct rq *rq);
+void init_sched_ext_class(void);
+
+/* core.c */
+void sched_ext_reset_class(struct task_struct *p);
+
+#else	/* CONFIG_SCHED_CLASS_EXT */
+
+#define scx_enabled()		false
+
+static inline bool task_should_scx(struct task_struct *p) { return false; }
+static inline void scx_post_fork(struct task_struct *p) {}
+static inline void scx_task_dead(struct task_struct *p) {}
+static inline void scx_tick(struct rq *rq) {}
+static inline void init_sched_ext_class(void) {}
+
+#endif	/* CONFIG_SCHED_CLASS_EXT */
+#endif	/* _KERNEL_SCHED_EXT_H */
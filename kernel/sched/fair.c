@@ -46,6 +46,7 @@
 #include <linux/profile.h>
 #include <linux/psi.h>
 #include <linux/ratelimit.h>
+#include <linux/rbtree_augmented.h>
 #include <linux/task_work.h>
 
 #include <asm/switch_to.h>
@@ -604,6 +605,117 @@ static inline bool entity_before(const struct sched_entity *a,
 #define __node_2_se(node) \
 	rb_entry((node), struct sched_entity, run_node)
 
+/*
+ * Average vruntime and eligibility:
+ *
+ * The virtual time of the runqueue is the load weighted average of the
+ * vruntime of all runnable entities:
+ *
+ *   V = \Sum w_i * v_i / W
+ *
+ * An entity is eligible when its lag, the service it is owed, is not
+ * negative, that is when v_i <= V. Only eligible entities are considered
+ * for their virtual deadline, which keeps short-slice (low latency_nice)
+ * tasks from running early more often than their weight allows.
+ *
+ * The sum is kept relative to min_vruntime to avoid overflow:
+ *
+ *   \Sum w_i * (v_i - min_vruntime)
+ *
+ * and is adjusted whenever min_vruntime moves. The current entity is not
+ * in the tree and is accounted on demand.
+ */
+static inline s64 entity_key(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	return (s64)(se->vruntime - cfs_rq->min_vruntime);
+}
+
+static void
+avg_vruntime_add(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	unsigned long weight = scale_load_down(se->load.weight);
+	s64 key = entity_key(cfs_rq, se);
+
+	cfs_rq->avg_vruntime += key * weight;
+	cfs_rq->avg_load += weight;
+}
+
+static void
+avg_vruntime_sub(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	unsigned long weight = scale_load_down(se->load.weight);
+	s64 key = entity_key(cfs_rq, se);
+
+	cfs_rq->avg_vruntime -= key * weight;
+	cfs_rq->avg_load -= weight;
+}
+
+static inline
+void avg_vruntime_update(struct cfs_rq *cfs_rq, s64 delta)
+{
+	/* v - (min_vruntime + delta) */
+	cfs_rq->avg_vruntime -= cfs_rq->avg_load * delta;
+}
+
+u64 avg_vruntime(struct cfs_rq *cfs_rq)
+{
+	struct sched_entity *curr = cfs_rq->curr;
+	s64 avg = cfs_rq->avg_vruntime;
+	long load = cfs_rq->avg_load;
+
+	if (curr && curr->on_rq) {
+		unsigned long weight = scale_load_down(curr->load.weight);
+
+		avg += entity_key(cfs_rq, curr) * weight;
+		load += weight;
+	}
+
+	if (load) {
+		/* round towards -inf so the result stays on a runnable entity */
+		if (avg < 0)
+			avg -= (load - 1);
+		avg = div_s64(avg, load);
+	}
+
+	return cfs_rq->min_vruntime + avg;
+}
+
+/*
+ * v_i <= V, but without the division:
+ *
+ *   (v_i - min_vruntime) * W <= \Sum w_j * (v_j - min_vruntime)
+ */
+static int entity_eligible(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	struct sched_entity *curr = cfs_rq->curr;
+	s64 avg = cfs_rq->avg_vruntime;
+	long load = cfs_rq->avg_load;
+
+	if (curr && curr->on_rq) {
+		unsigned long weight = scale_load_down(curr->load.weight);
+
+		avg += entity_key(cfs_rq, curr) * weight;
+		load += weight;
+	}
+
+	return avg >= entity_key(cfs_rq, se) * load;
+}
+
+static u64 __update_min_vruntime(struct cfs_rq *cfs_rq, u64 vruntime)
+{
+	u64 min_vruntime = cfs_rq->min_vruntime;
+	/*
+	 * open coded max_vruntime() to allow updating avg_vruntime
+	 */
+	s64 delta = (s64)(vruntime - min_vruntime);
+
+	if (delta > 0) {
+		avg_vruntime_update(cfs_rq, delta);
+		min_vruntime = vruntime;
+	}
+	return min_vruntime;
+}
+
 static void update_min_vruntime(struct cfs_rq *cfs_rq)
 {
 	struct sched_entity *curr = cfs_rq->curr;
@@ -629,7 +741,7 @@ static void update_min_vruntime(struct cfs_rq *cfs_rq)
 
 	/* ensure we never gain time by being placed backwards. */
 	u64_u32_store(cfs_rq->min_vruntime,
-		      max_vruntime(cfs_rq->min_vruntime, vruntime));
+		      __update_min_vruntime(cfs_rq, vruntime));
 }
 
 static inline bool __entity_less(struct rb_node *a, const struct rb_node *b)
@@ -637,17 +749,52 @@ static inline bool __entity_less(struct rb_node *a, const struct rb_node *b)
 	return entity_before(__node_2_se(a), __node_2_se(b));
 }
 
+#define deadline_gt(field, lse, rse) ({ (s64)((lse)->field - (rse)->field) > 0; })
+
+static inline void __update_min_deadline(struct sched_entity *se, struct rb_node *node)
+{
+	if (node) {
+		struct sched_entity *rse = __node_2_se(node);
+
+		if (deadline_gt(min_deadline, se, rse))
+			se->min_deadline = rse->min_deadline;
+	}
+}
+
+/*
+ * se->min_deadline = min(se->deadline, left->min_deadline, right->min_deadline)
+ */
+static inline bool min_deadline_update(struct sched_entity *se, bool exit)
+{
+	u64 old_min_deadline = se->min_deadline;
+	struct rb_node *node = &se->run_node;
+
+	se->min_deadline = se->deadline;
+	__update_min_deadline(se, node->rb_right);
+	__update_min_deadline(se, node->rb_left);
+
+	return se->min_deadline == old_min_deadline;
+}
+
+RB_DECLARE_CALLBACKS(static, min_deadline_cb, struct sched_entity,
+		     run_node, min_deadline, min_deadline_update);
+
 /*
  * Enqueue an entity into the rb-tree:
  */
 static void __enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
-	rb_add_cached(&se->run_node, &cfs_rq->tasks_timeline, __entity_less);
+	avg_vruntime_add(cfs_rq, se);
+	se->min_deadline = se->deadline;
+	rb_add_augmented_cached(&se->run_node, &cfs_rq->tasks_timeline,
+				__entity_less, &min_deadline_cb);
 }
 
 static void __dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
-	rb_erase_cached(&se->run_node, &cfs_rq->tasks_timeline);
+	rb_erase_augmented_cached(&se->run_node, &cfs_rq->tasks_timeline,
+				  &min_deadline_cb);
+	avg_vruntime_sub(cfs_rq, se);
 }
 
 struct sched_entity *__pick_first_entity(struct cfs_rq *cfs_rq)
@@ -670,6 +817,111 @@ static struct sched_entity *__pick_next_entity(struct sched_entity *se)
 	return __node_2_se(next);
 }
 
+/*
+ * Earliest Eligible Virtual Deadline First
+ *
+ * Of the eligible entities, including the current one, pick the one with
+ * the earliest virtual deadline.
+ *
+ * The tree is ordered by vruntime, so the eligible entities form a prefix
+ * of it; each node caches the earliest deadline of its subtree in
+ * min_deadline. Walk down towards the eligibility boundary remembering the
+ * best eligible node and the left subtree (entirely eligible) with the
+ * best min_deadline, then descend that subtree to the node holding it.
+ * This is O(log n).
+ */
+static struct sched_entity *__pick_eevdf(struct cfs_rq *cfs_rq)
+{
+	struct rb_node *node = cfs_rq->tasks_timeline.rb_root.rb_node;
+	struct sched_entity *curr = cfs_rq->curr;
+	struct sched_entity *best = NULL;
+	struct sched_entity *best_left = NULL;
+
+	if (curr && (!curr->on_rq || !entity_eligible(cfs_rq, curr)))
+		curr = NULL;
+	best = curr;
+
+	while (node) {
+		struct sched_entity *se = __node_2_se(node);
+
+		/*
+		 * If this entity is not eligible, try the left subtree.
+		 */
+		if (!entity_eligible(cfs_rq, se)) {
+			node = node->rb_left;
+			continue;
+		}
+
+		if (!best || deadline_gt(deadline, best, se))
+			best = se;
+
+		/*
+		 * Every entity in the left subtree is eligible, remember the
+		 * one with the earliest min_deadline.
+		 */
+		if (node->rb_left) {
+			struct sched_entity *left = __node_2_se(node->rb_left);
+
+			if (!best_left || deadline_gt(min_deadline, best_left, left))
+				best_left = left;
+
+			/* min_deadline is in the left subtree, go find it */
+			if (left->min_deadline == se->min_deadline)
+				break;
+		}
+
+		/* min_deadline is at this node, no need to look right */
+		if (se->deadline == se->min_deadline)
+			break;
+
+		/* else min_deadline is in the right subtree */
+		node = node->rb_right;
+	}
+
+	/*
+	 * Either the best is an eligible node found on the way down, or
+	 * the tree was empty and @curr (or nothing) is the answer.
+	 */
+	if (!best_left || (s64)(best_left->min_deadline - best->deadline) > 0)
+		return best;
+
+	/*
+	 * best_left and all of its children are eligible, look for the node
+	 * with deadline == min_deadline.
+	 */
+	node = &best_left->run_node;
+	while (node) {
+		struct sched_entity *se = __node_2_se(node);
+
+		if (se->deadline == se->min_deadline)
+			return se;
+
+		if (node->rb_left &&
+		    __node_2_se(node->rb_left)->min_deadline == se->min_deadline) {
+			node = node->rb_left;
+			continue;
+		}
+
+		node = node->rb_right;
+	}
+	return NULL;
+}
+
+static struct sched_entity *pick_eevdf(struct cfs_rq *cfs_rq)
+{
+	struct sched_entity *se = __pick_eevdf(cfs_rq);
+
+	if (!se) {
+		struct sched_entity *left = __pick_first_entity(cfs_rq);
+
+		if (printk_ratelimit())
+			pr_err("EEVDF scheduling fail, picking leftmost\n");
+		return left;
+	}
+
+	return se;
+}
+
 #ifdef CONFIG_SCHED_DEBUG
 struct sched_entity *__pick_last_entity(struct cfs_rq *cfs_rq)
 {
@@ -789,6 +1041,52 @@ static u64 sched_vslice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	return calc_delta_fair(sched_slice(cfs_rq, se), se);
 }
 
+/*
+ * The request size of an entity, in wall-time, before it gets a new virtual
+ * deadline. It is derived from the base slice the same way the load weight
+ * is derived from the nice value, so each latency_nice step is worth ~10%:
+ * latency_nice -20 asks for the shortest slices, 19 for the longest.
+ *
+ * Group entities use the base slice.
+ */
+static u64 entity_slice(struct sched_entity *se)
+{
+	u64 slice = sysctl_sched_min_granularity;
+
+	if (entity_is_task(se)) {
+		int prio = task_of(se)->latency_prio;
+
+		slice = div_u64(slice * NICE_0_LOAD,
+				scale_load(sched_prio_to_weight[prio]));
+	}
+
+	return clamp_t(u64, slice, 100 * NSEC_PER_USEC, 100 * NSEC_PER_MSEC);
+}
+
+/*
+ * vd_i = ve_i + r_i / w_i
+ */
+static inline void set_entity_deadline(struct sched_entity *se)
+{
+	se->deadline = se->vruntime + calc_delta_fair(entity_slice(se), se);
+}
+
+/*
+ * Hand out a new request once the current one has been consumed. With
+ * more than one runnable entity, another one may now have an earlier
+ * deadline: reschedule to let the pick decide.
+ */
+static void update_deadline(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	if ((s64)(se->vruntime - se->deadline) < 0)
+		return;
+
+	set_entity_deadline(se);
+
+	if (sched_feat(EEVDF) && cfs_rq->nr_running > 1)
+		resched_curr(rq_of(cfs_rq));
+}
+
 #include "pelt.h"
 #ifdef CONFIG_SMP
 
@@ -921,6 +1219,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 	schedstat_add(cfs_rq->exec_clock, delta_exec);
 
 	curr->vruntime += calc_delta_fair(delta_exec, curr);
+	update_deadline(cfs_rq, curr);
 	update_min_vruntime(cfs_rq);
 
 	if (entity_is_task(curr)) {
@@ -3379,6 +3678,8 @@ static void reweight_entity(struct cfs_rq *cfs_rq, struct sched_entity *se,
 		/* commit outstanding execution time */
 		if (cfs_rq->curr == se)
 			update_curr(cfs_rq);
+		else
+			avg_vruntime_sub(cfs_rq, se);
 		update_load_sub(&cfs_rq->load, se->load.weight);
 	}
 	dequeue_load_avg(cfs_rq, se);
@@ -3394,9 +3695,11 @@ static void reweight_entity(struct cfs_rq *cfs_rq, struct sched_entity *se,
 #endif
 
 	enqueue_load_avg(cfs_rq, se);
-	if (se->on_rq)
+	if (se->on_rq) {
 		update_load_add(&cfs_rq->load, se->load.weight);
-
+		if (cfs_rq->curr != se)
+			avg_vruntime_add(cfs_rq, se);
+	}
 }
 
 void reweight_task(struct task_struct *p, int prio)
@@ -4784,6 +5087,9 @@ place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int initial)
 		se->vruntime = vruntime;
 	else
 		se->vruntime = max_vruntime(se->vruntime, vruntime);
+
+	/* a placed entity starts a new request */
+	set_entity_deadline(se);
 }
 
 static void check_enqueue_throttle(struct cfs_rq *cfs_rq);
@@ -4830,8 +5136,10 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 * If we're the current task, we must renormalise before calling
 	 * update_curr().
 	 */
-	if (renorm && curr)
+	if (renorm && curr) {
 		se->vruntime += cfs_rq->min_vruntime;
+		se->deadline += cfs_rq->min_vruntime;
+	}
 
 	update_curr(cfs_rq);
 
@@ -4841,8 +5149,10 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 * placed in the past could significantly boost this task to the
 	 * fairness detriment of existing tasks.
 	 */
-	if (renorm && !curr)
+	if (renorm && !curr) {
 		se->vruntime += cfs_rq->min_vruntime;
+		se->deadline += cfs_rq->min_vruntime;
+	}
 
 	/*
 	 * When enqueuing a sched_entity, we must:
@@ -4965,8 +5275,10 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 * update_min_vruntime() again, which will discount @se's position and
 	 * can move min_vruntime forward still more.
 	 */
-	if (!(flags & DEQUEUE_SLEEP))
+	if (!(flags & DEQUEUE_SLEEP)) {
 		se->vruntime -= cfs_rq->min_vruntime;
+		se->deadline -= cfs_rq->min_vruntime;
+	}
 
 	/* return excess runtime on last dequeue */
 	return_cfs_rq_runtime(cfs_rq);
@@ -4996,6 +5308,10 @@ check_preempt_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr)
 	struct sched_entity *se;
 	s64 delta;
 
+	/* EEVDF reschedules from update_deadline() once the request is used up */
+	if (sched_feat(EEVDF))
+		return;
+
 	/*
 	 * When many tasks blow up the sched_period; it is possible that
 	 * sched_slice() reports unusually large results (when many tasks are
@@ -5083,9 +5399,22 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se);
 static struct sched_entity *
 pick_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *curr)
 {
-	struct sched_entity *left = __pick_first_entity(cfs_rq);
+	struct sched_entity *left;
 	struct sched_entity *se;
 
+	if (sched_feat(EEVDF)) {
+		/*
+		 * Enabling NEXT_BUDDY will affect latency but not fairness.
+		 */
+		if (sched_feat(NEXT_BUDDY) &&
+		    cfs_rq->next && entity_eligible(cfs_rq, cfs_rq->next))
+			return cfs_rq->next;
+
+		return pick_eevdf(cfs_rq);
+	}
+
+	left = __pick_first_entity(cfs_rq);
+
 	/*
 	 * If curr is set we have to see if its left of the leftmost entity
 	 * still in the tree, provided there was anything in the tree at all.
@@ -7731,8 +8060,10 @@ static void migrate_task_rq_fair(struct task_struct *p, int new_cpu)
 	 */
 	if (READ_ONCE(p->__state) == TASK_WAKING) {
 		struct cfs_rq *cfs_rq = cfs_rq_of(se);
+		u64 min_vruntime = u64_u32_load(cfs_rq->min_vruntime);
 
-		se->vruntime -= u64_u32_load(cfs_rq->min_vruntime);
+		se->vruntime -= min_vruntime;
+		se->deadline -= min_vruntime;
 	}
 
 	if (!task_on_rq_migrating(p)) {
@@ -7918,7 +8249,21 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	if (cse_is_idle != pse_is_idle)
 		return;
 
-	update_curr(cfs_rq_of(se));
+	cfs_rq = cfs_rq_of(se);
+	update_curr(cfs_rq);
+
+	if (sched_feat(EEVDF)) {
+		/*
+		 * Preempt only if the wakee is now the eligible entity with
+		 * the earliest deadline; a short latency_nice slice lets it
+		 * win this without being owed more than its share.
+		 */
+		if (pick_eevdf(cfs_rq) == pse)
+			goto preempt;
+
+		return;
+	}
+
 	if (wakeup_preempt_entity(se, pse) == 1) {
 		/*
 		 * Bias pick_next to pick the sched entity that is
@@ -8178,6 +8523,12 @@ static void yield_task_fair(struct rq *rq)
 		rq_clock_skip_update(rq);
 	}
 
+	/* the skip buddy is not used by EEVDF, push the deadline out instead */
+	if (sched_feat(EEVDF)) {
+		se->deadline += calc_delta_fair(entity_slice(se), se);
+		return;
+	}
+
 	set_skip_buddy(se);
 }
 
@@ -12113,6 +12464,7 @@ static void task_fork_fair(struct task_struct *p)
 	}
 
 	se->vruntime -= cfs_rq->min_vruntime;
+	se->deadline -= cfs_rq->min_vruntime;
 	rq_unlock(rq, &rf);
 }
 
@@ -12248,6 +12600,7 @@ static void detach_task_cfs_rq(struct task_struct *p)
 		 */
 		place_entity(cfs_rq, se, 0);
 		se->vruntime -= cfs_rq->min_vruntime;
+		se->deadline -= cfs_rq->min_vruntime;
 	}
 
 	detach_entity_cfs_rq(se);
@@ -12260,8 +12613,10 @@ static void attach_task_cfs_rq(struct task_struct *p)
 
 	attach_entity_cfs_rq(se);
 
-	if (!vruntime_normalized(p))
+	if (!vruntime_normalized(p)) {
 		se->vruntime += cfs_rq->min_vruntime;
+		se->deadline += cfs_rq->min_vruntime;
+	}
 }
 
 static void switched_from_fair(struct rq *rq, struct task_struct *p)
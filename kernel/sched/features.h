@@ -32,6 +32,13 @@ SCHED_FEAT(LAST_BUDDY, true)
  */
 SCHED_FEAT(CACHE_HOT_BUDDY, true)
 
+/*
+ * Pick the eligible entity with the earliest virtual deadline rather than
+ * the leftmost one, the deadline being derived from the latency_nice based
+ * slice. Wakeup preemption and tick preemption follow the same rule.
+ */
+SCHED_FEAT(EEVDF, true)
+
 /*
  * Allow wakeup-time preemption of the current task:
  */
@@ -16,6 +16,7 @@
 #include <linux/fs.h>
 #include <linux/kmod.h>
 #include <linux/ksm.h>
+#include <linux/futex.h>
 #include <linux/perf_event.h>
 #include <linux/resource.h>
 #include <linux/kernel.h>
@@ -2708,6 +2709,11 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 		error = !!test_bit(MMF_VM_MERGE_ANY, &me->mm->flags);
 		break;
 #endif
+	case PR_FUTEX_HASH:
+		if (arg4 || arg5)
+			return -EINVAL;
+		error = futex_hash_prctl(arg2, arg3);
+		break;
 	default:
 		error = -EINVAL;
 		break;
@@ -164,8 +164,28 @@ static inline void timers_update_nohz(void) { }
 DECLARE_PER_CPU(struct hrtimer_cpu_base, hrtimer_bases);
 
 extern u64 get_next_timer_interrupt(unsigned long basej, u64 basem);
+extern u64 timer_base_try_to_set_idle(unsigned long basej, u64 basem,
+				      bool *idle);
 void timer_clear_idle(void);
 
+#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
+extern u64 get_jiffies_update(unsigned long *basej);
+extern void timer_expire_remote(unsigned int cpu);
+extern void timer_lock_remote_base(unsigned int cpu);
+extern void timer_unlock_remote_base(unsigned int cpu);
+extern u64 fetch_next_timer_interrupt_remote(unsigned long basej, u64 basem,
+					     unsigned int cpu);
+extern void tmigr_handle_remote(void);
+extern bool tmigr_requires_handle_remote(void);
+extern void tmigr_cpu_activate(void);
+extern u64 tmigr_cpu_deactivate(u64 nextevt);
+#else
+static inline void tmigr_handle_remote(void) { }
+static inline bool tmigr_requires_handle_remote(void) { return false; }
+static inline void tmigr_cpu_activate(void) { }
+static inline u64 tmigr_cpu_deactivate(u64 nextevt) { return nextevt; }
+#endif
+
 #define CLOCK_SET_WALL							\
 	(BIT(HRTIMER_BASE_REALTIME) | BIT(HRTIMER_BASE_REALTIME_SOFT) |	\
 	 BIT(HRTIMER_BASE_TAI) | BIT(HRTIMER_BASE_TAI_SOFT))
@@ -798,18 +798,52 @@ static inline bool local_timer_softirq_pending(void)
 	return local_softirq_pending() & BIT(TIMER_SOFTIRQ);
 }
 
-static ktime_t tick_nohz_next_event(struct tick_sched *ts, int cpu)
+/**
+ * get_jiffies_update - read jiffies and the time when jiffies were updated last
+ * @basej:	Pointer to a variable to store jiffies
+ *
+ * Returns the clock monotonic time of the last jiffies update.
+ */
+u64 get_jiffies_update(unsigned long *basej)
 {
-	u64 basemono, next_tick, delta, expires;
 	unsigned long basejiff;
 	unsigned int seq;
+	u64 basemono;
 
-	/* Read jiffies and the time when jiffies were updated last */
 	do {
 		seq = read_seqcount_begin(&jiffies_seq);
 		basemono = last_jiffies_update;
 		basejiff = jiffies;
 	} while (read_seqcount_retry(&jiffies_seq, seq));
+	*basej = basejiff;
+	return basemono;
+}
+
+/*
+ * If this CPU is the one which had the do_timer() duty last, we limit
+ * the sleep time to the timekeeping max_deferment value.
+ * Otherwise we can sleep as long as we want.
+ */
+static u64 tick_nohz_max_expires(struct tick_sched *ts, int cpu, u64 basemono)
+{
+	u64 delta = timekeeping_max_deferment();
+
+	if (cpu != tick_do_timer_cpu &&
+	    (tick_do_timer_cpu != TICK_DO_TIMER_NONE || !ts->do_timer_last))
+		delta = KTIME_MAX;
+
+	/* Calculate the next expiry time */
+	if (delta < (KTIME_MAX - basemono))
+		return basemono + delta;
+	return KTIME_MAX;
+}
+
+static ktime_t tick_nohz_next_event(struct tick_sched *ts, int cpu)
+{
+	u64 basemono, next_tick, delta, expires;
+	unsigned long basejiff;
+
+	basemono = get_jiffies_update(&basejiff);
 	ts->last_jiffies = basejiff;
 	ts->timer_expires_base = basemono;
 
@@ -859,22 +893,7 @@ static ktime_t tick_nohz_next_event(struct tick_sched *ts, int cpu)
 		}
 	}
 
-	/*
-	 * If this CPU is the one which had the do_timer() duty last, we limit
-	 * the sleep time to the timekeeping max_deferment value.
-	 * Otherwise we can sleep as long as we want.
-	 */
-	delta = timekeeping_max_deferment();
-	if (cpu != tick_do_timer_cpu &&
-	    (tick_do_timer_cpu != TICK_DO_TIMER_NONE || !ts->do_timer_last))
-		delta = KTIME_MAX;
-
-	/* Calculate the next expiry time */
-	if (delta < (KTIME_MAX - basemono))
-		expires = basemono + delta;
-	else
-		expires = KTIME_MAX;
-
+	expires = tick_nohz_max_expires(ts, cpu, basemono);
 	ts->timer_expires = min_t(u64, expires, next_tick);
 
 out:
@@ -886,11 +905,29 @@ static void tick_nohz_stop_tick(struct tick_sched *ts, int cpu)
 	struct clock_event_device *dev = __this_cpu_read(tick_cpu_device.evtdev);
 	u64 basemono = ts->timer_expires_base;
 	u64 expires = ts->timer_expires;
-	ktime_t tick = expires;
+	u64 next_timer;
+	bool timer_idle;
+	ktime_t tick;
 
 	/* Make sure we won't be trying to stop it twice in a row. */
 	ts->timer_expires_base = 0;
 
+	/*
+	 * The tick gets stopped for real, so hand the global timers over to
+	 * the timer migration hierarchy now. The next timer event changes
+	 * either way: the CPU's own global timers don't count anymore, but
+	 * if it is the last one going idle, it has to wake up for the first
+	 * event of the whole hierarchy, which can be earlier.
+	 */
+	next_timer = timer_base_try_to_set_idle(ts->last_jiffies, basemono,
+						&timer_idle);
+	if (timer_idle) {
+		ts->next_timer = next_timer;
+		expires = min_t(u64, tick_nohz_max_expires(ts, cpu, basemono),
+				next_timer);
+	}
+	tick = expires;
+
 	/*
 	 * If this CPU is the one which updates jiffies, then give up
 	 * the assignment and let it be taken by the CPU which runs
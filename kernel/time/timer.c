@@ -181,18 +181,22 @@ EXPORT_SYMBOL(jiffies_64);
 #define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
 
 /*
- * The resulting wheel size. If NOHZ is configured we allocate two
- * wheels so we have a separate storage for the deferrable timers.
+ * The resulting wheel size. If NOHZ is configured we allocate three
+ * wheels: pinned timers, non-pinned (global) timers which can be expired
+ * by another CPU through the timer migration hierarchy while this CPU is
+ * idle, and deferrable timers.
  */
 #define WHEEL_SIZE	(LVL_SIZE * LVL_DEPTH)
 
 #ifdef CONFIG_NO_HZ_COMMON
-# define NR_BASES	2
-# define BASE_STD	0
-# define BASE_DEF	1
+# define NR_BASES	3
+# define BASE_LOCAL	0
+# define BASE_GLOBAL	1
+# define BASE_DEF	2
 #else
 # define NR_BASES	1
-# define BASE_STD	0
+# define BASE_LOCAL	0
+# define BASE_GLOBAL	0
 # define BASE_DEF	0
 #endif
 
@@ -900,30 +904,28 @@ static int detach_if_pending(struct timer_list *timer, struct timer_base *base,
 	return 1;
 }
 
-static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
+static inline unsigned int get_timer_base_idx(u32 tflags)
 {
-	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_STD], cpu);
-
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
-	 * to use the deferrable base.
+	 * to use the deferrable base. Otherwise pinned timers go to the
+	 * local base and all others to the global base.
 	 */
 	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && (tflags & TIMER_DEFERRABLE))
-		base = per_cpu_ptr(&timer_bases[BASE_DEF], cpu);
-	return base;
+		return BASE_DEF;
+	if (tflags & TIMER_PINNED)
+		return BASE_LOCAL;
+	return BASE_GLOBAL;
 }
 
-static inline struct timer_base *get_timer_this_cpu_base(u32 tflags)
+static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	return per_cpu_ptr(&timer_bases[get_timer_base_idx(tflags)], cpu);
+}
 
-	/*
-	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
-	 * to use the deferrable base.
-	 */
-	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && (tflags & TIMER_DEFERRABLE))
-		base = this_cpu_ptr(&timer_bases[BASE_DEF]);
-	return base;
+static inline struct timer_base *get_timer_this_cpu_base(u32 tflags)
+{
+	return this_cpu_ptr(&timer_bases[get_timer_base_idx(tflags)]);
 }
 
 static inline struct timer_base *get_timer_base(u32 tflags)
@@ -931,14 +933,14 @@ static inline struct timer_base *get_timer_base(u32 tflags)
 	return get_timer_cpu_base(tflags, tflags & TIMER_CPUMASK);
 }
 
+/*
+ * Timers are always queued on the local CPU. Non-pinned timers of an idle
+ * CPU are expired by the timer migration hierarchy, so there is no need
+ * to go looking for a busy CPU at enqueue time.
+ */
 static inline struct timer_base *
 get_target_base(struct timer_base *base, unsigned tflags)
 {
-#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
-	if (static_branch_likely(&timers_migration_enabled) &&
-	    !(tflags & TIMER_PINNED))
-		return get_timer_cpu_base(tflags, get_nohz_timer_target());
-#endif
 	return get_timer_this_cpu_base(tflags);
 }
 
@@ -1245,6 +1247,25 @@ void add_timer(struct timer_list *timer)
 }
 EXPORT_SYMBOL(add_timer);
 
+/**
+ * add_timer_global - Start a timer without TIMER_PINNED flag set
+ * @timer:	The timer to be started
+ *
+ * Same as add_timer() except that the TIMER_PINNED flag is cleared, so a
+ * timer which was started with add_timer_on() before ends up on the
+ * global base again.
+ *
+ * See add_timer() for further details.
+ */
+void add_timer_global(struct timer_list *timer)
+{
+	if (WARN_ON_ONCE(timer_pending(timer)))
+		return;
+	timer->flags &= ~TIMER_PINNED;
+	__mod_timer(timer, timer->expires, MOD_TIMER_NOTPENDING);
+}
+EXPORT_SYMBOL(add_timer_global);
+
 /**
  * add_timer_on - Start a timer on a particular CPU
  * @timer:	The timer to be started
@@ -1264,7 +1285,12 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	if (WARN_ON_ONCE(timer_pending(timer)))
 		return;
 
-	new_base = get_timer_cpu_base(timer->flags, cpu);
+	/*
+	 * The timer has to stay on @cpu, so it must not end up on the
+	 * global base where the migration hierarchy could expire it
+	 * elsewhere.
+	 */
+	new_base = get_timer_cpu_base(timer->flags | TIMER_PINNED, cpu);
 
 	/*
 	 * If @timer was on a different CPU, it should be migrated with the
@@ -1286,7 +1312,10 @@ void add_timer_on(struct timer_list *timer, int cpu)
 		base = new_base;
 		raw_spin_lock(&base->lock);
 		WRITE_ONCE(timer->flags,
-			   (timer->flags & ~TIMER_BASEMASK) | cpu);
+			   (timer->flags & ~TIMER_BASEMASK) | cpu | TIMER_PINNED);
+	} else if (!(timer->flags & TIMER_PINNED)) {
+		/* Same base either way, so lock_timer_base() is not affected */
+		WRITE_ONCE(timer->flags, timer->flags | TIMER_PINNED);
 	}
 	forward_timer_base(base);
 
@@ -1910,28 +1939,15 @@ static u64 cmp_next_hrtimer_event(u64 basem, u64 expires)
 	return DIV_ROUND_UP_ULL(nextevt, TICK_NSEC) * TICK_NSEC;
 }
 
-/**
- * get_next_timer_interrupt - return the time (clock mono) of the next timer
- * @basej:	base time jiffies
- * @basem:	base time clock monotonic
- *
- * Returns the tick aligned clock monotonic time of the next pending
- * timer or KTIME_MAX if no timer is pending.
+/*
+ * Fetch the next expiry of @base as clock monotonic time, KTIME_MAX if no
+ * timer is pending. Caller must hold base->lock.
  */
-u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
+static u64 next_timer_interrupt(struct timer_base *base, unsigned long basej,
+				u64 basem)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-	u64 expires = KTIME_MAX;
 	unsigned long nextevt;
 
-	/*
-	 * Pretend that there is no timer pending if the cpu is offline.
-	 * Possible pending timers will be migrated later to an active cpu.
-	 */
-	if (cpu_is_offline(smp_processor_id()))
-		return expires;
-
-	raw_spin_lock(&base->lock);
 	if (base->next_expiry_recalc)
 		base->next_expiry = __next_timer_interrupt(base);
 	nextevt = base->next_expiry;
@@ -1948,27 +1964,113 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
 			base->clk = nextevt;
 	}
 
-	if (time_before_eq(nextevt, basej)) {
-		expires = basem;
-		base->is_idle = false;
-	} else {
-		if (base->timers_pending)
-			expires = basem + (u64)(nextevt - basej) * TICK_NSEC;
+	if (time_before_eq(nextevt, basej))
+		return basem;
+	if (!base->timers_pending)
+		return KTIME_MAX;
+	return basem + (u64)(nextevt - basej) * TICK_NSEC;
+}
+
+/**
+ * get_next_timer_interrupt - return the time (clock mono) of the next timer
+ * @basej:	base time jiffies
+ * @basem:	base time clock monotonic
+ *
+ * Returns the tick aligned clock monotonic time of the next pending
+ * timer or KTIME_MAX if no timer is pending.
+ *
+ * The global timers are still accounted to this CPU here. They are handed
+ * over to the timer migration hierarchy by timer_base_try_to_set_idle(),
+ * once the tick is stopped for real.
+ */
+u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
+{
+	struct timer_base *base_local, *base_global;
+	u64 tevt_local, tevt_global, expires;
+
+	/*
+	 * Pretend that there is no timer pending if the cpu is offline.
+	 * Possible pending timers will be migrated later to an active cpu.
+	 */
+	if (cpu_is_offline(smp_processor_id()))
+		return KTIME_MAX;
+
+	base_local = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	base_global = this_cpu_ptr(&timer_bases[BASE_GLOBAL]);
+
+	raw_spin_lock(&base_local->lock);
+	raw_spin_lock_nested(&base_global->lock, SINGLE_DEPTH_NESTING);
+
+	tevt_local = next_timer_interrupt(base_local, basej, basem);
+	tevt_global = next_timer_interrupt(base_global, basej, basem);
+	expires = min(tevt_local, tevt_global);
+
+	if (expires <= basem) {
+		base_local->is_idle = false;
+		base_global->is_idle = false;
+	} else if ((expires - basem) > TICK_NSEC) {
 		/*
-		 * If we expect to sleep more than a tick, mark the base idle.
-		 * Also the tick is stopped so any added timer must forward
-		 * the base clk itself to keep granularity small. This idle
-		 * logic is only maintained for the BASE_STD base, deferrable
-		 * timers may still see large granularity skew (by design).
+		 * If we expect to sleep more than a tick, mark the bases
+		 * idle. Also the tick is stopped so any added timer must
+		 * forward the base clk itself to keep granularity small.
+		 * This idle logic is not maintained for the deferrable
+		 * base, deferrable timers may still see large granularity
+		 * skew (by design).
 		 */
-		if ((expires - basem) > TICK_NSEC)
-			base->is_idle = true;
+		base_local->is_idle = true;
+		base_global->is_idle = true;
 	}
-	raw_spin_unlock(&base->lock);
+
+	raw_spin_unlock(&base_global->lock);
+	raw_spin_unlock(&base_local->lock);
 
 	return cmp_next_hrtimer_event(basem, expires);
 }
 
+/**
+ * timer_base_try_to_set_idle - hand the global timers over when going idle
+ * @basej:	base time jiffies
+ * @basem:	base time clock monotonic
+ * @idle:	Set to true if the timer bases were marked idle
+ *
+ * Called from tick_nohz_stop_tick(). If get_next_timer_interrupt() marked
+ * the bases idle, the global timers are handed over to the timer migration
+ * hierarchy. Doing that only now avoids going through the hierarchy for
+ * every tick_nohz_get_sleep_length() call after which the tick is retained.
+ *
+ * Returns the tick aligned clock monotonic time of the next event this CPU
+ * has to wake up for or KTIME_MAX if there is none.
+ */
+u64 timer_base_try_to_set_idle(unsigned long basej, u64 basem, bool *idle)
+{
+	struct timer_base *base_local, *base_global;
+	u64 tevt_local, tevt_global;
+
+	*idle = false;
+
+	if (cpu_is_offline(smp_processor_id()))
+		return KTIME_MAX;
+
+	base_local = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	base_global = this_cpu_ptr(&timer_bases[BASE_GLOBAL]);
+
+	raw_spin_lock(&base_local->lock);
+	raw_spin_lock_nested(&base_global->lock, SINGLE_DEPTH_NESTING);
+
+	tevt_local = next_timer_interrupt(base_local, basej, basem);
+	tevt_global = next_timer_interrupt(base_global, basej, basem);
+
+	if (base_local->is_idle) {
+		tevt_global = tmigr_cpu_deactivate(tevt_global);
+		*idle = true;
+	}
+
+	raw_spin_unlock(&base_global->lock);
+	raw_spin_unlock(&base_local->lock);
+
+	return cmp_next_hrtimer_event(basem, min(tevt_local, tevt_global));
+}
+
 /**
  * timer_clear_idle - Clear the idle state of the timer base
  *
@@ -1976,17 +2078,50 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
  */
 void timer_clear_idle(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
 	/*
 	 * We do this unlocked. The worst outcome is a remote enqueue sending
 	 * a pointless IPI, but taking the lock would just make the window for
 	 * sending the IPI a few instructions smaller for the cost of taking
 	 * the lock in the exit from idle path.
 	 */
-	base->is_idle = false;
+	this_cpu_ptr(&timer_bases[BASE_LOCAL])->is_idle = false;
+	this_cpu_ptr(&timer_bases[BASE_GLOBAL])->is_idle = false;
+
+	/* Take over the global timers again, and maybe those of others */
+	tmigr_cpu_activate();
 }
-#endif
+
+#ifdef CONFIG_SMP
+/**
+ * fetch_next_timer_interrupt_remote - fetch the next global timer of a CPU
+ * @basej:	base time jiffies
+ * @basem:	base time clock monotonic
+ * @cpu:	Remote CPU
+ *
+ * Used by the timer migration code to requeue the event of an idle CPU
+ * after expiring its timers. Caller must hold the base lock, see
+ * timer_lock_remote_base().
+ */
+u64 fetch_next_timer_interrupt_remote(unsigned long basej, u64 basem,
+				      unsigned int cpu)
+{
+	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
+
+	lockdep_assert_held(&base->lock);
+	return next_timer_interrupt(base, basej, basem);
+}
+
+void timer_lock_remote_base(unsigned int cpu)
+{
+	raw_spin_lock_irq(&per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu)->lock);
+}
+
+void timer_unlock_remote_base(unsigned int cpu)
+{
+	raw_spin_unlock_irq(&per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu)->lock);
+}
+#endif /* CONFIG_SMP */
+#endif /* CONFIG_NO_HZ_COMMON */
 
 /**
  * __run_timers - run all expired timers (if any) on this CPU.
@@ -2025,16 +2160,33 @@ static inline void __run_timers(struct timer_base *base)
 	timer_base_unlock_expiry(base);
 }
 
+#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
+/**
+ * timer_expire_remote - expire the global timers of an idle CPU
+ * @cpu:	Remote CPU
+ *
+ * Called from the timer softirq of the CPU which handles the timer
+ * migration hierarchy on behalf of @cpu.
+ */
+void timer_expire_remote(unsigned int cpu)
+{
+	__run_timers(per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu));
+}
+#endif
+
 /*
  * This function runs timers and the timer-tq in bottom half context.
  */
 static __latent_entropy void run_timer_softirq(struct softirq_action *h)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
-	__run_timers(base);
-	if (IS_ENABLED(CONFIG_NO_HZ_COMMON))
+	__run_timers(this_cpu_ptr(&timer_bases[BASE_LOCAL]));
+	if (IS_ENABLED(CONFIG_NO_HZ_COMMON)) {
+		__run_timers(this_cpu_ptr(&timer_bases[BASE_GLOBAL]));
 		__run_timers(this_cpu_ptr(&timer_bases[BASE_DEF]));
+
+		if (is_timers_nohz_active())
+			tmigr_handle_remote();
+	}
 }
 
 /*
@@ -2042,19 +2194,20 @@ static __latent_entropy void run_timer_softirq(struct softirq_action *h)
  */
 static void run_local_timers(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	int i;
 
 	hrtimer_run_queues();
+
 	/* Raise the softirq only if required. */
-	if (time_before(jiffies, base->next_expiry)) {
-		if (!IS_ENABLED(CONFIG_NO_HZ_COMMON))
-			return;
-		/* CPU is awake, so check the deferrable base. */
-		base++;
-		if (time_before(jiffies, base->next_expiry))
+	for (i = 0; i < NR_BASES; i++, base++) {
+		/* CPU is awake, so check the deferrable base as well. */
+		if (time_after_eq(jiffies, base->next_expiry) ||
+		    (i == BASE_DEF && tmigr_requires_handle_remote())) {
+			raise_softirq(TIMER_SOFTIRQ);
 			return;
+		}
 	}
-	raise_softirq(TIMER_SOFTIRQ);
 }
 
 /*
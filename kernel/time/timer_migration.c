@@ -0,0 +1,583 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Infrastructure for migrating the global timers of idle CPUs
+ *
+ * Non-pinned timers are queued on the global timer base of the local CPU.
+ * While a CPU is busy it expires them itself. When it goes idle it does not
+ * need to wake up for them: the first one is handed over to a hierarchy of
+ * groups and expired by another CPU which is awake anyway.
+ *
+ * The hierarchy is built at boot from the possible CPUs. Level 0 groups
+ * contain up to TMIGR_CHILDREN_PER_GROUP CPUs of the same NUMA node, every
+ * level above contains up to TMIGR_CHILDREN_PER_GROUP groups of the level
+ * below, first per node and, once there is a single group per node, across
+ * nodes, until a single top level group is left:
+ *
+ *	LVL 2			[GRP2:0]
+ *				/	\
+ *	LVL 1		[GRP1:0]		[GRP1:1]
+ *			 node 0			 node 1
+ *			/      \		/      \
+ *	LVL 0	[GRP0:0]  [GRP0:1]	[GRP0:2]  [GRP0:3]
+ *		 CPU 0-7   CPU 8-15	 CPU16-23  CPU24-31
+ *
+ * A child is active while it expires its own global timers: a CPU whose
+ * tick is running, or a group with at least one active child. One active
+ * child of a group is its migrator and expires the events of the idle
+ * children on their behalf, from the timer softirq. The migrator of a level
+ * N+1 group therefore always is a CPU which is the migrator of all the
+ * groups below it.
+ *
+ * When the last child of a group goes idle, the group goes idle as well
+ * and its first event is queued in the parent. When the last CPU of the
+ * whole hierarchy goes idle, it wakes up for the first event of the top
+ * level group, so nothing is lost. A CPU going active walks up until it
+ * reaches a group which was already active.
+ *
+ * Lock ordering: timer base lock -> tmigr_cpu::lock -> group locks, bottom
+ * up and hand over hand, so that the state of a group can not change while
+ * its event in the parent is updated.
+ */
+
+#include <linux/cpuhotplug.h>
+#include <linux/nodemask.h>
+#include <linux/sched/nohz.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/timerqueue.h>
+
+#include "timer_migration.h"
+#include "tick-internal.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/timer_migration.h>
+
+static DEFINE_PER_CPU(struct tmigr_cpu, tmigr_cpu);
+
+static unsigned int tmigr_hierarchy_levels __read_mostly;
+
+static void tmigr_update_next_expiry(struct tmigr_group *group)
+{
+	struct timerqueue_node *node = timerqueue_getnext(&group->events);
+
+	WRITE_ONCE(group->next_expiry, node ? node->expires : KTIME_MAX);
+}
+
+/* Caller must hold group->lock, KTIME_MAX only dequeues @evt */
+static void tmigr_requeue_event(struct tmigr_group *group,
+				struct tmigr_event *evt, u64 expires)
+{
+	if (timerqueue_node_queued(&evt->nextevt))
+		timerqueue_del(&group->events, &evt->nextevt);
+
+	evt->nextevt.expires = expires;
+	if (expires != KTIME_MAX)
+		timerqueue_add(&group->events, &evt->nextevt);
+
+	tmigr_update_next_expiry(group);
+}
+
+/*
+ * tmigr_idle_up - requeue the event of an idle child and walk up
+ * @group:	Parent group of the child
+ * @evt:	Event of the child
+ * @expires:	New expiry of @evt
+ * @childmask:	Bit of the child in @group if it just went idle, 0 if it
+ *		already was idle and only its event changes
+ *
+ * As long as the groups on the way up are idle, their first events are
+ * propagated upwards. The caller holds the lock of the child.
+ *
+ * Returns the first event of the top level group if the whole hierarchy is
+ * idle, KTIME_MAX otherwise.
+ */
+static u64 tmigr_idle_up(struct tmigr_group *group, struct tmigr_event *evt,
+			 u64 expires, u8 childmask)
+{
+	struct tmigr_group *child = NULL;
+	u64 ret = KTIME_MAX;
+
+	for (;;) {
+		raw_spin_lock_nested(&group->lock, group->level);
+		if (child)
+			raw_spin_unlock(&child->lock);
+
+		if (childmask) {
+			group->active &= ~childmask;
+			if (group->migrator == childmask) {
+				u8 migrator = 0;
+
+				if (group->active)
+					migrator = BIT(__ffs(group->active));
+				WRITE_ONCE(group->migrator, migrator);
+			}
+		}
+		tmigr_requeue_event(group, evt, expires);
+
+		if (group->active)
+			break;
+
+		if (!group->parent) {
+			ret = group->next_expiry;
+			break;
+		}
+
+		expires = group->next_expiry;
+		evt = &group->groupevt;
+		childmask = group->childmask;
+		child = group;
+		group = group->parent;
+	}
+	raw_spin_unlock(&group->lock);
+
+	return ret;
+}
+
+/*
+ * tmigr_active_up - mark a child active and walk up until a group which
+ * already was active is reached. The caller holds the lock of the child.
+ */
+static void tmigr_active_up(struct tmigr_group *group, struct tmigr_event *evt,
+			    u8 childmask)
+{
+	struct tmigr_group *child = NULL;
+
+	for (;;) {
+		bool was_idle;
+
+		raw_spin_lock_nested(&group->lock, group->level);
+		if (child)
+			raw_spin_unlock(&child->lock);
+
+		was_idle = !group->active;
+		group->active |= childmask;
+		if (!group->migrator)
+			WRITE_ONCE(group->migrator, childmask);
+
+		/* The child takes care of its own events again */
+		tmigr_requeue_event(group, evt, KTIME_MAX);
+
+		if (!was_idle || !group->parent)
+			break;
+
+		evt = &group->groupevt;
+		childmask = group->childmask;
+		child = group;
+		group = group->parent;
+	}
+	raw_spin_unlock(&group->lock);
+}
+
+/**
+ * tmigr_cpu_activate - the CPU takes over its global timers again
+ *
+ * Called from timer_clear_idle() with interrupts disabled.
+ */
+void tmigr_cpu_activate(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+
+	if (!tmc->online || !tmc->idle)
+		return;
+
+	raw_spin_lock(&tmc->lock);
+	tmc->idle = false;
+	tmc->wakeup = KTIME_MAX;
+	trace_tmigr_cpu_active(tmc);
+	tmigr_active_up(tmc->tmgroup, &tmc->cpuevt, tmc->childmask);
+	raw_spin_unlock(&tmc->lock);
+}
+
+/**
+ * tmigr_cpu_deactivate - hand the global timers over to the hierarchy
+ * @nextexp:	The first global timer of the CPU, KTIME_MAX if none
+ *
+ * Called from timer_base_try_to_set_idle() with interrupts disabled and the
+ * timer base locks held, whenever the CPU is about to stop its tick. The
+ * first call puts the CPU to idle in the hierarchy, later ones update its
+ * event as timers might have been queued from interrupts in the meantime.
+ *
+ * Returns the time the CPU has to wake up for global timers: KTIME_MAX if
+ * an active CPU takes care of them, or the first event of the hierarchy if
+ * this was the last active CPU.
+ */
+u64 tmigr_cpu_deactivate(u64 nextexp)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	u64 ret;
+
+	if (!tmc->online)
+		return nextexp;
+
+	raw_spin_lock(&tmc->lock);
+	if (!tmc->idle) {
+		tmc->idle = true;
+		WRITE_ONCE(tmc->wakeup,
+			   tmigr_idle_up(tmc->tmgroup, &tmc->cpuevt, nextexp,
+					 tmc->childmask));
+	} else if (nextexp != tmc->cpuevt.nextevt.expires) {
+		/*
+		 * If the whole hierarchy is idle, the CPU which went idle
+		 * last only knows about the events which were queued at the
+		 * time, so wake up for this one ourselves.
+		 */
+		if (tmigr_idle_up(tmc->tmgroup, &tmc->cpuevt, nextexp, 0) != KTIME_MAX)
+			WRITE_ONCE(tmc->wakeup, min(tmc->wakeup, nextexp));
+	}
+	ret = tmc->wakeup;
+	trace_tmigr_cpu_idle(tmc, nextexp);
+	raw_spin_unlock(&tmc->lock);
+
+	/*
+	 * With timer migration disabled the CPU keeps waking up for its
+	 * own global timers. It still reports them to the hierarchy, so
+	 * that it stays consistent when migration is enabled again.
+	 */
+	if (!static_branch_likely(&timers_migration_enabled))
+		ret = min(ret, nextexp);
+
+	return ret;
+}
+
+static void tmigr_handle_remote_group(struct tmigr_group *group, u64 now,
+				      unsigned long basej);
+
+static void tmigr_handle_remote_cpu(unsigned int cpu, u64 now,
+				    unsigned long basej)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+	u64 expires;
+
+	trace_tmigr_handle_remote_cpu(cpu, now);
+	timer_expire_remote(cpu);
+
+	timer_lock_remote_base(cpu);
+	raw_spin_lock(&tmc->lock);
+	/*
+	 * A CPU which went active in the meantime expires its timers
+	 * itself, the timers of an offline CPU get migrated.
+	 */
+	if (tmc->online && tmc->idle) {
+		expires = fetch_next_timer_interrupt_remote(basej, now, cpu);
+		tmigr_idle_up(tmc->tmgroup, &tmc->cpuevt, expires, 0);
+	}
+	raw_spin_unlock(&tmc->lock);
+	timer_unlock_remote_base(cpu);
+}
+
+static void tmigr_handle_remote_child(struct tmigr_group *child, u64 now,
+				      unsigned long basej)
+{
+	tmigr_handle_remote_group(child, now, basej);
+
+	raw_spin_lock_irq(&child->lock);
+	/* An active group is taken care of by its own migrator */
+	if (!child->active)
+		tmigr_idle_up(child->parent, &child->groupevt,
+			      child->next_expiry, 0);
+	raw_spin_unlock_irq(&child->lock);
+}
+
+/*
+ * Expire the events of @group which are due. Each event is dequeued before
+ * it is handled and requeued with the next expiry of its owner afterwards,
+ * unless the owner went active in the meantime.
+ */
+static void tmigr_handle_remote_group(struct tmigr_group *group, u64 now,
+				      unsigned long basej)
+{
+	for (;;) {
+		struct timerqueue_node *node;
+		struct tmigr_event *evt;
+
+		raw_spin_lock_irq(&group->lock);
+		node = timerqueue_getnext(&group->events);
+		if (!node || node->expires > now) {
+			raw_spin_unlock_irq(&group->lock);
+			return;
+		}
+		timerqueue_del(&group->events, node);
+		tmigr_update_next_expiry(group);
+		raw_spin_unlock_irq(&group->lock);
+
+		evt = container_of(node, struct tmigr_event, nextevt);
+		if (evt->group)
+			tmigr_handle_remote_child(evt->group, now, basej);
+		else
+			tmigr_handle_remote_cpu(evt->cpu, now, basej);
+	}
+}
+
+/*
+ * The whole hierarchy went idle after this CPU and it woke up on behalf of
+ * all of it. There is no migrator left, so expire what is due on every
+ * level above the CPU, then wake up again for what is left.
+ */
+static void tmigr_handle_remote_idle(struct tmigr_cpu *tmc, u64 now,
+				     unsigned long basej)
+{
+	struct tmigr_group *group;
+
+	if (READ_ONCE(tmc->wakeup) > now)
+		return;
+
+	for (group = tmc->tmgroup; group; group = group->parent)
+		tmigr_handle_remote_group(group, now, basej);
+
+	raw_spin_lock_irq(&tmc->lock);
+	if (tmc->online && tmc->idle)
+		WRITE_ONCE(tmc->wakeup,
+			   tmigr_idle_up(tmc->tmgroup, &tmc->cpuevt,
+					 tmc->cpuevt.nextevt.expires, 0));
+	raw_spin_unlock_irq(&tmc->lock);
+}
+
+/**
+ * tmigr_handle_remote - expire the global timers of idle CPUs
+ *
+ * Called from the timer softirq. Handles all levels of the hierarchy this
+ * CPU is the migrator of or, if it is idle, all levels once its wakeup on
+ * behalf of the hierarchy is due.
+ */
+void tmigr_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	unsigned long basej;
+	u8 childmask;
+	u64 now;
+
+	if (!tmc->online)
+		return;
+
+	now = get_jiffies_update(&basej);
+
+	if (tmc->idle) {
+		tmigr_handle_remote_idle(tmc, now, basej);
+		return;
+	}
+
+	group = tmc->tmgroup;
+	childmask = tmc->childmask;
+	while (group && READ_ONCE(group->migrator) == childmask) {
+		tmigr_handle_remote_group(group, now, basej);
+		childmask = group->childmask;
+		group = group->parent;
+	}
+}
+
+/**
+ * tmigr_requires_handle_remote - check whether remote timers are due
+ *
+ * Called from the tick with interrupts disabled. Lockless, a change of
+ * migrator which is missed here is picked up on the next tick.
+ *
+ * Returns true if tmigr_handle_remote() has work to do.
+ */
+bool tmigr_requires_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	unsigned long basej;
+	u8 childmask;
+	u64 now = 0;
+
+	if (!tmc->online)
+		return false;
+
+	/* The last CPU going idle wakes up for the whole hierarchy */
+	if (tmc->idle) {
+		u64 wakeup = READ_ONCE(tmc->wakeup);
+
+		return wakeup != KTIME_MAX && wakeup <= get_jiffies_update(&basej);
+	}
+
+	group = tmc->tmgroup;
+	childmask = tmc->childmask;
+	while (group && READ_ONCE(group->migrator) == childmask) {
+		u64 next = READ_ONCE(group->next_expiry);
+
+		if (next != KTIME_MAX) {
+			if (!now)
+				now = get_jiffies_update(&basej);
+			if (next <= now)
+				return true;
+		}
+		childmask = group->childmask;
+		group = group->parent;
+	}
+
+	return false;
+}
+
+static int tmigr_cpu_online(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+
+	if (WARN_ON_ONCE(!tmc->tmgroup))
+		return -EINVAL;
+
+	raw_spin_lock_irq(&tmc->lock);
+	tmc->online = true;
+	tmc->idle = false;
+	tmc->wakeup = KTIME_MAX;
+	tmigr_active_up(tmc->tmgroup, &tmc->cpuevt, tmc->childmask);
+	trace_tmigr_cpu_online(tmc);
+	raw_spin_unlock_irq(&tmc->lock);
+
+	return 0;
+}
+
+static int tmigr_cpu_offline(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	u64 firstexp;
+
+	raw_spin_lock_irq(&tmc->lock);
+	/* The global timers of an offline CPU are moved by timers_dead_cpu() */
+	firstexp = tmigr_idle_up(tmc->tmgroup, &tmc->cpuevt, KTIME_MAX,
+				 tmc->idle ? 0 : tmc->childmask);
+	tmc->online = false;
+	tmc->idle = true;
+	tmc->wakeup = KTIME_MAX;
+	trace_tmigr_cpu_offline(tmc);
+	raw_spin_unlock_irq(&tmc->lock);
+
+	/*
+	 * Nobody is left awake in the hierarchy to take care of the pending
+	 * events, kick another CPU so it goes through idle again and picks
+	 * them up.
+	 */
+	if (firstexp != KTIME_MAX)
+		wake_up_nohz_cpu(cpumask_any_but(cpu_online_mask, cpu));
+
+	return 0;
+}
+
+static void __init tmigr_init_group(struct tmigr_group *group,
+				    unsigned int lvl, int node)
+{
+	raw_spin_lock_init(&group->lock);
+	timerqueue_init(&group->groupevt.nextevt);
+	group->groupevt.group = group;
+	group->next_expiry = KTIME_MAX;
+	timerqueue_init_head(&group->events);
+	group->level = lvl;
+	group->numa_node = node;
+}
+
+/*
+ * Groups are filled in order, so the last group of a node on a level is
+ * the only one which might still have room for another child.
+ */
+static struct tmigr_group * __init tmigr_get_group(struct list_head *list,
+						   unsigned int lvl, int node)
+{
+	struct tmigr_group *group;
+
+	list_for_each_entry_reverse(group, list, list) {
+		if (group->numa_node != node)
+			continue;
+		if (group->num_children < TMIGR_CHILDREN_PER_GROUP)
+			return group;
+		break;
+	}
+
+	group = kzalloc_node(sizeof(*group), GFP_KERNEL, node);
+	if (!group)
+		return NULL;
+
+	tmigr_init_group(group, lvl, node);
+	list_add_tail(&group->list, list);
+	return group;
+}
+
+static int __init tmigr_build_hierarchy(void)
+{
+	struct list_head levels[TMIGR_MAX_LEVELS];
+	struct tmigr_group *group, *parent;
+	unsigned int cpu, lvl;
+
+	for (lvl = 0; lvl < TMIGR_MAX_LEVELS; lvl++)
+		INIT_LIST_HEAD(&levels[lvl]);
+
+	for_each_possible_cpu(cpu) {
+		struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+
+		group = tmigr_get_group(&levels[0], 0, cpu_to_node(cpu));
+		if (!group)
+			return -ENOMEM;
+
+		raw_spin_lock_init(&tmc->lock);
+		timerqueue_init(&tmc->cpuevt.nextevt);
+		tmc->cpuevt.cpu = cpu;
+		tmc->wakeup = KTIME_MAX;
+		tmc->tmgroup = group;
+		tmc->childmask = BIT(group->num_children++);
+	}
+
+	for (lvl = 0; !list_is_singular(&levels[lvl]); lvl++) {
+		nodemask_t nodes = NODE_MASK_NONE;
+		bool per_node = false;
+
+		if (WARN_ON_ONCE(lvl + 1 == TMIGR_MAX_LEVELS))
+			return -EINVAL;
+
+		/* Keep the groups of a node together until one per node is left */
+		list_for_each_entry(group, &levels[lvl], list) {
+			if (group->numa_node == NUMA_NO_NODE)
+				break;
+			if (node_isset(group->numa_node, nodes)) {
+				per_node = true;
+				break;
+			}
+			node_set(group->numa_node, nodes);
+		}
+
+		list_for_each_entry(group, &levels[lvl], list) {
+			int node = per_node ? group->numa_node : NUMA_NO_NODE;
+
+			parent = tmigr_get_group(&levels[lvl + 1], lvl + 1, node);
+			if (!parent)
+				return -ENOMEM;
+
+			group->parent = parent;
+			group->childmask = BIT(parent->num_children++);
+		}
+	}
+	tmigr_hierarchy_levels = lvl + 1;
+
+	for (lvl = 0; lvl < tmigr_hierarchy_levels; lvl++) {
+		list_for_each_entry(group, &levels[lvl], list)
+			trace_tmigr_group_set(group);
+	}
+
+	return 0;
+}
+
+static int __init tmigr_init(void)
+{
+	int ret;
+
+	BUILD_BUG_ON_NOT_POWER_OF_2(TMIGR_CHILDREN_PER_GROUP);
+	BUILD_BUG_ON(TMIGR_MAX_LEVELS > MAX_LOCKDEP_SUBCLASSES);
+
+	ret = tmigr_build_hierarchy();
+	if (ret)
+		goto err;
+
+	pr_info("Timer migration: %d hierarchy levels; %d children per group\n",
+		tmigr_hierarchy_levels, TMIGR_CHILDREN_PER_GROUP);
+
+	ret = cpuhp_setup_state(CPUHP_AP_TMIGR_ONLINE, "tmigr:online",
+				tmigr_cpu_online, tmigr_cpu_offline);
+	if (ret)
+		goto err;
+
+	return 0;
+
+err:
+	pr_err("Timer migration setup failed\n");
+	return ret;
+}
+early_initcall(tmigr_init);
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef _KERNEL_TIME_MIGRATION_H
+#define _KERNEL_TIME_MIGRATION_H
+
+/* Per group capacity. Must be a power of 2! */
+#define TMIGR_CHILDREN_PER_GROUP 8
+
+/* Bounded by the lockdep subclasses used for nesting the group locks */
+#define TMIGR_MAX_LEVELS	8
+
+/**
+ * struct tmigr_event - a timer event associated to a CPU or a group
+ * @nextevt:	Node in the timerqueue of the parent group, the expiry is
+ *		the first global timer of the CPU or the first event of
+ *		the group
+ * @cpu:	CPU the event belongs to, only valid for CPU events
+ * @group:	Group the event belongs to, NULL for CPU events
+ *
+ * The event is protected by the lock of the group it is queued in.
+ */
+struct tmigr_event {
+	struct timerqueue_node	nextevt;
+	unsigned int		cpu;
+	struct tmigr_group	*group;
+};
+
+/**
+ * struct tmigr_group - timer migration hierarchy group
+ * @lock:		Lock protecting the group, taken bottom up
+ * @parent:		Parent group, NULL for the top level group
+ * @groupevt:		The event of this group in @parent, queued while
+ *			the group is idle
+ * @next_expiry:	First event in @events, KTIME_MAX if empty; read
+ *			locklessly by the migrator to check whether there
+ *			is work to do
+ * @events:		Events of the idle children
+ * @active:		Mask of the active children
+ * @migrator:		Childmask of the active child which expires the
+ *			events of the idle ones, 0 when the group is idle
+ * @childmask:		Bit of this group in @parent->active
+ * @level:		Hierarchy level, 0 groups contain CPUs
+ * @numa_node:		NUMA node of the children, NUMA_NO_NODE on the
+ *			levels spanning nodes
+ * @num_children:	Number of children
+ * @list:		List head used while building the hierarchy
+ */
+struct tmigr_group {
+	raw_spinlock_t		lock;
+	struct tmigr_group	*parent;
+	struct tmigr_event	groupevt;
+	u64			next_expiry;
+	struct timerqueue_head	events;
+	u8			active;
+	u8			migrator;
+	u8			childmask;
+	unsigned int		level;
+	int			numa_node;
+	unsigned int		num_children;
+	struct list_head	list;
+};
+
+/**
+ * struct tmigr_cpu - timer migration per CPU state
+ * @lock:	Lock protecting the state; taken after the CPU's timer base
+ *		lock and before the group locks
+ * @online:	The CPU takes part in the hierarchy
+ * @idle:	The CPU handed its global timers over to the hierarchy
+ * @wakeup:	The time the CPU has to wake up on behalf of the hierarchy,
+ *		KTIME_MAX unless it was the last one going idle
+ * @cpuevt:	The first global timer of the CPU, queued in @tmgroup
+ *		while the CPU is idle
+ * @tmgroup:	The level 0 group the CPU belongs to
+ * @childmask:	Bit of the CPU in @tmgroup->active
+ */
+struct tmigr_cpu {
+	raw_spinlock_t		lock;
+	bool			online;
+	bool			idle;
+	u64			wakeup;
+	struct tmigr_event	cpuevt;
+	struct tmigr_group	*tmgroup;
+	u8			childmask;
+};
+
+#endif
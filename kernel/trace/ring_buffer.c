@@ -8,6 +8,7 @@
 #include <linux/trace_events.h>
 #include <linux/ring_buffer.h>
 #include <linux/trace_clock.h>
+#include <linux/trace_mmap.h>
 #include <linux/sched/clock.h>
 #include <linux/trace_seq.h>
 #include <linux/spinlock.h>
@@ -331,6 +332,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 id;		/* ID for external mapping */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -530,6 +532,12 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mapping, see ring_buffer_map() */
+	struct mutex			mapping_lock;
+	unsigned long			*subbuf_ids;	/* ID to subbuf VA */
+	struct trace_buffer_meta	*meta_page;
+	int				mapped;
 };
 
 struct trace_buffer {
@@ -1724,6 +1732,7 @@ rb_allocate_cpu_buffer(struct trace_buffer *buffer, long nr_pages, int cpu)
 	init_irq_work(&cpu_buffer->irq_work.work, rb_wake_up_waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.full_waiters);
+	mutex_init(&cpu_buffer->mapping_lock);
 
 	bpage = kzalloc_node(ALIGN(sizeof(*bpage), cache_line_size()),
 			    GFP_KERNEL, cpu_to_node(cpu));
@@ -4757,6 +4766,22 @@ static int rb_lost_events(struct ring_buffer_per_cpu *cpu_buffer)
 	return cpu_buffer->lost_events;
 }
 
+/* Must be called with the reader_lock held and the buffer mapped */
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	meta->reader.read = cpu_buffer->reader_page->read;
+	meta->reader.id = cpu_buffer->reader_page->id;
+
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+
+	/* Some archs do not have data cache coherency between kernel and user space */
+	flush_dcache_page(virt_to_page(meta));
+}
+
 static struct ring_buffer_event *
 rb_buffer_peek(struct ring_buffer_per_cpu *cpu_buffer, u64 *ts,
 	       unsigned long *lost_events)
@@ -5289,6 +5314,12 @@ rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 	cpu_buffer->last_overrun = 0;
 
 	rb_head_page_activate(cpu_buffer);
+
+	/* the subbufs keep their IDs, only the reader has to be updated */
+	if (cpu_buffer->mapped) {
+		cpu_buffer->meta_page->reader.lost_events = 0;
+		rb_update_meta_page(cpu_buffer);
+	}
 }
 
 /* Must have disabled the cpu buffer then done a synchronize_rcu */
@@ -5506,6 +5537,12 @@ int ring_buffer_swap_cpu(struct trace_buffer *buffer_a,
 	if (cpu_buffer_a->nr_pages != cpu_buffer_b->nr_pages)
 		goto out;
 
+	/* user space would keep reading the other buffer's pages */
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped) {
+		ret = -EBUSY;
+		goto out;
+	}
+
 	ret = -EAGAIN;
 
 	if (atomic_read(&buffer_a->record_disabled))
@@ -5730,12 +5767,14 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 	/*
 	 * If this page has been partially read or
 	 * if len is not big enough to read the rest of the page or
-	 * a writer is still on the page, then
+	 * a writer is still on the page, or
+	 * the pages are mapped to user space, then
 	 * we must copy the data from the page to the buffer.
 	 * Otherwise, we can simply swap the page with the one passed in.
 	 */
 	if (read || (len < (commit - read)) ||
-	    cpu_buffer->reader_page == cpu_buffer->commit_page) {
+	    cpu_buffer->reader_page == cpu_buffer->commit_page ||
+	    cpu_buffer->mapped) {
 		struct buffer_data_page *rpage = cpu_buffer->reader_page->page;
 		unsigned int rpos = read;
 		unsigned int pos = 0;
@@ -5748,7 +5787,8 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 		 * the reader page.
 		 */
 		if (full &&
-		    (!read || (len < (commit - read)) ||
+		    ((!read && !cpu_buffer->mapped) ||
+		     (len < (commit - read)) ||
 		     cpu_buffer->reader_page == cpu_buffer->commit_page))
 			goto out_unlock;
 
@@ -5852,6 +5892,290 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+/*
+ * Give every subbuf, the reader included, an ID that is its index in the
+ * user space mapping. The IDs stick to the buffer_pages, which is what lets
+ * user space find the reader after it has been swapped with the head page.
+ */
+static void rb_setup_ids_meta_page(struct ring_buffer_per_cpu *cpu_buffer,
+				   unsigned long *subbuf_ids)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+	unsigned int nr_subbufs = cpu_buffer->nr_pages + 1;
+	struct buffer_page *first_subbuf, *subbuf;
+	int id = 0;
+
+	subbuf_ids[id] = (unsigned long)cpu_buffer->reader_page->page;
+	cpu_buffer->reader_page->id = id++;
+
+	first_subbuf = subbuf = rb_set_head_page(cpu_buffer);
+	do {
+		if (RB_WARN_ON(cpu_buffer, id >= nr_subbufs))
+			break;
+
+		subbuf_ids[id] = (unsigned long)subbuf->page;
+		subbuf->id = id;
+
+		rb_inc_page(&subbuf);
+		id++;
+	} while (subbuf != first_subbuf);
+
+	cpu_buffer->subbuf_ids = subbuf_ids;
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->nr_subbufs = nr_subbufs;
+	meta->subbuf_size = PAGE_SIZE;
+	meta->reader.lost_events = 0;
+
+	rb_update_meta_page(cpu_buffer);
+}
+
+static int __rb_map_vma(struct ring_buffer_per_cpu *cpu_buffer,
+			struct vm_area_struct *vma)
+{
+	unsigned long nr_subbufs, nr_pages, pgoff = vma->vm_pgoff;
+	struct page **pages;
+	int p = 0, err;
+
+	lockdep_assert_held(&cpu_buffer->mapping_lock);
+
+	/* The pages belong to the writer, user space can only look */
+	if (vma->vm_flags & (VM_WRITE | VM_EXEC) ||
+	    !(vma->vm_flags & VM_MAYSHARE))
+		return -EPERM;
+
+	nr_subbufs = cpu_buffer->nr_pages + 1; /* + reader subbuf */
+	if (pgoff > nr_subbufs)
+		return -EINVAL;
+
+	nr_pages = vma_pages(vma);
+	if (!nr_pages || nr_pages > nr_subbufs + 1 - pgoff) /* + meta page */
+		return -EINVAL;
+
+	/*
+	 * Make sure it can't become writable or executable later, nor be
+	 * copied or grown
+	 */
+	vm_flags_mod(vma, VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP,
+		     VM_MAYWRITE | VM_MAYEXEC);
+
+	pages = kcalloc(nr_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	if (!pgoff)
+		pages[p++] = virt_to_page(cpu_buffer->meta_page);
+	else
+		pgoff--;
+
+	for (; p < nr_pages; p++, pgoff++)
+		pages[p] = virt_to_page((void *)cpu_buffer->subbuf_ids[pgoff]);
+
+	err = vm_insert_pages(vma, vma->vm_start, pages, &nr_pages);
+	kfree(pages);
+
+	return err;
+}
+
+/**
+ * ring_buffer_map - map a per CPU buffer into user space
+ * @buffer: the buffer the per CPU buffer belongs to
+ * @cpu: the CPU of the buffer to map
+ * @vma: the read-only, shared vma to map it into
+ *
+ * Page 0 of the mapping is the meta page, a struct trace_buffer_meta,
+ * followed by all the subbufs ordered by their ID. While the buffer is
+ * mapped it can't be resized nor swapped with another buffer, and
+ * ring_buffer_read_page() always copies instead of swapping pages out.
+ * Consuming the buffer is done with ring_buffer_map_get_reader().
+ *
+ * The same buffer can be mapped more than once, every successful call
+ * has to be paired with ring_buffer_unmap().
+ *
+ * Returns 0 on success, a negative error code otherwise.
+ */
+int ring_buffer_map(struct trace_buffer *buffer, int cpu,
+		    struct vm_area_struct *vma)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long flags, *subbuf_ids;
+	int err;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (cpu_buffer->mapped) {
+		err = __rb_map_vma(cpu_buffer, vma);
+		if (!err)
+			cpu_buffer->mapped++;
+		goto unlock_mapping;
+	}
+
+	/* prevent another thread from changing buffer sizes */
+	mutex_lock(&buffer->mutex);
+
+	err = -ENOMEM;
+	cpu_buffer->meta_page = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!cpu_buffer->meta_page)
+		goto unlock;
+
+	/* subbuf_ids include the reader while nr_pages does not */
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	if (!subbuf_ids)
+		goto free_meta;
+
+	atomic_inc(&cpu_buffer->resize_disabled);
+
+	/* Block any subbuf swap until the IDs are assigned */
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	rb_setup_ids_meta_page(cpu_buffer, subbuf_ids);
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	err = __rb_map_vma(cpu_buffer, vma);
+	if (err) {
+		atomic_dec(&cpu_buffer->resize_disabled);
+		cpu_buffer->subbuf_ids = NULL;
+		kfree(subbuf_ids);
+		goto free_meta;
+	}
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->mapped = 1;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	goto unlock;
+
+ free_meta:
+	free_page((unsigned long)cpu_buffer->meta_page);
+	cpu_buffer->meta_page = NULL;
+ unlock:
+	mutex_unlock(&buffer->mutex);
+ unlock_mapping:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_unmap - drop a user space mapping of a per CPU buffer
+ * @buffer: the buffer the per CPU buffer belongs to
+ * @cpu: the CPU of the buffer to unmap
+ *
+ * The last unmap frees the meta page and makes the buffer resizable again.
+ * The vma itself holds a reference on every page it maps, so the pages
+ * stay around until it is gone.
+ */
+int ring_buffer_unmap(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long flags;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (!cpu_buffer->mapped) {
+		err = -ENODEV;
+		goto out;
+	} else if (cpu_buffer->mapped > 1) {
+		cpu_buffer->mapped--;
+		goto out;
+	}
+
+	mutex_lock(&buffer->mutex);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->mapped = 0;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	kfree(cpu_buffer->subbuf_ids);
+	cpu_buffer->subbuf_ids = NULL;
+	free_page((unsigned long)cpu_buffer->meta_page);
+	cpu_buffer->meta_page = NULL;
+	atomic_dec(&cpu_buffer->resize_disabled);
+
+	mutex_unlock(&buffer->mutex);
+ out:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_get_reader - consume the reader subbuf of a mapped buffer
+ * @buffer: the buffer the per CPU buffer belongs to
+ * @cpu: the CPU of the mapped buffer
+ *
+ * Consumes the events committed on the reader subbuf so far and hands them
+ * over to user space: they are the ones up to meta->reader.read. Once user
+ * space has been given the whole reader subbuf, the next call swaps the
+ * next subbuf in, reports the events the writer overwrote in the meantime
+ * in meta->reader.lost_events, and hands that one over instead.
+ *
+ * Nothing is ever consumed that user space wasn't told about, so it can
+ * read the events of the writer on the reader subbuf without racing with
+ * it.
+ */
+int ring_buffer_map_get_reader(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct buffer_page *reader;
+	unsigned long flags;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (!cpu_buffer->mapped) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	reader = cpu_buffer->reader_page;
+	if (reader->read >= rb_page_size(reader)) {
+		rb_get_reader_page(cpu_buffer);
+		if (cpu_buffer->reader_page != reader) {
+			cpu_buffer->meta_page->reader.lost_events =
+				cpu_buffer->lost_events;
+			cpu_buffer->lost_events = 0;
+			reader = cpu_buffer->reader_page;
+		}
+	}
+
+	while (reader->read < rb_page_size(reader))
+		rb_advance_reader(cpu_buffer);
+
+	/* Some archs do not have data cache coherency between kernel and user space */
+	flush_dcache_page(virt_to_page(reader->page));
+
+	rb_update_meta_page(cpu_buffer);
+
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+ out:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 /*
  * We only allocate new buffers, never free them if the CPU goes down.
  * If we were to free the buffer, then the user would lose any trace that was in
@@ -48,6 +48,7 @@
 #include <linux/fsnotify.h>
 #include <linux/irq_work.h>
 #include <linux/workqueue.h>
+#include <linux/trace_mmap.h>
 
 #include <asm/setup.h> /* COMMAND_LINE_SIZE */
 
@@ -1265,6 +1266,12 @@ int tracing_alloc_snapshot_instance(struct trace_array *tr)
 	int ret;
 
 	if (!tr->allocated_snapshot) {
+		/*
+		 * The buffers of a mapped instance can't be swapped. This is
+		 * racy against a new mapping, update_max_tr() checks again.
+		 */
+		if (READ_ONCE(tr->mapped))
+			return -EBUSY;
 
 		/* allocate spare buffer */
 		ret = resize_buffer_duplicate_size(&tr->max_buffer,
@@ -1876,6 +1883,12 @@ update_max_tr(struct trace_array *tr, struct task_struct *tsk, int cpu,
 
 	arch_spin_lock(&tr->max_lock);
 
+	/* User space maps the pages of array_buffer, they can't be swapped */
+	if (tr->mapped) {
+		arch_spin_unlock(&tr->max_lock);
+		return;
+	}
+
 	/* Inherit the recordable setting from array_buffer */
 	if (ring_buffer_record_is_set_on(tr->array_buffer.buffer))
 		ring_buffer_record_on(tr->max_buffer.buffer);
@@ -1920,6 +1933,11 @@ update_max_tr_single(struct trace_array *tr, struct task_struct *tsk, int cpu)
 
 	arch_spin_lock(&tr->max_lock);
 
+	if (tr->mapped) {
+		arch_spin_unlock(&tr->max_lock);
+		return;
+	}
+
 	ret = ring_buffer_swap_cpu(tr->max_buffer.buffer, tr->array_buffer.buffer, cpu);
 
 	if (ret == -EBUSY) {
@@ -5760,6 +5778,7 @@ static const char readme_msg[] =
 	"\t            [:pause][:continue][:clear]\n"
 	"\t            [:name=histname1]\n"
 	"\t            [:nohitcount]\n"
+	"\t            [:percpu]\n"
 	"\t            [:<handler>.<action>]\n"
 	"\t            [if <filter>]\n\n"
 	"\t    Note, special fields can be used as well:\n"
@@ -5818,6 +5837,10 @@ static const char readme_msg[] =
 	"\t    unchanged.\n\n"
 	"\t    The 'nohitcount' (or NOHC) parameter will suppress display of\n"
 	"\t    raw hitcount in the histogram.\n\n"
+	"\t    The 'percpu' parameter gives every CPU its own hash table,\n"
+	"\t    merged when the 'hist' file is read.  This avoids contention\n"
+	"\t    on busy events, at the cost of a table per CPU, and can't be\n"
+	"\t    combined with variables or actions.\n\n"
 	"\t    The enable_hist and disable_hist triggers can be used to\n"
 	"\t    have one event conditionally start and stop another event's\n"
 	"\t    already-attached hist trigger.  The syntax is analogous to\n"
@@ -7570,7 +7593,7 @@ tracing_snapshot_write(struct file *filp, const char __user *ubuf, size_t cnt,
 
 	local_irq_disable();
 	arch_spin_lock(&tr->max_lock);
-	if (tr->cond_snapshot)
+	if (tr->cond_snapshot || tr->mapped)
 		ret = -EBUSY;
 	arch_spin_unlock(&tr->max_lock);
 	local_irq_enable();
@@ -8471,6 +8494,9 @@ static long tracing_buffers_ioctl(struct file *file, unsigned int cmd, unsigned
 	struct ftrace_buffer_info *info = file->private_data;
 	struct trace_iterator *iter = &info->iter;
 
+	if (cmd == TRACE_MMAP_IOCTL_GET_READER)
+		return ring_buffer_map_get_reader(iter->array_buffer->buffer,
+						  iter->cpu_file);
 	if (cmd)
 		return -ENOIOCTLCMD;
 
@@ -8486,6 +8512,80 @@ static long tracing_buffers_ioctl(struct file *file, unsigned int cmd, unsigned
 	return 0;
 }
 
+static void get_snapshot_map(struct trace_array *tr)
+{
+	local_irq_disable();
+	arch_spin_lock(&tr->max_lock);
+	tr->mapped++;
+	arch_spin_unlock(&tr->max_lock);
+	local_irq_enable();
+}
+
+static void put_snapshot_map(struct trace_array *tr)
+{
+	local_irq_disable();
+	arch_spin_lock(&tr->max_lock);
+	if (!WARN_ON_ONCE(!tr->mapped))
+		tr->mapped--;
+	arch_spin_unlock(&tr->max_lock);
+	local_irq_enable();
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+
+	ring_buffer_unmap(vma->vm_private_data, info->iter.cpu_file);
+	put_snapshot_map(info->iter.tr);
+}
+
+static int tracing_buffers_may_split(struct vm_area_struct *vma,
+				     unsigned long addr)
+{
+	/* The mapping is accounted for once, in tracing_buffers_mmap() */
+	return -EINVAL;
+}
+
+static int tracing_buffers_mremap(struct vm_area_struct *vma)
+{
+	/*
+	 * Moving the mapping calls ->close() on the old vma without an
+	 * ->open() on the new one, which would drop the references taken in
+	 * tracing_buffers_mmap() while the pages are still mapped.
+	 */
+	return -EINVAL;
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.close		= tracing_buffers_mmap_close,
+	.may_split	= tracing_buffers_may_split,
+	.mremap		= tracing_buffers_mremap,
+};
+
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	struct trace_buffer *buffer;
+	int ret;
+
+	/* No swapping with the snapshot buffer from now on */
+	get_snapshot_map(iter->tr);
+
+	/* A swap could have happened before the count was raised */
+	buffer = READ_ONCE(iter->array_buffer->buffer);
+	ret = ring_buffer_map(buffer, iter->cpu_file, vma);
+	if (ret) {
+		put_snapshot_map(iter->tr);
+		return ret;
+	}
+
+	vma->vm_private_data = buffer;
+	vma->vm_ops = &tracing_buffers_vmops;
+
+	return 0;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
@@ -8494,6 +8594,7 @@ static const struct file_operations tracing_buffers_fops = {
 	.splice_read	= tracing_buffers_splice_read,
 	.unlocked_ioctl = tracing_buffers_ioctl,
 	.llseek		= no_llseek,
+	.mmap		= tracing_buffers_mmap,
 };
 
 static ssize_t
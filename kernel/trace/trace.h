@@ -336,6 +336,12 @@ struct trace_array {
 	 * CONFIG_TRACER_MAX_TRACE.
 	 */
 	arch_spinlock_t		max_lock;
+	/*
+	 * Number of user space mappings of the per CPU buffers. The
+	 * buffers must not be swapped with the snapshot buffer while it
+	 * is non-zero. Protected by max_lock.
+	 */
+	unsigned int		mapped;
 	int			buffer_disabled;
 #ifdef CONFIG_FTRACE_SYSCALLS
 	int			sys_refcount_enter;
@@ -70,7 +70,8 @@
 	C(EXPECT_NUMBER,	"Expecting numeric literal"),		\
 	C(UNARY_MINUS_SUBEXPR,	"Unary minus not supported in sub-expressions"), \
 	C(DIVISION_BY_ZERO,	"Division by zero"),			\
-	C(NEED_NOHC_VAL,	"Non-hitcount value is required for 'nohitcount'"),
+	C(NEED_NOHC_VAL,	"Non-hitcount value is required for 'nohitcount'"), \
+	C(PERCPU_VARS,		"Variables and actions can't be used with 'percpu'"),
 
 #undef C
 #define C(a, b)		HIST_ERR_##a
@@ -525,6 +526,7 @@ struct hist_trigger_attrs {
 	bool		clear;
 	bool		ts_in_usecs;
 	bool		no_hitcount;
+	bool		percpu;
 	unsigned int	map_bits;
 
 	char		*assignment_str[TRACING_MAP_VARS_MAX];
@@ -1567,6 +1569,8 @@ parse_hist_trigger_attrs(struct trace_array *tr, char *trigger_str)
 			attrs->cont = true;
 		else if (strcmp(str, "clear") == 0)
 			attrs->clear = true;
+		else if (strcmp(str, "percpu") == 0)
+			attrs->percpu = true;
 		else {
 			ret = parse_action(str, attrs);
 			if (ret)
@@ -1693,10 +1697,22 @@ static void hist_trigger_elt_data_init(struct tracing_map_elt *elt)
 		save_comm(elt_data->comm, current);
 }
 
+static void hist_trigger_elt_data_merge(struct tracing_map_elt *elt,
+					struct tracing_map_elt *cpu_elt)
+{
+	struct hist_elt_data *elt_data = elt->private_data;
+	struct hist_elt_data *cpu_elt_data = cpu_elt->private_data;
+
+	/* elt_init() saved the comm of the reader doing the merge */
+	if (elt_data->comm)
+		memcpy(elt_data->comm, cpu_elt_data->comm, TASK_COMM_LEN);
+}
+
 static const struct tracing_map_ops hist_trigger_elt_data_ops = {
 	.elt_alloc	= hist_trigger_elt_data_alloc,
 	.elt_free	= hist_trigger_elt_data_free,
 	.elt_init	= hist_trigger_elt_data_init,
+	.elt_merge	= hist_trigger_elt_data_merge,
 };
 
 static const char *get_hist_field_flags(struct hist_field *hist_field)
@@ -5124,10 +5140,22 @@ create_hist_data(unsigned int map_bits,
 	if (ret)
 		goto free;
 
+	/*
+	 * Variables and actions look elements up from other events,
+	 * which may hit on other CPUs than the ones that set them.
+	 */
+	if (attrs->percpu &&
+	    (hist_data->n_vars || hist_data->n_var_refs ||
+	     hist_data->n_actions)) {
+		hist_err(file->tr, HIST_ERR_PERCPU_VARS, 0);
+		ret = -EINVAL;
+		goto free;
+	}
+
 	map_ops = &hist_trigger_elt_data_ops;
 
 	hist_data->map = tracing_map_create(map_bits, hist_data->key_size,
-					    map_ops, hist_data);
+					    map_ops, hist_data, attrs->percpu);
 	if (IS_ERR(hist_data->map)) {
 		ret = PTR_ERR(hist_data->map);
 		hist_data->map = NULL;
@@ -6057,6 +6085,8 @@ static int event_hist_trigger_print(struct seq_file *m,
 		seq_printf(m, ":clock=%s", hist_data->attrs->clock);
 	if (hist_data->attrs->no_hitcount)
 		seq_puts(m, ":nohitcount");
+	if (hist_data->attrs->percpu)
+		seq_puts(m, ":percpu");
 
 	print_actions_spec(m, hist_data);
 
@@ -502,6 +502,58 @@ static int tracing_map_alloc_elts(struct tracing_map *map)
 	return 0;
 }
 
+static void tracing_map_free_cpu_maps(struct tracing_map *map)
+{
+	int cpu;
+
+	if (!map->cpu_maps)
+		return;
+
+	for_each_possible_cpu(cpu)
+		tracing_map_destroy(map->cpu_maps[cpu]);
+
+	kfree(map->cpu_maps);
+	map->cpu_maps = NULL;
+}
+
+static int tracing_map_alloc_cpu_maps(struct tracing_map *map)
+{
+	struct tracing_map *cpu_map;
+	int cpu, err;
+
+	map->cpu_maps = kcalloc(nr_cpu_ids, sizeof(*map->cpu_maps),
+				GFP_KERNEL);
+	if (!map->cpu_maps)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		cpu_map = tracing_map_create(map->map_bits, map->key_size,
+					     map->ops, map->private_data,
+					     false);
+		if (IS_ERR(cpu_map)) {
+			err = PTR_ERR(cpu_map);
+			goto free;
+		}
+		map->cpu_maps[cpu] = cpu_map;
+
+		memcpy(cpu_map->fields, map->fields, sizeof(map->fields));
+		cpu_map->n_fields = map->n_fields;
+		memcpy(cpu_map->key_idx, map->key_idx, sizeof(map->key_idx));
+		cpu_map->n_keys = map->n_keys;
+		cpu_map->n_vars = map->n_vars;
+
+		err = tracing_map_init(cpu_map);
+		if (err)
+			goto free;
+	}
+
+	return 0;
+ free:
+	tracing_map_free_cpu_maps(map);
+
+	return err;
+}
+
 static inline bool keys_match(void *key, void *test_key, unsigned key_size)
 {
 	bool match = true;
@@ -625,6 +677,9 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
  * run out of entries.  Readers can at any point in time traverse the
  * tracing map and safely access the key/val pairs.
  *
+ * For per-CPU maps, the key is inserted into the map of the current
+ * CPU, and the returned tracing_map_elt is private to that CPU.
+ *
  * Return: the tracing_map_elt pointer val associated with the key.
  * If this was a newly inserted key, the val will be a newly allocated
  * and associated tracing_map_elt pointer val.  If the key wasn't
@@ -633,6 +688,13 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
  */
 struct tracing_map_elt *tracing_map_insert(struct tracing_map *map, void *key)
 {
+	/*
+	 * Insertions are lock-free, so the map of the CPU the caller
+	 * started on stays safe to use even if it migrates.
+	 */
+	if (map->cpu_maps)
+		map = map->cpu_maps[raw_smp_processor_id()];
+
 	return __tracing_map_insert(map, key, false);
 }
 
@@ -655,6 +717,9 @@ struct tracing_map_elt *tracing_map_insert(struct tracing_map *map, void *key)
  */
 struct tracing_map_elt *tracing_map_lookup(struct tracing_map *map, void *key)
 {
+	if (map->cpu_maps)
+		map = map->cpu_maps[raw_smp_processor_id()];
+
 	return __tracing_map_insert(map, key, true);
 }
 
@@ -673,35 +738,49 @@ void tracing_map_destroy(struct tracing_map *map)
 	if (!map)
 		return;
 
+	tracing_map_free_cpu_maps(map);
 	tracing_map_free_elts(map);
 
 	tracing_map_array_free(map->map);
 	kfree(map);
 }
 
+static void __tracing_map_clear(struct tracing_map *map)
+{
+	unsigned int i;
+
+	atomic_set(&map->next_elt, -1);
+	atomic64_set(&map->hits, 0);
+	atomic64_set(&map->drops, 0);
+
+	tracing_map_array_clear(map->map);
+
+	for (i = 0; i < map->max_elts; i++)
+		tracing_map_elt_clear(*(TRACING_MAP_ELT(map->elts, i)));
+}
+
 /**
  * tracing_map_clear - Clear a tracing_map
  * @map: The tracing_map to clear
  *
  * Resets the tracing map to a cleared or initial state.  The
  * tracing_map_elts are all cleared, and the array of struct
- * tracing_map_entry is reset to an initialized state.
+ * tracing_map_entry is reset to an initialized state.  For per-CPU
+ * maps, so are the maps of all the CPUs.
  *
  * Callers should make sure there are no writers actively inserting
  * into the map before calling this.
  */
 void tracing_map_clear(struct tracing_map *map)
 {
-	unsigned int i;
+	int cpu;
 
-	atomic_set(&map->next_elt, -1);
-	atomic64_set(&map->hits, 0);
-	atomic64_set(&map->drops, 0);
-
-	tracing_map_array_clear(map->map);
+	if (map->cpu_maps) {
+		for_each_possible_cpu(cpu)
+			__tracing_map_clear(map->cpu_maps[cpu]);
+	}
 
-	for (i = 0; i < map->max_elts; i++)
-		tracing_map_elt_clear(*(TRACING_MAP_ELT(map->elts, i)));
+	__tracing_map_clear(map);
 }
 
 static void set_sort_key(struct tracing_map *map,
@@ -716,6 +795,7 @@ static void set_sort_key(struct tracing_map *map,
  * @key_size: The size of the key for the map in bytes
  * @ops: Optional client-defined tracing_map_ops instance
  * @private_data: Client data associated with the map
+ * @percpu: Whether tracing_map_init() should give every CPU its own map
  *
  * Creates and sets up a map to contain 2 ** map_bits number of
  * elements (internally maintained as 'max_elts' in struct
@@ -763,7 +843,8 @@ static void set_sort_key(struct tracing_map *map,
 struct tracing_map *tracing_map_create(unsigned int map_bits,
 				       unsigned int key_size,
 				       const struct tracing_map_ops *ops,
-				       void *private_data)
+				       void *private_data,
+				       bool percpu)
 {
 	struct tracing_map *map;
 	unsigned int i;
@@ -784,6 +865,7 @@ struct tracing_map *tracing_map_create(unsigned int map_bits,
 	map->ops = ops;
 
 	map->private_data = private_data;
+	map->percpu = percpu;
 
 	map->map = tracing_map_array_alloc(map->map_size,
 					   sizeof(struct tracing_map_entry));
@@ -817,6 +899,9 @@ struct tracing_map *tracing_map_create(unsigned int map_bits,
  * - internally we double that in order to keep the table sparse and
  * keep collisions manageable.
  *
+ * For per-CPU maps, the maps of all the possible CPUs, each with its
+ * own pool of tracing_map_elts, are allocated as well.
+ *
  * See tracing_map.h for a description of tracing_map_ops.
  *
  * Return: the tracing_map pointer if successful, ERR_PTR if not.
@@ -832,11 +917,78 @@ int tracing_map_init(struct tracing_map *map)
 	if (err)
 		return err;
 
+	if (map->percpu) {
+		err = tracing_map_alloc_cpu_maps(map);
+		if (err)
+			return err;
+	}
+
 	tracing_map_clear(map);
 
 	return err;
 }
 
+static void tracing_map_elt_merge(struct tracing_map_elt *elt,
+				  struct tracing_map_elt *cpu_elt)
+{
+	unsigned int i;
+
+	for (i = 0; i < elt->map->n_fields; i++)
+		if (elt->fields[i].cmp_fn == tracing_map_cmp_atomic64)
+			atomic64_add(atomic64_read(&cpu_elt->fields[i].sum),
+				     &elt->fields[i].sum);
+
+	for (i = 0; i < elt->map->n_vars; i++)
+		if (cpu_elt->var_set[i])
+			tracing_map_set_var(elt, i,
+					    atomic64_read(&cpu_elt->vars[i]));
+
+	if (elt->map->ops && elt->map->ops->elt_merge)
+		elt->map->ops->elt_merge(elt, cpu_elt);
+}
+
+/*
+ * Rebuild the elts of a per-CPU map from the maps of all the CPUs.
+ * Writers only ever touch the per-CPU maps and keep going while this
+ * runs, what they add in the meantime may or may not make it.
+ */
+static void tracing_map_merge_cpu_maps(struct tracing_map *map)
+{
+	struct tracing_map_entry *entry;
+	struct tracing_map_elt *elt, *cpu_elt;
+	struct tracing_map *cpu_map;
+	u64 hits = 0, drops = 0;
+	unsigned int i;
+	int cpu;
+
+	__tracing_map_clear(map);
+
+	for_each_possible_cpu(cpu) {
+		cpu_map = map->cpu_maps[cpu];
+
+		hits += atomic64_read(&cpu_map->hits);
+		drops += atomic64_read(&cpu_map->drops);
+
+		for (i = 0; i < cpu_map->map_size; i++) {
+			entry = TRACING_MAP_ENTRY(cpu_map->map, i);
+
+			cpu_elt = READ_ONCE(entry->val);
+			if (!entry->key || !cpu_elt)
+				continue;
+
+			/* Keys that don't fit in the merged map count as drops */
+			elt = __tracing_map_insert(map, cpu_elt->key, false);
+			if (!elt)
+				continue;
+
+			tracing_map_elt_merge(elt, cpu_elt);
+		}
+	}
+
+	atomic64_set(&map->hits, hits);
+	atomic64_add(drops, &map->drops);
+}
+
 static int cmp_entries_dup(const void *A, const void *B)
 {
 	const struct tracing_map_sort_entry *a, *b;
@@ -1063,6 +1215,12 @@ static void sort_secondary(struct tracing_map *map,
  * The client should not hold on to the returned array but should use
  * it and call tracing_map_destroy_sort_entries() when done.
  *
+ * For per-CPU maps, the maps of all the CPUs are first merged into
+ * the elements of @map, which the returned entries point to, and the
+ * 'hits' and 'drops' of @map are updated to account for all the
+ * CPUs.  Calls for the same map must then be serialized by the
+ * client, and the entries are only valid until the next call.
+ *
  * Return: the number of sort_entries in the struct tracing_map_sort_entry
  * array, negative on error
  */
@@ -1079,6 +1237,9 @@ int tracing_map_sort_entries(struct tracing_map *map,
 	if (!entries)
 		return -ENOMEM;
 
+	if (map->cpu_maps)
+		tracing_map_merge_cpu_maps(map);
+
 	for (i = 0, n_entries = 0; i < map->map_size; i++) {
 		struct tracing_map_entry *entry;
 
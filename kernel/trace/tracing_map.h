@@ -125,6 +125,18 @@ typedef int (*tracing_map_cmp_fn_t) (void *val_a, void *val_b);
  * user, tracing_map_sort_entry objects contain a number of additional
  * fields which are used for caching and internal purposes and can
  * safely be ignored.
+ *
+ * Finally, a tracing_map can be created as a per-CPU map.  Every
+ * possible CPU then gets its own private tracing_map, with the same
+ * fields and its own pool of tracing_map_elts, and
+ * tracing_map_insert() only ever touches the map of the CPU it runs
+ * on, so that CPUs hitting the same keys don't fight over the same
+ * entries and sums.  The elements of the tracing_map itself are
+ * only used by tracing_map_sort_entries(), which merges all the
+ * per-CPU maps into them before sorting.  The price is a pool of
+ * max_elts tracing_map_elts per CPU, and that elements looked up on
+ * one CPU are never seen by another, which rules out per-element
+ * variables shared between events.
 */
 
 struct tracing_map_field {
@@ -198,6 +210,8 @@ struct tracing_map {
 	unsigned int			n_vars;
 	atomic64_t			hits;
 	atomic64_t			drops;
+	bool				percpu;
+	struct tracing_map		**cpu_maps;
 };
 
 /**
@@ -229,19 +243,27 @@ struct tracing_map {
  *	be initialized when used i.e. when the element is actually
  *	claimed by tracing_map_insert() in the context of the map
  *	insertion.
+ *
+ * @elt_merge: For per-CPU maps, this callback is called for every
+ *	per-CPU element folded into a merged element (the first
+ *	parameter) by tracing_map_sort_entries(), and allows
+ *	per-element client-defined data to be carried over.
  */
 struct tracing_map_ops {
 	int			(*elt_alloc)(struct tracing_map_elt *elt);
 	void			(*elt_free)(struct tracing_map_elt *elt);
 	void			(*elt_clear)(struct tracing_map_elt *elt);
 	void			(*elt_init)(struct tracing_map_elt *elt);
+	void			(*elt_merge)(struct tracing_map_elt *elt,
+					     struct tracing_map_elt *cpu_elt);
 };
 
 extern struct tracing_map *
 tracing_map_create(unsigned int map_bits,
 		   unsigned int key_size,
 		   const struct tracing_map_ops *ops,
-		   void *private_data);
+		   void *private_data,
+		   bool percpu);
 extern int tracing_map_init(struct tracing_map *map);
 
 extern int tracing_map_add_sum_field(struct tracing_map *map);
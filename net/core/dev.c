@@ -77,6 +77,7 @@
 #include <linux/hash.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
+#include <linux/sched/clock.h>
 #include <linux/sched/mm.h>
 #include <linux/mutex.h>
 #include <linux/rwsem.h>
@@ -6321,7 +6322,8 @@ static void init_gro_hash(struct napi_struct *napi)
 	napi->gro_bitmask = 0;
 }
 
-int dev_set_threaded(struct net_device *dev, bool threaded)
+int dev_set_threaded(struct net_device *dev,
+		     enum netdev_napi_threaded threaded)
 {
 	struct napi_struct *napi;
 	int err = 0;
@@ -6334,7 +6336,7 @@ int dev_set_threaded(struct net_device *dev, bool threaded)
 			if (!napi->thread) {
 				err = napi_kthread_create(napi);
 				if (err) {
-					threaded = false;
+					threaded = NETDEV_NAPI_THREADED_DISABLED;
 					break;
 				}
 			}
@@ -6355,6 +6357,8 @@ int dev_set_threaded(struct net_device *dev, bool threaded)
 	 * This should not cause hiccups/stalls to the live traffic.
 	 */
 	list_for_each_entry(napi, &dev->napi_list, dev_list) {
+		assign_bit(NAPI_STATE_THREADED_BUSY_POLL, &napi->state,
+			   threaded == NETDEV_NAPI_THREADED_BUSY_POLL);
 		if (threaded)
 			set_bit(NAPI_STATE_THREADED, &napi->state);
 		else
@@ -6418,7 +6422,8 @@ void napi_disable(struct napi_struct *n)
 		}
 
 		new = val | NAPIF_STATE_SCHED | NAPIF_STATE_NPSVC;
-		new &= ~(NAPIF_STATE_THREADED | NAPIF_STATE_PREFER_BUSY_POLL);
+		new &= ~(NAPIF_STATE_THREADED | NAPIF_STATE_THREADED_BUSY_POLL |
+			 NAPIF_STATE_PREFER_BUSY_POLL);
 	} while (!try_cmpxchg(&n->state, &val, new));
 
 	hrtimer_cancel(&n->timer);
@@ -6444,6 +6449,8 @@ void napi_enable(struct napi_struct *n)
 		new = val & ~(NAPIF_STATE_SCHED | NAPIF_STATE_NPSVC);
 		if (n->dev->threaded && n->thread)
 			new |= NAPIF_STATE_THREADED;
+		if (n->dev->threaded == NETDEV_NAPI_THREADED_BUSY_POLL && n->thread)
+			new |= NAPIF_STATE_THREADED_BUSY_POLL;
 	} while (!try_cmpxchg(&n->state, &val, new));
 }
 EXPORT_SYMBOL(napi_enable);
@@ -6621,39 +6628,123 @@ static void skb_defer_free_flush(struct softnet_data *sd)
 	}
 }
 
-static int napi_threaded_poll(void *data)
+static void napi_threaded_poll_loop(struct napi_struct *napi)
 {
-	struct napi_struct *napi = data;
 	struct softnet_data *sd;
 	void *have;
 
-	while (!napi_thread_wait(napi)) {
-		for (;;) {
-			bool repoll = false;
+	for (;;) {
+		bool repoll = false;
 
-			local_bh_disable();
-			sd = this_cpu_ptr(&softnet_data);
-			sd->in_napi_threaded_poll = true;
+		local_bh_disable();
+		sd = this_cpu_ptr(&softnet_data);
+		sd->in_napi_threaded_poll = true;
 
-			have = netpoll_poll_lock(napi);
-			__napi_poll(napi, &repoll);
-			netpoll_poll_unlock(have);
+		have = netpoll_poll_lock(napi);
+		__napi_poll(napi, &repoll);
+		netpoll_poll_unlock(have);
 
-			sd->in_napi_threaded_poll = false;
-			barrier();
+		sd->in_napi_threaded_poll = false;
+		barrier();
 
-			if (sd_has_rps_ipi_waiting(sd)) {
-				local_irq_disable();
-				net_rps_action_and_irq_enable(sd);
-			}
-			skb_defer_free_flush(sd);
-			local_bh_enable();
+		if (sd_has_rps_ipi_waiting(sd)) {
+			local_irq_disable();
+			net_rps_action_and_irq_enable(sd);
+		}
+		skb_defer_free_flush(sd);
+		local_bh_enable();
 
-			if (!repoll)
-				break;
+		if (!repoll)
+			break;
 
-			cond_resched();
+		cond_resched();
+	}
+}
+
+static bool napi_threaded_busy_poll_end(struct napi_struct *napi,
+					u64 last_work, u64 idle_ns)
+{
+	if (unlikely(napi_disable_pending(napi) || kthread_should_stop()))
+		return true;
+
+	if (!test_bit(NAPI_STATE_THREADED_BUSY_POLL, &napi->state))
+		return true;
+
+	return idle_ns && local_clock() - last_work > idle_ns;
+}
+
+/* Keep polling the device from the napi thread without going back to
+ * sleep in between, until the device has been idle for
+ * threaded_busy_poll_usecs or the napi leaves busy poll mode.
+ */
+static void napi_threaded_busy_poll(struct napi_struct *napi)
+{
+	struct net_device *dev = napi->dev;
+	int budget = READ_ONCE(dev->threaded_busy_poll_budget) ?: napi->weight;
+	u64 idle_ns = (u64)READ_ONCE(dev->threaded_busy_poll_usecs) *
+		      NSEC_PER_USEC;
+	u64 last_work = local_clock();
+	struct softnet_data *sd;
+	void *have;
+
+	/* We own NAPI_STATE_SCHED since the thread was woken up. Also
+	 * owning NAPI_STATE_IN_BUSY_POLL makes napi_complete_done() a nop,
+	 * so the driver keeps its interrupts masked while we poll.
+	 */
+	set_bit(NAPI_STATE_IN_BUSY_POLL, &napi->state);
+
+	do {
+		int work;
+
+		local_bh_disable();
+		sd = this_cpu_ptr(&softnet_data);
+		sd->in_napi_threaded_poll = true;
+
+		have = netpoll_poll_lock(napi);
+		work = napi->poll(napi, budget);
+		trace_napi_poll(napi, work, budget);
+		/* napi_complete_done() did not flush, do it here instead.
+		 * If HZ < 1000, flush all packets.
+		 */
+		if (napi->gro_bitmask)
+			napi_gro_flush(napi, HZ >= 1000);
+		gro_normal_list(napi);
+		netpoll_poll_unlock(have);
+
+		sd->in_napi_threaded_poll = false;
+		barrier();
+
+		if (sd_has_rps_ipi_waiting(sd)) {
+			local_irq_disable();
+			net_rps_action_and_irq_enable(sd);
 		}
+		skb_defer_free_flush(sd);
+		local_bh_enable();
+
+		if (work > 0)
+			last_work = local_clock();
+
+		cond_resched();
+	} while (!napi_threaded_busy_poll_end(napi, last_work, idle_ns));
+
+	/* Hard irqs may have set NAPI_STATE_MISSED while we were polling,
+	 * the regular poll below makes up for it and lets the driver
+	 * re-enable its interrupts from napi_complete_done().
+	 */
+	clear_bit(NAPI_STATE_MISSED, &napi->state);
+	clear_bit(NAPI_STATE_IN_BUSY_POLL, &napi->state);
+}
+
+static int napi_threaded_poll(void *data)
+{
+	struct napi_struct *napi = data;
+
+	while (!napi_thread_wait(napi)) {
+		if (test_bit(NAPI_STATE_THREADED_BUSY_POLL, &napi->state) &&
+		    !napi_disable_pending(napi))
+			napi_threaded_busy_poll(napi);
+
+		napi_threaded_poll_loop(napi);
 	}
 	return 0;
 }
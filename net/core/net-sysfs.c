@@ -30,6 +30,7 @@
 #ifdef CONFIG_SYSFS
 static const char fmt_hex[] = "%#x\n";
 static const char fmt_dec[] = "%d\n";
+static const char fmt_udec[] = "%u\n";
 static const char fmt_ulong[] = "%lu\n";
 static const char fmt_u64[] = "%llu\n";
 
@@ -422,6 +423,51 @@ static ssize_t napi_defer_hard_irqs_store(struct device *dev,
 }
 NETDEVICE_SHOW_RW(napi_defer_hard_irqs, fmt_dec);
 
+static int change_threaded_busy_poll_budget(struct net_device *dev,
+					    unsigned long val)
+{
+	/* Drivers size their rings and warn assuming at most this much */
+	if (val > NAPI_POLL_WEIGHT)
+		return -ERANGE;
+
+	WRITE_ONCE(dev->threaded_busy_poll_budget, val);
+	return 0;
+}
+
+static ssize_t threaded_busy_poll_budget_store(struct device *dev,
+					       struct device_attribute *attr,
+					       const char *buf, size_t len)
+{
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	return netdev_store(dev, attr, buf, len,
+			    change_threaded_busy_poll_budget);
+}
+NETDEVICE_SHOW_RW(threaded_busy_poll_budget, fmt_dec);
+
+static int change_threaded_busy_poll_usecs(struct net_device *dev,
+					   unsigned long val)
+{
+	if (val > UINT_MAX)
+		return -ERANGE;
+
+	WRITE_ONCE(dev->threaded_busy_poll_usecs, val);
+	return 0;
+}
+
+static ssize_t threaded_busy_poll_usecs_store(struct device *dev,
+					      struct device_attribute *attr,
+					      const char *buf, size_t len)
+{
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	return netdev_store(dev, attr, buf, len,
+			    change_threaded_busy_poll_usecs);
+}
+NETDEVICE_SHOW_RW(threaded_busy_poll_usecs, fmt_udec);
+
 static ssize_t ifalias_store(struct device *dev, struct device_attribute *attr,
 			     const char *buf, size_t len)
 {
@@ -604,7 +650,7 @@ static int modify_napi_threaded(struct net_device *dev, unsigned long val)
 	if (list_empty(&dev->napi_list))
 		return -EOPNOTSUPP;
 
-	if (val != 0 && val != 1)
+	if (val > NETDEV_NAPI_THREADED_BUSY_POLL)
 		return -EOPNOTSUPP;
 
 	ret = dev_set_threaded(dev, val);
@@ -646,6 +692,8 @@ static struct attribute *net_class_attrs[] __ro_after_init = {
 	&dev_attr_tx_queue_len.attr,
 	&dev_attr_gro_flush_timeout.attr,
 	&dev_attr_napi_defer_hard_irqs.attr,
+	&dev_attr_threaded_busy_poll_budget.attr,
+	&dev_attr_threaded_busy_poll_usecs.attr,
 	&dev_attr_phys_port_id.attr,
 	&dev_attr_phys_port_name.attr,
 	&dev_attr_phys_switch_id.attr,
@@ -756,6 +756,8 @@ int inet_accept(struct socket *sock, struct socket *newsock, int flags,
 
 	if (test_bit(SOCK_SUPPORT_ZC, &sock->flags))
 		set_bit(SOCK_SUPPORT_ZC, &newsock->flags);
+	if (test_bit(SOCK_SPLICE_PAGES, &sock->flags))
+		set_bit(SOCK_SPLICE_PAGES, &newsock->flags);
 	sock_graft(sk2, newsock);
 
 	newsock->state = SS_CONNECTED;
@@ -136,8 +136,10 @@ static int __tcp_set_ulp(struct sock *sk, const struct tcp_ulp_ops *ulp_ops)
 	if (icsk->icsk_ulp_ops)
 		goto out_err;
 
-	if (sk->sk_socket)
+	if (sk->sk_socket) {
 		clear_bit(SOCK_SUPPORT_ZC, &sk->sk_socket->flags);
+		clear_bit(SOCK_SPLICE_PAGES, &sk->sk_socket->flags);
+	}
 
 	err = -ENOTCONN;
 	if (!ulp_ops->clone && sk->sk_state == TCP_LISTEN)
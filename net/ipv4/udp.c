@@ -1444,13 +1444,39 @@ static bool udp_skb_has_head_state(struct sk_buff *skb)
 	return !(udp_skb_scratch(skb)->_tsize_state & UDP_SKB_IS_STATELESS);
 }
 
+/* Take back the forward allocated memory the per-CPU receive queues
+ * borrowed from the socket, see udp_percpu_rxq_enqueue().
+ */
+static int udp_percpu_rxq_reclaim(struct sock *sk)
+{
+	struct udp_percpu_rxq __percpu *percpu_rxq = udp_percpu_rxq(sk);
+	struct udp_percpu_rxq *rxq;
+	int cpu, credit = 0;
+
+	if (!percpu_rxq)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		rxq = per_cpu_ptr(percpu_rxq, cpu);
+		if (!READ_ONCE(rxq->fwd_alloc))
+			continue;
+
+		spin_lock(&rxq->queue.lock);
+		credit += rxq->fwd_alloc;
+		WRITE_ONCE(rxq->fwd_alloc, 0);
+		spin_unlock(&rxq->queue.lock);
+	}
+
+	return credit;
+}
+
 /* fully reclaim rmem/fwd memory allocated for skb */
 static void udp_rmem_release(struct sock *sk, int size, int partial,
 			     bool rx_queue_lock_held)
 {
 	struct udp_sock *up = udp_sk(sk);
 	struct sk_buff_head *sk_queue;
-	int amt;
+	int amt, credit = 0;
 
 	if (likely(partial)) {
 		up->forward_deficit += size;
@@ -1463,6 +1489,17 @@ static void udp_rmem_release(struct sock *sk, int size, int partial,
 	}
 	up->forward_deficit = 0;
 
+	/* Under memory pressure, don't leave the credit of the per-CPU queues
+	 * idle. UDP has no memory_pressure flag of its own, so check the
+	 * pressure threshold of udp_mem as well. The per-CPU queue locks nest
+	 * outside of the sk_receive_queue one, callers holding the latter
+	 * only come from the destructor, which returns the credit itself.
+	 */
+	if (!rx_queue_lock_held && udp_percpu_rxq(sk) &&
+	    (sk_under_memory_pressure(sk) ||
+	     sk_memory_allocated(sk) > sk_prot_mem_limits(sk, 1)))
+		credit = udp_percpu_rxq_reclaim(sk);
+
 	/* acquire the sk_receive_queue for fwd allocated memory scheduling,
 	 * if the called don't held it already
 	 */
@@ -1471,7 +1508,7 @@ static void udp_rmem_release(struct sock *sk, int size, int partial,
 		spin_lock(&sk_queue->lock);
 
 
-	sk->sk_forward_alloc += size;
+	sk->sk_forward_alloc += size + credit;
 	amt = (sk->sk_forward_alloc - partial) & ~(PAGE_SIZE - 1);
 	sk->sk_forward_alloc -= amt;
 
@@ -1542,8 +1579,156 @@ static int udp_rmem_schedule(struct sock *sk, int size)
 	return 0;
 }
 
+/* Minimum amount of forward allocated memory moved from the socket to a
+ * per-CPU receive queue at once.
+ */
+#define UDP_PERCPU_RXQ_CREDIT	(4 * PAGE_SIZE)
+
+static int udp_percpu_rxq_enqueue(struct sock *sk, struct sk_buff *skb,
+				  struct udp_percpu_rxq __percpu *percpu_rxq,
+				  int size)
+{
+	struct sk_buff_head *sk_queue = &sk->sk_receive_queue;
+	struct udp_percpu_rxq *rxq;
+	int cpu, credit, err = 0;
+
+	cpu = smp_processor_id();
+	rxq = per_cpu_ptr(percpu_rxq, cpu);
+
+	spin_lock(&rxq->queue.lock);
+	if (rxq->fwd_alloc < size) {
+		/* borrow a batch of forward allocated memory from the socket,
+		 * fall back to the exact amount under memory pressure
+		 */
+		credit = max_t(int, size - rxq->fwd_alloc,
+			       UDP_PERCPU_RXQ_CREDIT);
+		spin_lock(&sk_queue->lock);
+		err = udp_rmem_schedule(sk, credit);
+		if (err) {
+			credit = size - rxq->fwd_alloc;
+			err = udp_rmem_schedule(sk, credit);
+		}
+		if (!err) {
+			sk->sk_forward_alloc -= credit;
+			WRITE_ONCE(rxq->fwd_alloc, rxq->fwd_alloc + credit);
+		}
+		spin_unlock(&sk_queue->lock);
+		if (err)
+			goto out;
+	}
+
+	WRITE_ONCE(rxq->fwd_alloc, rxq->fwd_alloc - size);
+	sock_skb_set_dropcount(sk, skb);
+	__skb_queue_tail(&rxq->queue, skb);
+
+	/* the reader clears the bit under the same lock once it has
+	 * spliced the queue
+	 */
+	if (skb_queue_len(&rxq->queue) == 1)
+		set_bit(cpu, udp_sk(sk)->percpu_rxq_pending);
+out:
+	spin_unlock(&rxq->queue.lock);
+	return err;
+}
+
+/* Move the packets queued on the next CPU with pending data, in round-robin
+ * order, to the reader queue.  Caller holds the reader queue lock with BH
+ * disabled.  Returns false if all per-CPU queues are empty.
+ *
+ * Packets queued to sk_receive_queue before the per-CPU queues were
+ * enabled, or by producers that hadn't seen them yet, go first.
+ */
+static bool udp_percpu_rxq_splice(struct sock *sk, struct sk_buff_head *rcvq)
+{
+	struct sk_buff_head *sk_queue = &sk->sk_receive_queue;
+	struct udp_sock *up = udp_sk(sk);
+	struct udp_percpu_rxq *rxq;
+	unsigned int cpu;
+
+	if (unlikely(!skb_queue_empty_lockless(sk_queue))) {
+		spin_lock(&sk_queue->lock);
+		skb_queue_splice_tail_init(sk_queue, rcvq);
+		spin_unlock(&sk_queue->lock);
+		return true;
+	}
+
+	cpu = find_next_bit(up->percpu_rxq_pending, nr_cpu_ids,
+			    up->percpu_rxq_next);
+	if (cpu >= nr_cpu_ids)
+		cpu = find_first_bit(up->percpu_rxq_pending, nr_cpu_ids);
+	if (cpu >= nr_cpu_ids)
+		return false;
+
+	rxq = per_cpu_ptr(up->percpu_rxq, cpu);
+	spin_lock(&rxq->queue.lock);
+	skb_queue_splice_tail_init(&rxq->queue, rcvq);
+	clear_bit(cpu, up->percpu_rxq_pending);
+	spin_unlock(&rxq->queue.lock);
+
+	up->percpu_rxq_next = cpu + 1;
+	return true;
+}
+
+static int udp_percpu_rxq_enable(struct sock *sk)
+{
+	struct udp_percpu_rxq __percpu *percpu_rxq;
+	struct udp_sock *up = udp_sk(sk);
+	unsigned long *pending;
+	int cpu;
+
+	if (up->percpu_rxq)
+		return 0;
+
+	percpu_rxq = alloc_percpu(struct udp_percpu_rxq);
+	if (!percpu_rxq)
+		return -ENOMEM;
+
+	pending = bitmap_zalloc(nr_cpu_ids, GFP_KERNEL);
+	if (!pending) {
+		free_percpu(percpu_rxq);
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu)
+		skb_queue_head_init(&per_cpu_ptr(percpu_rxq, cpu)->queue);
+
+	up->percpu_rxq_pending = pending;
+	/* Whatever is already in sk_receive_queue, and what producers racing
+	 * with us still put there, is drained by udp_percpu_rxq_splice().
+	 * Paired with smp_load_acquire() in udp_percpu_rxq().
+	 */
+	smp_store_release(&up->percpu_rxq, percpu_rxq);
+	return 0;
+}
+
+/* Called at destruction time, when no producer can be running anymore:
+ * move the pending packets to the reader queue and give the borrowed
+ * forward allocated memory back to the socket.
+ */
+static void udp_percpu_rxq_destroy(struct sock *sk)
+{
+	struct udp_sock *up = udp_sk(sk);
+	struct udp_percpu_rxq *rxq;
+	int cpu;
+
+	if (!up->percpu_rxq)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		rxq = per_cpu_ptr(up->percpu_rxq, cpu);
+		skb_queue_splice_tail_init(&rxq->queue, &up->reader_queue);
+		sk->sk_forward_alloc += rxq->fwd_alloc;
+	}
+
+	free_percpu(up->percpu_rxq);
+	bitmap_free(up->percpu_rxq_pending);
+	up->percpu_rxq = NULL;
+	up->percpu_rxq_pending = NULL;
+}
+
 int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 {
+	struct udp_percpu_rxq __percpu *percpu_rxq = udp_percpu_rxq(sk);
 	struct sk_buff_head *list = &sk->sk_receive_queue;
 	int rmem, err = -ENOMEM;
 	spinlock_t *busy = NULL;
@@ -1565,7 +1750,9 @@ int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 	if (rmem > (sk->sk_rcvbuf >> 1)) {
 		skb_condense(skb);
 
-		busy = busylock_acquire(sk);
+		/* per-CPU queues have no shared lock to relieve */
+		if (!percpu_rxq)
+			busy = busylock_acquire(sk);
 	}
 	size = skb->truesize;
 	udp_set_dev_scratch(skb);
@@ -1577,6 +1764,13 @@ int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 	if (rmem > (size + (unsigned int)sk->sk_rcvbuf))
 		goto uncharge_drop;
 
+	if (percpu_rxq) {
+		err = udp_percpu_rxq_enqueue(sk, skb, percpu_rxq, size);
+		if (err)
+			goto uncharge_drop;
+		goto data_ready;
+	}
+
 	spin_lock(&list->lock);
 	err = udp_rmem_schedule(sk, size);
 	if (err) {
@@ -1594,6 +1788,7 @@ int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 	__skb_queue_tail(list, skb);
 	spin_unlock(&list->lock);
 
+data_ready:
 	if (!sock_flag(sk, SOCK_DEAD))
 		sk->sk_data_ready(sk);
 
@@ -1617,6 +1812,7 @@ void udp_destruct_common(struct sock *sk)
 	unsigned int total = 0;
 	struct sk_buff *skb;
 
+	udp_percpu_rxq_destroy(sk);
 	skb_queue_splice_tail_init(&sk->sk_receive_queue, &up->reader_queue);
 	while ((skb = __skb_dequeue(&up->reader_queue)) != NULL) {
 		total += skb->truesize;
@@ -1702,7 +1898,10 @@ static int first_packet_length(struct sock *sk)
 
 	spin_lock_bh(&rcvq->lock);
 	skb = __first_packet_length(sk, rcvq, &total);
-	if (!skb && !skb_queue_empty_lockless(sk_queue)) {
+	if (udp_percpu_rxq(sk)) {
+		while (!skb && udp_percpu_rxq_splice(sk, rcvq))
+			skb = __first_packet_length(sk, rcvq, &total);
+	} else if (!skb && !skb_queue_empty_lockless(sk_queue)) {
 		spin_lock(&sk_queue->lock);
 		skb_queue_splice_tail_init(sk_queue, rcvq);
 		spin_unlock(&sk_queue->lock);
@@ -1745,6 +1944,42 @@ int udp_ioctl(struct sock *sk, int cmd, unsigned long arg)
 }
 EXPORT_SYMBOL(udp_ioctl);
 
+/* Like __skb_wait_for_more_packets(), but looks at the per-CPU queues */
+static int udp_percpu_rxq_wait(struct sock *sk, int *err, long *timeo_p)
+{
+	DEFINE_WAIT(wait);
+	int error;
+
+	prepare_to_wait_exclusive(sk_sleep(sk), &wait, TASK_INTERRUPTIBLE);
+
+	error = sock_error(sk);
+	if (error)
+		goto out_err;
+
+	if (!udp_rxq_empty_lockless(sk))
+		goto out;
+
+	if (sk->sk_shutdown & RCV_SHUTDOWN)
+		goto out_noerr;
+
+	if (signal_pending(current)) {
+		error = sock_intr_errno(*timeo_p);
+		goto out_err;
+	}
+
+	*timeo_p = schedule_timeout(*timeo_p);
+out:
+	finish_wait(sk_sleep(sk), &wait);
+	return error;
+out_err:
+	*err = error;
+	goto out;
+out_noerr:
+	*err = 0;
+	error = 1;
+	goto out;
+}
+
 struct sk_buff *__skb_recv_udp(struct sock *sk, unsigned int flags,
 			       int *off, int *err)
 {
@@ -1775,11 +2010,27 @@ struct sk_buff *__skb_recv_udp(struct sock *sk, unsigned int flags,
 				return skb;
 			}
 
-			if (skb_queue_empty_lockless(sk_queue)) {
+			if (udp_rxq_empty_lockless(sk)) {
 				spin_unlock_bh(&queue->lock);
 				goto busy_check;
 			}
 
+			if (udp_percpu_rxq(sk)) {
+				/* the per-CPU queues are refilled without
+				 * touching sk_receive_queue, memory is
+				 * released by the usual destructor
+				 */
+				udp_percpu_rxq_splice(sk, queue);
+				skb = __skb_try_recv_from_queue(sk, queue, flags,
+								off, err, &last);
+				if (skb && !(flags & MSG_PEEK))
+					udp_skb_destructor(sk, skb);
+				spin_unlock_bh(&queue->lock);
+				if (skb)
+					return skb;
+				goto busy_check;
+			}
+
 			/* refill the reader queue and walk it again
 			 * keep both queues locked to avoid re-acquiring
 			 * the sk_receive_queue lock if fwd memory scheduling
@@ -1802,13 +2053,15 @@ struct sk_buff *__skb_recv_udp(struct sock *sk, unsigned int flags,
 				break;
 
 			sk_busy_loop(sk, flags & MSG_DONTWAIT);
-		} while (!skb_queue_empty_lockless(sk_queue));
+		} while (!udp_rxq_empty_lockless(sk));
 
 		/* sk_queue is empty, reader_queue may contain peeked packets */
 	} while (timeo &&
-		 !__skb_wait_for_more_packets(sk, &sk->sk_receive_queue,
-					      &error, &timeo,
-					      (struct sk_buff *)sk_queue));
+		 !(udp_percpu_rxq(sk) ?
+		   udp_percpu_rxq_wait(sk, &error, &timeo) :
+		   __skb_wait_for_more_packets(sk, &sk->sk_receive_queue,
+					       &error, &timeo,
+					       (struct sk_buff *)sk_queue)));
 
 	*err = error;
 	return NULL;
@@ -2773,6 +3026,18 @@ int udp_lib_setsockopt(struct sock *sk, int level, int optname,
 		release_sock(sk);
 		break;
 
+	case UDP_PERCPU_RXQ:
+		/* the per-CPU queues can't be torn down while producers
+		 * may be running, the option can only be turned on
+		 */
+		lock_sock(sk);
+		if (valbool)
+			err = udp_percpu_rxq_enable(sk);
+		else if (up->percpu_rxq)
+			err = -EINVAL;
+		release_sock(sk);
+		break;
+
 	/*
 	 * 	UDP-Lite's partial checksum coverage (RFC 3828).
 	 */
@@ -2861,6 +3126,10 @@ int udp_lib_getsockopt(struct sock *sk, int level, int optname,
 		val = up->gro_enabled;
 		break;
 
+	case UDP_PERCPU_RXQ:
+		val = !!udp_percpu_rxq(sk);
+		break;
+
 	/* The following two cannot be changed on UDP sockets, the return is
 	 * always 0 (which corresponds to the full checksum coverage of UDP). */
 	case UDPLITE_SEND_CSCOV:
@@ -2909,7 +3178,8 @@ __poll_t udp_poll(struct file *file, struct socket *sock, poll_table *wait)
 	__poll_t mask = datagram_poll(file, sock, wait);
 	struct sock *sk = sock->sk;
 
-	if (!skb_queue_empty_lockless(&udp_sk(sk)->reader_queue))
+	if (!skb_queue_empty_lockless(&udp_sk(sk)->reader_queue) ||
+	    !udp_rxq_empty_lockless(sk))
 		mask |= EPOLLIN | EPOLLRDNORM;
 
 	/* Check for false positives due to checksum errors */
@@ -23,7 +23,7 @@ static int sk_udp_recvmsg(struct sock *sk, struct msghdr *msg, size_t len,
 static bool udp_sk_has_data(struct sock *sk)
 {
 	return !skb_queue_empty(&udp_sk(sk)->reader_queue) ||
-	       !skb_queue_empty(&sk->sk_receive_queue);
+	       !udp_rxq_empty_lockless(sk);
 }
 
 static bool psock_has_data(struct sk_psock *psock)
@@ -74,12 +74,19 @@ struct conntrack_gc_work {
 };
 
 static __read_mostly struct kmem_cache *nf_conntrack_cachep;
-static DEFINE_SPINLOCK(nf_conntrack_locks_all_lock);
-static __read_mostly bool nf_conntrack_locks_all;
 
 /* serialize hash resizes and nf_ct_iterate_cleanup */
 static DEFINE_MUTEX(nf_conntrack_mutex);
 
+/* Table being populated by nf_conntrack_hash_resize() and the lock stripes
+ * whose entries were already moved there.  Lock stripes cover a contiguous
+ * range of buckets in any table, so moving one stripe only requires its
+ * own lock.
+ */
+static struct hlist_nulls_head *nf_conntrack_hash_next;
+static unsigned int nf_conntrack_htable_size_next;
+static DECLARE_BITMAP(nf_conntrack_locks_moved, CONNTRACK_LOCKS);
+
 #define GC_SCAN_INTERVAL_MAX	(60ul * HZ)
 #define GC_SCAN_INTERVAL_MIN	(1ul * HZ)
 
@@ -103,44 +110,31 @@ static struct conntrack_gc_work conntrack_gc_work;
 
 void nf_conntrack_lock(spinlock_t *lock) __acquires(lock)
 {
-	/* 1) Acquire the lock */
-	spin_lock(lock);
-
-	/* 2) read nf_conntrack_locks_all, with ACQUIRE semantics
-	 * It pairs with the smp_store_release() in nf_conntrack_all_unlock()
-	 */
-	if (likely(smp_load_acquire(&nf_conntrack_locks_all) == false))
-		return;
-
-	/* fast path failed, unlock */
-	spin_unlock(lock);
-
-	/* Slow path 1) get global lock */
-	spin_lock(&nf_conntrack_locks_all_lock);
-
-	/* Slow path 2) get the lock we want */
 	spin_lock(lock);
-
-	/* Slow path 3) release the global lock */
-	spin_unlock(&nf_conntrack_locks_all_lock);
 }
 EXPORT_SYMBOL_GPL(nf_conntrack_lock);
 
-static void nf_conntrack_double_unlock(unsigned int h1, unsigned int h2)
+/* The lock stripe only depends on the unscaled hash, so it does not
+ * change when the table is resized.
+ */
+static unsigned int nf_conntrack_lock_idx(u32 hash)
+{
+	return reciprocal_scale(hash, CONNTRACK_LOCKS);
+}
+
+static void nf_conntrack_double_unlock(u32 h1, u32 h2)
 {
-	h1 %= CONNTRACK_LOCKS;
-	h2 %= CONNTRACK_LOCKS;
+	h1 = nf_conntrack_lock_idx(h1);
+	h2 = nf_conntrack_lock_idx(h2);
 	spin_unlock(&nf_conntrack_locks[h1]);
 	if (h1 != h2)
 		spin_unlock(&nf_conntrack_locks[h2]);
 }
 
-/* return true if we need to recompute hashes (in case hash table was resized) */
-static bool nf_conntrack_double_lock(struct net *net, unsigned int h1,
-				     unsigned int h2, unsigned int sequence)
+static void nf_conntrack_double_lock(u32 h1, u32 h2)
 {
-	h1 %= CONNTRACK_LOCKS;
-	h2 %= CONNTRACK_LOCKS;
+	h1 = nf_conntrack_lock_idx(h1);
+	h2 = nf_conntrack_lock_idx(h2);
 	if (h1 <= h2) {
 		nf_conntrack_lock(&nf_conntrack_locks[h1]);
 		if (h1 != h2)
@@ -151,52 +145,6 @@ static bool nf_conntrack_double_lock(struct net *net, unsigned int h1,
 		spin_lock_nested(&nf_conntrack_locks[h1],
 				 SINGLE_DEPTH_NESTING);
 	}
-	if (read_seqcount_retry(&nf_conntrack_generation, sequence)) {
-		nf_conntrack_double_unlock(h1, h2);
-		return true;
-	}
-	return false;
-}
-
-static void nf_conntrack_all_lock(void)
-	__acquires(&nf_conntrack_locks_all_lock)
-{
-	int i;
-
-	spin_lock(&nf_conntrack_locks_all_lock);
-
-	/* For nf_contrack_locks_all, only the latest time when another
-	 * CPU will see an update is controlled, by the "release" of the
-	 * spin_lock below.
-	 * The earliest time is not controlled, an thus KCSAN could detect
-	 * a race when nf_conntract_lock() reads the variable.
-	 * WRITE_ONCE() is used to ensure the compiler will not
-	 * optimize the write.
-	 */
-	WRITE_ONCE(nf_conntrack_locks_all, true);
-
-	for (i = 0; i < CONNTRACK_LOCKS; i++) {
-		spin_lock(&nf_conntrack_locks[i]);
-
-		/* This spin_unlock provides the "release" to ensure that
-		 * nf_conntrack_locks_all==true is visible to everyone that
-		 * acquired spin_lock(&nf_conntrack_locks[]).
-		 */
-		spin_unlock(&nf_conntrack_locks[i]);
-	}
-}
-
-static void nf_conntrack_all_unlock(void)
-	__releases(&nf_conntrack_locks_all_lock)
-{
-	/* All prior stores must be complete before we clear
-	 * 'nf_conntrack_locks_all'. Otherwise nf_conntrack_lock()
-	 * might observe the false value but not the entire
-	 * critical section.
-	 * It pairs with the smp_load_acquire() in nf_conntrack_lock()
-	 */
-	smp_store_release(&nf_conntrack_locks_all, false);
-	spin_unlock(&nf_conntrack_locks_all_lock);
 }
 
 unsigned int nf_conntrack_htable_size __read_mostly;
@@ -205,6 +153,13 @@ EXPORT_SYMBOL_GPL(nf_conntrack_htable_size);
 unsigned int nf_conntrack_max __read_mostly;
 EXPORT_SYMBOL_GPL(nf_conntrack_max);
 seqcount_spinlock_t nf_conntrack_generation __read_mostly;
+static DEFINE_SPINLOCK(nf_conntrack_generation_lock);
+
+/* Largest table size that stays a multiple of CONNTRACK_LOCKS and that
+ * nf_ct_alloc_hashtable() accepts, so that rounding it up can't wrap.
+ */
+#define NF_CT_HTABLE_SIZE_MAX \
+	rounddown(UINT_MAX / sizeof(struct hlist_nulls_head), CONNTRACK_LOCKS)
 static siphash_aligned_key_t nf_conntrack_hash_rnd;
 
 static u32 hash_conntrack_raw(const struct nf_conntrack_tuple *tuple,
@@ -244,11 +199,21 @@ static u32 __hash_conntrack(const struct net *net,
 	return reciprocal_scale(hash_conntrack_raw(tuple, zoneid, net), size);
 }
 
-static u32 hash_conntrack(const struct net *net,
-			  const struct nf_conntrack_tuple *tuple,
-			  unsigned int zoneid)
+/* Return the chain for unscaled @hash.  Caller must hold the lock stripe
+ * of @hash, which keeps the stripe from being moved to the next table.
+ */
+static struct hlist_nulls_head *nf_conntrack_hash_head(u32 hash)
 {
-	return scale_hash(hash_conntrack_raw(tuple, zoneid, net));
+	struct hlist_nulls_head *next;
+
+	/* pairs with smp_store_release() in nf_conntrack_hash_resize() */
+	next = smp_load_acquire(&nf_conntrack_hash_next);
+	if (next && test_bit(nf_conntrack_lock_idx(hash),
+			     nf_conntrack_locks_moved))
+		return &next[reciprocal_scale(hash,
+					      nf_conntrack_htable_size_next)];
+
+	return &nf_conntrack_hash[scale_hash(hash)];
 }
 
 static bool nf_ct_get_tuple_ports(const struct sk_buff *skb,
@@ -608,18 +573,15 @@ EXPORT_SYMBOL(nf_ct_destroy);
 static void __nf_ct_delete_from_lists(struct nf_conn *ct)
 {
 	struct net *net = nf_ct_net(ct);
-	unsigned int hash, reply_hash;
-	unsigned int sequence;
+	u32 hash, reply_hash;
 
-	do {
-		sequence = read_seqcount_begin(&nf_conntrack_generation);
-		hash = hash_conntrack(net,
-				      &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple,
-				      nf_ct_zone_id(nf_ct_zone(ct), IP_CT_DIR_ORIGINAL));
-		reply_hash = hash_conntrack(net,
-					   &ct->tuplehash[IP_CT_DIR_REPLY].tuple,
-					   nf_ct_zone_id(nf_ct_zone(ct), IP_CT_DIR_REPLY));
-	} while (nf_conntrack_double_lock(net, hash, reply_hash, sequence));
+	hash = hash_conntrack_raw(&ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple,
+				  nf_ct_zone_id(nf_ct_zone(ct), IP_CT_DIR_ORIGINAL),
+				  net);
+	reply_hash = hash_conntrack_raw(&ct->tuplehash[IP_CT_DIR_REPLY].tuple,
+					nf_ct_zone_id(nf_ct_zone(ct), IP_CT_DIR_REPLY),
+					net);
+	nf_conntrack_double_lock(hash, reply_hash);
 
 	clean_from_lists(ct);
 	nf_conntrack_double_unlock(hash, reply_hash);
@@ -741,13 +703,14 @@ static struct nf_conntrack_tuple_hash *
 ____nf_conntrack_find(struct net *net, const struct nf_conntrack_zone *zone,
 		      const struct nf_conntrack_tuple *tuple, u32 hash)
 {
+	struct hlist_nulls_head *ct_hash, *next;
 	struct nf_conntrack_tuple_hash *h;
-	struct hlist_nulls_head *ct_hash;
 	struct hlist_nulls_node *n;
 	unsigned int bucket, hsize;
 
 begin:
 	nf_conntrack_get_ht(&ct_hash, &hsize);
+lookup:
 	bucket = reciprocal_scale(hash, hsize);
 
 	hlist_nulls_for_each_entry_rcu(h, n, &ct_hash[bucket], hnnode) {
@@ -772,6 +735,16 @@ ____nf_conntrack_find(struct net *net, const struct nf_conntrack_zone *zone,
 		goto begin;
 	}
 
+	/* A resize in progress may have moved the entry to the next table
+	 * already.  Once the tables are swapped both pointers are equal.
+	 */
+	next = smp_load_acquire(&nf_conntrack_hash_next);
+	if (next && next != ct_hash) {
+		ct_hash = next;
+		hsize = READ_ONCE(nf_conntrack_htable_size_next);
+		goto lookup;
+	}
+
 	return NULL;
 }
 
@@ -833,13 +806,12 @@ nf_conntrack_find_get(struct net *net, const struct nf_conntrack_zone *zone,
 EXPORT_SYMBOL_GPL(nf_conntrack_find_get);
 
 static void __nf_conntrack_hash_insert(struct nf_conn *ct,
-				       unsigned int hash,
-				       unsigned int reply_hash)
+				       u32 hash, u32 reply_hash)
 {
 	hlist_nulls_add_head_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode,
-			   &nf_conntrack_hash[hash]);
+				 nf_conntrack_hash_head(hash));
 	hlist_nulls_add_head_rcu(&ct->tuplehash[IP_CT_DIR_REPLY].hnnode,
-			   &nf_conntrack_hash[reply_hash]);
+				 nf_conntrack_hash_head(reply_hash));
 }
 
 static bool nf_ct_ext_valid_pre(const struct nf_ct_ext *ext)
@@ -874,12 +846,11 @@ nf_conntrack_hash_check_insert(struct nf_conn *ct)
 {
 	const struct nf_conntrack_zone *zone;
 	struct net *net = nf_ct_net(ct);
-	unsigned int hash, reply_hash;
 	struct nf_conntrack_tuple_hash *h;
 	struct hlist_nulls_node *n;
 	unsigned int max_chainlen;
 	unsigned int chainlen = 0;
-	unsigned int sequence;
+	u32 hash, reply_hash;
 	int err = -EEXIST;
 
 	zone = nf_ct_zone(ct);
@@ -887,21 +858,18 @@ nf_conntrack_hash_check_insert(struct nf_conn *ct)
 	if (!nf_ct_ext_valid_pre(ct->ext))
 		return -EAGAIN;
 
+	hash = hash_conntrack_raw(&ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple,
+				  nf_ct_zone_id(zone, IP_CT_DIR_ORIGINAL), net);
+	reply_hash = hash_conntrack_raw(&ct->tuplehash[IP_CT_DIR_REPLY].tuple,
+					nf_ct_zone_id(zone, IP_CT_DIR_REPLY), net);
+
 	local_bh_disable();
-	do {
-		sequence = read_seqcount_begin(&nf_conntrack_generation);
-		hash = hash_conntrack(net,
-				      &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple,
-				      nf_ct_zone_id(nf_ct_zone(ct), IP_CT_DIR_ORIGINAL));
-		reply_hash = hash_conntrack(net,
-					   &ct->tuplehash[IP_CT_DIR_REPLY].tuple,
-					   nf_ct_zone_id(nf_ct_zone(ct), IP_CT_DIR_REPLY));
-	} while (nf_conntrack_double_lock(net, hash, reply_hash, sequence));
+	nf_conntrack_double_lock(hash, reply_hash);
 
 	max_chainlen = MIN_CHAINLEN + get_random_u32_below(MAX_CHAINLEN);
 
 	/* See if there's one in the list already, including reverse */
-	hlist_nulls_for_each_entry(h, n, &nf_conntrack_hash[hash], hnnode) {
+	hlist_nulls_for_each_entry(h, n, nf_conntrack_hash_head(hash), hnnode) {
 		if (nf_ct_key_equal(h, &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple,
 				    zone, net))
 			goto out;
@@ -912,7 +880,7 @@ nf_conntrack_hash_check_insert(struct nf_conn *ct)
 
 	chainlen = 0;
 
-	hlist_nulls_for_each_entry(h, n, &nf_conntrack_hash[reply_hash], hnnode) {
+	hlist_nulls_for_each_entry(h, n, nf_conntrack_hash_head(reply_hash), hnnode) {
 		if (nf_ct_key_equal(h, &ct->tuplehash[IP_CT_DIR_REPLY].tuple,
 				    zone, net))
 			goto out;
@@ -1029,7 +997,7 @@ static int __nf_ct_resolve_clash(struct sk_buff *skb,
  * nf_ct_resolve_clash_harder - attempt to insert clashing conntrack entry
  *
  * @skb: skb that causes the collision
- * @repl_idx: hash slot for reply direction
+ * @reply_hash: unscaled hash of the reply direction
  *
  * Called when origin or reply direction had a clash.
  * The skb can be handled without packet drop provided the reply direction
@@ -1040,7 +1008,7 @@ static int __nf_ct_resolve_clash(struct sk_buff *skb,
  *
  * Returns NF_DROP if the clash could not be handled.
  */
-static int nf_ct_resolve_clash_harder(struct sk_buff *skb, u32 repl_idx)
+static int nf_ct_resolve_clash_harder(struct sk_buff *skb, u32 reply_hash)
 {
 	struct nf_conn *loser_ct = (struct nf_conn *)skb_nfct(skb);
 	const struct nf_conntrack_zone *zone;
@@ -1054,7 +1022,7 @@ static int nf_ct_resolve_clash_harder(struct sk_buff *skb, u32 repl_idx)
 	/* Reply direction must never result in a clash, unless both origin
 	 * and reply tuples are identical.
 	 */
-	hlist_nulls_for_each_entry(h, n, &nf_conntrack_hash[repl_idx], hnnode) {
+	hlist_nulls_for_each_entry(h, n, nf_conntrack_hash_head(reply_hash), hnnode) {
 		if (nf_ct_key_equal(h,
 				    &loser_ct->tuplehash[IP_CT_DIR_REPLY].tuple,
 				    zone, net))
@@ -1080,7 +1048,7 @@ static int nf_ct_resolve_clash_harder(struct sk_buff *skb, u32 repl_idx)
 	hlist_nulls_add_fake(&loser_ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
 
 	hlist_nulls_add_head_rcu(&loser_ct->tuplehash[IP_CT_DIR_REPLY].hnnode,
-				 &nf_conntrack_hash[repl_idx]);
+				 nf_conntrack_hash_head(reply_hash));
 
 	NF_CT_STAT_INC(net, clash_resolve);
 	return NF_ACCEPT;
@@ -1091,7 +1059,7 @@ static int nf_ct_resolve_clash_harder(struct sk_buff *skb, u32 repl_idx)
  *
  * @skb: skb that causes the clash
  * @h: tuplehash of the clashing entry already in table
- * @reply_hash: hash slot for reply direction
+ * @reply_hash: unscaled hash of the reply direction
  *
  * A conntrack entry can be inserted to the connection tracking table
  * if there is no existing entry with an identical tuple.
@@ -1156,9 +1124,9 @@ nf_ct_resolve_clash(struct sk_buff *skb, struct nf_conntrack_tuple_hash *h,
 int
 __nf_conntrack_confirm(struct sk_buff *skb)
 {
-	unsigned int chainlen = 0, sequence, max_chainlen;
+	unsigned int chainlen = 0, max_chainlen;
 	const struct nf_conntrack_zone *zone;
-	unsigned int hash, reply_hash;
+	u32 hash, reply_hash;
 	struct nf_conntrack_tuple_hash *h;
 	struct nf_conn *ct;
 	struct nf_conn_help *help;
@@ -1178,17 +1146,14 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 		return NF_ACCEPT;
 
 	zone = nf_ct_zone(ct);
-	local_bh_disable();
 
-	do {
-		sequence = read_seqcount_begin(&nf_conntrack_generation);
-		/* reuse the hash saved before */
-		hash = *(unsigned long *)&ct->tuplehash[IP_CT_DIR_REPLY].hnnode.pprev;
-		hash = scale_hash(hash);
-		reply_hash = hash_conntrack(net,
-					   &ct->tuplehash[IP_CT_DIR_REPLY].tuple,
-					   nf_ct_zone_id(nf_ct_zone(ct), IP_CT_DIR_REPLY));
-	} while (nf_conntrack_double_lock(net, hash, reply_hash, sequence));
+	/* reuse the hash saved before */
+	hash = *(unsigned long *)&ct->tuplehash[IP_CT_DIR_REPLY].hnnode.pprev;
+	reply_hash = hash_conntrack_raw(&ct->tuplehash[IP_CT_DIR_REPLY].tuple,
+					nf_ct_zone_id(zone, IP_CT_DIR_REPLY), net);
+
+	local_bh_disable();
+	nf_conntrack_double_lock(hash, reply_hash);
 
 	/* We're not in hash table, and we refuse to set up related
 	 * connections for unconfirmed conns.  But packet copies and
@@ -1228,7 +1193,7 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 	/* See if there's one in the list already, including reverse:
 	   NAT could have grabbed it without realizing, since we're
 	   not in the hash.  If there is, we lost race. */
-	hlist_nulls_for_each_entry(h, n, &nf_conntrack_hash[hash], hnnode) {
+	hlist_nulls_for_each_entry(h, n, nf_conntrack_hash_head(hash), hnnode) {
 		if (nf_ct_key_equal(h, &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple,
 				    zone, net))
 			goto out;
@@ -1237,7 +1202,7 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 	}
 
 	chainlen = 0;
-	hlist_nulls_for_each_entry(h, n, &nf_conntrack_hash[reply_hash], hnnode) {
+	hlist_nulls_for_each_entry(h, n, nf_conntrack_hash_head(reply_hash), hnnode) {
 		if (nf_ct_key_equal(h, &ct->tuplehash[IP_CT_DIR_REPLY].tuple,
 				    zone, net))
 			goto out;
@@ -2371,7 +2336,7 @@ get_next_corpse(int (*iter)(struct nf_conn *i, void *data),
 		if (hlist_nulls_empty(hslot))
 			continue;
 
-		lockp = &nf_conntrack_locks[*bucket % CONNTRACK_LOCKS];
+		lockp = nf_conntrack_bucket_lock(*bucket, nf_conntrack_htable_size);
 		local_bh_disable();
 		nf_conntrack_lock(lockp);
 		hlist_nulls_for_each_entry(h, n, hslot, hnnode) {
@@ -2592,15 +2557,15 @@ EXPORT_SYMBOL_GPL(nf_ct_alloc_hashtable);
 
 int nf_conntrack_hash_resize(unsigned int hashsize)
 {
-	int i, bucket;
-	unsigned int old_size;
+	unsigned int i, bucket, old_size, per_lock;
 	struct hlist_nulls_head *hash, *old_hash;
 	struct nf_conntrack_tuple_hash *h;
 	struct nf_conn *ct;
 
-	if (!hashsize)
+	if (!hashsize || hashsize > NF_CT_HTABLE_SIZE_MAX)
 		return -EINVAL;
 
+	hashsize = roundup(hashsize, CONNTRACK_LOCKS);
 	hash = nf_ct_alloc_hashtable(&hashsize, 1);
 	if (!hash)
 		return -ENOMEM;
@@ -2613,43 +2578,65 @@ int nf_conntrack_hash_resize(unsigned int hashsize)
 		return 0;
 	}
 
-	local_bh_disable();
-	nf_conntrack_all_lock();
-	write_seqcount_begin(&nf_conntrack_generation);
+	bitmap_zero(nf_conntrack_locks_moved, CONNTRACK_LOCKS);
+	nf_conntrack_htable_size_next = hashsize;
+	/* pairs with smp_load_acquire() in nf_conntrack_hash_head() */
+	smp_store_release(&nf_conntrack_hash_next, hash);
 
-	/* Lookups in the old hash might happen in parallel, which means we
-	 * might get false negatives during connection lookup. New connections
-	 * created because of a false negative won't make it into the hash
-	 * though since that required taking the locks.
+	/* Move the table one lock stripe at a time.  Insertions and deletions
+	 * only wait for the stripe that is being moved, lookups search both
+	 * tables until the new one has been published.
+	 *
+	 * Lookups may still get a false negative if they race with the move
+	 * of the entry they are looking for.  New connections created because
+	 * of that won't make it into the hash, confirmation checks for clashes
+	 * under the stripe lock.
 	 */
+	per_lock = old_size / CONNTRACK_LOCKS;
+	for (i = 0; i < CONNTRACK_LOCKS; i++) {
+		local_bh_disable();
+		nf_conntrack_lock(&nf_conntrack_locks[i]);
 
-	for (i = 0; i < nf_conntrack_htable_size; i++) {
-		while (!hlist_nulls_empty(&nf_conntrack_hash[i])) {
-			unsigned int zone_id;
+		for (bucket = i * per_lock; bucket < (i + 1) * per_lock; bucket++) {
+			while (!hlist_nulls_empty(&nf_conntrack_hash[bucket])) {
+				unsigned int zone_id, new_bucket;
 
-			h = hlist_nulls_entry(nf_conntrack_hash[i].first,
-					      struct nf_conntrack_tuple_hash, hnnode);
-			ct = nf_ct_tuplehash_to_ctrack(h);
-			hlist_nulls_del_rcu(&h->hnnode);
+				h = hlist_nulls_entry(nf_conntrack_hash[bucket].first,
+						      struct nf_conntrack_tuple_hash, hnnode);
+				ct = nf_ct_tuplehash_to_ctrack(h);
+				hlist_nulls_del_rcu(&h->hnnode);
 
-			zone_id = nf_ct_zone_id(nf_ct_zone(ct), NF_CT_DIRECTION(h));
-			bucket = __hash_conntrack(nf_ct_net(ct),
-						  &h->tuple, zone_id, hashsize);
-			hlist_nulls_add_head_rcu(&h->hnnode, &hash[bucket]);
+				zone_id = nf_ct_zone_id(nf_ct_zone(ct), NF_CT_DIRECTION(h));
+				new_bucket = __hash_conntrack(nf_ct_net(ct),
+							      &h->tuple, zone_id, hashsize);
+				hlist_nulls_add_head_rcu(&h->hnnode, &hash[new_bucket]);
+			}
 		}
+
+		set_bit(i, nf_conntrack_locks_moved);
+		spin_unlock(&nf_conntrack_locks[i]);
+		local_bh_enable();
+		cond_resched();
 	}
+
+	/* All stripes now resolve to the new table, so lock holders don't
+	 * care about the switch below.
+	 */
 	old_hash = nf_conntrack_hash;
 
+	spin_lock_bh(&nf_conntrack_generation_lock);
+	write_seqcount_begin(&nf_conntrack_generation);
 	nf_conntrack_hash = hash;
 	nf_conntrack_htable_size = hashsize;
-
 	write_seqcount_end(&nf_conntrack_generation);
-	nf_conntrack_all_unlock();
-	local_bh_enable();
+	spin_unlock_bh(&nf_conntrack_generation_lock);
+
+	/* Readers that fetched the old table might still look at the next one */
+	synchronize_net();
+	smp_store_release(&nf_conntrack_hash_next, NULL);
 
 	mutex_unlock(&nf_conntrack_mutex);
 
-	synchronize_net();
 	kvfree(old_hash);
 	return 0;
 }
@@ -2681,7 +2668,7 @@ int nf_conntrack_init_start(void)
 	int i;
 
 	seqcount_spinlock_init(&nf_conntrack_generation,
-			       &nf_conntrack_locks_all_lock);
+			       &nf_conntrack_generation_lock);
 
 	for (i = 0; i < CONNTRACK_LOCKS; i++)
 		spin_lock_init(&nf_conntrack_locks[i]);
@@ -2707,6 +2694,11 @@ int nf_conntrack_init_start(void)
 		max_factor = 1;
 	}
 
+	/* each lock stripe covers the same number of buckets */
+	nf_conntrack_htable_size = min_t(unsigned int, nf_conntrack_htable_size,
+					 NF_CT_HTABLE_SIZE_MAX);
+	nf_conntrack_htable_size = roundup(nf_conntrack_htable_size,
+					   CONNTRACK_LOCKS);
 	nf_conntrack_hash = nf_ct_alloc_hashtable(&nf_conntrack_htable_size, 1);
 	if (!nf_conntrack_hash)
 		return -ENOMEM;
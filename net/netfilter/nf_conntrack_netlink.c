@@ -1194,7 +1194,9 @@ ctnetlink_dump_table(struct sk_buff *skb, struct netlink_callback *cb)
 	i = 0;
 
 	local_bh_disable();
-	for (; cb->args[0] < nf_conntrack_htable_size; cb->args[0]++) {
+	for (;; cb->args[0]++) {
+		struct hlist_nulls_head *ct_hash;
+		unsigned int hsize;
 restart:
 		while (i) {
 			i--;
@@ -1203,13 +1205,13 @@ ctnetlink_dump_table(struct sk_buff *skb, struct netlink_callback *cb)
 			nf_ct_put(nf_ct_evict[i]);
 		}
 
-		lockp = &nf_conntrack_locks[cb->args[0] % CONNTRACK_LOCKS];
-		nf_conntrack_lock(lockp);
-		if (cb->args[0] >= nf_conntrack_htable_size) {
-			spin_unlock(lockp);
+		nf_conntrack_get_ht(&ct_hash, &hsize);
+		if (cb->args[0] >= hsize)
 			goto out;
-		}
-		hlist_nulls_for_each_entry(h, n, &nf_conntrack_hash[cb->args[0]],
+
+		lockp = nf_conntrack_bucket_lock(cb->args[0], hsize);
+		nf_conntrack_lock(lockp);
+		hlist_nulls_for_each_entry(h, n, &ct_hash[cb->args[0]],
 					   hnnode) {
 			ct = nf_ct_tuplehash_to_ctrack(h);
 			if (nf_ct_is_expired(ct)) {
@@ -1139,6 +1139,18 @@ static int tls_get_info(const struct sock *sk, struct sk_buff *skb)
 		if (err)
 			goto nla_failure;
 	}
+	if (ctx->rx_conf == TLS_SW || ctx->rx_conf == TLS_HW) {
+		err = nla_put_u64_64bit(skb, TLS_INFO_RX_ZC_RECORDS,
+					READ_ONCE(ctx->rx_zc_records),
+					TLS_INFO_UNSPEC);
+		if (err)
+			goto nla_failure;
+		err = nla_put_u64_64bit(skb, TLS_INFO_RX_COPY_RECORDS,
+					READ_ONCE(ctx->rx_copy_records),
+					TLS_INFO_UNSPEC);
+		if (err)
+			goto nla_failure;
+	}
 
 	rcu_read_unlock();
 	nla_nest_end(skb, start);
@@ -1161,6 +1173,8 @@ static size_t tls_get_info_size(const struct sock *sk)
 		nla_total_size(sizeof(u16)) +	/* TLS_INFO_TXCONF */
 		nla_total_size(0) +		/* TLS_INFO_ZC_RO_TX */
 		nla_total_size(0) +		/* TLS_INFO_RX_NO_PAD */
+		nla_total_size_64bit(sizeof(u64)) + /* TLS_INFO_RX_ZC_RECORDS */
+		nla_total_size_64bit(sizeof(u64)) + /* TLS_INFO_RX_COPY_RECORDS */
 		0;
 
 	return size;
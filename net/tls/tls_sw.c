@@ -1728,6 +1728,15 @@ static int tls_rx_one_record(struct sock *sk, struct msghdr *msg,
 	rxm->full_len -= prot->overhead_size;
 	tls_advance_record_sn(sk, prot, &tls_ctx->rx);
 
+	if (darg->zc) {
+		TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXZEROCOPY);
+		WRITE_ONCE(tls_ctx->rx_zc_records, tls_ctx->rx_zc_records + 1);
+	} else {
+		TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXCOPY);
+		WRITE_ONCE(tls_ctx->rx_copy_records,
+			   tls_ctx->rx_copy_records + 1);
+	}
+
 	return 0;
 }
 
@@ -92,7 +92,7 @@
 #endif
 
 #if defined(SORTTABLE_64) && defined(UNWINDER_ORC_ENABLED)
-/* ORC unwinder only support X86_64 */
+/* ORC unwinder only support X86_64 and LoongArch */
 #include <asm/orc_types.h>
 
 #define ERRSTR_MAXSZ	256
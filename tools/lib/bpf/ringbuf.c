@@ -28,6 +28,11 @@ struct ring {
 	void *data;
 	unsigned long *consumer_pos;
 	unsigned long *producer_pos;
+	/* only set for BPF_F_RB_OVERWRITE rings */
+	unsigned long *overwrite_pos;
+	/* samples of overwrite rings are copied here before use */
+	void *sample_buf;
+	size_t sample_buf_sz;
 	unsigned long mask;
 	int map_fd;
 };
@@ -67,6 +72,9 @@ static void ringbuf_unmap_ring(struct ring_buffer *rb, struct ring *r)
 		munmap(r->producer_pos, rb->page_size + 2 * (r->mask + 1));
 		r->producer_pos = NULL;
 	}
+	free(r->sample_buf);
+	r->sample_buf = NULL;
+	r->sample_buf_sz = 0;
 }
 
 /* Add extra RINGBUF maps to this ring buffer manager */
@@ -144,6 +152,9 @@ int ring_buffer__add(struct ring_buffer *rb, int map_fd,
 	}
 	r->producer_pos = tmp;
 	r->data = tmp + rb->page_size;
+	/* overwrite position directly follows the producer position */
+	if (info.map_flags & BPF_F_RB_OVERWRITE)
+		r->overwrite_pos = r->producer_pos + 1;
 
 	e = &rb->events[rb->ring_cnt];
 	memset(e, 0, sizeof(*e));
@@ -224,6 +235,44 @@ static inline int roundup_len(__u32 len)
 	return (len + 7) / 8 * 8;
 }
 
+/* Producers of an overwrite ring can overwrite the record at cons_pos while
+ * we read it, so its header and sample are only trusted if overwrite_pos
+ * didn't move past it in the meantime, the same way a seqcount reader
+ * retries. The sample is copied out first, as the callback may look at it
+ * at any time. Returns 1 with *sample pointing to the copy, 0 if the record
+ * was overwritten, or a negative error.
+ */
+static int ringbuf_copy_sample(struct ring *r, unsigned long cons_pos,
+			       int len, void **sample)
+{
+	unsigned long over_pos;
+	/* a garbled header can claim any length, never read past the ring */
+	bool valid = roundup_len(len) <= r->mask + 1;
+	size_t sz = len & ~(BPF_RINGBUF_BUSY_BIT | BPF_RINGBUF_DISCARD_BIT);
+	void *tmp;
+
+	if (valid && !(len & BPF_RINGBUF_DISCARD_BIT)) {
+		if (sz > r->sample_buf_sz) {
+			tmp = realloc(r->sample_buf, sz);
+			if (!tmp)
+				return -ENOMEM;
+			r->sample_buf = tmp;
+			r->sample_buf_sz = sz;
+		}
+		memcpy(r->sample_buf, *sample, sz);
+		*sample = r->sample_buf;
+	}
+
+	/* pairs with smp_wmb() in the kernel's bpf_ringbuf_overwrite() */
+	smp_rmb();
+	over_pos = smp_load_acquire(r->overwrite_pos);
+	if ((long)(over_pos - cons_pos) > 0)
+		return 0;
+
+	/* the record is still there, so its header can't be garbled */
+	return valid ? 1 : -EINVAL;
+}
+
 static int64_t ringbuf_process_ring(struct ring *r)
 {
 	int *len_ptr, len, err;
@@ -238,6 +287,18 @@ static int64_t ringbuf_process_ring(struct ring *r)
 		got_new_data = false;
 		prod_pos = smp_load_acquire(r->producer_pos);
 		while (cons_pos < prod_pos) {
+			/* skip records that producers have already overwritten */
+			if (r->overwrite_pos) {
+				unsigned long over_pos;
+
+				over_pos = smp_load_acquire(r->overwrite_pos);
+				if ((long)(over_pos - cons_pos) > 0) {
+					cons_pos = over_pos;
+					if (cons_pos >= prod_pos)
+						break;
+				}
+			}
+
 			len_ptr = r->data + (cons_pos & r->mask);
 			len = smp_load_acquire(len_ptr);
 
@@ -245,11 +306,20 @@ static int64_t ringbuf_process_ring(struct ring *r)
 			if (len & BPF_RINGBUF_BUSY_BIT)
 				goto done;
 
+			sample = (void *)len_ptr + BPF_RINGBUF_HDR_SZ;
+			if (r->overwrite_pos) {
+				err = ringbuf_copy_sample(r, cons_pos, len, &sample);
+				if (err < 0)
+					return err;
+				/* overwritten, resume from overwrite_pos */
+				if (!err)
+					continue;
+			}
+
 			got_new_data = true;
 			cons_pos += roundup_len(len);
 
 			if ((len & BPF_RINGBUF_DISCARD_BIT) == 0) {
-				sample = (void *)len_ptr + BPF_RINGBUF_HDR_SZ;
 				err = r->sample_cb(r->ctx, sample, len);
 				if (err < 0) {
 					/* update consumer pos and bail out */
@@ -21,6 +21,7 @@
 #include <linux/zalloc.h>
 #include <sys/time.h>
 #include <sys/mman.h>
+#include <sys/prctl.h>
 #include <perf/cpumap.h>
 
 #include "../util/mutex.h"
@@ -31,6 +32,12 @@
 
 #include <err.h>
 
+#ifndef PR_FUTEX_HASH
+#define PR_FUTEX_HASH			78
+# define PR_FUTEX_HASH_SET_SLOTS	1
+# define PR_FUTEX_HASH_GET_SLOTS	2
+#endif
+
 static bool done = false;
 static int futex_flag = 0;
 
@@ -50,6 +57,7 @@ struct worker {
 static struct bench_futex_parameters params = {
 	.nfutexes = 1024,
 	.runtime  = 10,
+	.nbuckets = -1,
 };
 
 static const struct option options[] = {
@@ -59,6 +67,7 @@ static const struct option options[] = {
 	OPT_BOOLEAN( 's', "silent",  &params.silent, "Silent mode: do not display data/details"),
 	OPT_BOOLEAN( 'S', "shared",  &params.fshared, "Use shared futexes instead of private ones"),
 	OPT_BOOLEAN( 'm', "mlockall", &params.mlockall, "Lock all current and future memory"),
+	OPT_INTEGER( 'b', "buckets", &params.nbuckets, "Use a private futex hash with this many buckets (0: kernel default)"),
 	OPT_END()
 };
 
@@ -162,9 +171,21 @@ int bench_futex_hash(int argc, const char **argv)
 	if (!params.fshared)
 		futex_flag = FUTEX_PRIVATE_FLAG;
 
-	printf("Run summary [PID %d]: %d threads, each operating on %d [%s] futexes for %d secs.\n\n",
+	/* must happen before any worker thread is created */
+	if (params.nbuckets >= 0 &&
+	    prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_SET_SLOTS, params.nbuckets, 0, 0))
+		err(EXIT_FAILURE, "prctl(PR_FUTEX_HASH)");
+
+	printf("Run summary [PID %d]: %d threads, each operating on %d [%s] futexes for %d secs.\n",
 	       getpid(), params.nthreads, params.nfutexes, params.fshared ? "shared":"private", params.runtime);
 
+	ret = prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_GET_SLOTS, 0, 0, 0);
+	if (ret > 0)
+		printf("Private futex hash: %d buckets\n\n", ret);
+	else
+		printf("Futex hash: global\n\n");
+	ret = 0;
+
 	init_stats(&throughput_stats);
 	mutex_init(&thread_lock);
 	cond_init(&thread_parent);
@@ -25,6 +25,7 @@ struct bench_futex_parameters {
 	unsigned int nfutexes;
 	unsigned int nwakes;
 	unsigned int nrequeue;
+	int nbuckets; /* private futex hash slots, -1: global hash */
 };
 
 /**
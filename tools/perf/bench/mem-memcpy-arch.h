@@ -11,3 +11,14 @@
 
 #endif
 
+#ifdef HAVE_ARCH_LOONGARCH64_SUPPORT
+
+#define MEMCPY_FN(fn, name, desc)		\
+	void *fn(void *, const void *, size_t);
+
+#include "mem-memcpy-loongarch-asm-def.h"
+
+#undef MEMCPY_FN
+
+#endif
+
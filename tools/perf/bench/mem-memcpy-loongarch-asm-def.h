@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+MEMCPY_FN(__memcpy_generic,
+	"loongarch-generic",
+	"byte-by-byte memcpy() in arch/loongarch/lib/memcpy.S")
+
+MEMCPY_FN(__memcpy_fast,
+	"loongarch-fast",
+	"unaligned-access memcpy() in arch/loongarch/lib/memcpy.S")
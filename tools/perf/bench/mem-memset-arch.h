@@ -11,3 +11,14 @@
 
 #endif
 
+#ifdef HAVE_ARCH_LOONGARCH64_SUPPORT
+
+#define MEMSET_FN(fn, name, desc)		\
+	void *fn(void *, int, size_t);
+
+#include "mem-memset-loongarch-asm-def.h"
+
+#undef MEMSET_FN
+
+#endif
+
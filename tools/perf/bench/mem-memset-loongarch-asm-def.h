@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+MEMSET_FN(__memset_generic,
+	"loongarch-generic",
+	"byte-by-byte memset() in arch/loongarch/lib/memset.S")
+
+MEMSET_FN(__memset_fast,
+	"loongarch-fast",
+	"unaligned-access memset() in arch/loongarch/lib/memset.S")
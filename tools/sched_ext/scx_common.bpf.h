@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Definitions shared by the example BPF schedulers, see
+ * include/linux/sched/ext.h for the kernel side.
+ */
+#ifndef __SCX_COMMON_BPF_H
+#define __SCX_COMMON_BPF_H
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+/*
+ * Only enums used by a type end up in the kernel BTF, spell out the
+ * constants the examples need.
+ */
+#define SCX_DSQ_GLOBAL		((1ULL << 63) | 1)
+#define SCX_DSQ_LOCAL		((1ULL << 63) | 2)
+#define SCX_SLICE_DFL		(20ULL * 1000 * 1000)	/* 20ms */
+#define SCX_ENQ_WAKEUP		(1ULL << 0)
+#define SCX_ENQ_PREEMPT		(1ULL << 32)
+#define SCX_OPS_SWITCH_PARTIAL	(1ULL << 0)
+
+#define BPF_STRUCT_OPS(name, args...)					\
+	SEC("struct_ops/"#name) BPF_PROG(name, ##args)
+
+s32 scx_bpf_create_dsq(u64 dsq_id, s32 node) __ksym;
+void scx_bpf_destroy_dsq(u64 dsq_id) __ksym;
+void scx_bpf_dispatch(struct task_struct *p, u64 dsq_id, u64 slice,
+		      u64 enq_flags) __ksym;
+bool scx_bpf_consume(u64 dsq_id) __ksym;
+s32 scx_bpf_dsq_nr_queued(u64 dsq_id) __ksym;
+void scx_bpf_kick_cpu(s32 cpu, u64 flags) __ksym;
+s32 scx_bpf_select_cpu_dfl(struct task_struct *p, s32 prev_cpu,
+			   u64 wake_flags) __ksym;
+void scx_bpf_error_bstr(char *fmt, unsigned long long *data,
+			u32 data__sz) __ksym;
+s32 scx_bpf_task_cpu(const struct task_struct *p) __ksym;
+u32 scx_bpf_nr_cpu_ids(void) __ksym;
+
+/*
+ * scx_bpf_error() wraps the scx_bpf_error_bstr() kfunc with variadic
+ * arguments instead of an array of u64, like bpf_printk() does for
+ * bpf_trace_vprintk(). The BPF scheduler is disabled after the call.
+ */
+#define scx_bpf_error(fmt, args...)					\
+({									\
+	static char ___fmt[] = fmt;					\
+	unsigned long long ___param[___bpf_narg(args)];			\
+									\
+	_Pragma("GCC diagnostic push")					\
+	_Pragma("GCC diagnostic ignored \"-Wint-conversion\"")		\
+	___bpf_fill(___param, args);					\
+	_Pragma("GCC diagnostic pop")					\
+									\
+	scx_bpf_error_bstr(___fmt, ___param, sizeof(___param));		\
+})
+
+#endif /* __SCX_COMMON_BPF_H */
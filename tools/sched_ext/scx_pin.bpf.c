@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * A scheduler which pins selected threads to dedicated CPUs.
+ *
+ * Every CPU gets its own DSQ, with the DSQ ID being the CPU number, and
+ * there's one more DSQ shared by all CPUs. Threads listed in the @pinned
+ * map (thread ID -> CPU) are dispatched to the DSQ of their CPU, everything
+ * else goes to the shared DSQ. A CPU always runs its pinned threads before
+ * consuming the shared DSQ, which is how latency-critical threads like RPC
+ * handlers can be kept on warm, mostly dedicated cores.
+ *
+ * Pinned threads don't preempt a running shared one, they wait for the end
+ * of its slice at most. Keep @shared_slice_ns short to bound that delay.
+ */
+#include "scx_common.bpf.h"
+#include "user_exit_info.h"
+
+char _license[] SEC("license") = "GPL";
+
+#define MAX_CPUS	512
+#define SHARED_DSQ	MAX_CPUS
+
+const volatile u32 nr_cpus = 1;		/* set by the loader */
+const volatile u64 shared_slice_ns = SCX_SLICE_DFL;
+
+struct user_exit_info uei;
+
+bool bpf_cpumask_test_cpu(u32 cpu, const struct cpumask *cpumask) __ksym;
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, sizeof(s32));
+	__uint(max_entries, 4096);
+} pinned SEC(".maps");
+
+/* [0] pinned enqueues, [1] shared enqueues */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, sizeof(u64));
+	__uint(max_entries, 2);
+} stats SEC(".maps");
+
+static void stat_inc(u32 idx)
+{
+	u64 *cnt_p = bpf_map_lookup_elem(&stats, &idx);
+
+	if (cnt_p)
+		(*cnt_p)++;
+}
+
+/* the CPU @p is pinned to, or -1 if it isn't or can't run there */
+static s32 pinned_cpu(struct task_struct *p)
+{
+	u32 tid = p->pid;
+	s32 *cpu;
+
+	cpu = bpf_map_lookup_elem(&pinned, &tid);
+	if (!cpu || *cpu < 0 || *cpu >= nr_cpus)
+		return -1;
+	if (!bpf_cpumask_test_cpu(*cpu, p->cpus_ptr))
+		return -1;
+	return *cpu;
+}
+
+s32 BPF_STRUCT_OPS(pin_select_cpu, struct task_struct *p, s32 prev_cpu,
+		   u64 wake_flags)
+{
+	s32 cpu = pinned_cpu(p);
+
+	if (cpu >= 0)
+		return cpu;
+
+	return scx_bpf_select_cpu_dfl(p, prev_cpu, wake_flags);
+}
+
+void BPF_STRUCT_OPS(pin_enqueue, struct task_struct *p, u64 enq_flags)
+{
+	s32 cpu = pinned_cpu(p);
+
+	if (cpu >= 0) {
+		stat_inc(0);
+		scx_bpf_dispatch(p, cpu, SCX_SLICE_DFL, enq_flags);
+		/* wake the CPU up if it's idle */
+		scx_bpf_kick_cpu(cpu, 0);
+		return;
+	}
+
+	stat_inc(1);
+	scx_bpf_dispatch(p, SHARED_DSQ, shared_slice_ns, enq_flags);
+}
+
+void BPF_STRUCT_OPS(pin_dispatch, s32 cpu, struct task_struct *prev)
+{
+	if (cpu < nr_cpus && scx_bpf_consume(cpu))
+		return;
+
+	scx_bpf_consume(SHARED_DSQ);
+}
+
+s32 BPF_STRUCT_OPS(pin_init)
+{
+	u32 i;
+	s32 ret;
+
+	for (i = 0; i < MAX_CPUS; i++) {
+		if (i >= nr_cpus)
+			break;
+		ret = scx_bpf_create_dsq(i, -1);
+		if (ret)
+			return ret;
+	}
+
+	return scx_bpf_create_dsq(SHARED_DSQ, -1);
+}
+
+void BPF_STRUCT_OPS(pin_exit, struct scx_exit_info *ei)
+{
+	uei_record(&uei, ei);
+}
+
+SEC(".struct_ops")
+struct sched_ext_ops pin_ops = {
+	.select_cpu		= (void *)pin_select_cpu,
+	.enqueue		= (void *)pin_enqueue,
+	.dispatch		= (void *)pin_dispatch,
+	.init			= (void *)pin_init,
+	.exit			= (void *)pin_exit,
+	.name			= "pin",
+};
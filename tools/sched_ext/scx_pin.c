@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Loader for scx_pin.bpf.c, see there.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <libgen.h>
+#include <bpf/bpf.h>
+#include "user_exit_info.h"
+#include "scx_pin.skel.h"
+
+#define MAX_CPUS	512	/* keep in sync with scx_pin.bpf.c */
+
+const char help_fmt[] =
+"A sched_ext scheduler pinning selected threads to dedicated CPUs.\n"
+"\n"
+"Usage: %s [-s SLICE_US] -p TID:CPU [-p TID:CPU...]\n"
+"\n"
+"  -p TID:CPU    Pin thread TID to CPU, can be repeated\n"
+"  -s SLICE_US   Slice of the unpinned threads in microseconds\n"
+"  -h            Display this help and exit\n";
+
+static volatile int exit_req;
+
+static void sigint_handler(int dummy)
+{
+	exit_req = 1;
+}
+
+static void read_stats(struct scx_pin *skel, __u64 *stats)
+{
+	int nr_cpus = libbpf_num_possible_cpus();
+	__u64 cnts[2][nr_cpus];
+	__u32 idx;
+
+	memset(stats, 0, sizeof(stats[0]) * 2);
+
+	for (idx = 0; idx < 2; idx++) {
+		int ret, cpu;
+
+		ret = bpf_map_lookup_elem(bpf_map__fd(skel->maps.stats),
+					  &idx, cnts[idx]);
+		if (ret < 0)
+			continue;
+		for (cpu = 0; cpu < nr_cpus; cpu++)
+			stats[idx] += cnts[idx][cpu];
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int nr_cpus = libbpf_num_possible_cpus();
+	__u32 tids[64];
+	__s32 cpus[64];
+	int nr_pinned = 0;
+	struct scx_pin *skel;
+	struct bpf_link *link;
+	int opt, i;
+
+	if (nr_cpus > MAX_CPUS) {
+		fprintf(stderr, "Too many CPUs (%d > %d)\n", nr_cpus, MAX_CPUS);
+		return 1;
+	}
+
+	skel = scx_pin__open();
+	if (!skel) {
+		fprintf(stderr, "Failed to open BPF skeleton\n");
+		return 1;
+	}
+	skel->rodata->nr_cpus = nr_cpus;
+
+	while ((opt = getopt(argc, argv, "p:s:h")) != -1) {
+		switch (opt) {
+		case 'p':
+			if (nr_pinned == sizeof(tids) / sizeof(tids[0]) ||
+			    sscanf(optarg, "%u:%d", &tids[nr_pinned],
+				   &cpus[nr_pinned]) != 2 ||
+			    cpus[nr_pinned] < 0 || cpus[nr_pinned] >= nr_cpus) {
+				fprintf(stderr, "Invalid pinning \"%s\"\n", optarg);
+				return 1;
+			}
+			nr_pinned++;
+			break;
+		case 's':
+			skel->rodata->shared_slice_ns = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		default:
+			fprintf(stderr, help_fmt, basename(argv[0]));
+			return opt != 'h';
+		}
+	}
+
+	if (scx_pin__load(skel)) {
+		fprintf(stderr, "Failed to load BPF skeleton\n");
+		scx_pin__destroy(skel);
+		return 1;
+	}
+
+	for (i = 0; i < nr_pinned; i++) {
+		if (bpf_map_update_elem(bpf_map__fd(skel->maps.pinned),
+					&tids[i], &cpus[i], BPF_ANY)) {
+			fprintf(stderr, "Failed to pin %u to CPU %d: %s\n",
+				tids[i], cpus[i], strerror(errno));
+			scx_pin__destroy(skel);
+			return 1;
+		}
+	}
+
+	signal(SIGINT, sigint_handler);
+	signal(SIGTERM, sigint_handler);
+
+	link = bpf_map__attach_struct_ops(skel->maps.pin_ops);
+	if (!link) {
+		fprintf(stderr, "Failed to attach struct_ops: %s\n",
+			strerror(errno));
+		scx_pin__destroy(skel);
+		return 1;
+	}
+
+	while (!exit_req && !uei_exited(&skel->bss->uei)) {
+		__u64 stats[2];
+
+		read_stats(skel, stats);
+		printf("pinned=%llu shared=%llu\n", stats[0], stats[1]);
+		fflush(stdout);
+		sleep(1);
+	}
+
+	bpf_link__destroy(link);
+	uei_print(&skel->bss->uei);
+	scx_pin__destroy(skel);
+	return 0;
+}
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * A simple global FIFO scheduler.
+ *
+ * All SCHED_NORMAL, SCHED_BATCH, SCHED_IDLE and SCHED_EXT tasks are
+ * dispatched to the global DSQ, which every CPU consumes in FIFO order.
+ * This is about the smallest useful BPF scheduler and a starting point for
+ * writing new ones.
+ */
+#include "scx_common.bpf.h"
+#include "user_exit_info.h"
+
+char _license[] SEC("license") = "GPL";
+
+struct user_exit_info uei;
+
+/* [0] enqueues on wakeup, [1] other enqueues (slice exhausted, migration) */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, sizeof(u64));
+	__uint(max_entries, 2);
+} stats SEC(".maps");
+
+static void stat_inc(u32 idx)
+{
+	u64 *cnt_p = bpf_map_lookup_elem(&stats, &idx);
+
+	if (cnt_p)
+		(*cnt_p)++;
+}
+
+void BPF_STRUCT_OPS(simple_enqueue, struct task_struct *p, u64 enq_flags)
+{
+	stat_inc(enq_flags & SCX_ENQ_WAKEUP ? 0 : 1);
+	scx_bpf_dispatch(p, SCX_DSQ_GLOBAL, SCX_SLICE_DFL, enq_flags);
+}
+
+void BPF_STRUCT_OPS(simple_exit, struct scx_exit_info *ei)
+{
+	uei_record(&uei, ei);
+}
+
+SEC(".struct_ops")
+struct sched_ext_ops simple_ops = {
+	.enqueue		= (void *)simple_enqueue,
+	.exit			= (void *)simple_exit,
+	.name			= "simple",
+};
@@ -279,6 +279,8 @@ extern struct argp bench_local_storage_rcu_tasks_trace_argp;
 extern struct argp bench_strncmp_argp;
 extern struct argp bench_hashmap_lookup_argp;
 extern struct argp bench_local_storage_create_argp;
+extern struct argp bench_rhash_map_argp;
+extern struct argp bench_lpm_trie_map_argp;
 
 static const struct argp_child bench_parsers[] = {
 	{ &bench_ringbufs_argp, 0, "Ring buffers benchmark", 0 },
@@ -290,6 +292,8 @@ static const struct argp_child bench_parsers[] = {
 		"local_storage RCU Tasks Trace slowdown benchmark", 0 },
 	{ &bench_hashmap_lookup_argp, 0, "Hashmap lookup benchmark", 0 },
 	{ &bench_local_storage_create_argp, 0, "local-storage-create benchmark", 0 },
+	{ &bench_rhash_map_argp, 0, "Fixed vs resizable hashmap benchmark", 0 },
+	{ &bench_lpm_trie_map_argp, 0, "LPM trie lookup benchmark", 0 },
 	{},
 };
 
@@ -518,6 +522,11 @@ extern const struct bench bench_local_storage_cache_hashmap_control;
 extern const struct bench bench_local_storage_tasks_trace;
 extern const struct bench bench_bpf_hashmap_lookup;
 extern const struct bench bench_local_storage_create;
+extern const struct bench bench_htab_lookup;
+extern const struct bench bench_rhtab_lookup;
+extern const struct bench bench_htab_update;
+extern const struct bench bench_rhtab_update;
+extern const struct bench bench_lpm_trie_lookup;
 
 static const struct bench *benchs[] = {
 	&bench_count_global,
@@ -559,6 +568,11 @@ static const struct bench *benchs[] = {
 	&bench_local_storage_tasks_trace,
 	&bench_bpf_hashmap_lookup,
 	&bench_local_storage_create,
+	&bench_htab_lookup,
+	&bench_rhtab_lookup,
+	&bench_htab_update,
+	&bench_rhtab_update,
+	&bench_lpm_trie_lookup,
 };
 
 static void find_benchmark(void)
@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <argp.h>
+#include <stdio.h>
+#include <arpa/inet.h>
+#include "bench.h"
+#include "bpf_util.h"
+#include "lpm_trie_bench.skel.h"
+
+/* Random /32 lookups from BPF in an IPv4 LPM trie filled with random
+ * prefixes between /8 and /32.
+ */
+
+static struct ctx {
+	struct lpm_trie_bench *skel;
+	struct bpf_link *link;
+	long hits;
+	long drops;
+} ctx;
+
+static struct {
+	__u32 nr_entries;
+} args = {
+	.nr_entries = 100000,
+};
+
+enum {
+	ARG_NR_ENTRIES = 12000,
+};
+
+static const struct argp_option opts[] = {
+	{ "nr_entries", ARG_NR_ENTRIES, "NR_ENTRIES", 0,
+	  "Number of prefixes in the trie" },
+	{},
+};
+
+static error_t parse_arg(int key, char *arg, struct argp_state *state)
+{
+	long ret;
+
+	switch (key) {
+	case ARG_NR_ENTRIES:
+		ret = strtol(arg, NULL, 10);
+		if (ret < 1 || ret > (1 << 24)) {
+			fprintf(stderr, "invalid nr_entries\n");
+			argp_usage(state);
+		}
+		args.nr_entries = ret;
+		break;
+	default:
+		return ARGP_ERR_UNKNOWN;
+	}
+
+	return 0;
+}
+
+/* exported into benchmark runner */
+const struct argp bench_lpm_trie_map_argp = {
+	.options = opts,
+	.parser = parse_arg,
+};
+
+struct trie_key {
+	__u32 prefixlen;
+	__u32 data;
+};
+
+static void validate(void)
+{
+	if (env.consumer_cnt != 0) {
+		fprintf(stderr, "benchmark doesn't support consumers!\n");
+		exit(1);
+	}
+}
+
+static void *producer(void *input)
+{
+	while (true) {
+		/* trigger the bpf program */
+		syscall(__NR_getpgid);
+	}
+
+	return NULL;
+}
+
+static void measure(struct bench_res *res)
+{
+	long total_hits = 0, total_drops = 0;
+	unsigned int nr_cpus = bpf_num_possible_cpus();
+	int i;
+
+	for (i = 0; i < nr_cpus && i < ARRAY_SIZE(ctx.skel->bss->percpu_stats); i++) {
+		total_hits += ctx.skel->bss->percpu_stats[i].hits;
+		total_drops += ctx.skel->bss->percpu_stats[i].drops;
+	}
+
+	res->hits = total_hits - ctx.hits;
+	res->drops = total_drops - ctx.drops;
+	ctx.hits = total_hits;
+	ctx.drops = total_drops;
+}
+
+static void fill_map(int fd)
+{
+	struct trie_key key;
+	__u32 i, value;
+
+	srandom(0x1b9);
+
+	for (i = 0; i < args.nr_entries; i++) {
+		key.prefixlen = 8 + random() % 25;
+		key.data = htonl(random() & ~(0xffffffffULL >> key.prefixlen));
+		value = i;
+
+		/* duplicates just overwrite the value */
+		if (bpf_map_update_elem(fd, &key, &value, BPF_ANY)) {
+			fprintf(stderr, "failed to populate map: %d\n", -errno);
+			exit(1);
+		}
+	}
+}
+
+static void setup(void)
+{
+	setup_libbpf();
+
+	ctx.skel = lpm_trie_bench__open();
+	if (!ctx.skel) {
+		fprintf(stderr, "failed to open skeleton\n");
+		exit(1);
+	}
+
+	bpf_map__set_max_entries(ctx.skel->maps.trie_map, args.nr_entries);
+
+	if (lpm_trie_bench__load(ctx.skel)) {
+		fprintf(stderr, "failed to load skeleton\n");
+		exit(1);
+	}
+
+	fill_map(bpf_map__fd(ctx.skel->maps.trie_map));
+
+	ctx.link = bpf_program__attach(ctx.skel->progs.benchmark_lookup);
+	if (!ctx.link) {
+		fprintf(stderr, "failed to attach program\n");
+		exit(1);
+	}
+}
+
+const struct bench bench_lpm_trie_lookup = {
+	.name = "lpm-trie-lookup",
+	.argp = &bench_lpm_trie_map_argp,
+	.validate = validate,
+	.setup = setup,
+	.producer_thread = producer,
+	.measure = measure,
+	.report_progress = hits_drops_report_progress,
+	.report_final = hits_drops_report_final,
+};
@@ -0,0 +1,285 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <argp.h>
+#include <limits.h>
+#include <stdio.h>
+#include "bench.h"
+#include "bpf_util.h"
+#include "rhash_map_bench.skel.h"
+
+/* BPF triggering benchmarks comparing the fixed, preallocated hash table
+ * (BPF_MAP_TYPE_HASH) with the resizable one (BPF_MAP_TYPE_RHASH).
+ */
+
+static struct ctx {
+	struct rhash_map_bench *skel;
+	struct bpf_link *link;
+	long hits;
+	long drops;
+} ctx;
+
+static struct {
+	__u32 nr_entries;
+	__u32 max_entries;
+} args = {
+	.nr_entries = 1000,
+	.max_entries = 1000000,
+};
+
+enum {
+	ARG_NR_ENTRIES = 11000,
+	ARG_MAX_ENTRIES = 11001,
+};
+
+static const struct argp_option opts[] = {
+	{ "nr_entries", ARG_NR_ENTRIES, "NR_ENTRIES", 0,
+	  "Live entries looked up, or inserted and deleted per producer" },
+	{ "max_entries", ARG_MAX_ENTRIES, "MAX_ENTRIES", 0,
+	  "max_entries of the map" },
+	{},
+};
+
+static error_t parse_arg(int key, char *arg, struct argp_state *state)
+{
+	long ret;
+
+	switch (key) {
+	case ARG_NR_ENTRIES:
+		ret = strtol(arg, NULL, 10);
+		if (ret < 1 || ret >= (1 << 24)) {
+			fprintf(stderr, "invalid nr_entries\n");
+			argp_usage(state);
+		}
+		args.nr_entries = ret;
+		break;
+	case ARG_MAX_ENTRIES:
+		ret = strtol(arg, NULL, 10);
+		if (ret < 1 || ret > UINT_MAX) {
+			fprintf(stderr, "invalid max_entries\n");
+			argp_usage(state);
+		}
+		args.max_entries = ret;
+		break;
+	default:
+		return ARGP_ERR_UNKNOWN;
+	}
+
+	return 0;
+}
+
+/* exported into benchmark runner */
+const struct argp bench_rhash_map_argp = {
+	.options = opts,
+	.parser = parse_arg,
+};
+
+static void validate(void)
+{
+	if (env.consumer_cnt != 0) {
+		fprintf(stderr, "benchmark doesn't support consumers!\n");
+		exit(1);
+	}
+}
+
+static void validate_update(void)
+{
+	validate();
+
+	if ((__u64)args.nr_entries * env.producer_cnt > args.max_entries) {
+		fprintf(stderr, "max_entries too small for %d producers\n",
+			env.producer_cnt);
+		exit(1);
+	}
+}
+
+static void *producer(void *input)
+{
+	while (true) {
+		/* trigger the bpf program */
+		syscall(__NR_getpgid);
+	}
+
+	return NULL;
+}
+
+static void *producer_update(void *input)
+{
+	int fd = bpf_program__fd(ctx.skel->progs.benchmark_update);
+	/* tc test runs need at least an Ethernet header worth of data */
+	char pkt[64] = {};
+	LIBBPF_OPTS(bpf_test_run_opts, opts,
+		.data_in = pkt,
+		.data_size_in = sizeof(pkt),
+	);
+
+	while (true) {
+		if (bpf_prog_test_run_opts(fd, &opts)) {
+			fprintf(stderr, "failed to run update program\n");
+			exit(1);
+		}
+	}
+
+	return NULL;
+}
+
+static void measure(struct bench_res *res)
+{
+	long total_hits = 0, total_drops = 0;
+	unsigned int nr_cpus = bpf_num_possible_cpus();
+	int i;
+
+	for (i = 0; i < nr_cpus && i < ARRAY_SIZE(ctx.skel->bss->percpu_stats); i++) {
+		total_hits += ctx.skel->bss->percpu_stats[i].hits;
+		total_drops += ctx.skel->bss->percpu_stats[i].drops;
+	}
+
+	res->hits = total_hits - ctx.hits;
+	res->drops = total_drops - ctx.drops;
+	ctx.hits = total_hits;
+	ctx.drops = total_drops;
+}
+
+static void setup(enum bpf_map_type type, bool lookup)
+{
+	struct bpf_map *map;
+	__u64 value = 0;
+	__u32 key;
+	int fd;
+
+	setup_libbpf();
+
+	ctx.skel = rhash_map_bench__open();
+	if (!ctx.skel) {
+		fprintf(stderr, "failed to open skeleton\n");
+		exit(1);
+	}
+
+	map = ctx.skel->maps.hash_map_bench;
+	bpf_map__set_type(map, type);
+	bpf_map__set_max_entries(map, args.max_entries);
+	if (type == BPF_MAP_TYPE_RHASH)
+		bpf_map__set_map_flags(map, BPF_F_NO_PREALLOC);
+
+	ctx.skel->bss->nr_entries = args.nr_entries;
+
+	bpf_program__set_autoload(ctx.skel->progs.benchmark_lookup, lookup);
+	bpf_program__set_autoload(ctx.skel->progs.benchmark_update, !lookup);
+
+	if (rhash_map_bench__load(ctx.skel)) {
+		fprintf(stderr, "failed to load skeleton\n");
+		exit(1);
+	}
+
+	/* the update program is run by producer_update() */
+	if (!lookup)
+		return;
+
+	fd = bpf_map__fd(map);
+	for (key = 0; key < args.nr_entries; key++) {
+		if (bpf_map_update_elem(fd, &key, &value, BPF_NOEXIST)) {
+			fprintf(stderr, "failed to populate map\n");
+			exit(1);
+		}
+	}
+
+	ctx.link = bpf_program__attach(ctx.skel->progs.benchmark_lookup);
+	if (!ctx.link) {
+		fprintf(stderr, "failed to attach program\n");
+		exit(1);
+	}
+}
+
+static void htab_lookup_setup(void)
+{
+	setup(BPF_MAP_TYPE_HASH, true);
+}
+
+static void rhtab_lookup_setup(void)
+{
+	setup(BPF_MAP_TYPE_RHASH, true);
+}
+
+static void htab_update_setup(void)
+{
+	setup(BPF_MAP_TYPE_HASH, false);
+}
+
+static void rhtab_update_setup(void)
+{
+	setup(BPF_MAP_TYPE_RHASH, false);
+}
+
+/* The memory the kernel charges for the map, as reported in fdinfo */
+static long map_memlock(int fd)
+{
+	char path[64], line[128];
+	long memlock = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", fd);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "memlock:\t%ld", &memlock) == 1)
+			break;
+	}
+	fclose(f);
+
+	return memlock;
+}
+
+static void report_final(struct bench_res res[], int res_cnt)
+{
+	long memlock = map_memlock(bpf_map__fd(ctx.skel->maps.hash_map_bench));
+
+	hits_drops_report_final(res, res_cnt);
+	printf("Map memory:     %ld KiB (nr_entries %u, max_entries %u)\n",
+	       memlock < 0 ? memlock : memlock / 1024,
+	       args.nr_entries, args.max_entries);
+}
+
+const struct bench bench_htab_lookup = {
+	.name = "htab-lookup",
+	.argp = &bench_rhash_map_argp,
+	.validate = validate,
+	.setup = htab_lookup_setup,
+	.producer_thread = producer,
+	.measure = measure,
+	.report_progress = hits_drops_report_progress,
+	.report_final = report_final,
+};
+
+const struct bench bench_rhtab_lookup = {
+	.name = "rhtab-lookup",
+	.argp = &bench_rhash_map_argp,
+	.validate = validate,
+	.setup = rhtab_lookup_setup,
+	.producer_thread = producer,
+	.measure = measure,
+	.report_progress = hits_drops_report_progress,
+	.report_final = report_final,
+};
+
+const struct bench bench_htab_update = {
+	.name = "htab-update",
+	.argp = &bench_rhash_map_argp,
+	.validate = validate_update,
+	.setup = htab_update_setup,
+	.producer_thread = producer_update,
+	.measure = measure,
+	.report_progress = hits_drops_report_progress,
+	.report_final = report_final,
+};
+
+const struct bench bench_rhtab_update = {
+	.name = "rhtab-update",
+	.argp = &bench_rhash_map_argp,
+	.validate = validate_update,
+	.setup = rhtab_update_setup,
+	.producer_thread = producer_update,
+	.measure = measure,
+	.report_progress = hits_drops_report_progress,
+	.report_final = report_final,
+};
@@ -2,12 +2,20 @@
 /* Copyright (c) 2020, Tessares SA. */
 /* Copyright (c) 2022, SUSE. */
 
+#include <pthread.h>
 #include <test_progs.h>
 #include "cgroup_helpers.h"
 #include "network_helpers.h"
 #include "mptcp_sock.skel.h"
+#include "mptcp_bpf_first.skel.h"
 
 #define NS_TEST "mptcp_ns"
+#define ADDR_1	"10.0.1.1"
+#define ADDR_2	"10.0.1.2"
+#define ADDR_3	"10.0.2.1"
+#define ADDR_4	"10.0.2.2"
+#define PORT_1	10001
+#define TOTAL_BYTES	(10 * 1024 * 1024)
 
 #ifndef TCP_CA_NAME_MAX
 #define TCP_CA_NAME_MAX	16
@@ -182,8 +190,150 @@ static void test_base(void)
 	close(cgroup_fd);
 }
 
+/* Two veth pairs emulate two paths between the same endpoints; the
+ * second path is announced as an additional subflow endpoint.
+ */
+static struct nstoken *sched_init(char *flags, char *sched)
+{
+	struct nstoken *nstoken;
+
+	SYS(fail, "ip netns add %s", NS_TEST);
+	SYS(fail, "ip -net %s link set dev lo up", NS_TEST);
+	SYS(fail, "ip -net %s link add veth1 type veth peer name veth2", NS_TEST);
+	SYS(fail, "ip -net %s addr add %s/24 dev veth1", NS_TEST, ADDR_1);
+	SYS(fail, "ip -net %s link set dev veth1 up", NS_TEST);
+	SYS(fail, "ip -net %s addr add %s/24 dev veth2", NS_TEST, ADDR_2);
+	SYS(fail, "ip -net %s link set dev veth2 up", NS_TEST);
+	SYS(fail, "ip -net %s link add veth3 type veth peer name veth4", NS_TEST);
+	SYS(fail, "ip -net %s addr add %s/24 dev veth3", NS_TEST, ADDR_3);
+	SYS(fail, "ip -net %s link set dev veth3 up", NS_TEST);
+	SYS(fail, "ip -net %s addr add %s/24 dev veth4", NS_TEST, ADDR_4);
+	SYS(fail, "ip -net %s link set dev veth4 up", NS_TEST);
+	SYS(fail, "ip -net %s mptcp endpoint add %s dev veth3 %s",
+	    NS_TEST, ADDR_3, flags);
+	SYS(fail, "ip -net %s mptcp limits set subflow 2 add_addr_accepted 2",
+	    NS_TEST);
+	SYS(fail, "ip netns exec %s sysctl -qw net.mptcp.scheduler=%s",
+	    NS_TEST, sched);
+
+	nstoken = open_netns(NS_TEST);
+	if (!ASSERT_OK_PTR(nstoken, "open_netns"))
+		goto fail;
+
+	return nstoken;
+fail:
+	SYS_NOFAIL("ip netns del " NS_TEST " &> /dev/null");
+	return NULL;
+}
+
+static void sched_cleanup(struct nstoken *nstoken)
+{
+	close_netns(nstoken);
+	SYS_NOFAIL("ip netns del " NS_TEST " &> /dev/null");
+}
+
+static void *recv_data_thread(void *arg)
+{
+	int fd = *(int *)arg;
+	char buf[16384];
+	ssize_t total = 0, ret;
+
+	while (total < TOTAL_BYTES) {
+		ret = recv(fd, buf, sizeof(buf), 0);
+		if (ret <= 0)
+			break;
+		total += ret;
+	}
+
+	return NULL;
+}
+
+/* the scheduler under test runs on the server side, which sends */
+static void send_data(int server_fd, int client_fd)
+{
+	char buf[16384] = {};
+	ssize_t total = 0, ret;
+	pthread_t reader;
+	int fd;
+
+	fd = accept(server_fd, NULL, NULL);
+	if (!ASSERT_GE(fd, 0, "accept"))
+		return;
+
+	if (!ASSERT_OK(pthread_create(&reader, NULL, recv_data_thread, &client_fd),
+		       "pthread_create"))
+		goto out;
+
+	while (total < TOTAL_BYTES) {
+		ret = send(fd, buf, sizeof(buf), 0);
+		if (!ASSERT_GT(ret, 0, "send"))
+			break;
+		total += ret;
+	}
+
+	pthread_join(reader, NULL);
+out:
+	close(fd);
+}
+
+/* returns 0 if the subflow towards @dst has sent some data */
+static int has_bytes_sent(char *dst)
+{
+	char cmd[128];
+
+	snprintf(cmd, sizeof(cmd), "ss -it src %s sport %d dst %s | grep -q bytes_sent:",
+		 ADDR_1, PORT_1, dst);
+	return system(cmd);
+}
+
+static void test_first(void)
+{
+	struct mptcp_bpf_first *first_skel;
+	int server_fd, client_fd;
+	struct nstoken *nstoken;
+	struct bpf_link *link;
+
+	first_skel = mptcp_bpf_first__open_and_load();
+	if (!ASSERT_OK_PTR(first_skel, "bpf_first__open_and_load"))
+		return;
+
+	link = bpf_map__attach_struct_ops(first_skel->maps.first);
+	if (!ASSERT_OK_PTR(link, "bpf_map__attach_struct_ops")) {
+		mptcp_bpf_first__destroy(first_skel);
+		return;
+	}
+
+	nstoken = sched_init("subflow", "bpf_first");
+	if (!nstoken)
+		goto fail;
+
+	server_fd = start_mptcp_server(AF_INET, ADDR_1, PORT_1, 0);
+	if (!ASSERT_GE(server_fd, 0, "start_mptcp_server"))
+		goto cleanup;
+
+	client_fd = connect_to_fd(server_fd, 0);
+	if (!ASSERT_GE(client_fd, 0, "connect_to_fd")) {
+		close(server_fd);
+		goto cleanup;
+	}
+
+	send_data(server_fd, client_fd);
+	ASSERT_OK(has_bytes_sent(ADDR_1), "has_bytes_sent addr_1");
+	ASSERT_GT(has_bytes_sent(ADDR_3), 0, "has_bytes_sent addr_3");
+
+	close(client_fd);
+	close(server_fd);
+cleanup:
+	sched_cleanup(nstoken);
+fail:
+	bpf_link__destroy(link);
+	mptcp_bpf_first__destroy(first_skel);
+}
+
 void test_mptcp(void)
 {
 	if (test__start_subtest("base"))
 		test_base();
+	if (test__start_subtest("first"))
+		test_first();
 }
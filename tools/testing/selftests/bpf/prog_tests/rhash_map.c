@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <test_progs.h>
+
+#define MAX_ENTRIES 4096
+
+static int create_rhash(__u32 max_entries)
+{
+	LIBBPF_OPTS(bpf_map_create_opts, opts, .map_flags = BPF_F_NO_PREALLOC);
+
+	return bpf_map_create(BPF_MAP_TYPE_RHASH, "rhash", sizeof(__u32),
+			      sizeof(__u64), max_entries, &opts);
+}
+
+static void test_rhash_create(void)
+{
+	LIBBPF_OPTS(bpf_map_create_opts, opts);
+	int fd;
+
+	/* elements are always allocated on demand */
+	fd = bpf_map_create(BPF_MAP_TYPE_RHASH, "rhash", sizeof(__u32),
+			    sizeof(__u64), MAX_ENTRIES, &opts);
+	if (!ASSERT_LT(fd, 0, "prealloc"))
+		close(fd);
+
+	fd = create_rhash(0);
+	if (!ASSERT_LT(fd, 0, "max_entries_zero"))
+		close(fd);
+}
+
+static void test_rhash_ops(void)
+{
+	__u32 key, next_key, *prev_key;
+	__u64 value, seen[MAX_ENTRIES / 64] = {};
+	int fd, err, i, nr, nr_seen = 0, pass;
+
+	fd = create_rhash(MAX_ENTRIES);
+	if (!ASSERT_GE(fd, 0, "create_rhash"))
+		return;
+
+	/* fill the map well past the initial table size */
+	for (i = 0; i < MAX_ENTRIES; i++) {
+		key = i;
+		value = i * 2;
+		err = bpf_map_update_elem(fd, &key, &value, BPF_NOEXIST);
+		if (!ASSERT_OK(err, "insert"))
+			goto out;
+	}
+
+	key = MAX_ENTRIES;
+	err = bpf_map_update_elem(fd, &key, &value, BPF_ANY);
+	ASSERT_EQ(err, -E2BIG, "insert_full");
+
+	key = 0;
+	err = bpf_map_update_elem(fd, &key, &value, BPF_NOEXIST);
+	ASSERT_EQ(err, -EEXIST, "insert_existing");
+
+	/* replacing an element works on a full map */
+	value = 42;
+	err = bpf_map_update_elem(fd, &key, &value, BPF_EXIST);
+	ASSERT_OK(err, "replace");
+	err = bpf_map_lookup_elem(fd, &key, &value);
+	ASSERT_OK(err, "lookup_replaced");
+	ASSERT_EQ(value, 42, "replaced_value");
+
+	for (i = 1; i < MAX_ENTRIES; i++) {
+		key = i;
+		err = bpf_map_lookup_elem(fd, &key, &value);
+		if (!ASSERT_OK(err, "lookup") || !ASSERT_EQ(value, i * 2, "value"))
+			goto out;
+	}
+
+	/* A walk racing with the deferred resize of the inserts above may
+	 * see keys twice or miss keys that moved behind it, so only require
+	 * every key to show up within a few walks.
+	 */
+	for (pass = 0; pass < 8; pass++) {
+		nr = 0;
+		prev_key = NULL;
+		while (!bpf_map_get_next_key(fd, prev_key, &next_key)) {
+			if (!ASSERT_LT(next_key, MAX_ENTRIES, "next_key_range") ||
+			    !ASSERT_LT(nr, 4 * MAX_ENTRIES, "nr_steps"))
+				goto out;
+			if (!(seen[next_key / 64] & (1ULL << (next_key % 64))))
+				nr_seen++;
+			seen[next_key / 64] |= 1ULL << (next_key % 64);
+			key = next_key;
+			prev_key = &key;
+			nr++;
+		}
+		if (nr_seen == MAX_ENTRIES)
+			break;
+		/* give the resize worker time to finish */
+		usleep(10000);
+	}
+	ASSERT_EQ(nr_seen, MAX_ENTRIES, "nr_keys");
+
+	for (i = 0; i < MAX_ENTRIES; i++) {
+		key = i;
+		err = bpf_map_delete_elem(fd, &key);
+		if (!ASSERT_OK(err, "delete"))
+			goto out;
+	}
+
+	key = 0;
+	err = bpf_map_delete_elem(fd, &key);
+	ASSERT_EQ(err, -ENOENT, "delete_missing");
+	err = bpf_map_update_elem(fd, &key, &value, BPF_EXIST);
+	ASSERT_EQ(err, -ENOENT, "replace_missing");
+	err = bpf_map_get_next_key(fd, NULL, &next_key);
+	ASSERT_EQ(err, -ENOENT, "empty");
+
+	/* the map can be filled up again once drained */
+	for (i = 0; i < MAX_ENTRIES; i++) {
+		key = i;
+		err = bpf_map_update_elem(fd, &key, &value, BPF_ANY);
+		if (!ASSERT_OK(err, "refill"))
+			goto out;
+	}
+out:
+	close(fd);
+}
+
+void test_rhash_map(void)
+{
+	if (test__start_subtest("create"))
+		test_rhash_create();
+	if (test__start_subtest("ops"))
+		test_rhash_ops();
+}
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: GPL-2.0
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <test_progs.h>
+#include "test_ringbuf_overwrite.skel.h"
+
+#define NR_SAMPLES 1000
+
+struct sample {
+	long seq;
+};
+
+static struct {
+	long first_seq;
+	long last_seq;
+	int cnt;
+	int bad_ring;
+	int gaps;
+} seen;
+
+static int process_sample(void *ctx, void *data, size_t len)
+{
+	int ring = (long)ctx;
+	struct sample *s = data;
+
+	/* everything was produced on CPU 0 */
+	if (ring != 0)
+		seen.bad_ring++;
+
+	if (seen.cnt == 0)
+		seen.first_seq = s->seq;
+	else if (s->seq != seen.last_seq + 1)
+		seen.gaps++;
+
+	seen.last_seq = s->seq;
+	seen.cnt++;
+	return 0;
+}
+
+static void test_ringbuf_overwrite_create(void)
+{
+	LIBBPF_OPTS(bpf_map_create_opts, opts, .map_flags = BPF_F_RB_OVERWRITE);
+	int page_size = getpagesize();
+	int fd;
+
+	fd = bpf_map_create(BPF_MAP_TYPE_RINGBUF, NULL, 0, 0, page_size, &opts);
+	if (ASSERT_GE(fd, 0, "ringbuf_overwrite"))
+		close(fd);
+
+	/* user-space producers can't be overwritten */
+	fd = bpf_map_create(BPF_MAP_TYPE_USER_RINGBUF, NULL, 0, 0, page_size, &opts);
+	if (!ASSERT_LT(fd, 0, "user_ringbuf_overwrite"))
+		close(fd);
+}
+
+static void test_ringbuf_overwrite_percpu(void)
+{
+	LIBBPF_OPTS(bpf_map_create_opts, opts, .map_flags = BPF_F_RB_OVERWRITE);
+	struct test_ringbuf_overwrite *skel;
+	struct ring_buffer *ringbuf = NULL;
+	int page_size = getpagesize();
+	int i, err, nr_cpus, *fds = NULL;
+	cpu_set_t cpu_set, old_cpu_set;
+	bool pinned = false;
+
+	nr_cpus = libbpf_num_possible_cpus();
+	if (!ASSERT_GT(nr_cpus, 0, "nr_cpus"))
+		return;
+
+	fds = calloc(nr_cpus, sizeof(*fds));
+	if (!ASSERT_OK_PTR(fds, "fds"))
+		return;
+	for (i = 0; i < nr_cpus; i++)
+		fds[i] = -1;
+
+	skel = test_ringbuf_overwrite__open();
+	if (!ASSERT_OK_PTR(skel, "skel_open"))
+		goto cleanup;
+
+	err = bpf_map__set_max_entries(skel->maps.ringbuf_percpu, nr_cpus);
+	if (!ASSERT_OK(err, "set_max_entries"))
+		goto cleanup;
+
+	err = test_ringbuf_overwrite__load(skel);
+	if (!ASSERT_OK(err, "skel_load"))
+		goto cleanup;
+
+	for (i = 0; i < nr_cpus; i++) {
+		fds[i] = bpf_map_create(BPF_MAP_TYPE_RINGBUF, NULL, 0, 0,
+					page_size, &opts);
+		if (!ASSERT_GE(fds[i], 0, "ringbuf_create"))
+			goto cleanup;
+
+		err = bpf_map_update_elem(bpf_map__fd(skel->maps.ringbuf_percpu),
+					  &i, &fds[i], BPF_ANY);
+		if (!ASSERT_OK(err, "ringbuf_insert"))
+			goto cleanup;
+
+		/* all rings are polled through the same epoll instance */
+		if (!ringbuf) {
+			ringbuf = ring_buffer__new(fds[i], process_sample,
+						   (void *)(long)i, NULL);
+			if (!ASSERT_OK_PTR(ringbuf, "ring_buffer__new"))
+				goto cleanup;
+		} else {
+			err = ring_buffer__add(ringbuf, fds[i], process_sample,
+					       (void *)(long)i);
+			if (!ASSERT_OK(err, "ring_buffer__add"))
+				goto cleanup;
+		}
+	}
+
+	err = pthread_getaffinity_np(pthread_self(), sizeof(old_cpu_set),
+				     &old_cpu_set);
+	if (!ASSERT_OK(err, "get_thread_affinity"))
+		goto cleanup;
+
+	CPU_ZERO(&cpu_set);
+	CPU_SET(0, &cpu_set);
+	err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+	if (!ASSERT_OK(err, "set_thread_affinity"))
+		goto cleanup;
+	pinned = true;
+
+	skel->bss->pid = getpid();
+
+	err = test_ringbuf_overwrite__attach(skel);
+	if (!ASSERT_OK(err, "skel_attach"))
+		goto cleanup;
+
+	/* produce way more than a page worth of records without consuming */
+	for (i = 0; i < NR_SAMPLES; i++)
+		syscall(__NR_getpgid);
+
+	test_ringbuf_overwrite__detach(skel);
+
+	ASSERT_EQ(skel->bss->total, NR_SAMPLES, "total");
+	ASSERT_EQ(skel->bss->dropped, 0, "dropped");
+	ASSERT_EQ(skel->bss->skipped, 0, "skipped");
+
+	memset(&seen, 0, sizeof(seen));
+	err = ring_buffer__consume(ringbuf);
+	if (!ASSERT_GT(err, 0, "consume"))
+		goto cleanup;
+
+	/* only the newest records survive, in order and without holes */
+	ASSERT_EQ(err, seen.cnt, "consume_cnt");
+	ASSERT_EQ(seen.bad_ring, 0, "bad_ring");
+	ASSERT_EQ(seen.gaps, 0, "gaps");
+	ASSERT_EQ(seen.last_seq, NR_SAMPLES - 1, "last_seq");
+	ASSERT_GT(seen.first_seq, 0, "first_seq");
+	ASSERT_LE(seen.cnt * (sizeof(struct sample) + BPF_RINGBUF_HDR_SZ),
+		  page_size, "cnt");
+
+	/* everything was consumed */
+	err = ring_buffer__consume(ringbuf);
+	ASSERT_EQ(err, 0, "extra_samples");
+
+cleanup:
+	if (pinned)
+		pthread_setaffinity_np(pthread_self(), sizeof(old_cpu_set),
+				       &old_cpu_set);
+	ring_buffer__free(ringbuf);
+	for (i = 0; i < nr_cpus; i++) {
+		if (fds[i] >= 0)
+			close(fds[i]);
+	}
+	free(fds);
+	test_ringbuf_overwrite__destroy(skel);
+}
+
+void test_ringbuf_overwrite(void)
+{
+	if (test__start_subtest("create"))
+		test_ringbuf_overwrite_create();
+	if (test__start_subtest("percpu"))
+		test_ringbuf_overwrite_percpu();
+}
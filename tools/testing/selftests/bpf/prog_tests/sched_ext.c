@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <sched.h>
+#include <sys/wait.h>
+#include <test_progs.h>
+#include "sched_ext.skel.h"
+
+#ifndef SCHED_EXT
+#define SCHED_EXT		7
+#endif
+
+/* from include/linux/sched/ext.h */
+#define SCX_EXIT_UNREG		64
+#define SCX_EXIT_ERROR_BPF	1025
+
+/*
+ * Switch a child to SCHED_EXT and let it sleep and run a number of times.
+ * It exits with 0 if it stayed SCHED_EXT, whichever class ran it.
+ */
+static int run_sched_ext_child(void)
+{
+	struct sched_param param = {};
+	int status, i;
+	pid_t pid;
+
+	pid = fork();
+	if (!ASSERT_GE(pid, 0, "fork"))
+		return -1;
+
+	if (pid == 0) {
+		if (sched_setscheduler(0, SCHED_EXT, &param))
+			exit(1);
+		for (i = 0; i < 100; i++)
+			usleep(1000);
+		exit(sched_getscheduler(0) != SCHED_EXT);
+	}
+
+	if (!ASSERT_EQ(waitpid(pid, &status, 0), pid, "waitpid"))
+		return -1;
+	if (!ASSERT_TRUE(WIFEXITED(status), "child exited"))
+		return -1;
+	return WEXITSTATUS(status);
+}
+
+static void test_fifo(struct sched_ext *skel)
+{
+	struct bpf_link *link;
+
+	link = bpf_map__attach_struct_ops(skel->maps.fifo_ops);
+	if (!ASSERT_OK_PTR(link, "bpf_map__attach_struct_ops"))
+		return;
+
+	ASSERT_OK(run_sched_ext_child(), "child");
+	ASSERT_GE(skel->bss->nr_enqueued, 100, "nr_enqueued");
+	ASSERT_GT(skel->bss->nr_consumed, 0, "nr_consumed");
+	ASSERT_GE(skel->bss->nr_running, 100, "nr_running");
+	ASSERT_EQ(skel->bss->fifo_exit_kind, 0, "fifo_exit_kind");
+
+	bpf_link__destroy(link);
+	ASSERT_EQ(skel->bss->fifo_exit_kind, SCX_EXIT_UNREG, "fifo_exit_kind");
+}
+
+static void test_error(struct sched_ext *skel)
+{
+	struct bpf_link *link;
+	int i;
+
+	link = bpf_map__attach_struct_ops(skel->maps.error_ops);
+	if (!ASSERT_OK_PTR(link, "bpf_map__attach_struct_ops"))
+		return;
+
+	/* the child keeps running on the fair class after the error */
+	ASSERT_OK(run_sched_ext_child(), "child");
+
+	/* disabling is asynchronous to the error */
+	for (i = 0; i < 100 && !skel->bss->error_exit_kind; i++)
+		usleep(10000);
+	ASSERT_EQ(skel->bss->error_exit_kind, SCX_EXIT_ERROR_BPF,
+		  "error_exit_kind");
+	ASSERT_STRNEQ(skel->bss->error_exit_msg, "injected error for pid",
+		      strlen("injected error for pid"), "error_exit_msg");
+
+	bpf_link__destroy(link);
+
+	/* a new BPF scheduler can be loaded after an error */
+	skel->bss->fifo_exit_kind = 0;
+	skel->bss->nr_enqueued = 0;
+	link = bpf_map__attach_struct_ops(skel->maps.fifo_ops);
+	if (!ASSERT_OK_PTR(link, "reattach fifo_ops"))
+		return;
+	ASSERT_OK(run_sched_ext_child(), "child after error");
+	ASSERT_GT(skel->bss->nr_enqueued, 0, "nr_enqueued after error");
+	bpf_link__destroy(link);
+}
+
+void serial_test_sched_ext(void)
+{
+	struct sched_ext *skel;
+
+	skel = sched_ext__open_and_load();
+	if (!ASSERT_OK_PTR(skel, "sched_ext__open_and_load"))
+		return;
+
+	if (test__start_subtest("fifo"))
+		test_fifo(skel);
+	if (test__start_subtest("error"))
+		test_error(skel);
+
+	sched_ext__destroy(skel);
+}
@@ -0,0 +1,236 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <unistd.h>
+#include <test_progs.h>
+#include "uprobe_multi.skel.h"
+#include "trace_helpers.h"
+
+#define NR_FUNCS 3
+
+/* uprobe attach points */
+noinline void uprobe_multi_func_1(void)
+{
+	asm volatile ("");
+}
+
+noinline void uprobe_multi_func_2(void)
+{
+	asm volatile ("");
+}
+
+noinline void uprobe_multi_func_3(void)
+{
+	asm volatile ("");
+}
+
+static void (*funcs[NR_FUNCS])(void) = {
+	uprobe_multi_func_1,
+	uprobe_multi_func_2,
+	uprobe_multi_func_3,
+};
+
+static int uprobe_multi_attach(struct bpf_program *prog, bool retprobe,
+			       unsigned long *offsets, __u64 *cookies,
+			       __u32 cnt, pid_t pid)
+{
+	LIBBPF_OPTS(bpf_link_create_opts, opts,
+		.uprobe_multi.path = "/proc/self/exe",
+		.uprobe_multi.offsets = offsets,
+		.uprobe_multi.cookies = cookies,
+		.uprobe_multi.cnt = cnt,
+		.uprobe_multi.pid = pid,
+		.uprobe_multi.flags = retprobe ? BPF_F_UPROBE_MULTI_RETURN : 0,
+	);
+
+	return bpf_link_create(bpf_program__fd(prog), 0, BPF_TRACE_UPROBE_MULTI, &opts);
+}
+
+static void test_attach(pid_t filter_pid)
+{
+	int link_fd = -1, retlink_fd = -1;
+	unsigned long offsets[NR_FUNCS];
+	__u64 cookies[NR_FUNCS];
+	struct uprobe_multi *skel;
+	ssize_t offset;
+	int i;
+
+	skel = uprobe_multi__open_and_load();
+	if (!ASSERT_OK_PTR(skel, "uprobe_multi__open_and_load"))
+		return;
+
+	for (i = 0; i < NR_FUNCS; i++) {
+		offset = get_uprobe_offset(funcs[i]);
+		if (!ASSERT_GE(offset, 0, "get_uprobe_offset"))
+			goto cleanup;
+		offsets[i] = offset;
+		cookies[i] = i + 1;
+		skel->bss->func_addr[i] = (__u64)(uintptr_t)funcs[i];
+	}
+	skel->bss->pid = getpid();
+
+	link_fd = uprobe_multi_attach(skel->progs.test_uprobe, false, offsets,
+				      cookies, NR_FUNCS, filter_pid);
+	if (!ASSERT_GE(link_fd, 0, "link_create"))
+		goto cleanup;
+
+	retlink_fd = uprobe_multi_attach(skel->progs.test_uretprobe, true, offsets,
+					 cookies, NR_FUNCS, filter_pid);
+	if (!ASSERT_GE(retlink_fd, 0, "retlink_create"))
+		goto cleanup;
+
+	for (i = 0; i < NR_FUNCS; i++)
+		funcs[i]();
+
+	for (i = 0; i < NR_FUNCS; i++) {
+		ASSERT_EQ(skel->bss->entry_result[i], 1, "entry_result");
+		ASSERT_EQ(skel->bss->return_result[i], 1, "return_result");
+	}
+	ASSERT_EQ(skel->bss->bad_hits, 0, "bad_hits");
+
+	/* nothing fires once the links are gone */
+	close(link_fd);
+	close(retlink_fd);
+	link_fd = retlink_fd = -1;
+
+	for (i = 0; i < NR_FUNCS; i++)
+		funcs[i]();
+
+	for (i = 0; i < NR_FUNCS; i++) {
+		ASSERT_EQ(skel->bss->entry_result[i], 1, "entry_result_detached");
+		ASSERT_EQ(skel->bss->return_result[i], 1, "return_result_detached");
+	}
+
+cleanup:
+	if (link_fd >= 0)
+		close(link_fd);
+	if (retlink_fd >= 0)
+		close(retlink_fd);
+	uprobe_multi__destroy(skel);
+}
+
+static void test_bad_args(void)
+{
+	LIBBPF_OPTS(bpf_link_create_opts, opts);
+	unsigned long offset, offset_2, bad_offset = LONG_MAX;
+	int prog_fd, link_fd, good_link_fd = -1;
+	struct uprobe_multi *skel;
+	ssize_t uprobe_offset;
+
+	skel = uprobe_multi__open_and_load();
+	if (!ASSERT_OK_PTR(skel, "uprobe_multi__open_and_load"))
+		return;
+
+	uprobe_offset = get_uprobe_offset(uprobe_multi_func_1);
+	if (!ASSERT_GE(uprobe_offset, 0, "get_uprobe_offset"))
+		goto cleanup;
+	offset = uprobe_offset;
+
+	uprobe_offset = get_uprobe_offset(uprobe_multi_func_2);
+	if (!ASSERT_GE(uprobe_offset, 0, "get_uprobe_offset"))
+		goto cleanup;
+	offset_2 = uprobe_offset;
+
+	prog_fd = bpf_program__fd(skel->progs.test_uprobe);
+
+	/* no path */
+	opts.uprobe_multi.offsets = &offset;
+	opts.uprobe_multi.cnt = 1;
+	link_fd = bpf_link_create(prog_fd, 0, BPF_TRACE_UPROBE_MULTI, &opts);
+	if (!ASSERT_EQ(link_fd, -EINVAL, "no_path"))
+		close(link_fd);
+
+	/* no offsets */
+	opts.uprobe_multi.path = "/proc/self/exe";
+	opts.uprobe_multi.offsets = NULL;
+	link_fd = bpf_link_create(prog_fd, 0, BPF_TRACE_UPROBE_MULTI, &opts);
+	if (!ASSERT_EQ(link_fd, -EINVAL, "no_offsets"))
+		close(link_fd);
+
+	/* zero cnt */
+	opts.uprobe_multi.offsets = &offset;
+	opts.uprobe_multi.cnt = 0;
+	link_fd = bpf_link_create(prog_fd, 0, BPF_TRACE_UPROBE_MULTI, &opts);
+	if (!ASSERT_EQ(link_fd, -EINVAL, "zero_cnt"))
+		close(link_fd);
+
+	/* bad flags */
+	opts.uprobe_multi.cnt = 1;
+	opts.uprobe_multi.flags = 1 << 31;
+	link_fd = bpf_link_create(prog_fd, 0, BPF_TRACE_UPROBE_MULTI, &opts);
+	if (!ASSERT_EQ(link_fd, -EINVAL, "bad_flags"))
+		close(link_fd);
+
+	/* not a regular file */
+	opts.uprobe_multi.flags = 0;
+	opts.uprobe_multi.path = "/";
+	link_fd = bpf_link_create(prog_fd, 0, BPF_TRACE_UPROBE_MULTI, &opts);
+	if (!ASSERT_EQ(link_fd, -EBADF, "not_regular"))
+		close(link_fd);
+
+	/* no such pid */
+	opts.uprobe_multi.path = "/proc/self/exe";
+	opts.uprobe_multi.pid = INT_MAX;
+	link_fd = bpf_link_create(prog_fd, 0, BPF_TRACE_UPROBE_MULTI, &opts);
+	if (!ASSERT_EQ(link_fd, -ESRCH, "bad_pid"))
+		close(link_fd);
+
+	/* an offset past the end of the file fails the whole batch */
+	opts.uprobe_multi.pid = 0;
+	opts.uprobe_multi.offsets = (unsigned long []){ offset, bad_offset };
+	opts.uprobe_multi.cnt = 2;
+	link_fd = bpf_link_create(prog_fd, 0, BPF_TRACE_UPROBE_MULTI, &opts);
+	if (!ASSERT_EQ(link_fd, -EINVAL, "bad_offset"))
+		close(link_fd);
+
+	/* so does an offset that is negative as loff_t */
+	opts.uprobe_multi.offsets = (unsigned long []){ offset, -8UL };
+	link_fd = bpf_link_create(prog_fd, 0, BPF_TRACE_UPROBE_MULTI, &opts);
+	if (!ASSERT_EQ(link_fd, -EINVAL, "negative_offset"))
+		close(link_fd);
+
+	skel->bss->pid = getpid();
+	skel->bss->func_addr[0] = (__u64)(uintptr_t)uprobe_multi_func_1;
+	skel->bss->func_addr[1] = (__u64)(uintptr_t)uprobe_multi_func_2;
+
+	/* cookies are func index + 1 */
+	opts.uprobe_multi.offsets = &offset_2;
+	opts.uprobe_multi.cookies = (__u64 []){ 2 };
+	opts.uprobe_multi.cnt = 1;
+	good_link_fd = bpf_link_create(prog_fd, 0, BPF_TRACE_UPROBE_MULTI, &opts);
+	if (!ASSERT_GE(good_link_fd, 0, "good_link"))
+		goto cleanup;
+
+	/*
+	 * The uprobe of func_2 exists already without a ref_ctr_offset, so a
+	 * batch asking for one fails after the uprobe of func_1 was set up.
+	 * That one has to be rolled back, the one of func_2 has to stay.
+	 */
+	opts.uprobe_multi.offsets = (unsigned long []){ offset, offset_2 };
+	opts.uprobe_multi.ref_ctr_offsets = (unsigned long []){ 0, 2 };
+	opts.uprobe_multi.cookies = (__u64 []){ 1, 2 };
+	opts.uprobe_multi.cnt = 2;
+	link_fd = bpf_link_create(prog_fd, 0, BPF_TRACE_UPROBE_MULTI, &opts);
+	if (!ASSERT_EQ(link_fd, -EINVAL, "ref_ctr_mismatch"))
+		close(link_fd);
+
+	uprobe_multi_func_1();
+	uprobe_multi_func_2();
+	ASSERT_EQ(skel->bss->entry_result[0], 0, "no_leftover_probe");
+	ASSERT_EQ(skel->bss->entry_result[1], 1, "good_probe");
+	ASSERT_EQ(skel->bss->bad_hits, 0, "no_leftover_hits");
+
+cleanup:
+	if (good_link_fd >= 0)
+		close(good_link_fd);
+	uprobe_multi__destroy(skel);
+}
+
+void test_uprobe_multi_test(void)
+{
+	if (test__start_subtest("attach"))
+		test_attach(0);
+	if (test__start_subtest("attach_pid"))
+		test_attach(getpid());
+	if (test__start_subtest("bad_args"))
+		test_bad_args();
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include "bpf_misc.h"
+
+char _license[] SEC("license") = "GPL";
+
+struct trie_key {
+	__u32 prefixlen;
+	__u32 data;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_LPM_TRIE);
+	__type(key, struct trie_key);
+	__type(value, __u32);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	/* max_entries is set by userspace */
+} trie_map SEC(".maps");
+
+#define NR_CPUS 256
+#define CPU_MASK (NR_CPUS - 1)
+
+/* Lookups per trigger */
+#define BATCH 256
+
+/* Filled by us */
+struct {
+	long hits;
+	long drops;
+} __attribute__((__aligned__(128))) percpu_stats[NR_CPUS];
+
+static int lookup_callback(__u32 index, void *unused)
+{
+	u32 cpu = bpf_get_smp_processor_id() & CPU_MASK;
+	struct trie_key key = {
+		.prefixlen = 32,
+		.data = bpf_get_prandom_u32(),
+	};
+
+	/* misses still walk the trie, count them separately */
+	if (bpf_map_lookup_elem(&trie_map, &key))
+		percpu_stats[cpu].hits++;
+	else
+		percpu_stats[cpu].drops++;
+	return 0;
+}
+
+SEC("fentry/" SYS_PREFIX "sys_getpgid")
+int benchmark_lookup(void *ctx)
+{
+	bpf_loop(BATCH, lookup_callback, NULL, 0);
+	return 0;
+}
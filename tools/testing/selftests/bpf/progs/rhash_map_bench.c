@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include "bpf_misc.h"
+
+char _license[] SEC("license") = "GPL";
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__type(key, u32);
+	__type(value, u64);
+	/* type, max_entries and map_flags are set by userspace, so the same
+	 * programs run against the fixed and the resizable hash table
+	 */
+} hash_map_bench SEC(".maps");
+
+#define NR_CPUS 256
+#define CPU_MASK (NR_CPUS - 1)
+
+/* Operations per trigger */
+#define BATCH 256
+
+/* Configured by userspace */
+u32 nr_entries;
+
+/* Filled by us */
+struct {
+	long hits;
+	long drops;
+} __attribute__((__aligned__(128))) percpu_stats[NR_CPUS];
+
+/* Next key to update, per CPU */
+u32 __attribute__((__aligned__(128))) percpu_next[NR_CPUS];
+
+static int lookup_callback(__u32 index, void *unused)
+{
+	u32 cpu = bpf_get_smp_processor_id() & CPU_MASK;
+	u32 key = bpf_get_prandom_u32() % nr_entries;
+
+	if (bpf_map_lookup_elem(&hash_map_bench, &key))
+		percpu_stats[cpu].hits++;
+	else
+		percpu_stats[cpu].drops++;
+	return 0;
+}
+
+SEC("fentry/" SYS_PREFIX "sys_getpgid")
+int benchmark_lookup(void *ctx)
+{
+	bpf_loop(BATCH, lookup_callback, NULL, 0);
+	return 0;
+}
+
+/* Each CPU inserts nr_entries keys of its own and then deletes them again,
+ * so the table keeps growing and shrinking while it is being updated.
+ */
+static int update_callback(__u32 index, void *unused)
+{
+	u32 cpu = bpf_get_smp_processor_id() & CPU_MASK;
+	u32 next = percpu_next[cpu];
+	u32 key = (cpu << 24) | (next % nr_entries);
+	u64 value = next;
+	long err;
+
+	if (next / nr_entries % 2 == 0)
+		err = bpf_map_update_elem(&hash_map_bench, &key, &value, BPF_ANY);
+	else
+		err = bpf_map_delete_elem(&hash_map_bench, &key);
+
+	if (err)
+		percpu_stats[cpu].drops++;
+	else
+		percpu_stats[cpu].hits++;
+
+	percpu_next[cpu] = next + 1 < 2 * nr_entries ? next + 1 : 0;
+	return 0;
+}
+
+/* Tracing programs may only look rhash maps up, and sleepable ones can't
+ * use them at all, so run this one as a tc program through BPF_PROG_TEST_RUN.
+ */
+SEC("tc")
+int benchmark_update(struct __sk_buff *skb)
+{
+	bpf_loop(BATCH, update_callback, NULL, 0);
+	return 0;
+}
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+char _license[] SEC("license") = "GPL";
+
+#define FIFO_DSQ	0
+
+s32 scx_bpf_create_dsq(u64 dsq_id, s32 node) __ksym;
+void scx_bpf_dispatch(struct task_struct *p, u64 dsq_id, u64 slice,
+		      u64 enq_flags) __ksym;
+bool scx_bpf_consume(u64 dsq_id) __ksym;
+void scx_bpf_error_bstr(char *fmt, unsigned long long *data,
+			u32 data__sz) __ksym;
+
+u64 nr_enqueued, nr_consumed, nr_running;
+int fifo_exit_kind;
+int error_exit_kind;
+char error_exit_msg[64];
+
+/* SCHED_EXT tasks go through a DSQ created at init time */
+SEC("struct_ops/fifo_enqueue")
+void BPF_PROG(fifo_enqueue, struct task_struct *p, u64 enq_flags)
+{
+	__sync_fetch_and_add(&nr_enqueued, 1);
+	scx_bpf_dispatch(p, FIFO_DSQ, 0, enq_flags);
+}
+
+SEC("struct_ops/fifo_dispatch")
+void BPF_PROG(fifo_dispatch, s32 cpu, struct task_struct *prev)
+{
+	if (scx_bpf_consume(FIFO_DSQ))
+		__sync_fetch_and_add(&nr_consumed, 1);
+}
+
+SEC("struct_ops/fifo_running")
+void BPF_PROG(fifo_running, struct task_struct *p)
+{
+	__sync_fetch_and_add(&nr_running, 1);
+}
+
+SEC("struct_ops/fifo_init")
+s32 BPF_PROG(fifo_init)
+{
+	return scx_bpf_create_dsq(FIFO_DSQ, -1);
+}
+
+SEC("struct_ops/fifo_exit")
+void BPF_PROG(fifo_exit, struct scx_exit_info *ei)
+{
+	fifo_exit_kind = ei->kind;
+}
+
+SEC(".struct_ops")
+struct sched_ext_ops fifo_ops = {
+	.enqueue	= (void *)fifo_enqueue,
+	.dispatch	= (void *)fifo_dispatch,
+	.running	= (void *)fifo_running,
+	.init		= (void *)fifo_init,
+	.exit		= (void *)fifo_exit,
+	.flags		= 1,	/* SCX_OPS_SWITCH_PARTIAL */
+	.name		= "fifo",
+};
+
+/* the first SCHED_EXT enqueue errors out and the kernel takes over */
+SEC("struct_ops/error_enqueue")
+void BPF_PROG(error_enqueue, struct task_struct *p, u64 enq_flags)
+{
+	static char fmt[] = "injected error for pid %d";
+	unsigned long long param[1] = { p->pid };
+
+	scx_bpf_error_bstr(fmt, param, sizeof(param));
+}
+
+SEC("struct_ops/error_exit")
+void BPF_PROG(error_exit, struct scx_exit_info *ei)
+{
+	bpf_probe_read_kernel_str(error_exit_msg, sizeof(error_exit_msg),
+				  ei->msg);
+	error_exit_kind = ei->kind;
+}
+
+SEC(".struct_ops")
+struct sched_ext_ops error_ops = {
+	.enqueue	= (void *)error_enqueue,
+	.exit		= (void *)error_exit,
+	.flags		= 1,	/* SCX_OPS_SWITCH_PARTIAL */
+	.name		= "error",
+};
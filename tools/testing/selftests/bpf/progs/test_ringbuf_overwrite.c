@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+
+char _license[] SEC("license") = "GPL";
+
+struct sample {
+	long seq;
+};
+
+struct ringbuf_map {
+	__uint(type, BPF_MAP_TYPE_RINGBUF);
+	__uint(map_flags, BPF_F_RB_OVERWRITE);
+	/* libbpf will adjust to valid page size */
+	__uint(max_entries, 1000);
+};
+
+/* one overwrite ring buffer per CPU, filled in by user space */
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+	__uint(max_entries, 1);
+	__type(key, int);
+	__array(values, struct ringbuf_map);
+} ringbuf_percpu SEC(".maps");
+
+/* inputs */
+int pid = 0;
+
+/* outputs */
+long total = 0;
+long dropped = 0;
+long skipped = 0;
+
+SEC("tp/syscalls/sys_enter_getpgid")
+int test_ringbuf_overwrite(void *ctx)
+{
+	int cur_pid = bpf_get_current_pid_tgid() >> 32;
+	int cpu = bpf_get_smp_processor_id();
+	struct sample *sample;
+	void *rb;
+
+	if (cur_pid != pid)
+		return 0;
+
+	rb = bpf_map_lookup_elem(&ringbuf_percpu, &cpu);
+	if (!rb) {
+		skipped += 1;
+		return 1;
+	}
+
+	sample = bpf_ringbuf_reserve(rb, sizeof(*sample), 0);
+	if (!sample) {
+		dropped += 1;
+		return 1;
+	}
+
+	sample->seq = total;
+	total += 1;
+
+	bpf_ringbuf_submit(sample, BPF_RB_NO_WAKEUP);
+
+	return 0;
+}
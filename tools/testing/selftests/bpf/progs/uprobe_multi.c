@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+char _license[] SEC("license") = "GPL";
+
+#define NR_FUNCS 3
+
+/* set by user space */
+__u64 func_addr[NR_FUNCS] = {};
+int pid = 0;
+
+/* one hit per function, checked against the cookie */
+__u64 entry_result[NR_FUNCS] = {};
+__u64 return_result[NR_FUNCS] = {};
+__u64 bad_hits = 0;
+
+static void uprobe_multi_check(void *ctx, __u64 *result)
+{
+	__u64 addr = bpf_get_func_ip(ctx);
+	__u64 cookie = bpf_get_attach_cookie(ctx);
+	int i;
+
+	if (bpf_get_current_pid_tgid() >> 32 != pid)
+		return;
+
+	for (i = 0; i < NR_FUNCS; i++) {
+		if (addr != func_addr[i])
+			continue;
+		/* cookies are func index + 1 */
+		if (cookie == i + 1)
+			result[i]++;
+		else
+			bad_hits++;
+		return;
+	}
+	bad_hits++;
+}
+
+SEC("uprobe.multi")
+int test_uprobe(struct pt_regs *ctx)
+{
+	uprobe_multi_check(ctx, entry_result);
+	return 0;
+}
+
+SEC("uretprobe.multi")
+int test_uretprobe(struct pt_regs *ctx)
+{
+	uprobe_multi_check(ctx, return_result);
+	return 0;
+}
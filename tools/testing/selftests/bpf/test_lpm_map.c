@@ -205,11 +205,11 @@ static void test_lpm_order(void)
 	tlpm_clear(l2);
 }
 
-static void test_lpm_map(int keysize)
+static void test_lpm_map(int keysize, size_t max_entries, size_t n_nodes)
 {
 	LIBBPF_OPTS(bpf_map_create_opts, opts, .map_flags = BPF_F_NO_PREALLOC);
 	volatile size_t n_matches, n_matches_after_delete;
-	size_t i, j, n_nodes, n_lookups;
+	size_t i, j, n_lookups;
 	struct tlpm_node *t, *list = NULL;
 	struct bpf_lpm_trie_key *key;
 	uint8_t *data, *value;
@@ -222,7 +222,6 @@ static void test_lpm_map(int keysize)
 
 	n_matches = 0;
 	n_matches_after_delete = 0;
-	n_nodes = 1 << 8;
 	n_lookups = 1 << 16;
 
 	data = alloca(keysize);
@@ -237,7 +236,7 @@ static void test_lpm_map(int keysize)
 	map = bpf_map_create(BPF_MAP_TYPE_LPM_TRIE, NULL,
 			     sizeof(*key) + keysize,
 			     keysize + 1,
-			     4096,
+			     max_entries,
 			     &opts);
 	assert(map >= 0);
 
@@ -254,6 +253,10 @@ static void test_lpm_map(int keysize)
 		assert(!r);
 	}
 
+	/* Give a large trie the time to build its stride table */
+	if (max_entries > 4096)
+		usleep(100 * 1000);
+
 	for (i = 0; i < n_lookups; ++i) {
 		for (j = 0; j < keysize; ++j)
 			data[j] = rand() & 0xff;
@@ -529,6 +532,70 @@ static void test_lpm_delete(void)
 	close(map_fd);
 }
 
+/* A stride table entry must not keep pointing at a deleted node that
+ * doesn't start with the entry's own bits.
+ */
+static void test_lpm_stride_delete(void)
+{
+	LIBBPF_OPTS(bpf_map_create_opts, opts, .map_flags = BPF_F_NO_PREALLOC);
+	struct bpf_lpm_trie_key *key;
+	size_t key_size;
+	__u64 value;
+	int map_fd;
+	__u32 i;
+
+	key_size = sizeof(*key) + sizeof(__u32);
+	key = alloca(key_size);
+
+	map_fd = bpf_map_create(BPF_MAP_TYPE_LPM_TRIE, NULL,
+				key_size, sizeof(value),
+				1 << 16, &opts);
+	assert(map_fd >= 0);
+
+	/* Enough entries, out of the way, for the stride table to be built */
+	value = 0;
+	key->prefixlen = 32;
+	for (i = 0; i < 4096; i++) {
+		*(__u32 *)key->data = htonl(0xc0000000 | i);
+		assert(bpf_map_update_elem(map_fd, key, &value, 0) == 0);
+	}
+	usleep(100 * 1000);
+
+	value = 1;
+	key->prefixlen = 24;
+	inet_pton(AF_INET, "10.0.0.0", key->data);
+	assert(bpf_map_update_elem(map_fd, key, &value, 0) == 0);
+
+	/* 0.0.0.0/4, which 11.0.0.0 gets masked to, above the /24 */
+	value = 2;
+	key->prefixlen = 4;
+	inet_pton(AF_INET, "11.0.0.0", key->data);
+	assert(bpf_map_update_elem(map_fd, key, &value, 0) == 0);
+
+	key->prefixlen = 24;
+	inet_pton(AF_INET, "10.0.0.0", key->data);
+	assert(bpf_map_delete_elem(map_fd, key) == 0);
+
+	key->prefixlen = 32;
+	inet_pton(AF_INET, "11.1.2.3", key->data);
+	assert(bpf_map_lookup_elem(map_fd, key, &value) == 0);
+	assert(value == 2);
+
+	inet_pton(AF_INET, "10.0.0.1", key->data);
+	assert(bpf_map_lookup_elem(map_fd, key, &value) == 0);
+	assert(value == 2);
+
+	key->prefixlen = 4;
+	inet_pton(AF_INET, "11.0.0.0", key->data);
+	assert(bpf_map_delete_elem(map_fd, key) == 0);
+
+	key->prefixlen = 32;
+	inet_pton(AF_INET, "11.1.2.3", key->data);
+	assert(bpf_map_lookup_elem(map_fd, key, &value) == -ENOENT);
+
+	close(map_fd);
+}
+
 static void test_lpm_get_next_key(void)
 {
 	LIBBPF_OPTS(bpf_map_create_opts, opts, .map_flags = BPF_F_NO_PREALLOC);
@@ -785,10 +852,17 @@ int main(void)
 
 	/* Test with 8, 16, 24, 32, ... 128 bit prefix length */
 	for (i = 1; i <= 16; ++i)
-		test_lpm_map(i);
+		test_lpm_map(i, 4096, 1 << 8);
+
+	/* Large tries skip their top through a 16 bit stride table, built
+	 * once they hold 4096 entries
+	 */
+	for (i = 1; i <= 16; i *= 2)
+		test_lpm_map(i, 1 << 16, 1 << 12);
 
 	test_lpm_ipaddr();
 	test_lpm_delete();
+	test_lpm_stride_delete();
 	test_lpm_get_next_key();
 	test_lpm_multi_thread();
 
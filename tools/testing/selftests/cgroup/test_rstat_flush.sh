@@ -0,0 +1,120 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Stress concurrent rstat flushes: many readers of memory.stat and cpu.stat
+# spread over a cgroup tree while tasks in the leaves keep generating
+# updates. Checks that readers make progress and that the stat files stay
+# sane, i.e. that waiting for an ongoing ancestor flush doesn't hang or
+# return garbage.
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+
+CGROUP_ROOT=
+TEST_CG=
+WORK_DIR=
+DURATION=${DURATION:-10}
+NR_CHILDREN=${NR_CHILDREN:-16}
+NR_READERS=${NR_READERS:-$(( $(nproc) * 2 ))}
+PIDS=()
+
+cleanup()
+{
+	local cg
+
+	[ ${#PIDS[@]} -gt 0 ] && kill "${PIDS[@]}" 2>/dev/null
+	wait 2>/dev/null
+	[ -n "$WORK_DIR" ] && rm -rf "$WORK_DIR"
+	[ -n "$TEST_CG" ] || return
+	for cg in "$TEST_CG"/child*/leaf "$TEST_CG"/child*; do
+		[ -d "$cg" ] && rmdir "$cg"
+	done
+	rmdir "$TEST_CG" 2>/dev/null
+}
+trap cleanup EXIT
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "SKIP: must be run as root"
+	exit $ksft_skip
+fi
+
+CGROUP_ROOT=$(awk '$3 == "cgroup2" { print $2; exit }' /proc/mounts)
+if [ -z "$CGROUP_ROOT" ]; then
+	echo "SKIP: cgroup2 is not mounted"
+	exit $ksft_skip
+fi
+
+for ctrl in memory cpu; do
+	if ! grep -qw $ctrl "$CGROUP_ROOT/cgroup.controllers"; then
+		echo "SKIP: $ctrl controller is not available"
+		exit $ksft_skip
+	fi
+done
+
+echo "+memory +cpu" > "$CGROUP_ROOT/cgroup.subtree_control" || exit 1
+
+TEST_CG=$CGROUP_ROOT/test_rstat_flush.$$
+mkdir "$TEST_CG" || exit 1
+echo "+memory +cpu" > "$TEST_CG/cgroup.subtree_control" || exit 1
+
+for i in $(seq $NR_CHILDREN); do
+	mkdir "$TEST_CG/child$i" || exit 1
+	echo "+memory +cpu" > "$TEST_CG/child$i/cgroup.subtree_control" || exit 1
+	mkdir "$TEST_CG/child$i/leaf" || exit 1
+done
+
+WORK_DIR=$(mktemp -d) || exit 1
+
+# Writers: keep rewriting a file from each leaf, which dirties page cache
+# charged to the leaf and burns cpu
+for i in $(seq $NR_CHILDREN); do
+	(
+		echo $BASHPID > "$TEST_CG/child$i/leaf/cgroup.procs"
+		while :; do
+			head -c 1M /dev/zero > "$WORK_DIR/leaf$i"
+		done
+	) &
+	PIDS+=($!)
+done
+
+# Readers: flush the whole tree, the middle level and the leaves at once
+READ_LOG=$(mktemp)
+for i in $(seq $NR_READERS); do
+	(
+		n=0
+		end=$(( SECONDS + DURATION ))
+		child=$TEST_CG/child$(( i % NR_CHILDREN + 1 ))
+		while [ $SECONDS -lt $end ]; do
+			for cg in "$TEST_CG" "$child" "$child/leaf"; do
+				grep -q '^anon ' "$cg/memory.stat" || exit 1
+				grep -q '^usage_usec ' "$cg/cpu.stat" || exit 1
+			done
+			n=$(( n + 1 ))
+		done
+		echo $n >> "$READ_LOG"
+	) &
+	PIDS+=($!)
+done
+
+sleep $(( DURATION + 5 ))
+
+ret=0
+reads=$(wc -l < "$READ_LOG")
+if [ "$reads" -ne "$NR_READERS" ]; then
+	echo "FAIL: only $reads of $NR_READERS readers finished"
+	ret=1
+elif grep -qx 0 "$READ_LOG"; then
+	echo "FAIL: a reader made no progress"
+	ret=1
+fi
+
+usage=$(awk '$1 == "usage_usec" { print $2 }' "$TEST_CG/cpu.stat")
+if [ -z "$usage" ] || [ "$usage" -eq 0 ]; then
+	echo "FAIL: no cpu usage accounted to $TEST_CG"
+	ret=1
+fi
+
+total=$(awk '{ s += $1 } END { print s }' "$READ_LOG")
+rm -f "$READ_LOG"
+[ $ret -eq 0 ] && echo "PASS: $total rounds of concurrent rstat flushes"
+exit $ret
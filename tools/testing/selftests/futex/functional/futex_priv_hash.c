@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Test the PR_FUTEX_HASH prctl, which gives a process its own hash table
+ * for private futexes, and check that private futexes keep working on it.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include "logging.h"
+#include "futextest.h"
+
+#ifndef PR_FUTEX_HASH
+#define PR_FUTEX_HASH			78
+# define PR_FUTEX_HASH_SET_SLOTS	1
+# define PR_FUTEX_HASH_GET_SLOTS	2
+#endif
+
+#define TEST_NAME "futex-priv-hash"
+#define timeout_ns  30000000
+#define WAKE_WAIT_US 10000
+
+static futex_t futex;
+
+void usage(char *prog)
+{
+	printf("Usage: %s\n", prog);
+	printf("  -c	Use color\n");
+	printf("  -h	Display this help message\n");
+	printf("  -v L	Verbosity level: %d=QUIET %d=CRITICAL %d=INFO\n",
+	       VQUIET, VCRITICAL, VINFO);
+}
+
+static void *waiterfn(void *arg)
+{
+	struct timespec to;
+
+	to.tv_sec = 0;
+	to.tv_nsec = timeout_ns;
+
+	if (futex_wait(&futex, 0, &to, FUTEX_PRIVATE_FLAG))
+		printf("waiter failed errno %d\n", errno);
+
+	return NULL;
+}
+
+static int futex_hash_slots_get(void)
+{
+	return prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_GET_SLOTS, 0, 0, 0);
+}
+
+static int futex_hash_slots_set(unsigned long slots)
+{
+	return prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_SET_SLOTS, slots, 0, 0);
+}
+
+int main(int argc, char *argv[])
+{
+	int res, ret = RET_PASS, c;
+	pthread_t waiter;
+
+	while ((c = getopt(argc, argv, "cht:v:")) != -1) {
+		switch (c) {
+		case 'c':
+			log_color(1);
+			break;
+		case 'h':
+			usage(basename(argv[0]));
+			exit(0);
+		case 'v':
+			log_verbosity(atoi(optarg));
+			break;
+		default:
+			usage(basename(argv[0]));
+			exit(1);
+		}
+	}
+
+	ksft_print_header();
+	ksft_set_plan(6);
+	ksft_print_msg("%s: Test the private futex hash prctl\n",
+		       basename(argv[0]));
+
+	/* Nothing allocates a private hash before a second thread exists */
+	res = futex_hash_slots_get();
+	if (res < 0 && errno == EINVAL)
+		ksft_exit_skip("PR_FUTEX_HASH not supported\n");
+	if (res) {
+		ksft_test_result_fail("initial GET_SLOTS returned: %d %s\n",
+				      res, res < 0 ? strerror(errno) : "");
+		ret = RET_FAIL;
+	} else {
+		ksft_test_result_pass("no private hash initially\n");
+	}
+
+	res = prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_GET_SLOTS, 1, 0, 0);
+	if (res != -1 || errno != EINVAL) {
+		ksft_test_result_fail("GET_SLOTS with an argument returned: %d %s\n",
+				      res, res < 0 ? strerror(errno) : "");
+		ret = RET_FAIL;
+	} else {
+		ksft_test_result_pass("GET_SLOTS rejects an argument\n");
+	}
+
+	res = futex_hash_slots_set(1UL << 30);
+	if (res != -1 || errno != EINVAL) {
+		ksft_test_result_fail("SET_SLOTS of 2^30 returned: %d %s\n",
+				      res, res < 0 ? strerror(errno) : "");
+		ret = RET_FAIL;
+	} else {
+		ksft_test_result_pass("SET_SLOTS rejects too many slots\n");
+	}
+
+	/* The slot count is rounded up to a power of two */
+	res = futex_hash_slots_set(5);
+	if (!res)
+		res = futex_hash_slots_get();
+	if (res != 8) {
+		ksft_test_result_fail("SET_SLOTS of 5 gave: %d %s\n",
+				      res, res < 0 ? strerror(errno) : "");
+		ret = RET_FAIL;
+	} else {
+		ksft_test_result_pass("SET_SLOTS rounds up to 8 slots\n");
+	}
+
+	res = futex_hash_slots_set(16);
+	if (res != -1 || errno != EBUSY || futex_hash_slots_get() != 8) {
+		ksft_test_result_fail("second SET_SLOTS returned: %d %s\n",
+				      res, res < 0 ? strerror(errno) : "");
+		ret = RET_FAIL;
+	} else {
+		ksft_test_result_pass("private hash can't be replaced\n");
+	}
+
+	info("Calling private futex_wait on futex: %p\n", &futex);
+	if (pthread_create(&waiter, NULL, waiterfn, NULL))
+		error("pthread_create failed\n", errno);
+
+	usleep(WAKE_WAIT_US);
+
+	info("Calling private futex_wake on futex: %p\n", &futex);
+	res = futex_wake(&futex, 1, FUTEX_PRIVATE_FLAG);
+	if (res != 1) {
+		ksft_test_result_fail("futex_wake private returned: %d %s\n",
+				      errno, strerror(errno));
+		ret = RET_FAIL;
+	} else {
+		ksft_test_result_pass("futex_wake on the private hash succeeds\n");
+	}
+	pthread_join(waiter, NULL);
+
+	ksft_print_cnts();
+	return ret;
+}
@@ -196,6 +196,27 @@ static int tls_recv_cmsg(struct __test_metadata *_metadata,
 	return n;
 }
 
+static long tls_stat_read(const char *name)
+{
+	char key[64];
+	long val;
+	FILE *f;
+
+	f = fopen("/proc/net/tls_stat", "r");
+	if (!f)
+		return -1;
+
+	while (fscanf(f, "%63s %ld", key, &val) == 2) {
+		if (!strcmp(key, name)) {
+			fclose(f);
+			return val;
+		}
+	}
+
+	fclose(f);
+	return -1;
+}
+
 FIXTURE(tls_basic)
 {
 	int fd, cfd;
@@ -449,6 +470,35 @@ TEST_F(tls, recv_max)
 	EXPECT_EQ(memcmp(buf, recv_mem, send_len), 0);
 }
 
+TEST_F(tls, recv_max_zc_stat)
+{
+	unsigned int send_len = TLS_PAYLOAD_MAX_LEN;
+	char recv_mem[TLS_PAYLOAD_MAX_LEN];
+	char buf[TLS_PAYLOAD_MAX_LEN];
+	long zc;
+
+	if (self->notls)
+		SKIP(return, "no TLS support");
+
+	zc = tls_stat_read("TlsRxZeroCopy");
+	if (zc < 0)
+		SKIP(return, "no TlsRxZeroCopy counter");
+
+	/* TLS 1.3 only decrypts in place when no padding is expected */
+	if (variant->tls_version == TLS_1_3_VERSION && !variant->nopad)
+		SKIP(return, "TLS 1.3 zero-copy needs TLS_RX_EXPECT_NO_PAD");
+
+	memrnd(buf, sizeof(buf));
+
+	/* A full record read into a large enough buffer is decrypted in
+	 * place.
+	 */
+	EXPECT_EQ(send(self->fd, buf, send_len, 0), send_len);
+	EXPECT_EQ(recv(self->cfd, recv_mem, send_len, MSG_WAITALL), send_len);
+	EXPECT_EQ(memcmp(buf, recv_mem, send_len), 0);
+	EXPECT_GT(tls_stat_read("TlsRxZeroCopy"), zc);
+}
+
 TEST_F(tls, recv_small)
 {
 	char const *test_str = "test_read";
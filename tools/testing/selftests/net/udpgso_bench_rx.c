@@ -35,11 +35,16 @@
 #define UDP_GRO		104
 #endif
 
+#ifndef UDP_PERCPU_RXQ
+#define UDP_PERCPU_RXQ	105
+#endif
+
 static int  cfg_port		= 8000;
 static bool cfg_tcp;
 static bool cfg_verify;
 static bool cfg_read_all;
 static bool cfg_gro_segment;
+static bool cfg_percpu_rxq;
 static int  cfg_family		= PF_INET6;
 static int  cfg_alen 		= sizeof(struct sockaddr_in6);
 static int  cfg_expected_pkt_nr;
@@ -284,7 +289,7 @@ static void do_flush_udp(int fd)
 
 static void usage(const char *filepath)
 {
-	error(1, 0, "Usage: %s [-C connect_timeout] [-Grtv] [-b addr] [-p port]"
+	error(1, 0, "Usage: %s [-C connect_timeout] [-GQrtv] [-b addr] [-p port]"
 	      " [-l pktlen] [-n packetnr] [-R rcv_timeout] [-S gsosize]",
 	      filepath);
 }
@@ -294,7 +299,7 @@ static void parse_opts(int argc, char **argv)
 	const char *bind_addr = NULL;
 	int c;
 
-	while ((c = getopt(argc, argv, "4b:C:Gl:n:p:rR:S:tv")) != -1) {
+	while ((c = getopt(argc, argv, "4b:C:Gl:n:p:QrR:S:tv")) != -1) {
 		switch (c) {
 		case '4':
 			cfg_family = PF_INET;
@@ -318,6 +323,9 @@ static void parse_opts(int argc, char **argv)
 		case 'p':
 			cfg_port = strtoul(optarg, NULL, 0);
 			break;
+		case 'Q':
+			cfg_percpu_rxq = true;
+			break;
 		case 'r':
 			cfg_read_all = true;
 			break;
@@ -365,6 +373,12 @@ static void do_recv(void)
 			error(1, errno, "setsockopt UDP_GRO");
 	}
 
+	if (cfg_percpu_rxq && !cfg_tcp) {
+		int val = 1;
+		if (setsockopt(fd, IPPROTO_UDP, UDP_PERCPU_RXQ, &val, sizeof(val)))
+			error(1, errno, "setsockopt UDP_PERCPU_RXQ");
+	}
+
 	treport = gettimeofday_ms() + 1000;
 	do {
 		do_poll(fd, timeout_ms);
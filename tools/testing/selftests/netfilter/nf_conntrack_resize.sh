@@ -0,0 +1,149 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Resize the conntrack hash table while UDP flows are being set up across
+# a veth pair between two network namespaces, and check that no entry is
+# lost or duplicated by the resize. The time taken to set up the flows
+# with and without concurrent resizes is printed for comparison.
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+
+readonly hashsize_param=/sys/module/nf_conntrack/parameters/hashsize
+readonly sfx=$(mktemp -u "XXXXXXXX")
+readonly ns1="ns1-$sfx"
+readonly ns2="ns2-$sfx"
+readonly nr_flows=4000
+ret=0
+orig_hashsize=""
+resize_pid=""
+
+cleanup()
+{
+	[ -n "$resize_pid" ] && kill $resize_pid 2>/dev/null && wait $resize_pid
+	[ -n "$orig_hashsize" ] && echo $orig_hashsize > $hashsize_param
+	ip netns del $ns1 2>/dev/null
+	ip netns del $ns2 2>/dev/null
+}
+
+nft --version > /dev/null 2>&1
+if [ $? -ne 0 ];then
+	echo "SKIP: Could not run test without nft tool"
+	exit $ksft_skip
+fi
+
+conntrack -V > /dev/null 2>&1
+if [ $? -ne 0 ];then
+	echo "SKIP: Could not run test without conntrack tool"
+	exit $ksft_skip
+fi
+
+ip -Version > /dev/null 2>&1
+if [ $? -ne 0 ];then
+	echo "SKIP: Could not run test without ip tool"
+	exit $ksft_skip
+fi
+
+modprobe -q nf_conntrack
+if [ ! -w $hashsize_param ]; then
+	echo "SKIP: $hashsize_param is not writable"
+	exit $ksft_skip
+fi
+
+trap cleanup EXIT
+orig_hashsize=$(cat $hashsize_param)
+
+ip netns add $ns1 || exit $ksft_skip
+ip netns add $ns2
+
+ip link add veth1 netns $ns1 type veth peer name veth2 netns $ns2
+ip -net $ns1 link set lo up
+ip -net $ns1 link set veth1 up
+ip -net $ns1 addr add 10.0.1.1/24 dev veth1
+ip -net $ns2 link set lo up
+ip -net $ns2 link set veth2 up
+ip -net $ns2 addr add 10.0.1.2/24 dev veth2
+
+ip netns exec $ns2 nft -f /dev/stdin <<EOF
+table inet filter {
+	chain input {
+		type filter hook input priority 0; policy accept;
+		udp dport 1024-65535 ct state new counter
+	}
+}
+EOF
+if [ $? -ne 0 ]; then
+	echo "SKIP: Could not add conntrack rule in $ns2"
+	exit $ksft_skip
+fi
+
+ip netns exec $ns2 sysctl -q net.netfilter.nf_conntrack_udp_timeout=300
+
+# one flow per destination port starting at $1, sent from bash so no
+# helper is needed
+send_flows()
+{
+	local base=$1
+
+	ip netns exec $ns1 bash -c '
+		for port in $(seq '$base' $(('$base' + '$nr_flows' - 1))); do
+			echo > /dev/udp/10.0.1.2/$port
+		done' 2>/dev/null
+}
+
+time_flows()
+{
+	local what=$1
+	local base=$2
+	local start end
+
+	start=$(date +%s%N)
+	send_flows $base
+	end=$(date +%s%N)
+	echo "$what: $nr_flows flows in $(( (end - start) / 1000000 ))ms"
+}
+
+resize_loop()
+{
+	local size
+
+	while true; do
+		for size in 1024 16384 4096 65536; do
+			echo $size > $hashsize_param
+		done
+	done
+}
+
+# walk the table rather than trusting nf_conntrack_count, which doesn't
+# notice an entry that fell out of its hash chain
+check_count()
+{
+	local what=$1
+	local expect=$2
+	local count
+
+	count=$(ip netns exec $ns2 conntrack -L -p udp 2>/dev/null | wc -l)
+	if [ "$count" -ne "$expect" ]; then
+		echo "FAIL: $what: $count conntrack entries, expected $expect"
+		ret=1
+	else
+		echo "PASS: $what: $count conntrack entries"
+	fi
+}
+
+time_flows "no resize" 2000
+check_count "no resize" $nr_flows
+
+resize_loop &
+resize_pid=$!
+
+# the entries from the first round move while these are inserted
+time_flows "concurrent resize" 20000
+
+kill $resize_pid
+wait $resize_pid 2>/dev/null
+resize_pid=""
+
+check_count "after resize" $((2 * nr_flows))
+
+exit $ret
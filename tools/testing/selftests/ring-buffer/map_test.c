@@ -0,0 +1,343 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Ring-buffer memory mapping tests
+ *
+ * Consumes trace_marker writes of a scratch instance through the mapping
+ * of its per CPU trace_pipe_raw, and checks they come out in order and
+ * that the events the writer overwrote are all accounted for.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/trace_mmap.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../kselftest_harness.h"
+
+#define INSTANCE	"instances/map_test"
+#define MARKER		"map_test: "
+
+/* struct buffer_data_page */
+struct subbuf {
+	__u64	time_stamp;
+	long	commit;
+	char	data[];
+};
+
+/* struct ring_buffer_event */
+struct rb_event {
+	__u32	type_len:5, time_delta:27;
+	__u32	array[];
+};
+
+#define RB_TYPE_PADDING		29
+#define RB_TYPE_TIME_EXTEND	30
+#define RB_TYPE_TIME_STAMP	31
+
+static const char *tracefs;
+
+static int tracefs_write(const char *file, const char *str)
+{
+	char path[256];
+	int fd, ret;
+
+	snprintf(path, sizeof(path), "%s/%s/%s", tracefs, INSTANCE, file);
+	fd = open(path, O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		return -errno;
+
+	ret = write(fd, str, strlen(str));
+	ret = ret < 0 ? -errno : 0;
+	close(fd);
+
+	return ret;
+}
+
+/* Where the next event to read is, across GET_READER calls */
+struct reader {
+	__u32	id;
+	__u32	pos;
+};
+
+struct events {
+	int		nr;
+	int		first;
+	int		last;
+	int		unordered;
+	__u64		lost;
+};
+
+static void parse_event(struct events *ev, const char *data, int len)
+{
+	const char *marker = memmem(data, len, MARKER, strlen(MARKER));
+	int seq;
+
+	if (!marker)
+		return;
+
+	seq = atoi(marker + strlen(MARKER));
+	if (!ev->nr)
+		ev->first = seq;
+	else if (seq != ev->last + 1)
+		ev->unordered++;
+	ev->last = seq;
+	ev->nr++;
+}
+
+/* Read the events of a subbuf between @pos and @end */
+static void read_subbuf(struct events *ev, struct subbuf *subbuf,
+			__u32 pos, __u32 end)
+{
+	while (pos < end) {
+		struct rb_event *event = (void *)(subbuf->data + pos);
+		__u32 len;
+
+		switch (event->type_len) {
+		case RB_TYPE_PADDING:
+			if (!event->time_delta)
+				return;
+			len = event->array[0];
+			break;
+		case RB_TYPE_TIME_EXTEND:
+		case RB_TYPE_TIME_STAMP:
+			len = 4;
+			break;
+		case 0:
+			len = event->array[0];
+			parse_event(ev, (char *)&event->array[1], len - 4);
+			break;
+		default:
+			len = event->type_len * 4;
+			parse_event(ev, (char *)&event->array[0], len);
+			break;
+		}
+		pos += sizeof(*event) + len;
+	}
+}
+
+FIXTURE(map) {
+	struct trace_buffer_meta	*meta;
+	size_t				map_len;
+	int				cpu_fd;
+	int				marker_fd;
+	int				cpu;
+	struct reader			reader;
+};
+
+/* Consume everything the writer committed so far */
+static int consume(FIXTURE_DATA(map) *self, struct events *ev)
+{
+	struct trace_buffer_meta *meta = self->meta;
+	struct subbuf *subbuf;
+
+	for (;;) {
+		if (ioctl(self->cpu_fd, TRACE_MMAP_IOCTL_GET_READER) < 0)
+			return -errno;
+
+		if (meta->reader.id != self->reader.id) {
+			self->reader.id = meta->reader.id;
+			self->reader.pos = 0;
+			ev->lost += meta->reader.lost_events;
+		} else if (meta->reader.read == self->reader.pos) {
+			/* caught up with the writer */
+			return 0;
+		}
+
+		subbuf = (void *)meta + meta->meta_page_size +
+			 meta->subbuf_size * self->reader.id;
+		read_subbuf(ev, subbuf, self->reader.pos, meta->reader.read);
+		self->reader.pos = meta->reader.read;
+	}
+}
+
+static void write_markers(FIXTURE_DATA(map) *self, int from, int to)
+{
+	char buf[32];
+	int i, len;
+
+	for (i = from; i < to; i++) {
+		len = snprintf(buf, sizeof(buf), MARKER "%d\n", i);
+		if (write(self->marker_fd, buf, len) != len)
+			break;
+	}
+}
+
+FIXTURE_SETUP(map)
+{
+	struct trace_buffer_meta *meta;
+	char path[256];
+	cpu_set_t cpus;
+	int page_size = getpagesize();
+
+	if (getuid() != 0)
+		SKIP(return, "Skipping: %s", "Please run the test as root");
+
+	if (!access("/sys/kernel/tracing/trace", F_OK))
+		tracefs = "/sys/kernel/tracing";
+	else if (!access("/sys/kernel/debug/tracing/trace", F_OK))
+		tracefs = "/sys/kernel/debug/tracing";
+	else
+		SKIP(return, "Skipping: %s", "tracefs is not mounted");
+
+	snprintf(path, sizeof(path), "%s/%s", tracefs, INSTANCE);
+	rmdir(path);
+	ASSERT_EQ(mkdir(path, 0755), 0);
+
+	/* Stay on one CPU so that all the markers land in the same buffer */
+	self->cpu = sched_getcpu();
+	ASSERT_GE(self->cpu, 0);
+	CPU_ZERO(&cpus);
+	CPU_SET(self->cpu, &cpus);
+	ASSERT_EQ(sched_setaffinity(0, sizeof(cpus), &cpus), 0);
+
+	/* A handful of subbufs, easy to overflow */
+	ASSERT_EQ(tracefs_write("buffer_size_kb", "16"), 0);
+
+	snprintf(path, sizeof(path), "%s/%s/trace_marker", tracefs, INSTANCE);
+	self->marker_fd = open(path, O_WRONLY);
+	ASSERT_GE(self->marker_fd, 0);
+
+	snprintf(path, sizeof(path), "%s/%s/per_cpu/cpu%d/trace_pipe_raw",
+		 tracefs, INSTANCE, self->cpu);
+	self->cpu_fd = open(path, O_RDONLY | O_NONBLOCK);
+	ASSERT_GE(self->cpu_fd, 0);
+
+	meta = mmap(NULL, page_size, PROT_READ, MAP_SHARED, self->cpu_fd, 0);
+	if (meta == MAP_FAILED && errno == ENODEV)
+		SKIP(return, "Skipping: %s", "trace_pipe_raw can't be mapped");
+	ASSERT_NE(meta, MAP_FAILED);
+
+	self->map_len = meta->meta_page_size +
+			meta->subbuf_size * meta->nr_subbufs;
+	munmap(meta, page_size);
+
+	self->meta = mmap(NULL, self->map_len, PROT_READ, MAP_SHARED,
+			  self->cpu_fd, 0);
+	ASSERT_NE(self->meta, MAP_FAILED);
+
+	self->reader.id = -1;
+	self->reader.pos = 0;
+}
+
+FIXTURE_TEARDOWN(map)
+{
+	char path[256];
+
+	if (self->meta && self->meta != MAP_FAILED)
+		munmap(self->meta, self->map_len);
+	if (self->cpu_fd > 0)
+		close(self->cpu_fd);
+	if (self->marker_fd > 0)
+		close(self->marker_fd);
+
+	if (tracefs) {
+		snprintf(path, sizeof(path), "%s/%s", tracefs, INSTANCE);
+		rmdir(path);
+	}
+}
+
+TEST_F(map, meta_page)
+{
+	struct trace_buffer_meta *meta = self->meta;
+	int page_size = getpagesize();
+	void *map;
+
+	EXPECT_EQ(meta->meta_page_size, page_size);
+	EXPECT_EQ(meta->meta_struct_len, sizeof(*meta));
+	EXPECT_EQ(meta->subbuf_size, page_size);
+	EXPECT_GT(meta->nr_subbufs, 1);
+	EXPECT_EQ(meta->entries, 0);
+
+	/* The pages belong to the writer */
+	map = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   self->cpu_fd, 0);
+	EXPECT_EQ(map, MAP_FAILED);
+	map = mmap(NULL, page_size, PROT_READ, MAP_PRIVATE, self->cpu_fd, 0);
+	EXPECT_EQ(map, MAP_FAILED);
+	EXPECT_NE(mprotect(meta, page_size, PROT_READ | PROT_WRITE), 0);
+
+	/* Nothing past the last subbuf */
+	map = mmap(NULL, self->map_len + page_size, PROT_READ, MAP_SHARED,
+		   self->cpu_fd, 0);
+	EXPECT_EQ(map, MAP_FAILED);
+
+	/* A subbuf alone can be mapped at its offset */
+	map = mmap(NULL, page_size, PROT_READ, MAP_SHARED, self->cpu_fd,
+		   meta->meta_page_size);
+	EXPECT_NE(map, MAP_FAILED);
+	if (map != MAP_FAILED)
+		munmap(map, page_size);
+
+	/* The subbufs can't be resized from under the mapping */
+	EXPECT_EQ(tracefs_write("buffer_size_kb", "32"), -EBUSY);
+}
+
+TEST_F(map, mremap)
+{
+	void *dst, *map;
+
+	/* Room to move the mapping to */
+	dst = mmap(NULL, self->map_len, PROT_NONE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(dst, MAP_FAILED);
+
+	map = mremap(self->meta, self->map_len, self->map_len,
+		     MREMAP_MAYMOVE | MREMAP_FIXED, dst);
+	EXPECT_EQ(map, MAP_FAILED);
+	if (map != MAP_FAILED)
+		self->meta = map;
+	else
+		munmap(dst, self->map_len);
+
+	/* The mapping is still accounted for */
+	EXPECT_EQ(tracefs_write("buffer_size_kb", "32"), -EBUSY);
+	EXPECT_EQ(self->meta->meta_page_size, getpagesize());
+}
+
+TEST_F(map, ordering)
+{
+	struct events ev = {};
+	int round, nr = 100;
+
+	/* Consume while the writer is still on the reader subbuf too */
+	for (round = 0; round < 3; round++) {
+		write_markers(self, round * nr, (round + 1) * nr);
+		ASSERT_EQ(consume(self, &ev), 0);
+		ASSERT_EQ(ev.nr, (round + 1) * nr);
+	}
+
+	EXPECT_EQ(ev.first, 0);
+	EXPECT_EQ(ev.last, 3 * nr - 1);
+	EXPECT_EQ(ev.unordered, 0);
+	EXPECT_EQ(ev.lost, 0);
+	EXPECT_EQ(self->meta->overrun, 0);
+}
+
+TEST_F(map, lost_events)
+{
+	struct events ev = {};
+	int nr = 5000;
+
+	/* Way more than the buffer holds, the writer overwrites the oldest */
+	write_markers(self, 0, nr);
+	ASSERT_EQ(consume(self, &ev), 0);
+
+	EXPECT_GT(ev.lost, 0);
+	EXPECT_EQ(ev.lost, self->meta->overrun);
+	EXPECT_EQ(ev.nr + ev.lost, nr);
+
+	/* What's left are the most recent events, in order */
+	EXPECT_EQ(ev.first, ev.lost);
+	EXPECT_EQ(ev.last, nr - 1);
+	EXPECT_EQ(ev.unordered, 0);
+}
+
+TEST_HARNESS_MAIN